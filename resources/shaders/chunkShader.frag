@@ -0,0 +1,13 @@
+#version 330 core
+out vec4 FragColor;
+// one layer per block texture, uv in blocks so the textures repeat
+uniform sampler2DArray blockTextures;
+
+in vec2 TexCoords;
+in float Shade;
+flat in int TextureLayer;
+void main() {
+    FragColor = texture(blockTextures, vec3(fract(TexCoords), TextureLayer));
+    FragColor.rgb *= Shade;
+    FragColor.a = 1.0;
+}
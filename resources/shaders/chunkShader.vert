@@ -0,0 +1,42 @@
+#version 330 core
+// packed chunk vertex, unpacked like world::Decode in world/vertex-format.hpp
+layout (location = 0) in uint aPosition;
+layout (location = 1) in uint aMaterial;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out float Shade;
+flat out int TextureLayer;
+
+// section origin
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// indexed by Direction
+const vec3 kNormals[6] = vec3[6](
+    vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0),
+    vec3(0.0, -1.0, 0.0), vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0));
+// brightness by ambient occlusion level, 0 fully occluded
+const float kAo[4] = float[4](0.45, 0.65, 0.85, 1.0);
+
+void main()
+{
+    vec3 local = vec3(aPosition & 31u, (aPosition >> 5) & 31u,
+                      (aPosition >> 10) & 31u);
+    vec2 uv = vec2((aPosition >> 15) & 31u, (aPosition >> 20) & 31u);
+    int face = int((aPosition >> 25) & 7u);
+    uint ao = (aPosition >> 28) & 3u;
+    int layer = int(aMaterial & 65535u);
+    float sky = float((aMaterial >> 16) & 15u);
+    float block = float((aMaterial >> 20) & 15u);
+
+    FragPos = vec3(model * vec4(local, 1.0));
+    Normal = mat3(model) * kNormals[face];
+    TexCoords = uv;
+    TextureLayer = layer;
+    Shade = kAo[ao] * (0.1 + 0.9 * max(sky, block) / 15.0);
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,319 @@
+#include "job-system.hpp"
+
+#include <algorithm>
+
+namespace jobs {
+namespace {
+thread_local JobSystem const *current_system = nullptr;
+thread_local size_t current_index = 0;
+}  // namespace
+
+void JobSystem::Queue::Push(JobPtr job) {
+  std::lock_guard lock(mutex_);
+  jobs_.push_back(std::move(job));
+}
+
+JobSystem::JobPtr JobSystem::Queue::PopBack() {
+  std::lock_guard lock(mutex_);
+  if (jobs_.empty()) {
+    return nullptr;
+  }
+  JobPtr job = std::move(jobs_.back());
+  jobs_.pop_back();
+  return job;
+}
+
+JobSystem::JobPtr JobSystem::Queue::PopFront() {
+  std::lock_guard lock(mutex_);
+  if (jobs_.empty()) {
+    return nullptr;
+  }
+  JobPtr job = std::move(jobs_.front());
+  jobs_.pop_front();
+  return job;
+}
+
+JobSystem::JobSystem(unsigned workers)
+    : main_thread_(std::this_thread::get_id()) {
+  if (workers == 0) {
+    workers = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  }
+  // every worker has to exist before the first one starts stealing
+  for (unsigned i = 0; i < workers; i++) {
+    workers_.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < workers_.size(); i++) {
+    workers_[i]->thread = std::jthread([this, i] { WorkerLoop(i); });
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard lock(sleep_mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto &worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+JobHandle JobSystem::Schedule(std::function<void()> function,
+                              Priority priority,
+                              std::span<const JobHandle> dependencies) {
+  auto job = std::make_shared<detail::Job>();
+  job->function = std::move(function);
+  job->priority = priority;
+  return Submit(std::move(job), dependencies);
+}
+
+JobHandle JobSystem::Then(JobHandle const &dependency,
+                          std::function<void()> function, Priority priority) {
+  return Schedule(std::move(function), priority, {&dependency, 1});
+}
+
+JobHandle JobSystem::ScheduleOnMainThread(
+    std::function<void()> function, std::span<const JobHandle> dependencies) {
+  auto job = std::make_shared<detail::Job>();
+  job->function = std::move(function);
+  job->main_thread = true;
+  return Submit(std::move(job), dependencies);
+}
+
+JobHandle JobSystem::ParallelFor(
+    size_t count, size_t grain,
+    std::function<void(size_t begin, size_t end)> function,
+    Priority priority) {
+  grain = std::max<size_t>(grain, 1);
+  // the ranges share one copy of the function
+  auto shared = std::make_shared<decltype(function)>(std::move(function));
+  std::vector<JobHandle> ranges;
+  ranges.reserve((count + grain - 1) / grain);
+  for (size_t begin = 0; begin < count; begin += grain) {
+    const size_t end = std::min(count, begin + grain);
+    ranges.push_back(
+        Schedule([shared, begin, end] { (*shared)(begin, end); }, priority));
+  }
+  // rethrows the exception of the first failed range for Wait()
+  auto join = [ranges] {
+    for (JobHandle const &range : ranges) {
+      if (range.job_->exception) {
+        std::rethrow_exception(range.job_->exception);
+      }
+    }
+  };
+  return Schedule(std::move(join), priority, ranges);
+}
+
+JobHandle JobSystem::Submit(JobPtr job,
+                            std::span<const JobHandle> dependencies) {
+  job->pending.fetch_add(static_cast<uint32_t>(dependencies.size()),
+                         std::memory_order_relaxed);
+  for (JobHandle const &dependency : dependencies) {
+    detail::Job *parent = dependency.job_.get();
+    bool ready = parent == nullptr;
+    if (parent) {
+      std::lock_guard lock(parent->mutex);
+      if (parent->finished) {
+        ready = true;
+      } else {
+        parent->continuations.push_back(job);
+      }
+    }
+    if (ready) {
+      // can't reach zero, the wiring reference is still held
+      job->pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  }
+  JobHandle handle(job);
+  Release(job);
+  return handle;
+}
+
+void JobSystem::Release(JobPtr const &job) {
+  if (job->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    Enqueue(job);
+  }
+}
+
+void JobSystem::Enqueue(JobPtr job) {
+  const auto priority = static_cast<size_t>(job->priority);
+  if (job->main_thread) {
+    main_queues_[priority].Push(std::move(job));
+    return;
+  }
+  // counted first, so a worker can't take it before it is counted
+  queued_.fetch_add(1, std::memory_order_release);
+  if (auto worker = current_worker()) {
+    workers_[*worker]->queues[priority].Push(std::move(job));
+  } else {
+    injected_[priority].Push(std::move(job));
+  }
+  {
+    // pairs with the predicate check of the sleeping workers
+    std::lock_guard lock(sleep_mutex_);
+  }
+  wake_.notify_one();
+}
+
+JobSystem::JobPtr JobSystem::Find(std::optional<size_t> worker) {
+  const size_t count = workers_.size();
+  const size_t start = worker.value_or(0);
+  for (size_t priority = 0; priority < kPriorityCount; priority++) {
+    JobPtr job;
+    if (worker) {
+      job = workers_[*worker]->queues[priority].PopBack();
+    }
+    if (!job) {
+      job = injected_[priority].PopFront();
+    }
+    for (size_t i = 1; !job && i <= count; i++) {
+      const size_t victim = (start + i) % count;
+      if (worker && victim == *worker) {
+        continue;
+      }
+      job = workers_[victim]->queues[priority].PopFront();
+      if (worker) {
+        Worker &self = *workers_[*worker];
+        self.steal_attempts.fetch_add(1, std::memory_order_relaxed);
+        if (job) {
+          self.stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    }
+    if (job) {
+      queued_.fetch_sub(1, std::memory_order_acq_rel);
+      return job;
+    }
+  }
+  return nullptr;
+}
+
+void JobSystem::Run(JobPtr const &job, std::optional<size_t> worker) {
+  try {
+    job->function();
+  } catch (...) {
+    job->exception = std::current_exception();
+  }
+  // releases the captures before the dependents run
+  job->function = nullptr;
+  if (worker) {
+    workers_[*worker]->executed.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::vector<JobPtr> continuations;
+  {
+    std::lock_guard lock(job->mutex);
+    job->finished = true;
+    continuations.swap(job->continuations);
+  }
+  job->done.store(true, std::memory_order_release);
+  for (JobPtr const &continuation : continuations) {
+    Release(continuation);
+  }
+}
+
+bool JobSystem::RunMainThreadJob() {
+  for (auto &queue : main_queues_) {
+    if (JobPtr job = queue.PopFront()) {
+      Run(job, std::nullopt);
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::Wait(JobHandle const &job) {
+  const bool main_thread = is_main_thread();
+  const std::optional<size_t> worker = current_worker();
+  while (!job.done()) {
+    if (main_thread && RunMainThreadJob()) {
+      continue;
+    }
+    if (JobPtr other = Find(worker)) {
+      Run(other, worker);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  if (job.job_ && job.job_->exception) {
+    std::rethrow_exception(job.job_->exception);
+  }
+}
+
+size_t JobSystem::RunMainThreadJobs(std::chrono::nanoseconds budget) {
+  const auto begin = std::chrono::steady_clock::now();
+  size_t count = 0;
+  while (std::chrono::steady_clock::now() - begin < budget &&
+         RunMainThreadJob()) {
+    count++;
+  }
+  return count;
+}
+
+std::optional<size_t> JobSystem::current_worker() const noexcept {
+  if (current_system != this) {
+    return std::nullopt;
+  }
+  return current_index;
+}
+
+void JobSystem::WorkerLoop(size_t index) {
+  current_system = this;
+  current_index = index;
+  Worker &self = *workers_[index];
+  while (true) {
+    if (JobPtr job = Find(index)) {
+      Run(job, index);
+      continue;
+    }
+    const auto begin = std::chrono::steady_clock::now();
+    {
+      std::unique_lock lock(sleep_mutex_);
+      wake_.wait(lock, [this] {
+        return stop_ || queued_.load(std::memory_order_acquire) > 0;
+      });
+      // the queued jobs still run, a job can be counted before it is pushed
+      if (stop_ && queued_.load(std::memory_order_acquire) == 0) {
+        return;
+      }
+    }
+    self.idle_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - begin)
+                               .count(),
+                           std::memory_order_relaxed);
+  }
+}
+
+WorkerStats JobSystem::stats(size_t worker) const {
+  Worker const &self = *workers_.at(worker);
+  WorkerStats stats;
+  stats.executed = self.executed.load(std::memory_order_relaxed);
+  stats.stolen = self.stolen.load(std::memory_order_relaxed);
+  stats.steal_attempts = self.steal_attempts.load(std::memory_order_relaxed);
+  stats.idle =
+      std::chrono::nanoseconds(self.idle_ns.load(std::memory_order_relaxed));
+  return stats;
+}
+
+WorkerStats JobSystem::total_stats() const {
+  WorkerStats total;
+  for (size_t i = 0; i < workers_.size(); i++) {
+    const WorkerStats worker = stats(i);
+    total.executed += worker.executed;
+    total.stolen += worker.stolen;
+    total.steal_attempts += worker.steal_attempts;
+    total.idle += worker.idle;
+  }
+  return total;
+}
+
+void JobSystem::ResetStats() {
+  for (auto &worker : workers_) {
+    worker->executed = 0;
+    worker->stolen = 0;
+    worker->steal_attempts = 0;
+    worker->idle_ns = 0;
+  }
+}
+}  // namespace jobs
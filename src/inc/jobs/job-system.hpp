@@ -0,0 +1,165 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <vector>
+
+/*
+ * Work-stealing job system shared by the engine (meshing, generation,
+ * lighting, asset loading).
+ *
+ * Every worker owns one deque per priority. A worker pushes and pops at the
+ * back of its own deques, idle workers steal from the front of the others.
+ * Jobs scheduled from threads outside the pool go to a shared injection
+ * queue. Higher priorities are always drained first, across all queues.
+ *
+ * A job runs once all of its dependencies finished, so continuations are
+ * expressed as dependencies. Jobs that have to run on the main thread (GL
+ * uploads) are queued separately and executed by RunMainThreadJobs().
+ */
+namespace jobs {
+enum class Priority : uint8_t { kHigh, kNormal, kLow };
+inline constexpr size_t kPriorityCount = 3;
+
+namespace detail {
+struct Job {
+  std::function<void()> function;
+  Priority priority = Priority::kNormal;
+  bool main_thread = false;
+  // unfinished dependencies, plus one held while the job is being wired up
+  std::atomic<uint32_t> pending = 1;
+  std::atomic<bool> done = false;
+  std::exception_ptr exception;
+
+  std::mutex mutex;
+  bool finished = false;
+  std::vector<std::shared_ptr<Job>> continuations;
+};
+}  // namespace detail
+
+class JobHandle final {
+ public:
+  JobHandle() = default;
+
+  [[nodiscard]] bool valid() const noexcept { return job_ != nullptr; }
+  // An empty handle counts as done, so it can be used as a dependency.
+  [[nodiscard]] bool done() const noexcept {
+    return !job_ || job_->done.load(std::memory_order_acquire);
+  }
+
+ private:
+  friend class JobSystem;
+  explicit JobHandle(std::shared_ptr<detail::Job> job) : job_(std::move(job)) {}
+
+  std::shared_ptr<detail::Job> job_;
+};
+
+struct WorkerStats {
+  uint64_t executed = 0;
+  // steal rate = stolen / steal_attempts
+  uint64_t stolen = 0;
+  uint64_t steal_attempts = 0;
+  std::chrono::nanoseconds idle{0};
+};
+
+class JobSystem final {
+ public:
+  // The constructing thread becomes the main thread.
+  // workers == 0 uses one worker per core, minus the main thread.
+  explicit JobSystem(unsigned workers = 0);
+  // Runs the queued jobs and their dependents first. Main thread jobs left
+  // in the queue, and the jobs depending on them, never run.
+  ~JobSystem();
+  JobSystem(JobSystem const &) = delete;
+  JobSystem &operator=(JobSystem const &) = delete;
+
+  JobHandle Schedule(std::function<void()> function,
+                     Priority priority = Priority::kNormal,
+                     std::span<const JobHandle> dependencies = {});
+  JobHandle Then(JobHandle const &dependency, std::function<void()> function,
+                 Priority priority = Priority::kNormal);
+  // The job is only run by RunMainThreadJobs().
+  JobHandle ScheduleOnMainThread(std::function<void()> function,
+                                 std::span<const JobHandle> dependencies = {});
+  // Splits [0, count) into ranges of at most grain elements.
+  // The returned job finishes once every range was processed, and fails
+  // with the exception of the first range that threw, if any.
+  JobHandle ParallelFor(size_t count, size_t grain,
+                        std::function<void(size_t begin, size_t end)> function,
+                        Priority priority = Priority::kNormal);
+
+  // Runs other jobs until the job is done. Rethrows the exception thrown by
+  // the job, if any.
+  void Wait(JobHandle const &job);
+  // Runs main thread jobs until the queue is empty or the budget is used up.
+  // Returns the amount of jobs that ran.
+  size_t RunMainThreadJobs(
+      std::chrono::nanoseconds budget = std::chrono::nanoseconds::max());
+
+  [[nodiscard]] size_t worker_count() const noexcept {
+    return workers_.size();
+  }
+  // Index of the calling worker thread of this system.
+  [[nodiscard]] std::optional<size_t> current_worker() const noexcept;
+  [[nodiscard]] bool is_main_thread() const noexcept {
+    return std::this_thread::get_id() == main_thread_;
+  }
+
+  [[nodiscard]] WorkerStats stats(size_t worker) const;
+  [[nodiscard]] WorkerStats total_stats() const;
+  void ResetStats();
+
+ private:
+  using JobPtr = std::shared_ptr<detail::Job>;
+
+  class Queue final {
+   public:
+    void Push(JobPtr job);
+    JobPtr PopBack();
+    JobPtr PopFront();
+
+   private:
+    std::mutex mutex_;
+    std::deque<JobPtr> jobs_;
+  };
+
+  struct Worker {
+    std::array<Queue, kPriorityCount> queues;
+    std::atomic<uint64_t> executed = 0;
+    std::atomic<uint64_t> stolen = 0;
+    std::atomic<uint64_t> steal_attempts = 0;
+    std::atomic<int64_t> idle_ns = 0;
+    std::jthread thread;
+  };
+
+  JobHandle Submit(JobPtr job, std::span<const JobHandle> dependencies);
+  void Release(JobPtr const &job);
+  void Enqueue(JobPtr job);
+  JobPtr Find(std::optional<size_t> worker);
+  void Run(JobPtr const &job, std::optional<size_t> worker);
+  bool RunMainThreadJob();
+  void WorkerLoop(size_t index);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::array<Queue, kPriorityCount> injected_;
+  std::array<Queue, kPriorityCount> main_queues_;
+  std::thread::id main_thread_;
+
+  // jobs in the worker and injection queues, the workers sleep while 0
+  std::atomic<size_t> queued_ = 0;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+};
+}  // namespace jobs
@@ -381,8 +381,26 @@ std::unique_ptr<Entry> ParsePair(std::span<std::string_view> const& span) {
   std::unique_ptr<Entry> key = ParseLine(lget(*span.begin(), ':'));
   std::vector<std::string_view> vec{span.begin(), span.end()};
   vec[0] = lskip(span[0], ':');
+  // a nested block starts on the next line, its common indentation is
+  // removed so it parses like a top level document
+  if (trim(vec[0]).empty()) {
+    vec[0] = {};
+    size_t indent = std::string::npos;
+    for (size_t i = 1; i < vec.size(); i++) {
+      if (!trim(vec[i]).empty()) {
+        indent = std::min(indent, vec[i].find_first_not_of(' '));
+      }
+    }
+    if (indent != std::string::npos) {
+      for (size_t i = 1; i < vec.size(); i++) {
+        vec[i].remove_prefix(std::min(indent, vec[i].size()));
+      }
+    }
+  }
   remove_empty_strings(vec);
-  std::unique_ptr<Entry> value = Parse(vec);
+  // "key:" without a value is null
+  std::unique_ptr<Entry> value =
+      vec.empty() ? std::make_unique<Entry>(Type::kNull) : Parse(vec);
 
   return std::make_unique<Entry>(std::move(key), std::move(value), nullptr);
 }
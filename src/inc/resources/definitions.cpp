@@ -0,0 +1,91 @@
+#include "definitions.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <thread>
+
+namespace resource {
+namespace {
+struct File {
+  std::string name;
+  Entry const *entry;
+};
+
+void CollectFiles(Entry const &folder, std::string const &path,
+                  std::vector<File> &files) {
+  auto entry_path = [&path](Entry const &entry) {
+    return path.empty() ? entry.name() : path + "/" + entry.name();
+  };
+  for (Entry const &file : folder.files()) {
+    files.push_back({DefinitionName(entry_path(file)), &file});
+  }
+  for (Entry const &directory : folder.directories()) {
+    CollectFiles(directory, entry_path(directory), files);
+  }
+}
+}  // namespace
+
+std::string DefinitionName(std::string_view path) {
+  const size_t slash = path.rfind('/');
+  const size_t file = slash == std::string_view::npos ? 0 : slash + 1;
+  // dot files keep their name
+  if (const size_t dot = path.rfind('.');
+      dot != std::string_view::npos && dot > file) {
+    path = path.substr(0, dot);
+  }
+  std::string name{path};
+  if (const size_t first = name.find('/'); first != std::string::npos) {
+    name[first] = ':';
+  }
+  return name;
+}
+
+DefinitionSet LoadDefinitions(Entry const &folder, unsigned threads) {
+  std::vector<File> files;
+  CollectFiles(folder, "", files);
+  std::stable_sort(files.begin(), files.end(),
+                   [](File const &a, File const &b) { return a.name < b.name; });
+
+  std::vector<std::optional<yaml::Entry>> parsed(files.size());
+  std::vector<std::string> errors(files.size());
+  std::atomic<size_t> next = 0;
+  auto worker = [&] {
+    for (size_t i = next++; i < files.size(); i = next++) {
+      try {
+        parsed[i].emplace(yaml::Parse(files[i].entry->string()));
+      } catch (std::exception const &e) {
+        errors[i] = e.what();
+      }
+    }
+  };
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  threads = static_cast<unsigned>(
+      std::min<size_t>(threads, std::max<size_t>(files.size(), 1)));
+  {
+    std::vector<std::jthread> pool;
+    for (unsigned i = 1; i < threads; i++) {
+      pool.emplace_back(worker);
+    }
+    worker();
+  }
+
+  // merging on one thread in name order keeps the result independent of
+  // the scheduling
+  DefinitionSet result;
+  result.definitions.reserve(files.size());
+  for (size_t i = 0; i < files.size(); i++) {
+    if (!parsed[i]) {
+      result.errors.push_back(files[i].name + ": " + errors[i]);
+    } else if (!result.definitions.empty() &&
+               result.definitions.back().name == files[i].name) {
+      result.errors.push_back(files[i].name + ": duplicate definition");
+    } else {
+      result.definitions.emplace_back(files[i].name, std::move(*parsed[i]));
+    }
+  }
+  return result;
+}
+}  // namespace resource
@@ -0,0 +1,37 @@
+#pragma once
+#include <parsers/yaml/yaml.hpp>
+#include <string>
+#include <vector>
+
+#include "entry.hpp"
+
+/*
+ * Content definitions are YAML files under resources/data. The first folder
+ * level is the namespace, deeper folders become part of the path and the
+ * extension is dropped:
+ *   data/minecraft/dirt          -> minecraft:dirt
+ *   data/mod/ores/copper.yml     -> mod:ores/copper
+ */
+namespace resource {
+struct Definition {
+  Definition(std::string name, yaml::Entry &&yaml)
+      : name(std::move(name)), yaml(std::move(yaml)) {}
+
+  std::string name;
+  yaml::Entry yaml;
+};
+
+struct DefinitionSet {
+  // sorted by name, so ids assigned in this order are deterministic
+  std::vector<Definition> definitions;
+  // "name: reason" for every file that couldn't be parsed, sorted as well
+  std::vector<std::string> errors;
+};
+
+[[nodiscard]] std::string DefinitionName(std::string_view path);
+
+// Enumerates every file below folder, then reads and parses them on a pool
+// of worker threads. threads == 0 uses one thread per core.
+[[nodiscard]] DefinitionSet LoadDefinitions(Entry const &folder,
+                                            unsigned threads = 0);
+}  // namespace resource
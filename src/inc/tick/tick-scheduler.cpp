@@ -0,0 +1,80 @@
+#include "tick-scheduler.hpp"
+
+#include <algorithm>
+
+namespace tick {
+TickScheduler::TickScheduler(std::chrono::nanoseconds tick,
+                             uint32_t max_catch_up)
+    : tick_(tick), max_catch_up_(std::max(max_catch_up, 1u)) {}
+
+bool TickScheduler::Remove(TickHandle handle) {
+  if (!handle.valid() || handle.bucket >= buckets_.size()) {
+    return false;
+  }
+  if (ticking_) {
+    // checked again when applied, the same handle may be queued twice
+    if (!buckets_[handle.bucket]->alive(handle.id, handle.generation)) {
+      return false;
+    }
+    removed_.push_back(handle);
+    return true;
+  }
+  return buckets_[handle.bucket]->Remove(handle.id, handle.generation);
+}
+
+uint32_t TickScheduler::Advance(std::chrono::nanoseconds elapsed) {
+  accumulator_ += elapsed;
+  uint32_t ticks = 0;
+  while (accumulator_ >= tick_ && ticks < max_catch_up_) {
+    Tick();
+    accumulator_ -= tick_;
+    ticks++;
+  }
+  if (accumulator_ >= tick_) {
+    // keep the fraction, so the interpolation stays smooth
+    stats_.skipped += static_cast<uint64_t>(accumulator_ / tick_);
+    accumulator_ %= tick_;
+  }
+  return ticks;
+}
+
+void TickScheduler::Tick() {
+  const auto begin = std::chrono::steady_clock::now();
+  ticking_ = true;
+  // by index, Update() may add buckets of new types
+  for (size_t i = 0; i < buckets_.size(); i++) {
+    buckets_[i]->Tick();
+  }
+  ticking_ = false;
+  for (auto &bucket : buckets_) {
+    bucket->Flush();
+  }
+  for (TickHandle handle : removed_) {
+    buckets_[handle.bucket]->Remove(handle.id, handle.generation);
+  }
+  removed_.clear();
+
+  const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - begin);
+  stats_.ticks++;
+  stats_.last = duration;
+  stats_.max = std::max(stats_.max, duration);
+  stats_.total += duration;
+  if (duration > tick_) {
+    stats_.overruns++;
+  }
+}
+
+float TickScheduler::alpha() const noexcept {
+  return static_cast<float>(accumulator_.count()) /
+         static_cast<float>(tick_.count());
+}
+
+size_t TickScheduler::size() const noexcept {
+  size_t size = 0;
+  for (auto const &bucket : buckets_) {
+    size += bucket->size();
+  }
+  return size;
+}
+}  // namespace tick
@@ -0,0 +1,241 @@
+#pragma once
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*
+ * Fixed timestep game ticks.
+ *
+ * Updatables are stored by value in one bucket per type, so a tick walks
+ * contiguous arrays of the same type and calls T::Update() directly. The
+ * only virtual call is the one per bucket. Buckets tick in the order their
+ * types were first added.
+ *
+ * Objects added or removed during a tick are applied once the tick ends, so
+ * Update() may add and remove freely without invalidating the iteration.
+ */
+namespace tick {
+inline constexpr uint32_t kTicksPerSecond = 20;
+inline constexpr std::chrono::nanoseconds kTickDuration =
+    std::chrono::nanoseconds(std::chrono::seconds(1)) / kTicksPerSecond;
+
+template <typename T>
+concept Tickable = std::movable<T> && requires(T &value) { value.Update(); };
+
+// Ids are reused once their value is removed, the generation tells a stale
+// handle from the one of the value that reused its id.
+struct TickHandle {
+  static constexpr uint32_t kInvalid = UINT32_MAX;
+  uint32_t bucket = kInvalid;
+  uint32_t id = kInvalid;
+  uint32_t generation = 0;
+
+  [[nodiscard]] bool valid() const noexcept { return bucket != kInvalid; }
+  bool operator==(TickHandle const &) const = default;
+};
+
+struct TickStats {
+  uint64_t ticks = 0;
+  // ticks that took longer than the timestep
+  uint64_t overruns = 0;
+  // ticks dropped because the catch-up limit was hit
+  uint64_t skipped = 0;
+  std::chrono::nanoseconds last{0};
+  std::chrono::nanoseconds max{0};
+  std::chrono::nanoseconds total{0};
+
+  [[nodiscard]] std::chrono::nanoseconds average() const noexcept {
+    return ticks == 0 ? std::chrono::nanoseconds(0)
+                      : total / static_cast<int64_t>(ticks);
+  }
+};
+
+namespace detail {
+class BucketBase {
+ public:
+  virtual ~BucketBase() = default;
+  virtual void Tick() = 0;
+  // Moves the values added during the tick into the dense array.
+  virtual void Flush() = 0;
+  // Returns false for a stale handle.
+  virtual bool Remove(uint32_t id, uint32_t generation) = 0;
+  [[nodiscard]] virtual bool alive(uint32_t id,
+                                   uint32_t generation) const noexcept = 0;
+  [[nodiscard]] virtual size_t size() const noexcept = 0;
+};
+
+// Dense array of values with stable ids, removal swaps with the last value.
+template <Tickable T>
+class Bucket final : public BucketBase {
+ public:
+  void Tick() override {
+    for (T &value : values_) {
+      value.Update();
+    }
+  }
+
+  // Deferred values don't touch the array that is being iterated.
+  uint32_t Add(T &&value, bool deferred) {
+    uint32_t id;
+    if (free_ids_.empty()) {
+      id = static_cast<uint32_t>(index_of_id_.size());
+      index_of_id_.push_back(0);
+      generations_.push_back(0);
+    } else {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+    }
+    if (deferred) {
+      index_of_id_[id] = kPending | static_cast<uint32_t>(pending_.size());
+      pending_.push_back(std::move(value));
+      pending_ids_.push_back(id);
+    } else {
+      Insert(id, std::move(value));
+    }
+    return id;
+  }
+
+  void Flush() override {
+    for (size_t i = 0; i < pending_.size(); i++) {
+      Insert(pending_ids_[i], std::move(pending_[i]));
+    }
+    pending_.clear();
+    pending_ids_.clear();
+  }
+
+  bool Remove(uint32_t id, uint32_t generation) override {
+    if (!alive(id, generation)) {
+      return false;
+    }
+    const uint32_t index = index_of_id_[id];
+    const auto last = static_cast<uint32_t>(values_.size() - 1);
+    if (index != last) {
+      values_[index] = std::move(values_[last]);
+      id_of_index_[index] = id_of_index_[last];
+      index_of_id_[id_of_index_[index]] = index;
+    }
+    values_.pop_back();
+    id_of_index_.pop_back();
+    // every handle of the id is stale from now on
+    generations_[id]++;
+    free_ids_.push_back(id);
+    return true;
+  }
+
+  [[nodiscard]] bool alive(uint32_t id,
+                           uint32_t generation) const noexcept override {
+    // a free id is always a generation ahead of its last handle
+    return id < generations_.size() && generations_[id] == generation;
+  }
+  [[nodiscard]] uint32_t generation(uint32_t id) const noexcept {
+    return generations_[id];
+  }
+
+  [[nodiscard]] T &at(uint32_t id, uint32_t generation) {
+    if (!alive(id, generation)) {
+      throw std::out_of_range("Stale tick handle");
+    }
+    const uint32_t index = index_of_id_[id];
+    return index & kPending ? pending_[index & ~kPending] : values_[index];
+  }
+  [[nodiscard]] std::vector<T> &values() noexcept { return values_; }
+  [[nodiscard]] size_t size() const noexcept override {
+    return values_.size() + pending_.size();
+  }
+
+ private:
+  static constexpr uint32_t kPending = 1u << 31;
+
+  void Insert(uint32_t id, T &&value) {
+    index_of_id_[id] = static_cast<uint32_t>(values_.size());
+    values_.push_back(std::move(value));
+    id_of_index_.push_back(id);
+  }
+
+  std::vector<T> values_;
+  std::vector<uint32_t> id_of_index_;
+  std::vector<uint32_t> index_of_id_;
+  std::vector<uint32_t> generations_;
+  std::vector<uint32_t> free_ids_;
+  std::vector<T> pending_;
+  std::vector<uint32_t> pending_ids_;
+};
+}  // namespace detail
+
+class TickScheduler final {
+ public:
+  // At most max_catch_up ticks run per Advance(), a longer backlog is
+  // dropped instead of making the next frames even slower.
+  explicit TickScheduler(std::chrono::nanoseconds tick = kTickDuration,
+                         uint32_t max_catch_up = 10);
+
+  template <Tickable T, typename... Args>
+  TickHandle Add(Args &&...args) {
+    const uint32_t index = BucketIndex<T>();
+    auto &bucket = static_cast<detail::Bucket<T> &>(*buckets_[index]);
+    const uint32_t id = bucket.Add(T(std::forward<Args>(args)...), ticking_);
+    return {index, id, bucket.generation(id)};
+  }
+
+  // Returns false if the value was already removed, a stale handle never
+  // touches the value that reused its id. During a tick the removal is
+  // applied when the tick ends.
+  bool Remove(TickHandle handle);
+
+  // The reference stays valid until the next add or remove of the same type,
+  // or the end of the tick for values added during it. Throws
+  // std::out_of_range for a stale handle.
+  template <Tickable T>
+  [[nodiscard]] T &Get(TickHandle handle) {
+    return static_cast<detail::Bucket<T> &>(*buckets_.at(handle.bucket))
+        .at(handle.id, handle.generation);
+  }
+  template <Tickable T>
+  [[nodiscard]] std::vector<T> &values() {
+    return static_cast<detail::Bucket<T> &>(*buckets_[BucketIndex<T>()])
+        .values();
+  }
+
+  // Adds the elapsed time and runs every tick that is due.
+  // Returns the amount of ticks that ran.
+  uint32_t Advance(std::chrono::nanoseconds elapsed);
+  // Runs a single tick right away.
+  void Tick();
+
+  // How far the time is into the next tick, in [0, 1), for interpolation.
+  [[nodiscard]] float alpha() const noexcept;
+  [[nodiscard]] uint64_t tick_count() const noexcept { return stats_.ticks; }
+  [[nodiscard]] size_t size() const noexcept;
+  [[nodiscard]] TickStats const &stats() const noexcept { return stats_; }
+  void ResetStats() noexcept { stats_ = {}; }
+
+ private:
+  template <Tickable T>
+  uint32_t BucketIndex() {
+    auto [it, inserted] = bucket_ids_.try_emplace(
+        std::type_index(typeid(T)), static_cast<uint32_t>(buckets_.size()));
+    if (inserted) {
+      buckets_.push_back(std::make_unique<detail::Bucket<T>>());
+    }
+    return it->second;
+  }
+
+  std::chrono::nanoseconds tick_;
+  uint32_t max_catch_up_;
+  std::chrono::nanoseconds accumulator_{0};
+
+  std::vector<std::unique_ptr<detail::BucketBase>> buckets_;
+  std::unordered_map<std::type_index, uint32_t> bucket_ids_;
+  bool ticking_ = false;
+  std::vector<TickHandle> removed_;
+
+  TickStats stats_;
+};
+}  // namespace tick
@@ -0,0 +1,159 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*
+ * Fixed-size cache shared by many threads.
+ *
+ * Keys are spread over shards with a lock each, so threads only wait for
+ * each other when they hit the same shard. Inside a shard a key can only be
+ * stored in one set of kWays slots, and a miss replaces the least recently
+ * used slot of that set. The memory held never grows past the capacity.
+ *
+ * Values are immutable and handed out as shared_ptr, so an evicted value
+ * stays valid while a thread is still using it. GetOrCreate() computes a
+ * missing value without holding the lock: two threads missing the same key
+ * at once both compute it and the first one to finish is kept, so create
+ * must be a pure function of the key.
+ */
+namespace utils {
+struct CacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+};
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ConcurrentCache final {
+ public:
+  static constexpr size_t kShards = 16;
+  static constexpr size_t kWays = 4;
+
+  // The capacity is rounded up to a multiple of kShards * kWays.
+  explicit ConcurrentCache(size_t capacity) {
+    sets_ = std::max<size_t>(1, (capacity + kShards * kWays - 1) /
+                                    (kShards * kWays));
+    for (Shard &shard : shards_) {
+      shard.slots.resize(sets_ * kWays);
+    }
+  }
+
+  // nullptr if the key isn't cached.
+  [[nodiscard]] std::shared_ptr<const Value> Find(Key const &key) const {
+    const uint64_t hash = Mix(Hash{}(key));
+    Shard &shard = shards_[hash % kShards];
+    std::lock_guard lock(shard.mutex);
+    if (Slot *slot = Lookup(shard, key, hash)) {
+      shard.hits++;
+      return slot->value;
+    }
+    return nullptr;
+  }
+
+  template <typename Create>
+  std::shared_ptr<const Value> GetOrCreate(Key const &key, Create &&create) {
+    const uint64_t hash = Mix(Hash{}(key));
+    Shard &shard = shards_[hash % kShards];
+    {
+      std::lock_guard lock(shard.mutex);
+      if (Slot *slot = Lookup(shard, key, hash)) {
+        shard.hits++;
+        return slot->value;
+      }
+      shard.misses++;
+    }
+
+    auto value = std::make_shared<const Value>(create(key));
+    std::lock_guard lock(shard.mutex);
+    // another thread may have been faster
+    if (Slot *slot = Lookup(shard, key, hash)) {
+      return slot->value;
+    }
+    Slot *set = &shard.slots[Set(hash) * kWays];
+    Slot *victim = set;
+    for (size_t way = 1; way < kWays; way++) {
+      if (set[way].last_use < victim->last_use) {
+        victim = &set[way];
+      }
+    }
+    if (victim->value) {
+      shard.evictions++;
+    }
+    victim->key = key;
+    victim->value = value;
+    victim->last_use = ++shard.clock;
+    return value;
+  }
+
+  void Clear() {
+    for (Shard &shard : shards_) {
+      std::lock_guard lock(shard.mutex);
+      for (Slot &slot : shard.slots) {
+        slot = Slot{};
+      }
+    }
+  }
+
+  [[nodiscard]] size_t capacity() const noexcept {
+    return kShards * sets_ * kWays;
+  }
+  [[nodiscard]] CacheStats stats() const {
+    CacheStats total;
+    for (Shard const &shard : shards_) {
+      std::lock_guard lock(shard.mutex);
+      total.hits += shard.hits;
+      total.misses += shard.misses;
+      total.evictions += shard.evictions;
+    }
+    return total;
+  }
+
+ private:
+  struct Slot {
+    Key key{};
+    // 0 for empty slots, so they are replaced first
+    uint64_t last_use = 0;
+    std::shared_ptr<const Value> value;
+  };
+  // a cache line each, so the locks of two shards never share one
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    std::vector<Slot> slots;
+    uint64_t clock = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+  };
+
+  // std::hash of integers is often the identity
+  [[nodiscard]] static uint64_t Mix(uint64_t hash) noexcept {
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    return hash ^ (hash >> 33);
+  }
+  [[nodiscard]] size_t Set(uint64_t hash) const noexcept {
+    return static_cast<size_t>((hash / kShards) % sets_);
+  }
+  Slot *Lookup(Shard &shard, Key const &key, uint64_t hash) const {
+    Slot *set = &shard.slots[Set(hash) * kWays];
+    for (size_t way = 0; way < kWays; way++) {
+      if (set[way].value && set[way].key == key) {
+        set[way].last_use = ++shard.clock;
+        return &set[way];
+      }
+    }
+    return nullptr;
+  }
+
+  size_t sets_;
+  mutable std::array<Shard, kShards> shards_;
+};
+}  // namespace utils
@@ -0,0 +1,311 @@
+#pragma once
+#include <concepts>
+#include <cstddef>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "utils/nbt.hpp"
+
+/*
+ * Compile-time bindings between C++ structs and NBT compounds.
+ * The field list is declared once per type by specializing nbt::Schema:
+ *
+ *   struct Furnace {
+ *     int32_t burn_time;
+ *     std::vector<Item> items;            // TAG_LIST of TAG_COMPOUND
+ *     std::vector<int32_t> recipes;       // TAG_INT_ARRAY
+ *     std::optional<std::string> name;    // omitted while empty
+ *   };
+ *   template <>
+ *   struct nbt::Schema<Furnace> {
+ *     static constexpr auto fields = std::make_tuple(
+ *         nbt::field("BurnTime", &Furnace::burn_time),
+ *         nbt::field("Items", &Furnace::items),
+ *         nbt::field("RecipesUsed", &Furnace::recipes),
+ *         nbt::field("CustomName", &Furnace::name));
+ *   };
+ *
+ * encode_struct writes the struct straight into the NBT byte stream and
+ * decode_struct reads it back, without building an intermediate TagCompound.
+ * Unknown tags are skipped, missing tags leave the fields untouched.
+ */
+namespace nbt {
+template <typename Class, typename Member>
+struct Field {
+  std::string_view name;
+  Member Class::*member;
+};
+
+template <typename Class, typename Member>
+constexpr Field<Class, Member> field(std::string_view name,
+                                     Member Class::*member) noexcept {
+  return {name, member};
+}
+
+template <typename T>
+struct Schema;
+
+template <typename T>
+concept Bound = requires { Schema<T>::fields; };
+
+namespace detail {
+template <typename T>
+struct is_vector : std::false_type {};
+template <typename T>
+struct is_vector<std::vector<T>> : std::true_type {};
+
+template <typename T>
+struct is_optional : std::false_type {};
+template <typename T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+template <typename T>
+consteval TagType bound_tag_type() {
+  if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, TagByte>)
+    return TAG_BYTE;
+  else if constexpr (std::is_enum_v<T>)
+    return bound_tag_type<std::underlying_type_t<T>>();
+  else if constexpr (std::is_same_v<T, TagShort>)
+    return TAG_SHORT;
+  else if constexpr (std::is_same_v<T, TagInt>)
+    return TAG_INT;
+  else if constexpr (std::is_same_v<T, TagLong>)
+    return TAG_LONG;
+  else if constexpr (std::is_same_v<T, TagFloat>)
+    return TAG_FLOAT;
+  else if constexpr (std::is_same_v<T, TagDouble>)
+    return TAG_DOUBLE;
+  else if constexpr (std::is_same_v<T, TagString>)
+    return TAG_STRING;
+  else if constexpr (std::is_same_v<T, TagByteArray>)
+    return TAG_BYTE_ARRAY;
+  else if constexpr (std::is_same_v<T, TagIntArray>)
+    return TAG_INT_ARRAY;
+  else if constexpr (std::is_same_v<T, TagLongArray>)
+    return TAG_LONG_ARRAY;
+  else if constexpr (is_vector<T>::value)
+    return TAG_LIST;
+  else if constexpr (is_optional<T>::value)
+    return bound_tag_type<typename T::value_type>();
+  else if constexpr (Bound<T>)
+    return TAG_COMPOUND;
+  else
+    static_assert(Bound<T>, "the type can't be mapped to an NBT tag");
+}
+
+inline void skip_bytes(std::istream &buf, std::size_t size) {
+  buf.ignore(static_cast<std::streamsize>(size));
+}
+
+inline void skip_bytes(std::span<const std::byte> &buf, std::size_t size) {
+  check_available(buf, size);
+  buf = buf.subspan(size);
+}
+
+// Keys are compared in place when decoding from memory.
+inline std::string read_key(std::istream &buf) { return decode_string(buf); }
+
+inline std::string_view read_key(std::span<const std::byte> &buf) {
+  const std::size_t len{decode<std::uint16_t>(buf)};
+  check_available(buf, len);
+  std::string_view key{reinterpret_cast<const char *>(buf.data()), len};
+  buf = buf.subspan(len);
+  return key;
+}
+
+template <typename Buf>
+void skip_tag(Buf &buf, TagByte type) {
+  switch (type) {
+    case TAG_BYTE:
+      return skip_bytes(buf, 1);
+    case TAG_SHORT:
+      return skip_bytes(buf, 2);
+    case TAG_INT:
+    case TAG_FLOAT:
+      return skip_bytes(buf, 4);
+    case TAG_LONG:
+    case TAG_DOUBLE:
+      return skip_bytes(buf, 8);
+    case TAG_BYTE_ARRAY:
+    case TAG_INT_ARRAY:
+    case TAG_LONG_ARRAY: {
+      const std::int32_t len{decode<TagInt>(buf)};
+      if (len < 0) throw std::runtime_error{"invalid array length"};
+      const std::size_t size{type == TAG_BYTE_ARRAY  ? 1u
+                             : type == TAG_INT_ARRAY ? 4u
+                                                     : 8u};
+      return skip_bytes(buf, len * size);
+    }
+    case TAG_STRING:
+      return skip_bytes(buf, decode<std::uint16_t>(buf));
+    case TAG_LIST: {
+      const TagByte element{decode<TagByte>(buf)};
+      const std::int32_t len{decode<TagInt>(buf)};
+      for (std::int32_t i{0}; i < len; i++) skip_tag(buf, element);
+      return;
+    }
+    case TAG_COMPOUND:
+      for (TagByte t{decode<TagByte>(buf)}; t != TAG_END;
+           t = decode<TagByte>(buf)) {
+        skip_bytes(buf, decode<std::uint16_t>(buf));
+        skip_tag(buf, t);
+      }
+      return;
+    default:
+      throw std::runtime_error{"invalid tag type"};
+  }
+}
+
+template <Bound T, typename Buf>
+void encode_fields(Buf &buf, const T &value);
+template <Bound T, typename Buf>
+void decode_fields(Buf &buf, T &value);
+
+template <typename T, typename Buf>
+void encode_payload(Buf &buf, const T &value) {
+  if constexpr (std::is_same_v<T, bool>)
+    encode<TagByte>(buf, value ? 1 : 0);
+  else if constexpr (std::is_enum_v<T>)
+    encode<std::underlying_type_t<T>>(buf,
+                                      static_cast<std::underlying_type_t<T>>(
+                                          value));
+  else if constexpr (std::is_arithmetic_v<T>)
+    encode<T>(buf, value);
+  else if constexpr (std::is_same_v<T, TagString>)
+    encode_string(buf, value);
+  else if constexpr (std::is_same_v<T, TagByteArray> ||
+                     std::is_same_v<T, TagIntArray> ||
+                     std::is_same_v<T, TagLongArray>)
+    encode_array<typename T::value_type>(buf, value);
+  else if constexpr (is_vector<T>::value) {
+    using Element = typename T::value_type;
+    encode<TagByte>(buf, static_cast<TagByte>(
+                             value.empty() ? TAG_END
+                                           : bound_tag_type<Element>()));
+    encode<TagInt>(buf, static_cast<TagInt>(value.size()));
+    for (const Element &element : value) encode_payload(buf, element);
+  } else
+    encode_fields(buf, value);
+}
+
+template <typename T, typename Buf>
+void decode_payload(Buf &buf, T &value) {
+  if constexpr (std::is_same_v<T, bool>)
+    value = decode<TagByte>(buf) != 0;
+  else if constexpr (std::is_enum_v<T>)
+    value = static_cast<T>(decode<std::underlying_type_t<T>>(buf));
+  else if constexpr (std::is_arithmetic_v<T>)
+    value = decode<T>(buf);
+  else if constexpr (std::is_same_v<T, TagString>)
+    value = decode_string(buf);
+  else if constexpr (std::is_same_v<T, TagByteArray> ||
+                     std::is_same_v<T, TagIntArray> ||
+                     std::is_same_v<T, TagLongArray>)
+    value = decode_array<typename T::value_type>(buf);
+  else if constexpr (is_vector<T>::value) {
+    using Element = typename T::value_type;
+    const TagByte type{decode<TagByte>(buf)};
+    const std::int32_t len{decode<TagInt>(buf)};
+    value.clear();
+    if (len <= 0) return;
+    if (type != bound_tag_type<Element>())
+      throw std::runtime_error{"unexpected list element type"};
+    check_available(buf, len);
+    value.resize(len);
+    for (Element &element : value) decode_payload(buf, element);
+  } else
+    decode_fields(buf, value);
+}
+
+template <typename T, typename Buf>
+void encode_field(Buf &buf, std::string_view name, const T &value) {
+  if constexpr (is_optional<T>::value) {
+    if (value) encode_field(buf, name, *value);
+  } else {
+    encode<TagByte>(buf, static_cast<TagByte>(bound_tag_type<T>()));
+    encode<TagShort>(buf, static_cast<TagShort>(name.size()));
+    write_bytes(buf, name.data(), name.size());
+    encode_payload(buf, value);
+  }
+}
+
+template <typename T, typename Buf>
+void decode_field(Buf &buf, TagByte type, T &value) {
+  if (type != bound_tag_type<T>())
+    throw std::runtime_error{"unexpected tag type"};
+  if constexpr (is_optional<T>::value)
+    decode_payload(buf, value.emplace());
+  else
+    decode_payload(buf, value);
+}
+
+template <Bound T, typename Buf>
+void encode_fields(Buf &buf, const T &value) {
+  std::apply(
+      [&](const auto &...fields) {
+        (encode_field(buf, fields.name, value.*(fields.member)), ...);
+      },
+      Schema<T>::fields);
+  encode<TagByte>(buf, TAG_END);
+}
+
+template <Bound T, typename Buf>
+void decode_fields(Buf &buf, T &value) {
+  for (TagByte type{decode<TagByte>(buf)}; type != TAG_END;
+       type = decode<TagByte>(buf)) {
+    const auto key{read_key(buf)};
+    // the fold stops at the first field with a matching name
+    const bool found = std::apply(
+        [&](const auto &...fields) {
+          return ((fields.name == key &&
+                   (decode_field(buf, type, value.*(fields.member)), true)) ||
+                  ...);
+        },
+        Schema<T>::fields);
+    if (!found) skip_tag(buf, type);
+  }
+}
+
+template <Bound T, typename Buf>
+T decode_struct_impl(Buf &buf) {
+  if (decode<TagByte>(buf) != TAG_COMPOUND)
+    throw std::runtime_error{"invalid tag type"};
+  (void)read_key(buf);
+  T value{};
+  decode_fields(buf, value);
+  return value;
+}
+}  // namespace detail
+
+// Writes a complete named root compound, just like NBT::encode, into an
+// std::ostream or appended to an std::vector<std::byte>.
+template <Bound T, typename Buf>
+void encode_struct(Buf &buf, const T &value, std::string_view name = "") {
+  detail::encode<TagByte>(buf, TAG_COMPOUND);
+  detail::encode<TagShort>(buf, static_cast<TagShort>(name.size()));
+  detail::write_bytes(buf, name.data(), name.size());
+  detail::encode_fields(buf, value);
+}
+
+template <Bound T>
+T decode_struct(std::istream &buf) {
+  return detail::decode_struct_impl<T>(buf);
+}
+
+template <Bound T>
+T decode_struct(std::istream &&buf) {
+  return detail::decode_struct_impl<T>(buf);
+}
+
+template <Bound T>
+T decode_struct(std::span<const std::byte> buf) {
+  return detail::decode_struct_impl<T>(buf);
+}
+}  // namespace nbt
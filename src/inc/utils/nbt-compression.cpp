@@ -0,0 +1,222 @@
+#include "nbt-compression.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace nbt {
+namespace {
+// zlib counts bytes with 32-bit integers, so huge buffers are fed in parts
+constexpr std::size_t kMaxChunk = std::numeric_limits<uInt>::max();
+// the initial guess for the size of a stream without a known size is
+// kInflateRatio times the compressed size, but never less than a block
+constexpr std::size_t kInflateBlock = 64 * 1024;
+constexpr std::size_t kInflateRatio = 4;
+// deflate can't expand data by more than about 1032:1, so a size hint beyond
+// that, e.g. a forged gzip trailer, is not believed up front
+constexpr std::size_t kMaxInflateRatio = 1032;
+
+constexpr int WindowBits(Compression compression) noexcept {
+  // 15 is the maximum window, +16 selects the gzip wrapper instead of zlib
+  return compression == Compression::kGzip ? 15 + 16 : 15;
+}
+
+Bytef *AsBytef(std::byte const *ptr) noexcept {
+  return reinterpret_cast<Bytef *>(const_cast<std::byte *>(ptr));
+}
+
+class InflateStream final {
+ public:
+  explicit InflateStream(Compression compression) {
+    if (inflateInit2(&stream, WindowBits(compression)) != Z_OK) {
+      throw std::runtime_error{"failed to initialize zlib inflate"};
+    }
+  }
+  ~InflateStream() { inflateEnd(&stream); }
+  InflateStream(InflateStream const &) = delete;
+  InflateStream &operator=(InflateStream const &) = delete;
+
+  z_stream stream{};
+};
+
+class DeflateStream final {
+ public:
+  DeflateStream(Compression compression, int level) {
+    if (deflateInit2(&stream, level, Z_DEFLATED, WindowBits(compression), 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+      throw std::runtime_error{"failed to initialize zlib deflate"};
+    }
+  }
+  ~DeflateStream() { deflateEnd(&stream); }
+  DeflateStream(DeflateStream const &) = delete;
+  DeflateStream &operator=(DeflateStream const &) = delete;
+
+  z_stream stream{};
+};
+}  // namespace
+
+Compression detect_compression(std::span<const std::byte> data) noexcept {
+  if (data.size() >= 2 && data[0] == std::byte{0x1f} &&
+      data[1] == std::byte{0x8b}) {
+    return Compression::kGzip;
+  }
+  // zlib header: deflate method and a header checksum divisible by 31
+  if (data.size() >= 2 && (std::to_integer<unsigned>(data[0]) & 0x0f) == 8 &&
+      ((std::to_integer<unsigned>(data[0]) << 8) |
+       std::to_integer<unsigned>(data[1])) %
+              31 ==
+          0) {
+    return Compression::kZlib;
+  }
+  return Compression::kNone;
+}
+
+std::vector<std::byte> inflate(std::span<const std::byte> data,
+                               Compression compression,
+                               std::size_t expected_size) {
+  if (compression == Compression::kNone) {
+    return {data.begin(), data.end()};
+  }
+  if (expected_size == 0 && compression == Compression::kGzip &&
+      data.size() >= 18) {
+    // the gzip trailer ends with the uncompressed size modulo 2^32
+    auto tail = data.last(4);
+    for (size_t i = 0; i < 4; i++) {
+      expected_size |= std::to_integer<std::size_t>(tail[i]) << (8 * i);
+    }
+  }
+  const std::size_t limit =
+      std::max(data.size() * kMaxInflateRatio, kInflateBlock);
+  std::vector<std::byte> out(
+      expected_size != 0
+          ? std::min(expected_size, limit)
+          : std::max(data.size() * kInflateRatio, kInflateBlock));
+
+  InflateStream inflater{compression};
+  z_stream &stream = inflater.stream;
+  std::size_t in_pos = 0;
+  std::size_t out_pos = 0;
+  while (true) {
+    if (stream.avail_in == 0) {
+      stream.next_in = AsBytef(data.data() + in_pos);
+      stream.avail_in =
+          static_cast<uInt>(std::min(data.size() - in_pos, kMaxChunk));
+    }
+    if (out_pos == out.size()) {
+      out.resize(out.size() * 2);
+    }
+    const std::size_t out_chunk = std::min(out.size() - out_pos, kMaxChunk);
+    stream.next_out = AsBytef(out.data() + out_pos);
+    stream.avail_out = static_cast<uInt>(out_chunk);
+
+    const uInt avail_in = stream.avail_in;
+    const int ret = ::inflate(&stream, Z_NO_FLUSH);
+    in_pos += avail_in - stream.avail_in;
+    out_pos += out_chunk - stream.avail_out;
+
+    if (ret == Z_STREAM_END) {
+      break;
+    }
+    if (ret == Z_BUF_ERROR && in_pos == data.size() && out_pos < out.size()) {
+      throw std::runtime_error{"unexpected end of compressed NBT"};
+    }
+    if (ret != Z_OK && ret != Z_BUF_ERROR) {
+      throw std::runtime_error{"corrupted compressed NBT"};
+    }
+  }
+  out.resize(out_pos);
+  return out;
+}
+
+std::vector<std::byte> deflate(std::span<const std::byte> data,
+                               Compression compression, int level) {
+  if (compression == Compression::kNone) {
+    return {data.begin(), data.end()};
+  }
+  DeflateStream deflater{compression, level};
+  z_stream &stream = deflater.stream;
+  std::vector<std::byte> out(
+      deflateBound(&stream, static_cast<uLong>(data.size())));
+
+  std::size_t in_pos = 0;
+  std::size_t out_pos = 0;
+  while (true) {
+    if (stream.avail_in == 0) {
+      stream.next_in = AsBytef(data.data() + in_pos);
+      stream.avail_in =
+          static_cast<uInt>(std::min(data.size() - in_pos, kMaxChunk));
+    }
+    if (out_pos == out.size()) {
+      out.resize(out.size() * 2);
+    }
+    const std::size_t out_chunk = std::min(out.size() - out_pos, kMaxChunk);
+    stream.next_out = AsBytef(out.data() + out_pos);
+    stream.avail_out = static_cast<uInt>(out_chunk);
+
+    const uInt avail_in = stream.avail_in;
+    const bool last = in_pos + avail_in == data.size();
+    const int ret = ::deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+    in_pos += avail_in - stream.avail_in;
+    out_pos += out_chunk - stream.avail_out;
+
+    if (ret == Z_STREAM_END) {
+      break;
+    }
+    if (ret != Z_OK && ret != Z_BUF_ERROR) {
+      throw std::runtime_error{"failed to compress NBT"};
+    }
+  }
+  out.resize(out_pos);
+  return out;
+}
+
+NBT decode_compressed(std::span<const std::byte> data,
+                      std::size_t expected_size) {
+  const Compression compression = detect_compression(data);
+  if (compression == Compression::kNone) {
+    return NBT{data};
+  }
+  const std::vector<std::byte> raw = inflate(data, compression, expected_size);
+  return NBT{std::span<const std::byte>{raw}};
+}
+
+std::vector<std::byte> encode_compressed(const NBT &nbt,
+                                         Compression compression, int level) {
+  std::vector<std::byte> raw = nbt.encode();
+  if (compression == Compression::kNone) {
+    return raw;
+  }
+  return deflate(raw, compression, level);
+}
+
+NBT load_file(std::filesystem::path const &path) {
+  std::ifstream file{path, std::ios::binary};
+  if (!file) {
+    throw std::runtime_error{"failed to open " + path.string()};
+  }
+  std::vector<std::byte> data(std::filesystem::file_size(path));
+  file.read(reinterpret_cast<char *>(data.data()),
+            static_cast<std::streamsize>(data.size()));
+  if (!file) {
+    throw std::runtime_error{"failed to read " + path.string()};
+  }
+  return decode_compressed(data);
+}
+
+void save_file(std::filesystem::path const &path, const NBT &nbt,
+               Compression compression) {
+  const std::vector<std::byte> data = encode_compressed(nbt, compression);
+  std::ofstream file{path, std::ios::binary | std::ios::trunc};
+  if (!file) {
+    throw std::runtime_error{"failed to open " + path.string()};
+  }
+  file.write(reinterpret_cast<char const *>(data.data()),
+             static_cast<std::streamsize>(data.size()));
+  if (!file) {
+    throw std::runtime_error{"failed to write " + path.string()};
+  }
+}
+}  // namespace nbt
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include "utils/nbt.hpp"
+
+namespace nbt {
+// Minecraft stores level.dat and structures gzip-compressed, while chunks
+// inside of region files are usually zlib-compressed.
+enum class Compression : std::uint8_t { kNone, kGzip, kZlib };
+
+// Guesses the compression from the magic bytes of the data. Raw NBT always
+// starts with TAG_COMPOUND or TAG_END, which can't be confused with either of
+// the compressed headers.
+[[nodiscard]] Compression detect_compression(
+    std::span<const std::byte> data) noexcept;
+
+// Inflates the whole input into a single contiguous buffer.
+// If the uncompressed size is known (expected_size != 0, or the gzip trailer
+// provides it) the buffer is allocated once and filled with a single inflate
+// call. Otherwise it grows in large blocks until the stream ends. A hint is
+// never trusted beyond the maximum deflate ratio of the input, so untrusted
+// data can't force a large allocation.
+[[nodiscard]] std::vector<std::byte> inflate(std::span<const std::byte> data,
+                                             Compression compression,
+                                             std::size_t expected_size = 0);
+
+// Compresses the input in a single pass into a buffer sized by deflateBound.
+// level follows zlib: -1 is the default, 0 stores, 9 is the slowest.
+[[nodiscard]] std::vector<std::byte> deflate(std::span<const std::byte> data,
+                                             Compression compression,
+                                             int level = -1);
+
+// Decodes possibly compressed NBT. The compression is detected from the data.
+[[nodiscard]] NBT decode_compressed(std::span<const std::byte> data,
+                                    std::size_t expected_size = 0);
+
+[[nodiscard]] std::vector<std::byte> encode_compressed(
+    const NBT &nbt, Compression compression = Compression::kGzip,
+    int level = -1);
+
+// Reads the file with a single read and decodes it in memory.
+[[nodiscard]] NBT load_file(std::filesystem::path const &path);
+
+void save_file(std::filesystem::path const &path, const NBT &nbt,
+               Compression compression = Compression::kGzip);
+}  // namespace nbt
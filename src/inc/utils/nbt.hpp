@@ -18,12 +18,17 @@ Licensed under zlib, see repo License file for details
 #ifndef NBT_HPP
 #define NBT_HPP
 
+#include <algorithm>
 #include <bit>
 #include <concepts>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <map>
 #include <optional>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <variant>
 #include <vector>
@@ -153,6 +158,7 @@ struct NBT : public TagCompound {
   NBT() = default;
   NBT(std::istream &buf) { decode(buf); };
   NBT(std::istream &&buf) { decode(buf); }
+  NBT(std::span<const std::byte> buf) { decode(buf); }
   NBT(const TagCompound &tag) : TagCompound{tag} {}
   NBT(const std::string &name) : name{name} {}
   NBT(const std::string &name, const TagCompound &tag)
@@ -162,13 +168,26 @@ struct NBT : public TagCompound {
 
   void decode(std::istream &buf);
   void decode(std::istream &&buf) { decode(buf); }
+  // decodes straight from memory, without going through a stream
+  void decode(std::span<const std::byte> buf);
 
   void encode(std::ostream &buf) const;
   void encode(std::ostream &&buf) const { encode(buf); }
+  // Exact size of the encoded document in bytes.
+  std::size_t encoded_size() const;
+  // Encodes into a single preallocated buffer with plain stores. The span
+  // overload throws if buf is too small and returns the bytes written.
+  std::vector<std::byte> encode() const;
+  std::size_t encode(std::span<std::byte> buf) const;
 
   operator bool() const { return !name && base.empty(); }
 
  private:
+  template <typename Buf>
+  void decode_impl(Buf &buf);
+  template <typename Buf>
+  void encode_impl(Buf &buf) const;
+
   friend std::ostream &operator<<(std::ostream &os, const NBT &val) {
     os << "\"" << (val.name ? *val.name : "") << "\"\n";
     detail::print_compound(os, "", val);
@@ -204,54 +223,109 @@ inline auto nbeswap(std::integral auto val) noexcept {
   return byteswap(val);
 }
 
-template <std::integral T>
-T decode(std::istream &buf) {
+// Every decoder is templated on the source buffer: either an std::istream or
+// an std::span<const std::byte>, which is consumed from the front as the
+// document is read.
+inline void read_bytes(std::istream &buf, void *dst, std::size_t size) {
+  buf.read(reinterpret_cast<char *>(dst), size);
+}
+
+inline void read_bytes(std::span<const std::byte> &buf, void *dst,
+                       std::size_t size) {
+  if (size > buf.size()) throw std::runtime_error{"unexpected end of NBT"};
+  std::memcpy(dst, buf.data(), size);
+  buf = buf.subspan(size);
+}
+
+// Rejects lengths that cannot possibly fit into the remaining input before
+// anything gets allocated for them. Streams don't know their size up front.
+inline void check_available(std::istream &, std::size_t) {}
+
+inline void check_available(const std::span<const std::byte> &buf,
+                            std::size_t size) {
+  if (size > buf.size()) throw std::runtime_error{"unexpected end of NBT"};
+}
+
+// Encoders are templated on the destination the same way: an std::ostream, a
+// growable std::vector<std::byte> that is appended to, or a raw cursor into
+// memory whose size has already been checked against encoded_size.
+inline void write_bytes(std::ostream &buf, const void *src, std::size_t size) {
+  buf.write(reinterpret_cast<const char *>(src), size);
+}
+
+inline void write_bytes(std::vector<std::byte> &buf, const void *src,
+                        std::size_t size) {
+  const auto *bytes = reinterpret_cast<const std::byte *>(src);
+  buf.insert(buf.end(), bytes, bytes + size);
+}
+
+inline void write_bytes(std::byte *&buf, const void *src, std::size_t size) {
+  std::memcpy(buf, src, size);
+  buf += size;
+}
+
+template <std::integral T, typename Buf>
+T decode(Buf &buf) {
   T val;
-  buf.read(reinterpret_cast<char *>(&val), sizeof(val));
+  read_bytes(buf, &val, sizeof(val));
   return nbeswap(val);
 }
 
-template <std::integral T>
-void encode(std::ostream &buf, const T val) {
+template <std::integral T, typename Buf>
+void encode(Buf &buf, const T val) {
   std::make_unsigned_t<T> out{nbeswap(val)};
-  buf.write(reinterpret_cast<char *>(&out), sizeof(out));
+  write_bytes(buf, &out, sizeof(out));
 }
 
-template <std::floating_point T>
-T decode(std::istream &buf) {
+template <std::floating_point T, typename Buf>
+T decode(Buf &buf) {
   std::conditional_t<sizeof(T) <= sizeof(TagInt), TagInt, TagLong> in;
-  buf.read(reinterpret_cast<char *>(&in), sizeof(in));
+  read_bytes(buf, &in, sizeof(in));
   in = nbeswap(in);
   return std::bit_cast<T, decltype(in)>(in);
 }
 
-template <std::floating_point T>
-void encode(std::ostream &buf, const T val) {
+template <std::floating_point T, typename Buf>
+void encode(Buf &buf, const T val) {
   std::conditional_t<sizeof(T) <= sizeof(TagInt), TagInt, TagLong> out{
       std::bit_cast<decltype(out), T>(val)};
   out = nbeswap(out);
-  buf.write(reinterpret_cast<char *>(&out), sizeof(out));
+  write_bytes(buf, &out, sizeof(out));
 }
 
-template <std::integral T>
-std::vector<T> decode_array(std::istream &buf) {
-  std::int32_t len;
-  buf.read(reinterpret_cast<char *>(&len), sizeof(len));
-  std::vector<T> vec(nbeswap(len));
-  for (auto &el : vec) {
-    buf.read(reinterpret_cast<char *>(&el), sizeof(el));
-    el = nbeswap(el);
-  }
+template <std::integral T, typename Buf>
+std::vector<T> decode_array(Buf &buf) {
+  std::int32_t len{decode<std::int32_t>(buf)};
+  if (len < 0) throw std::runtime_error{"invalid array length"};
+  check_available(buf, len * sizeof(T));
+  std::vector<T> vec(len);
+  // read the whole payload at once, then fix the byte order in place
+  read_bytes(buf, vec.data(), vec.size() * sizeof(T));
+  if constexpr (sizeof(T) > 1)
+    for (auto &el : vec) el = nbeswap(el);
   return vec;
 }
 
-template <std::integral T>
-void encode_array(std::ostream &buf, const std::vector<T> &vec) {
-  std::uint32_t len{nbeswap(static_cast<std::int32_t>(vec.size()))};
-  buf.write(reinterpret_cast<char *>(&len), sizeof(len));
-  for (auto el : vec) {
-    el = nbeswap(el);
-    buf.write(reinterpret_cast<char *>(&el), sizeof(el));
+template <std::integral T, typename Buf>
+void encode_array(Buf &buf, const std::vector<T> &vec) {
+  encode<std::int32_t>(buf, static_cast<std::int32_t>(vec.size()));
+  if constexpr (sizeof(T) == 1) {
+    write_bytes(buf, vec.data(), vec.size());
+  } else if constexpr (std::is_same_v<Buf, std::byte *>) {
+    // swap straight into the destination
+    for (auto el : vec) {
+      el = nbeswap(el);
+      write_bytes(buf, &el, sizeof(el));
+    }
+  } else {
+    // swap in chunks to keep the number of writes down
+    constexpr std::size_t kChunk{256};
+    std::make_unsigned_t<T> tmp[kChunk];
+    for (std::size_t i{0}; i < vec.size(); i += kChunk) {
+      const std::size_t count{std::min(kChunk, vec.size() - i)};
+      for (std::size_t j{0}; j < count; j++) tmp[j] = nbeswap(vec[i + j]);
+      write_bytes(buf, tmp, count * sizeof(T));
+    }
   }
 }
 
@@ -265,16 +339,19 @@ void print_array(std::ostream &os, const auto &vec) {
   os << "}";
 }
 
-inline TagString decode_string(std::istream &buf) {
-  std::int16_t len{decode<TagShort>(buf)};
+template <typename Buf>
+TagString decode_string(Buf &buf) {
+  std::uint16_t len{decode<std::uint16_t>(buf)};
+  check_available(buf, len);
   std::string str(len, '\0');
-  buf.read(str.data(), len);
+  read_bytes(buf, str.data(), len);
   return str;
 }
 
-inline void encode_string(std::ostream &buf, const TagString &str) {
+template <typename Buf>
+void encode_string(Buf &buf, const TagString &str) {
   encode<TagShort>(buf, static_cast<TagShort>(str.size()));
-  buf.write(str.data(), str.size());
+  write_bytes(buf, str.data(), str.size());
 }
 
 // clang-format off
@@ -298,15 +375,21 @@ inline void encode_string(std::ostream &buf, const TagString &str) {
   macro(TAG_COMPOUND, TagCompound, _compound)
 // clang-format on
 
-TagCompound decode_compound(std::istream &buf);
-void encode_compound(std::ostream &buf, const TagCompound &map);
+template <typename Buf>
+TagCompound decode_compound(Buf &buf);
+template <typename Buf>
+void encode_compound(Buf &buf, const TagCompound &map);
+std::size_t encoded_size(const TagCompound &map);
 void print_compound(std::ostream &os, const std::string &indent,
                     const TagCompound &map);
 
-inline TagList decode_list(std::istream &buf) {
+template <typename Buf>
+TagList decode_list(Buf &buf) {
   std::int8_t type{decode<TagByte>(buf)};
   std::int32_t len{decode<TagInt>(buf)};
   if (len <= 0) return {};
+  // every element except TagEnd takes at least one byte
+  if (type != TAG_END) check_available(buf, len);
 
   switch (type) {
     case TAG_END:
@@ -344,7 +427,8 @@ inline TagList decode_list(std::istream &buf) {
   }
 }
 
-inline void encode_list(std::ostream &buf, const TagList &list) {
+template <typename Buf>
+void encode_list(Buf &buf, const TagList &list) {
   /*
   if(list.base.valueless_by_exception())
     throw std::runtime_error {"invalid TagList"};
@@ -384,6 +468,40 @@ inline void encode_list(std::ostream &buf, const TagList &list) {
   }
 }
 
+template <std::integral T>
+std::size_t encoded_size(const std::vector<T> &vec) {
+  return sizeof(TagInt) + vec.size() * sizeof(T);
+}
+
+inline std::size_t encoded_size(const TagString &str) {
+  return sizeof(TagShort) + str.size();
+}
+
+inline std::size_t encoded_size(const TagList &list) {
+  std::size_t size{sizeof(TagByte) + sizeof(TagInt)};
+  switch (list.index()) {
+    case TAG_END:
+      break;
+
+#define X(enum, type)                                   \
+  case enum:                                            \
+    size += get_list<type>(list).size() * sizeof(type); \
+    break;
+      ALL_NUMERIC(X)
+#undef X
+
+#define X(enum, type, ...)                       \
+  case enum:                                     \
+    for (const auto &val : get_list<type>(list)) \
+      size += encoded_size(val);                 \
+    break;
+      ALL_ARRAYS(X)
+      ALL_OTHERS(X)
+#undef X
+  }
+  return size;
+}
+
 inline void print_list(std::ostream &os, const std::string &indent,
                        const TagList &list) {
   os << "<TagList of ";
@@ -461,7 +579,8 @@ inline void print_list(std::ostream &os, const std::string &indent,
   }
 }
 
-inline TagCompound decode_compound(std::istream &buf) {
+template <typename Buf>
+TagCompound decode_compound(Buf &buf) {
   TagCompound tag;
   TagByte type{decode<TagByte>(buf)};
   for (; type != TAG_END; type = decode<TagByte>(buf)) {
@@ -494,7 +613,8 @@ inline TagCompound decode_compound(std::istream &buf) {
   return tag;
 }
 
-inline void encode_compound(std::ostream &buf, const TagCompound &map) {
+template <typename Buf>
+void encode_compound(Buf &buf, const TagCompound &map) {
   for (const auto &[key, tag] : map.base) {
     encode<TagByte>(buf, static_cast<TagByte>(tag.index()));
     encode_string(buf, key);
@@ -528,6 +648,33 @@ inline void encode_compound(std::ostream &buf, const TagCompound &map) {
   encode<TagByte>(buf, 0);
 }
 
+inline std::size_t encoded_size(const TagCompound &map) {
+  std::size_t size{sizeof(TagByte)};
+  for (const auto &[key, tag] : map.base) {
+    size += sizeof(TagByte) + encoded_size(key);
+    switch (tag.index()) {
+#define X(enum, type)     \
+  case enum:              \
+    size += sizeof(type); \
+    break;
+      ALL_NUMERIC(X)
+#undef X
+
+#define X(enum, type, ...)                     \
+  case enum:                                   \
+    size += encoded_size(std::get<type>(tag)); \
+    break;
+      ALL_ARRAYS(X)
+      ALL_OTHERS(X)
+#undef X
+
+      default:
+        throw std::runtime_error{"invalid tag type"};
+    }
+  }
+  return size;
+}
+
 inline void print_compound(std::ostream &os, const std::string &indent,
                            const TagCompound &map) {
   os << "<TagCompound> {";
@@ -578,7 +725,8 @@ inline void print_compound(std::ostream &os, const std::string &indent,
 
 }  // namespace detail
 
-inline void NBT::decode(std::istream &buf) {
+template <typename Buf>
+void NBT::decode_impl(Buf &buf) {
   TagByte type{nbt::detail::decode<TagByte>(buf)};
   if (type == TAG_COMPOUND) {
     name = detail::decode_string(buf);
@@ -587,7 +735,12 @@ inline void NBT::decode(std::istream &buf) {
     throw std::runtime_error{"invalid tag type"};
 }
 
-inline void NBT::encode(std::ostream &buf) const {
+inline void NBT::decode(std::istream &buf) { decode_impl(buf); }
+
+inline void NBT::decode(std::span<const std::byte> buf) { decode_impl(buf); }
+
+template <typename Buf>
+void NBT::encode_impl(Buf &buf) const {
   if (!name && base.empty())
     detail::encode<TagByte>(buf, TAG_END);
   else {
@@ -597,6 +750,29 @@ inline void NBT::encode(std::ostream &buf) const {
   }
 }
 
+inline void NBT::encode(std::ostream &buf) const { encode_impl(buf); }
+
+inline std::size_t NBT::encoded_size() const {
+  if (!name && base.empty()) return sizeof(TagByte);
+  return sizeof(TagByte) + detail::encoded_size(name ? *name : "") +
+         detail::encoded_size(static_cast<const TagCompound &>(*this));
+}
+
+inline std::vector<std::byte> NBT::encode() const {
+  std::vector<std::byte> buf(encoded_size());
+  std::byte *out{buf.data()};
+  encode_impl(out);
+  return buf;
+}
+
+inline std::size_t NBT::encode(std::span<std::byte> buf) const {
+  const std::size_t size{encoded_size()};
+  if (size > buf.size()) throw std::runtime_error{"NBT buffer too small"};
+  std::byte *out{buf.data()};
+  encode_impl(out);
+  return size;
+}
+
 }  // namespace nbt
 
 #endif  // NBT_HPP
\ No newline at end of file
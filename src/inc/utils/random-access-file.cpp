@@ -0,0 +1,260 @@
+#include "random-access-file.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace utils {
+namespace {
+[[noreturn]] void ThrowError(std::string const &what,
+                             std::filesystem::path const &path) {
+#ifdef _WIN32
+  throw FileException(what + " " + path.string() + ": error " +
+                      std::to_string(GetLastError()));
+#else
+  throw FileException(what + " " + path.string() + ": " +
+                      std::strerror(errno));
+#endif
+}
+// matches both INVALID_HANDLE_VALUE and a failed open()
+constexpr intptr_t kInvalidHandle = -1;
+#ifdef _WIN32
+HANDLE AsHandle(intptr_t handle) { return reinterpret_cast<HANDLE>(handle); }
+OVERLAPPED OverlappedAt(uint64_t offset) {
+  OVERLAPPED overlapped{};
+  overlapped.Offset = static_cast<DWORD>(offset);
+  overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+  return overlapped;
+}
+#endif
+}  // namespace
+
+RandomAccessFile::RandomAccessFile(std::filesystem::path const &path)
+    : path_(path) {
+#ifdef _WIN32
+  handle_ = reinterpret_cast<intptr_t>(CreateFileW(
+      path.c_str(), GENERIC_READ | GENERIC_WRITE,
+      FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS,
+      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr));
+#else
+  handle_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+#endif
+  if (handle_ == kInvalidHandle) {
+    ThrowError("Failed to open", path_);
+  }
+}
+
+RandomAccessFile::~RandomAccessFile() { Close(); }
+
+RandomAccessFile::RandomAccessFile(RandomAccessFile &&other) noexcept
+    : path_(std::move(other.path_)),
+      handle_(std::exchange(other.handle_, kInvalidHandle)) {}
+
+RandomAccessFile &RandomAccessFile::operator=(
+    RandomAccessFile &&other) noexcept {
+  if (this != &other) {
+    Close();
+    path_ = std::move(other.path_);
+    handle_ = std::exchange(other.handle_, kInvalidHandle);
+  }
+  return *this;
+}
+
+void RandomAccessFile::Close() noexcept {
+  if (handle_ == kInvalidHandle) {
+    return;
+  }
+#ifdef _WIN32
+  CloseHandle(AsHandle(handle_));
+#else
+  ::close(static_cast<int>(handle_));
+#endif
+  handle_ = kInvalidHandle;
+}
+
+void RandomAccessFile::ReadAt(uint64_t offset,
+                              std::span<std::byte> buffer) const {
+  while (!buffer.empty()) {
+#ifdef _WIN32
+    OVERLAPPED overlapped = OverlappedAt(offset);
+    DWORD count = 0;
+    DWORD const to_read =
+        static_cast<DWORD>(std::min<size_t>(buffer.size(), 1u << 30));
+    if (!ReadFile(AsHandle(handle_), buffer.data(), to_read, &count,
+                  &overlapped)) {
+      ThrowError("Failed to read", path_);
+    }
+#else
+    ssize_t const count = ::pread(static_cast<int>(handle_), buffer.data(),
+                                  buffer.size(), static_cast<off_t>(offset));
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0) {
+      ThrowError("Failed to read", path_);
+    }
+#endif
+    if (count == 0) {
+      throw FileException("Unexpected end of file " + path_.string());
+    }
+    offset += count;
+    buffer = buffer.subspan(count);
+  }
+}
+
+void RandomAccessFile::WriteAt(uint64_t offset,
+                               std::span<const std::byte> buffer) {
+  while (!buffer.empty()) {
+#ifdef _WIN32
+    OVERLAPPED overlapped = OverlappedAt(offset);
+    DWORD count = 0;
+    DWORD const to_write =
+        static_cast<DWORD>(std::min<size_t>(buffer.size(), 1u << 30));
+    if (!WriteFile(AsHandle(handle_), buffer.data(), to_write, &count,
+                   &overlapped)) {
+      ThrowError("Failed to write", path_);
+    }
+#else
+    ssize_t const count = ::pwrite(static_cast<int>(handle_), buffer.data(),
+                                   buffer.size(), static_cast<off_t>(offset));
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+    if (count < 0) {
+      ThrowError("Failed to write", path_);
+    }
+#endif
+    offset += count;
+    buffer = buffer.subspan(count);
+  }
+}
+
+uint64_t RandomAccessFile::size() const {
+#ifdef _WIN32
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(AsHandle(handle_), &size)) {
+    ThrowError("Failed to get the size of", path_);
+  }
+  return static_cast<uint64_t>(size.QuadPart);
+#else
+  struct stat st;
+  if (::fstat(static_cast<int>(handle_), &st) != 0) {
+    ThrowError("Failed to get the size of", path_);
+  }
+  return static_cast<uint64_t>(st.st_size);
+#endif
+}
+
+void RandomAccessFile::Resize(uint64_t size) {
+#ifdef _WIN32
+  FILE_END_OF_FILE_INFO info;
+  info.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+  if (!SetFileInformationByHandle(AsHandle(handle_), FileEndOfFileInfo, &info,
+                                  sizeof(info))) {
+    ThrowError("Failed to resize", path_);
+  }
+#else
+  if (::ftruncate(static_cast<int>(handle_), static_cast<off_t>(size)) != 0) {
+    ThrowError("Failed to resize", path_);
+  }
+#endif
+}
+
+void RandomAccessFile::Flush() {
+#ifdef _WIN32
+  if (!FlushFileBuffers(AsHandle(handle_))) {
+    ThrowError("Failed to flush", path_);
+  }
+#else
+  if (::fsync(static_cast<int>(handle_)) != 0) {
+    ThrowError("Failed to flush", path_);
+  }
+#endif
+}
+
+MappedView::MappedView(RandomAccessFile const &file, size_t size)
+    : size_(size) {
+#ifdef _WIN32
+  HANDLE mapping =
+      CreateFileMappingW(AsHandle(file.native_handle()), nullptr,
+                         PAGE_READWRITE, 0, static_cast<DWORD>(size), nullptr);
+  if (mapping == nullptr) {
+    ThrowError("Failed to map", file.path());
+  }
+  void *data = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  if (data == nullptr) {
+    CloseHandle(mapping);
+    ThrowError("Failed to map", file.path());
+  }
+  mapping_ = reinterpret_cast<intptr_t>(mapping);
+#else
+  void *data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      static_cast<int>(file.native_handle()), 0);
+  if (data == MAP_FAILED) {
+    ThrowError("Failed to map", file.path());
+  }
+#endif
+  data_ = static_cast<std::byte *>(data);
+}
+
+MappedView::~MappedView() { Close(); }
+
+MappedView::MappedView(MappedView &&other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      mapping_(std::exchange(other.mapping_, 0)) {}
+
+MappedView &MappedView::operator=(MappedView &&other) noexcept {
+  if (this != &other) {
+    Close();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    mapping_ = std::exchange(other.mapping_, 0);
+  }
+  return *this;
+}
+
+void MappedView::Flush() {
+  if (!data_) {
+    return;
+  }
+#ifdef _WIN32
+  if (!FlushViewOfFile(data_, size_)) {
+    throw FileException("Failed to flush a mapped view");
+  }
+#else
+  if (::msync(data_, size_, MS_SYNC) != 0) {
+    throw FileException("Failed to flush a mapped view");
+  }
+#endif
+}
+
+void MappedView::Close() noexcept {
+  if (!data_) {
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+  CloseHandle(reinterpret_cast<HANDLE>(mapping_));
+#else
+  ::munmap(data_, size_);
+#endif
+  data_ = nullptr;
+  mapping_ = 0;
+}
+}  // namespace utils
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <stdexcept>
+
+namespace utils {
+class FileException : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+// Thin wrapper around a native file handle which reads and writes at explicit
+// offsets (pread/pwrite, overlapped ReadFile/WriteFile), so several threads
+// can read the same file without sharing a file position.
+class RandomAccessFile final {
+ public:
+  // Opens the file for reading and writing, creating it if it doesn't exist.
+  explicit RandomAccessFile(std::filesystem::path const &path);
+  ~RandomAccessFile();
+  RandomAccessFile(RandomAccessFile &&other) noexcept;
+  RandomAccessFile &operator=(RandomAccessFile &&other) noexcept;
+  RandomAccessFile(RandomAccessFile const &) = delete;
+  RandomAccessFile &operator=(RandomAccessFile const &) = delete;
+
+  // Both functions transfer the whole buffer or throw FileException.
+  void ReadAt(uint64_t offset, std::span<std::byte> buffer) const;
+  void WriteAt(uint64_t offset, std::span<const std::byte> buffer);
+
+  [[nodiscard]] uint64_t size() const;
+  void Resize(uint64_t size);
+  // Forces written data to the disk.
+  void Flush();
+
+  [[nodiscard]] std::filesystem::path const &path() const noexcept {
+    return path_;
+  }
+  [[nodiscard]] intptr_t native_handle() const noexcept { return handle_; }
+
+ private:
+  void Close() noexcept;
+
+  std::filesystem::path path_;
+  intptr_t handle_;
+};
+
+// Shared, writable memory mapping of the first bytes of a file.
+// Writes through the view end up in the file without explicit I/O calls.
+class MappedView final {
+ public:
+  MappedView() = default;
+  // The file has to be at least size bytes long.
+  MappedView(RandomAccessFile const &file, size_t size);
+  ~MappedView();
+  MappedView(MappedView &&other) noexcept;
+  MappedView &operator=(MappedView &&other) noexcept;
+  MappedView(MappedView const &) = delete;
+  MappedView &operator=(MappedView const &) = delete;
+
+  [[nodiscard]] std::span<std::byte> data() const noexcept {
+    return {data_, size_};
+  }
+  // Writes dirty pages of the view back to the file.
+  void Flush();
+
+ private:
+  void Close() noexcept;
+
+  std::byte *data_ = nullptr;
+  size_t size_ = 0;
+  intptr_t mapping_ = 0;  // mapping object, only used on Windows
+};
+}  // namespace utils
@@ -0,0 +1,71 @@
+#include "simd.hpp"
+
+#if UTILS_SIMD_X86 && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace utils {
+namespace {
+bool CpuHasAvx2() noexcept {
+#if !UTILS_SIMD_X86
+  return false;
+#elif defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  constexpr int kOsXsave = 1 << 27;
+  constexpr int kAvx = 1 << 28;
+  // the OS must also save the ymm registers
+  if ((info[2] & (kOsXsave | kAvx)) != (kOsXsave | kAvx) ||
+      (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+}  // namespace
+
+SimdLevel DetectSimdLevel() noexcept {
+  if (Supported(SimdLevel::kAvx2)) {
+    return SimdLevel::kAvx2;
+  }
+  if (Supported(SimdLevel::kSse2)) {
+    return SimdLevel::kSse2;
+  }
+  return SimdLevel::kScalar;
+}
+
+bool Supported(SimdLevel level) noexcept {
+  switch (level) {
+    case SimdLevel::kScalar:
+      return true;
+    case SimdLevel::kSse2:
+      // part of x86-64
+      return UTILS_SIMD_X86;
+    case SimdLevel::kAvx2: {
+      static const bool avx2 = CpuHasAvx2();
+      return avx2;
+    }
+  }
+  return false;
+}
+
+std::string_view ToString(SimdLevel level) noexcept {
+  switch (level) {
+    case SimdLevel::kScalar:
+      return "scalar";
+    case SimdLevel::kSse2:
+      return "sse2";
+    case SimdLevel::kAvx2:
+      return "avx2";
+  }
+  return "unknown";
+}
+}  // namespace utils
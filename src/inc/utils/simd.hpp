@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define UTILS_SIMD_X86 1
+#else
+#define UTILS_SIMD_X86 0
+#endif
+
+// Instruction set levels for the kernels that are compiled several times
+// and picked at runtime.
+namespace utils {
+enum class SimdLevel : uint8_t { kScalar, kSse2, kAvx2 };
+
+// The best level the CPU supports.
+[[nodiscard]] SimdLevel DetectSimdLevel() noexcept;
+[[nodiscard]] bool Supported(SimdLevel level) noexcept;
+[[nodiscard]] std::string_view ToString(SimdLevel level) noexcept;
+}  // namespace utils
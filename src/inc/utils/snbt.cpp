@@ -0,0 +1,407 @@
+#include "snbt.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <optional>
+
+namespace nbt {
+namespace {
+constexpr bool IsUnquotedChar(char c) noexcept {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+         (c >= 'A' && c <= 'Z') || c == '_' || c == '-' || c == '.' ||
+         c == '+';
+}
+
+constexpr bool IsWhitespace(char c) noexcept {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+constexpr char ToLower(char c) noexcept {
+  return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+}
+
+// from_chars doesn't accept a leading '+'
+constexpr std::string_view StripPlus(std::string_view str) noexcept {
+  return !str.empty() && str.front() == '+' ? str.substr(1) : str;
+}
+
+template <typename T>
+std::optional<T> ParseInteger(std::string_view str) noexcept {
+  str = StripPlus(str);
+  T value;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (ec != std::errc{} || ptr != str.data() + str.size() || str.empty()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+template <typename T>
+std::optional<T> ParseFloating(std::string_view str) noexcept {
+  str = StripPlus(str);
+  // rejects nan and inf, which would otherwise shadow unquoted strings
+  if (std::none_of(str.begin(), str.end(),
+                   [](char c) { return c >= '0' && c <= '9'; })) {
+    return std::nullopt;
+  }
+  T value;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+  if (ec != std::errc{} || ptr != str.data() + str.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+// Numbers are tried first; anything that doesn't fit a numeric pattern or
+// overflows its type is treated as an unquoted string.
+std::optional<Tag> ParseNumber(std::string_view token) noexcept {
+  const char suffix = ToLower(token.back());
+  const std::string_view body = token.substr(0, token.size() - 1);
+  switch (suffix) {
+    case 'b':
+      if (auto value = ParseInteger<TagByte>(body)) return *value;
+      return std::nullopt;
+    case 's':
+      if (auto value = ParseInteger<TagShort>(body)) return *value;
+      return std::nullopt;
+    case 'l':
+      if (auto value = ParseInteger<TagLong>(body)) return *value;
+      return std::nullopt;
+    case 'f':
+      if (auto value = ParseFloating<TagFloat>(body)) return *value;
+      return std::nullopt;
+    case 'd':
+      if (auto value = ParseFloating<TagDouble>(body)) return *value;
+      return std::nullopt;
+  }
+  if (std::all_of(token.begin(), token.end(), [](char c) {
+        return (c >= '0' && c <= '9') || c == '-' || c == '+';
+      })) {
+    if (auto value = ParseInteger<TagInt>(token)) return *value;
+    return std::nullopt;
+  }
+  if (auto value = ParseFloating<TagDouble>(token)) return *value;
+  return std::nullopt;
+}
+
+class Parser final {
+ public:
+  explicit Parser(std::string_view text) noexcept : text_(text) {}
+
+  TagCompound ParseRootCompound() {
+    Expect('{');
+    TagCompound compound = ParseCompound();
+    Finish();
+    return compound;
+  }
+
+  Tag ParseRootTag() {
+    Tag tag = ParseValue();
+    Finish();
+    return tag;
+  }
+
+ private:
+  [[noreturn]] void Error(std::string const &what) const {
+    throw SnbtException(what, pos_);
+  }
+
+  void SkipWhitespace() noexcept {
+    while (pos_ < text_.size() && IsWhitespace(text_[pos_])) {
+      pos_++;
+    }
+  }
+
+  char Peek() noexcept {
+    SkipWhitespace();
+    return pos_ < text_.size() ? text_[pos_] : '\0';
+  }
+
+  bool Consume(char c) noexcept {
+    if (Peek() != c) {
+      return false;
+    }
+    pos_++;
+    return true;
+  }
+
+  void Expect(char c) {
+    if (!Consume(c)) {
+      Error(std::string("expected '") + c + "'");
+    }
+  }
+
+  void Finish() {
+    SkipWhitespace();
+    if (pos_ != text_.size()) {
+      Error("unexpected trailing characters");
+    }
+  }
+
+  std::string_view UnquotedToken() noexcept {
+    SkipWhitespace();
+    const size_t begin = pos_;
+    while (pos_ < text_.size() && IsUnquotedChar(text_[pos_])) {
+      pos_++;
+    }
+    return text_.substr(begin, pos_ - begin);
+  }
+
+  // copies the string in segments between escapes
+  std::string ParseQuoted() {
+    const char quote = text_[pos_++];
+    std::string result;
+    size_t segment = pos_;
+    while (true) {
+      if (pos_ >= text_.size()) {
+        Error("unterminated string");
+      }
+      const char c = text_[pos_];
+      if (c == quote) {
+        result.append(text_, segment, pos_ - segment);
+        pos_++;
+        return result;
+      }
+      if (c == '\\') {
+        result.append(text_, segment, pos_ - segment);
+        pos_++;
+        if (pos_ >= text_.size() ||
+            (text_[pos_] != '\\' && text_[pos_] != '"' &&
+             text_[pos_] != '\'')) {
+          Error("invalid escape sequence");
+        }
+        segment = pos_;
+      }
+      pos_++;
+    }
+  }
+
+  std::string ParseKey() {
+    const char c = Peek();
+    if (c == '"' || c == '\'') {
+      return ParseQuoted();
+    }
+    const std::string_view token = UnquotedToken();
+    if (token.empty()) {
+      Error("expected a key");
+    }
+    return std::string(token);
+  }
+
+  // the opening brace is already consumed
+  TagCompound ParseCompound() {
+    TagCompound compound;
+    if (Consume('}')) {
+      return compound;
+    }
+    do {
+      std::string key = ParseKey();
+      Expect(':');
+      compound.base.insert_or_assign(std::move(key), ParseValue());
+    } while (Consume(','));
+    Expect('}');
+    return compound;
+  }
+
+  template <typename T>
+  std::vector<T> ParseArray(char suffix) {
+    std::vector<T> vec;
+    if (Consume(']')) {
+      return vec;
+    }
+    do {
+      std::string_view token = UnquotedToken();
+      if (suffix != '\0' && !token.empty() &&
+          ToLower(token.back()) == suffix) {
+        token.remove_suffix(1);
+      }
+      const auto value = ParseInteger<T>(token);
+      if (!value) {
+        Error("invalid array element");
+      }
+      vec.push_back(*value);
+    } while (Consume(','));
+    Expect(']');
+    return vec;
+  }
+
+  // the opening bracket is already consumed
+  Tag ParseListOrArray() {
+    SkipWhitespace();
+    if (pos_ + 1 < text_.size() && text_[pos_ + 1] == ';') {
+      const char type = text_[pos_];
+      pos_ += 2;
+      switch (type) {
+        case 'B':
+          return ParseArray<TagByte>('b');
+        case 'I':
+          return ParseArray<TagInt>('\0');
+        case 'L':
+          return ParseArray<TagLong>('l');
+      }
+      pos_ -= 2;
+      Error("unknown array type");
+    }
+    TagList list;
+    if (Consume(']')) {
+      return list;
+    }
+    // the first element decides the type of the list
+    std::visit(
+        [&list](auto &&value) {
+          using T = std::decay_t<decltype(value)>;
+          list.base.emplace<std::vector<T>>().push_back(std::move(value));
+        },
+        ParseValue());
+    while (Consume(',')) {
+      Tag value = ParseValue();
+      if (value.index() != list.index()) {
+        Error("list elements must have the same type");
+      }
+      std::visit(
+          [&value](auto &vec) {
+            using T = typename std::decay_t<decltype(vec)>::value_type;
+            vec.push_back(std::get<T>(std::move(value)));
+          },
+          list.base);
+    }
+    Expect(']');
+    return list;
+  }
+
+  Tag ParseValue() {
+    const char c = Peek();
+    switch (c) {
+      case '{':
+        pos_++;
+        return ParseCompound();
+      case '[':
+        pos_++;
+        return ParseListOrArray();
+      case '"':
+      case '\'':
+        return ParseQuoted();
+    }
+    const std::string_view token = UnquotedToken();
+    if (token.empty()) {
+      Error("expected a value");
+    }
+    if (auto number = ParseNumber(token)) {
+      return std::move(*number);
+    }
+    if (token == "true") {
+      return TagByte{1};
+    }
+    if (token == "false") {
+      return TagByte{0};
+    }
+    return TagString(token);
+  }
+
+  std::string_view text_;
+  size_t pos_ = 0;
+};
+
+void WriteQuoted(std::string &out, std::string_view str) {
+  out += '"';
+  for (const char c : str) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  out += '"';
+}
+
+void WriteKey(std::string &out, std::string_view key) {
+  if (!key.empty() && std::all_of(key.begin(), key.end(), IsUnquotedChar)) {
+    out += key;
+  } else {
+    WriteQuoted(out, key);
+  }
+}
+
+template <typename T>
+void WriteNumber(std::string &out, T value, std::string_view suffix) {
+  char buf[32];
+  auto result = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, result.ptr);
+  out += suffix;
+}
+
+void Write(std::string &out, const Tag &tag);
+void Write(std::string &out, const TagCompound &compound);
+void Write(std::string &out, const TagList &list);
+void Write(std::string &out, const TagByteArray &value);
+void Write(std::string &out, const TagIntArray &value);
+void Write(std::string &out, const TagLongArray &value);
+
+void Write(std::string &, TagEnd) { throw std::runtime_error{"invalid tag"}; }
+void Write(std::string &out, TagByte value) { WriteNumber(out, value, "b"); }
+void Write(std::string &out, TagShort value) { WriteNumber(out, value, "s"); }
+void Write(std::string &out, TagInt value) { WriteNumber(out, value, ""); }
+void Write(std::string &out, TagLong value) { WriteNumber(out, value, "L"); }
+void Write(std::string &out, TagFloat value) { WriteNumber(out, value, "f"); }
+void Write(std::string &out, TagDouble value) { WriteNumber(out, value, "d"); }
+void Write(std::string &out, const TagString &value) { WriteQuoted(out, value); }
+
+template <typename T>
+void WriteArray(std::string &out, std::string_view prefix,
+                const std::vector<T> &vec) {
+  out += prefix;
+  for (size_t i = 0; i < vec.size(); i++) {
+    if (i != 0) {
+      out += ',';
+    }
+    Write(out, vec[i]);
+  }
+  out += ']';
+}
+
+void Write(std::string &out, const TagByteArray &value) {
+  WriteArray(out, "[B;", value);
+}
+void Write(std::string &out, const TagIntArray &value) {
+  WriteArray(out, "[I;", value);
+}
+void Write(std::string &out, const TagLongArray &value) {
+  WriteArray(out, "[L;", value);
+}
+
+void Write(std::string &out, const TagList &list) {
+  std::visit([&out](auto const &vec) { WriteArray(out, "[", vec); },
+             list.base);
+}
+
+void Write(std::string &out, const TagCompound &compound) {
+  out += '{';
+  bool first = true;
+  for (auto const &[key, tag] : compound.base) {
+    if (!first) {
+      out += ',';
+    }
+    first = false;
+    WriteKey(out, key);
+    out += ':';
+    Write(out, tag);
+  }
+  out += '}';
+}
+
+void Write(std::string &out, const Tag &tag) {
+  std::visit([&out](auto const &value) { Write(out, value); }, tag);
+}
+}  // namespace
+
+TagCompound parse_snbt(std::string_view text) {
+  return Parser{text}.ParseRootCompound();
+}
+
+Tag parse_snbt_tag(std::string_view text) { return Parser{text}.ParseRootTag(); }
+
+void write_snbt(std::string &out, const TagCompound &compound) {
+  Write(out, compound);
+}
+
+void write_snbt(std::string &out, const Tag &tag) { Write(out, tag); }
+}  // namespace nbt
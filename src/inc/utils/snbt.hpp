@@ -0,0 +1,44 @@
+#pragma once
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "utils/nbt.hpp"
+
+/*
+ * Stringified NBT, as used by commands and data packs:
+ *   {name:"Steve",Health:20.0f,Pos:[1.5d,64.0d,-3.5d],Data:[I;1,2,3]}
+ *
+ * Numbers take a type suffix: b (byte), s (short), L (long), f (float),
+ * d (double); integers without a suffix are ints, decimals are doubles.
+ * true and false are bytes. Strings may be quoted with " or ', or left
+ * unquoted if they consist of [0-9A-Za-z_.+-] and don't look like a number.
+ */
+namespace nbt {
+class SnbtException : public std::runtime_error {
+ public:
+  SnbtException(std::string const &what, size_t position)
+      : std::runtime_error(what + " at position " + std::to_string(position)),
+        position_(position) {}
+  [[nodiscard]] size_t position() const noexcept { return position_; }
+
+ private:
+  size_t position_;
+};
+
+// Parses a single compound in one pass. Trailing whitespace is allowed,
+// anything else after the compound is an error.
+[[nodiscard]] TagCompound parse_snbt(std::string_view text);
+[[nodiscard]] Tag parse_snbt_tag(std::string_view text);
+
+// Appends compact SNBT (no whitespace) to out, so a single buffer can be
+// cleared and reused for many documents without reallocating.
+void write_snbt(std::string &out, const TagCompound &compound);
+void write_snbt(std::string &out, const Tag &tag);
+
+[[nodiscard]] inline std::string to_snbt(const TagCompound &compound) {
+  std::string out;
+  write_snbt(out, compound);
+  return out;
+}
+}  // namespace nbt
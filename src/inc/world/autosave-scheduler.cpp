@@ -0,0 +1,169 @@
+#include "autosave-scheduler.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <optional>
+
+#include "world/chunk-serializer.hpp"
+
+namespace world {
+AutosaveScheduler::AutosaveScheduler(ChunkIO &io, BlockRegistry const &blocks,
+                                     TileEntityRegistry const &tiles,
+                                     AutosaveSettings settings)
+    : io_(io),
+      blocks_(blocks),
+      tiles_(tiles),
+      settings_(settings),
+      self_(std::make_shared<AutosaveScheduler *>(this)) {}
+
+void AutosaveScheduler::Track(Chunk &chunk) {
+  const ChunkPos pos = chunk.pos();
+  auto [it, inserted] = chunks_.try_emplace(pos, Tracked{&chunk});
+  // the replaced chunk may be gone already, its callback finds this one
+  if (!inserted && it->second.chunk != &chunk) {
+    it->second.chunk = &chunk;
+    Dequeue(it->second);
+  }
+  chunk.set_on_dirty([self = std::weak_ptr(self_), pos] {
+    if (auto scheduler = self.lock()) {
+      (*scheduler)->Enqueue(pos);
+    }
+  });
+  Enqueue(pos);
+  stats_.tracked = chunks_.size();
+}
+
+bool AutosaveScheduler::Untrack(ChunkPos pos) {
+  auto it = chunks_.find(pos);
+  if (it == chunks_.end()) {
+    return false;
+  }
+  Tracked &tracked = it->second;
+  if (const auto since = tracked.chunk->dirty_since()) {
+    Save(tracked, *since);
+  }
+  Dequeue(tracked);
+  tracked.chunk->set_on_dirty({});
+  chunks_.erase(it);
+  stats_.tracked = chunks_.size();
+  return true;
+}
+
+void AutosaveScheduler::Tick(Clock::time_point now) {
+  const auto begin = Clock::now();
+  CollectWrites();
+
+  size_t saved = 0;
+  while (!queue_.empty()) {
+    const auto [since, pos] = *queue_.begin();
+    if (now - since < settings_.save_delay ||
+        (saved > 0 && Clock::now() - begin >= settings_.tick_budget)) {
+      break;
+    }
+    Tracked &tracked = chunks_.at(pos);
+    // cleared behind the scheduler's back, e.g. by a reload
+    if (const auto changed = tracked.chunk->dirty_since()) {
+      Save(tracked, *changed);
+      saved++;
+    } else {
+      Dequeue(tracked);
+    }
+  }
+
+  stats_.dirty = queue_.size();
+  stats_.dirty_tile_entities = dirty_tiles_;
+  stats_.writing = writes_.size();
+  std::optional<Clock::time_point> oldest;
+  if (!queue_.empty()) {
+    oldest = queue_.begin()->first;
+  }
+  for (Write const &write : writes_) {
+    oldest = std::min(oldest.value_or(write.since), write.since);
+  }
+  stats_.oldest_change =
+      oldest ? std::max(now - *oldest, Clock::duration::zero())
+             : Clock::duration::zero();
+  stats_.tick_time = Clock::now() - begin;
+  stats_.tick_time_max = std::max(stats_.tick_time_max, stats_.tick_time);
+}
+
+size_t AutosaveScheduler::SaveAll() {
+  CollectWrites();
+  size_t saved = 0;
+  while (!queue_.empty()) {
+    Tracked &tracked = chunks_.at(queue_.begin()->second);
+    if (const auto since = tracked.chunk->dirty_since()) {
+      Save(tracked, *since);
+      saved++;
+    } else {
+      Dequeue(tracked);
+    }
+  }
+  stats_.dirty = 0;
+  stats_.dirty_tile_entities = 0;
+  stats_.writing = writes_.size();
+  return saved;
+}
+
+void AutosaveScheduler::Enqueue(ChunkPos pos) {
+  Tracked &tracked = chunks_.at(pos);
+  const auto since = tracked.chunk->dirty_since();
+  if (!since) {
+    return;
+  }
+  if (!tracked.queued || *since < *tracked.queued) {
+    if (tracked.queued) {
+      queue_.erase({*tracked.queued, pos});
+    }
+    queue_.emplace(*since, pos);
+    tracked.queued = since;
+  }
+  if (!tracked.dirty_tiles && tracked.chunk->tile_entities().dirty()) {
+    tracked.dirty_tiles = true;
+    dirty_tiles_++;
+  }
+}
+
+void AutosaveScheduler::Dequeue(Tracked &tracked) {
+  if (tracked.queued) {
+    queue_.erase({*tracked.queued, tracked.chunk->pos()});
+    tracked.queued.reset();
+  }
+  if (tracked.dirty_tiles) {
+    tracked.dirty_tiles = false;
+    dirty_tiles_--;
+  }
+}
+
+void AutosaveScheduler::Save(Tracked &tracked, Clock::time_point since) {
+  Chunk &chunk = *tracked.chunk;
+  auto done = io_.Save(chunk.pos(),
+                       [snapshot = TakeSnapshot(chunk, blocks_, tiles_)] {
+                         return EncodeChunk(snapshot);
+                       });
+  Dequeue(tracked);
+  chunk.ClearDirty();
+  writes_.push_back({chunk.pos(), since, std::move(done)});
+  stats_.saves++;
+}
+
+void AutosaveScheduler::CollectWrites() {
+  std::erase_if(writes_, [this](Write &write) {
+    if (write.done.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready) {
+      return false;
+    }
+    try {
+      write.done.get();
+    } catch (std::exception const &) {
+      stats_.failed_writes++;
+      if (auto it = chunks_.find(write.pos); it != chunks_.end()) {
+        // queued again if it was clean, moved up if it changed since
+        it->second.chunk->MarkDirty(write.since);
+        Enqueue(write.pos);
+      }
+    }
+    return true;
+  });
+}
+}  // namespace world
@@ -0,0 +1,130 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "world/block-registry.hpp"
+#include "world/chunk-io.hpp"
+#include "world/chunk.hpp"
+#include "world/coordinates.hpp"
+#include "world/tile-entities.hpp"
+
+/*
+ * Saves changed chunks a few at a time instead of the whole world at once.
+ *
+ * Tick() runs once per game tick on the thread that owns the chunks. A
+ * tracked chunk is queued by the time of its change when it turns dirty, see
+ * Chunk::set_on_dirty(), and Tick() saves from the front of the queue until
+ * the tick budget is spent, always at least one so the backlog drains. Clean
+ * chunks cost nothing per tick.
+ * Saving a chunk only takes a snapshot and clears its dirty state, the NBT is
+ * encoded and written by the ChunkIO thread.
+ *
+ * A dirty chunk waits for save_delay before it is saved, so a chunk that is
+ * being edited isn't saved every tick. Raising the delay or lowering the
+ * budget costs less tick time and loses more on a crash; the stats report
+ * how many chunks wait and the age of the oldest change that isn't on disk.
+ *
+ * A write that fails marks the chunk dirty again with the time of its
+ * change. Untrack() saves a dirty chunk before it goes; SaveAll() followed
+ * by ChunkIO::Flush() makes everything durable, e.g. before quitting.
+ */
+namespace world {
+struct AutosaveSettings {
+  // tick time spent on saving
+  std::chrono::microseconds tick_budget{1000};
+  // how long a chunk stays dirty before it is saved
+  std::chrono::milliseconds save_delay{0};
+};
+
+struct AutosaveStats {
+  size_t tracked = 0;
+  // chunks with unsaved changes, and those among them whose tile entities
+  // changed
+  size_t dirty = 0;
+  size_t dirty_tile_entities = 0;
+  // saved, not written yet
+  size_t writing = 0;
+  // the oldest change that isn't written, dirty or writing
+  std::chrono::nanoseconds oldest_change{0};
+  uint64_t saves = 0;
+  uint64_t failed_writes = 0;
+  // time of the last Tick(), and the longest so far
+  std::chrono::nanoseconds tick_time{0};
+  std::chrono::nanoseconds tick_time_max{0};
+};
+
+class AutosaveScheduler final {
+ public:
+  using Clock = Chunk::Clock;
+
+  AutosaveScheduler(ChunkIO &io, BlockRegistry const &blocks,
+                    TileEntityRegistry const &tiles,
+                    AutosaveSettings settings = {});
+  AutosaveScheduler(AutosaveScheduler const &) = delete;
+  AutosaveScheduler &operator=(AutosaveScheduler const &) = delete;
+
+  // The chunk stays where it is until Untrack(), its on_dirty callback
+  // belongs to the scheduler until then.
+  void Track(Chunk &chunk);
+  // Saves the chunk if it is dirty. Returns false if it wasn't tracked.
+  bool Untrack(ChunkPos pos);
+
+  void Tick(Clock::time_point now = Clock::now());
+  // Saves every dirty chunk, whatever the budget. Returns how many.
+  size_t SaveAll();
+
+  [[nodiscard]] AutosaveStats const &stats() const noexcept { return stats_; }
+  [[nodiscard]] AutosaveSettings const &settings() const noexcept {
+    return settings_;
+  }
+  void set_settings(AutosaveSettings settings) noexcept {
+    settings_ = settings;
+  }
+
+ private:
+  struct Write {
+    ChunkPos pos;
+    Clock::time_point since;
+    std::future<void> done;
+  };
+
+  struct Tracked {
+    Chunk *chunk = nullptr;
+    // the key in queue_ while queued
+    std::optional<Clock::time_point> queued = std::nullopt;
+    // counted in dirty_tiles_
+    bool dirty_tiles = false;
+  };
+
+  // Queues a dirty chunk, or moves it up to an earlier change.
+  void Enqueue(ChunkPos pos);
+  void Dequeue(Tracked &tracked);
+  void Save(Tracked &tracked, Clock::time_point since);
+  // Drops the finished writes, failed ones make their chunk dirty again.
+  void CollectWrites();
+
+  ChunkIO &io_;
+  BlockRegistry const &blocks_;
+  TileEntityRegistry const &tiles_;
+  AutosaveSettings settings_;
+
+  std::unordered_map<ChunkPos, Tracked> chunks_;
+  // the dirty chunks, oldest change first
+  std::set<std::pair<Clock::time_point, ChunkPos>> queue_;
+  // queued chunks whose tile entities are dirty
+  size_t dirty_tiles_ = 0;
+  std::vector<Write> writes_;
+  AutosaveStats stats_;
+  // held weakly by the on_dirty callbacks, so chunks can outlive the
+  // scheduler
+  std::shared_ptr<AutosaveScheduler *> self_;
+};
+}  // namespace world
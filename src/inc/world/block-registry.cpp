@@ -0,0 +1,186 @@
+#include "block-registry.hpp"
+
+#include <cmath>
+
+namespace world {
+namespace {
+// yaml::Entry::operator[] inserts missing keys, this doesn't
+yaml::Entry const *FindValue(yaml::Entry const &map, std::string_view key) {
+  if (!map.is_map()) {
+    return nullptr;
+  }
+  for (yaml::Entry const &entry : map) {
+    if (entry.is_pair() && entry.key().to_string() == key) {
+      return &entry.value();
+    }
+  }
+  return nullptr;
+}
+
+bool ReadBool(std::string const &name, yaml::Entry const &yaml,
+              std::string_view key, bool fallback) {
+  yaml::Entry const *value = FindValue(yaml, key);
+  if (!value || value->is_null()) {
+    return fallback;
+  }
+  if (value->is_bool()) {
+    return value->to_bool();
+  }
+  // the parser keeps plain scalars in maps as strings
+  if (value->is_string() && value->to_string() == "true") {
+    return true;
+  }
+  if (value->is_string() && value->to_string() == "false") {
+    return false;
+  }
+  throw BlockRegistryException(name + ": " + std::string(key) +
+                               " must be a boolean");
+}
+
+float ReadNumber(std::string const &name, yaml::Entry const &yaml,
+                 std::string_view key, float fallback) {
+  yaml::Entry const *value = FindValue(yaml, key);
+  if (!value || value->is_null()) {
+    return fallback;
+  }
+  if (value->is_int()) {
+    return static_cast<float>(value->to_int());
+  }
+  if (value->is_uint()) {
+    return static_cast<float>(value->to_uint());
+  }
+  if (value->is_double()) {
+    return static_cast<float>(value->to_double());
+  }
+  throw BlockRegistryException(name + ": " + std::string(key) +
+                               " must be a number");
+}
+
+// A face uses its own texture, then its group (sides for the horizontal
+// faces), then the default one.
+std::array<std::string, kDirectionCount> ReadTextures(yaml::Entry const &yaml,
+                                                      std::string_view key) {
+  std::array<std::string, kDirectionCount> textures;
+  yaml::Entry const *section = FindValue(yaml, key);
+  if (!section) {
+    return textures;
+  }
+  auto get = [section](std::string_view face, std::string fallback) {
+    yaml::Entry const *value = FindValue(*section, face);
+    return value && value->is_string() && !value->to_string().empty()
+               ? std::string(value->to_string())
+               : fallback;
+  };
+  const std::string fallback = get("default", "");
+  const std::string sides = get("sides", fallback);
+  textures[static_cast<size_t>(Direction::kWest)] = get("west", sides);
+  textures[static_cast<size_t>(Direction::kEast)] = get("east", sides);
+  textures[static_cast<size_t>(Direction::kBottom)] = get("bottom", fallback);
+  textures[static_cast<size_t>(Direction::kTop)] = get("top", fallback);
+  textures[static_cast<size_t>(Direction::kNorth)] = get("north", sides);
+  textures[static_cast<size_t>(Direction::kSouth)] = get("south", sides);
+  return textures;
+}
+}  // namespace
+
+BlockDefinition BlockDefinition::Parse(std::string name,
+                                       yaml::Entry const &yaml) {
+  BlockDefinition definition;
+  definition.hardness = ReadNumber(name, yaml, "hardness", 0);
+  definition.solid = ReadBool(name, yaml, "solid", true);
+  definition.transparent = ReadBool(name, yaml, "transparent", false);
+  definition.interactable = ReadBool(name, yaml, "interactable", false);
+  definition.breakable = ReadBool(name, yaml, "breakable", true);
+  definition.tile = ReadBool(name, yaml, "tile", false);
+  const float light = ReadNumber(name, yaml, "light", 0);
+  if (light < 0 || light > 15 || light != std::floor(light)) {
+    throw BlockRegistryException(name +
+                                 ": light must be an integer from 0 to 15");
+  }
+  definition.light = static_cast<uint8_t>(light);
+  definition.diffuse = ReadTextures(yaml, "sides");
+  definition.specular = ReadTextures(yaml, "specular");
+  definition.name = std::move(name);
+  return definition;
+}
+
+BlockRegistry::BlockRegistry() {
+  BlockDefinition air;
+  air.name = kAirName;
+  air.solid = false;
+  air.transparent = true;
+  air.breakable = false;
+  Register(air);
+}
+
+BlockId BlockRegistry::Register(BlockDefinition const &definition) {
+  if (definition.name.empty()) {
+    throw BlockRegistryException("A block must have a name");
+  }
+  BlockId id;
+  if (auto it = ids_.find(definition.name); it != ids_.end()) {
+    id = it->second;
+  } else {
+    if (names_->size() > UINT16_MAX) {
+      throw BlockRegistryException("Too many blocks");
+    }
+    id = static_cast<BlockId>(names_->size());
+    ids_.emplace(definition.name, id);
+    // blocks are registered while loading, copying the names is cheap then
+    auto names = std::make_shared<std::vector<std::string>>(*names_);
+    names->push_back(definition.name);
+    names_ = std::move(names);
+    hardness_.emplace_back();
+    solid_.emplace_back();
+    transparent_.emplace_back();
+    interactable_.emplace_back();
+    breakable_.emplace_back();
+    tile_.emplace_back();
+    light_.emplace_back();
+    diffuse_.emplace_back();
+    specular_.emplace_back();
+  }
+  hardness_[id] = definition.hardness;
+  solid_[id] = definition.solid;
+  transparent_[id] = definition.transparent;
+  interactable_[id] = definition.interactable;
+  breakable_[id] = definition.breakable;
+  tile_[id] = definition.tile;
+  light_[id] = definition.light;
+  for (size_t i = 0; i < kDirectionCount; i++) {
+    diffuse_[id][i] = TextureId(definition.diffuse[i]);
+    specular_[id][i] = TextureId(definition.specular[i]);
+  }
+  return id;
+}
+
+std::optional<BlockId> BlockRegistry::Find(std::string_view name) const {
+  if (auto it = ids_.find(name); it != ids_.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+BlockId BlockRegistry::id(std::string_view name) const {
+  if (auto id = Find(name)) {
+    return *id;
+  }
+  throw BlockRegistryException("Unknown block " + std::string(name));
+}
+
+uint16_t BlockRegistry::TextureId(std::string const &texture) {
+  if (texture.empty()) {
+    return kNoTexture;
+  }
+  if (auto it = texture_ids_.find(texture); it != texture_ids_.end()) {
+    return it->second;
+  }
+  if (textures_.size() >= kNoTexture) {
+    throw BlockRegistryException("Too many textures");
+  }
+  const auto id = static_cast<uint16_t>(textures_.size());
+  textures_.push_back(texture);
+  texture_ids_.emplace(texture, id);
+  return id;
+}
+}  // namespace world
@@ -0,0 +1,150 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <parsers/yaml/yaml.hpp>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "world/chunk-section.hpp"
+#include "world/coordinates.hpp"
+
+/*
+ * Dense block ids assigned at load time. Every property lives in its own
+ * array indexed by BlockId, so meshing, physics and lighting never touch a
+ * string or a map. Names are only used to resolve ids while loading, and to
+ * save chunks.
+ *
+ * Definitions come from the YAML files in resources/data:
+ *   type: block
+ *   sides:                # diffuse textures
+ *     default: grass_side.png
+ *     top: grass_top.png  # also: sides, bottom, north, east, south, west
+ *   specular:
+ *     default: not_specular.png
+ *   hardness: 2
+ *   transparent: false    # the defaults are written out
+ *   interactable: false
+ *   solid: true
+ *   breakable: true
+ *   tile: false
+ *   light: 0              # light emitted, 0 to 15
+ *
+ * Textures are stored as indices into a table of texture names, so they can
+ * be used as layers of a texture array.
+ */
+namespace world {
+class BlockRegistryException : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+struct BlockDefinition {
+  std::string name;
+  float hardness = 0;
+  bool solid = true;
+  bool transparent = false;
+  bool interactable = false;
+  bool breakable = true;
+  bool tile = false;
+  uint8_t light = 0;
+  // indexed by Direction, empty means no texture
+  std::array<std::string, kDirectionCount> diffuse;
+  std::array<std::string, kDirectionCount> specular;
+
+  [[nodiscard]] static BlockDefinition Parse(std::string name,
+                                             yaml::Entry const &yaml);
+};
+
+class BlockRegistry final {
+ public:
+  // The names by id. A registration replaces the table instead of changing
+  // it, so a copy can be read on any thread while blocks are registered.
+  using NameTable = std::shared_ptr<const std::vector<std::string>>;
+  static constexpr uint16_t kNoTexture = UINT16_MAX;
+  static constexpr std::string_view kAirName = "minecraft:air";
+
+  // Air is always registered with id 0.
+  BlockRegistry();
+
+  // Registering a name again replaces its properties and keeps its id.
+  BlockId Register(BlockDefinition const &definition);
+  BlockId Register(std::string name, yaml::Entry const &yaml) {
+    return Register(BlockDefinition::Parse(std::move(name), yaml));
+  }
+
+  [[nodiscard]] std::optional<BlockId> Find(std::string_view name) const;
+  // Throws if the block is unknown.
+  [[nodiscard]] BlockId id(std::string_view name) const;
+  [[nodiscard]] std::string const &name(BlockId id) const {
+    return names_->at(id);
+  }
+  [[nodiscard]] size_t size() const noexcept { return names_->size(); }
+  [[nodiscard]] NameTable name_table() const noexcept { return names_; }
+
+  [[nodiscard]] float hardness(BlockId id) const noexcept {
+    return hardness_[id];
+  }
+  [[nodiscard]] bool solid(BlockId id) const noexcept { return solid_[id]; }
+  [[nodiscard]] bool transparent(BlockId id) const noexcept {
+    return transparent_[id];
+  }
+  [[nodiscard]] bool interactable(BlockId id) const noexcept {
+    return interactable_[id];
+  }
+  [[nodiscard]] bool breakable(BlockId id) const noexcept {
+    return breakable_[id];
+  }
+  [[nodiscard]] bool tile(BlockId id) const noexcept { return tile_[id]; }
+  [[nodiscard]] uint8_t light(BlockId id) const noexcept {
+    return light_[id];
+  }
+  [[nodiscard]] uint16_t diffuse_texture(BlockId id,
+                                         Direction face) const noexcept {
+    return diffuse_[id][static_cast<size_t>(face)];
+  }
+  [[nodiscard]] uint16_t specular_texture(BlockId id,
+                                          Direction face) const noexcept {
+    return specular_[id][static_cast<size_t>(face)];
+  }
+
+  // Whole tables, for code that wants to keep a raw pointer in a hot loop.
+  [[nodiscard]] std::span<const uint8_t> solid_table() const noexcept {
+    return solid_;
+  }
+  [[nodiscard]] std::span<const uint8_t> transparent_table() const noexcept {
+    return transparent_;
+  }
+  [[nodiscard]] std::span<const uint8_t> light_table() const noexcept {
+    return light_;
+  }
+  [[nodiscard]] std::span<const std::string> texture_names() const noexcept {
+    return textures_;
+  }
+
+ private:
+  uint16_t TextureId(std::string const &texture);
+
+  std::map<std::string, BlockId, std::less<>> ids_;
+  std::map<std::string, uint16_t, std::less<>> texture_ids_;
+  std::vector<std::string> textures_;
+
+  NameTable names_ = std::make_shared<const std::vector<std::string>>();
+  std::vector<float> hardness_;
+  // bytes rather than std::vector<bool>, so a lookup is a single load
+  std::vector<uint8_t> solid_;
+  std::vector<uint8_t> transparent_;
+  std::vector<uint8_t> interactable_;
+  std::vector<uint8_t> breakable_;
+  std::vector<uint8_t> tile_;
+  std::vector<uint8_t> light_;
+  std::vector<std::array<uint16_t, kDirectionCount>> diffuse_;
+  std::vector<std::array<uint16_t, kDirectionCount>> specular_;
+};
+}  // namespace world
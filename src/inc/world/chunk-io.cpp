@@ -0,0 +1,245 @@
+#include "chunk-io.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace world {
+ChunkIO::ChunkIO(std::filesystem::path const &directory)
+    : storage_(directory), thread_([this] { Run(); }) {}
+
+ChunkIO::~ChunkIO() {
+  try {
+    Shutdown();
+  } catch (...) {
+    // nobody is left to report it to
+  }
+}
+
+std::future<std::optional<nbt::NBT>> ChunkIO::Load(ChunkPos pos) {
+  std::promise<std::optional<nbt::NBT>> promise;
+  auto future = promise.get_future();
+  Encoder encode;
+  {
+    std::lock_guard lock(mutex_);
+    if (stopping_) {
+      throw ChunkIOException("Chunk I/O was shut down");
+    }
+    stats_.loads++;
+    PendingSave const *queued = nullptr;
+    if (auto region = saves_.find(ToRegionPos(pos)); region != saves_.end()) {
+      if (auto save = region->second.find(pos); save != region->second.end()) {
+        queued = &save->second;
+      }
+    }
+    if (!queued) {
+      loads_.push_back({pos, std::move(promise)});
+      wake_.notify_one();
+      return future;
+    }
+    stats_.loads_from_queue++;
+    if (auto const *nbt = std::get_if<nbt::NBT>(&queued->data)) {
+      promise.set_value(*nbt);
+      return future;
+    }
+    // a copy, it runs without the lock
+    encode = std::get<Encoder>(queued->data);
+    stats_.encoded++;
+  }
+  try {
+    promise.set_value(encode());
+  } catch (...) {
+    promise.set_exception(std::current_exception());
+  }
+  return future;
+}
+
+std::future<void> ChunkIO::Save(ChunkPos pos, nbt::NBT nbt) {
+  return Queue(pos, std::move(nbt));
+}
+
+std::future<void> ChunkIO::Save(ChunkPos pos, Encoder encode) {
+  return Queue(pos, std::move(encode));
+}
+
+std::future<void> ChunkIO::Queue(ChunkPos pos,
+                                 std::variant<nbt::NBT, Encoder> data) {
+  std::promise<void> promise;
+  auto future = promise.get_future();
+  {
+    std::lock_guard lock(mutex_);
+    if (stopping_) {
+      throw ChunkIOException("Chunk I/O was shut down");
+    }
+    stats_.saves++;
+    const uint64_t sequence = ++save_sequence_;
+    const RegionPos region = ToRegionPos(pos);
+    PendingSave &save = saves_[region][pos];
+    if (save.promises.empty()) {
+      queued_saves_++;
+      save.sequence = sequence;
+      unwritten_.emplace(sequence, region);
+    } else {
+      stats_.coalesced++;
+    }
+    save.data = std::move(data);
+    save.promises.push_back(std::move(promise));
+  }
+  wake_.notify_one();
+  return future;
+}
+
+void ChunkIO::Flush() {
+  std::unique_lock lock(mutex_);
+  if (stopping_) {
+    throw ChunkIOException("Chunk I/O was shut down");
+  }
+  // saved and flushed already when the sequence was flushed before
+  const uint64_t sequence = save_sequence_;
+  if (flushed_sequence_ < sequence) {
+    flush_sequence_ = std::max(flush_sequence_, sequence);
+    wake_.notify_one();
+    flushed_.wait(lock, [&] { return flushed_sequence_ >= sequence; });
+  }
+  if (flush_error_) {
+    std::rethrow_exception(std::exchange(flush_error_, nullptr));
+  }
+}
+
+void ChunkIO::Shutdown() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  // the I/O thread is gone, nothing writes it anymore
+  if (flush_error_) {
+    std::rethrow_exception(std::exchange(flush_error_, nullptr));
+  }
+}
+
+ChunkIOStats ChunkIO::stats() const {
+  std::lock_guard lock(mutex_);
+  ChunkIOStats stats = stats_;
+  stats.queued_loads = loads_.size();
+  stats.queued_saves = queued_saves_;
+  return stats;
+}
+
+void ChunkIO::Run() {
+  std::unique_lock lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] {
+      return stopping_ || !loads_.empty() || !saves_.empty() ||
+             flushed_sequence_ < flush_sequence_;
+    });
+    const bool flushing =
+        flushed_sequence_ < flush_sequence_ ||
+        (stopping_ && loads_.empty() && saves_.empty());
+    // everything saved before the flush requests is written
+    if (flushing && written() >= flush_sequence_) {
+      const uint64_t sequence = written();
+      lock.unlock();
+      std::exception_ptr error;
+      try {
+        storage_.Flush();
+      } catch (...) {
+        error = std::current_exception();
+      }
+      lock.lock();
+      if (error) {
+        flush_error_ = error;
+      }
+      flushed_sequence_ = sequence;
+      flushed_.notify_all();
+      if (stopping_ && loads_.empty() && saves_.empty()) {
+        return;
+      }
+      continue;
+    }
+    // a flush waits for the oldest saves, which go before the loads then
+    if (flushing) {
+      WriteRegion(lock, saves_.find(unwritten_.begin()->second));
+      continue;
+    }
+    // otherwise the player waits for loads, nobody for saves
+    if (!loads_.empty()) {
+      PendingLoad load = std::move(loads_.front());
+      loads_.pop_front();
+      lock.unlock();
+      const auto begin = std::chrono::steady_clock::now();
+      try {
+        load.promise.set_value(storage_.ReadChunk(load.pos));
+      } catch (...) {
+        load.promise.set_exception(std::current_exception());
+      }
+      const auto time = std::chrono::steady_clock::now() - begin;
+      lock.lock();
+      stats_.read_time += time;
+      continue;
+    }
+    auto next = saves_.upper_bound(last_region_);
+    WriteRegion(lock, next != saves_.end() ? next : saves_.begin());
+  }
+}
+
+void ChunkIO::WriteRegion(std::unique_lock<std::mutex> &lock,
+                          std::map<RegionPos, RegionSaves>::iterator region) {
+  auto node = saves_.extract(region);
+  last_region_ = node.key();
+  queued_saves_ -= node.mapped().size();
+  lock.unlock();
+  // loads of these chunks wait behind the batch, on this thread
+  Write(node.key(), node.mapped());
+  lock.lock();
+  for (auto const &[pos, save] : node.mapped()) {
+    unwritten_.erase(save.sequence);
+  }
+}
+
+uint64_t ChunkIO::written() const noexcept {
+  return unwritten_.empty() ? save_sequence_ : unwritten_.begin()->first - 1;
+}
+
+void ChunkIO::Write(RegionPos region, RegionSaves &saves) {
+  const auto begin = std::chrono::steady_clock::now();
+  std::shared_ptr<RegionFile> file;
+  std::exception_ptr open_error;
+  try {
+    file = storage_.GetRegion(region);
+  } catch (...) {
+    open_error = std::current_exception();
+  }
+  uint64_t encoded = 0;
+  for (auto &[pos, save] : saves) {
+    std::exception_ptr error = open_error;
+    if (!error) {
+      try {
+        if (auto const *nbt = std::get_if<nbt::NBT>(&save.data)) {
+          file->WriteChunk(pos, *nbt);
+        } else {
+          encoded++;
+          file->WriteChunk(pos, std::get<Encoder>(save.data)());
+        }
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+    for (std::promise<void> &promise : save.promises) {
+      if (error) {
+        promise.set_exception(error);
+      } else {
+        promise.set_value();
+      }
+    }
+  }
+  const auto time = std::chrono::steady_clock::now() - begin;
+  std::lock_guard lock(mutex_);
+  stats_.chunks_written += saves.size();
+  stats_.encoded += encoded;
+  stats_.batches++;
+  stats_.write_time += time;
+}
+}  // namespace world
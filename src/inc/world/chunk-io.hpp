@@ -0,0 +1,144 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "utils/nbt.hpp"
+#include "world/coordinates.hpp"
+#include "world/region-file.hpp"
+
+/*
+ * Region file access on a thread of its own, so ticks never wait for the
+ * disk.
+ *
+ * Load() and Save() can be called from any thread and return at once with a
+ * future. Saves are written behind: they wait in a queue per region, a save
+ * of a chunk that is still queued replaces the queued one, and the I/O
+ * thread writes the queue of a region in one batch. Loads go before the
+ * saves, and a load of a chunk whose save is still queued gets the queued
+ * NBT without reading the file.
+ *
+ * A save can also hand over an encoder instead of the NBT, which runs on the
+ * I/O thread when the chunk is written, usually on a ChunkSnapshot. An
+ * encoder replaced by a later save never runs.
+ *
+ * Every save takes a sequence number. Flush() waits until every save up to
+ * the last one queued before it is written and the region files are flushed
+ * to the disk. While a flush waits, the I/O thread writes the oldest saves
+ * first, ahead of the loads, so a steady stream of requests can't hold it
+ * back. Shutdown(), also called by the destructor, writes everything,
+ * flushes and stops the thread; requests after it throw. Call it before the
+ * destructor to see a failed final flush, the destructor can't throw it.
+ */
+namespace world {
+class ChunkIOException : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+struct ChunkIOStats {
+  // waiting for the I/O thread
+  size_t queued_loads = 0;
+  size_t queued_saves = 0;
+  uint64_t loads = 0;
+  // loads answered from a queued save
+  uint64_t loads_from_queue = 0;
+  uint64_t saves = 0;
+  // saves replaced by a later save of the same chunk before being written
+  uint64_t coalesced = 0;
+  uint64_t chunks_written = 0;
+  // encoders run, on the I/O thread or for a load
+  uint64_t encoded = 0;
+  uint64_t batches = 0;
+  std::chrono::nanoseconds read_time{0};
+  std::chrono::nanoseconds write_time{0};
+};
+
+class ChunkIO final {
+ public:
+  // Called from the I/O thread, or from Load() for a queued save.
+  using Encoder = std::function<nbt::NBT()>;
+
+  explicit ChunkIO(std::filesystem::path const &directory);
+  ~ChunkIO();
+  ChunkIO(ChunkIO const &) = delete;
+  ChunkIO &operator=(ChunkIO const &) = delete;
+
+  // nullopt if the chunk was never saved.
+  [[nodiscard]] std::future<std::optional<nbt::NBT>> Load(ChunkPos pos);
+  // The future is ready once the chunk, or a later save of it, is written.
+  std::future<void> Save(ChunkPos pos, nbt::NBT nbt);
+  std::future<void> Save(ChunkPos pos, Encoder encode);
+
+  // Blocks until the saves queued so far are written and the region files
+  // are flushed. Failed writes are reported through their futures, a failed
+  // flush is rethrown.
+  void Flush();
+  // Writes what is queued, flushes and stops the I/O thread. A failed flush
+  // that wasn't rethrown by Flush() yet is rethrown, once.
+  void Shutdown();
+
+  [[nodiscard]] ChunkIOStats stats() const;
+
+ private:
+  struct PendingLoad {
+    ChunkPos pos;
+    std::promise<std::optional<nbt::NBT>> promise;
+  };
+  struct PendingSave {
+    // of the first save still waiting, the later ones were coalesced into it
+    uint64_t sequence = 0;
+    std::variant<nbt::NBT, Encoder> data;
+    // every coalesced save waits for the one write
+    std::vector<std::promise<void>> promises;
+  };
+  using RegionSaves = std::unordered_map<ChunkPos, PendingSave>;
+
+  std::future<void> Queue(ChunkPos pos, std::variant<nbt::NBT, Encoder> data);
+  void Run();
+  // Writes the saves of the region without holding the lock.
+  void WriteRegion(std::unique_lock<std::mutex> &lock,
+                   std::map<RegionPos, RegionSaves>::iterator region);
+  void Write(RegionPos region, RegionSaves &saves);
+  // The saves up to this sequence number are written.
+  [[nodiscard]] uint64_t written() const noexcept;
+
+  RegionStorage storage_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  // the I/O thread finished a flush
+  std::condition_variable flushed_;
+  std::deque<PendingLoad> loads_;
+  std::map<RegionPos, RegionSaves> saves_;
+  size_t queued_saves_ = 0;
+  // the sequence number of the last save
+  uint64_t save_sequence_ = 0;
+  // saves that are queued or being written, by their sequence number
+  std::map<uint64_t, RegionPos> unwritten_;
+  // the saves Flush() waits for, and those flushed to the disk
+  uint64_t flush_sequence_ = 0;
+  uint64_t flushed_sequence_ = 0;
+  std::exception_ptr flush_error_;
+  // regions are written in turn, so busy ones don't starve the others
+  RegionPos last_region_;
+  bool stopping_ = false;
+  ChunkIOStats stats_;
+
+  std::thread thread_;
+};
+}  // namespace world
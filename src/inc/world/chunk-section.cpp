@@ -0,0 +1,174 @@
+#include "chunk-section.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+
+namespace world {
+ChunkSection::ChunkSection(BlockId fill) { Fill(fill); }
+
+BlockId ChunkSection::Set(uint32_t index, BlockId block) {
+  const BlockId old = Get(index);
+  if (old == block) {
+    return old;
+  }
+  Detach();
+  non_air_ = non_air_ + (block != kAir) - (old != kAir);
+  const uint32_t slot = bits_ == kDirectBits ? block : PaletteSlot(block);
+  // the palette may have been replaced with direct storage
+  if (bits_ == kDirectBits) {
+    RawSet(index, block);
+    Sync();
+    return old;
+  }
+  std::vector<uint16_t> &counts = storage_->counts;
+  const uint32_t old_slot = RawGet(index);
+  RawSet(index, slot);
+  counts[old_slot]--;
+  if (++counts[slot] == kVolume) {
+    Collapse(block);
+  }
+  Sync();
+  return old;
+}
+
+void ChunkSection::Fill(BlockId block) {
+  Collapse(block);
+  non_air_ = block == kAir ? 0 : kVolume;
+  Sync();
+}
+
+void ChunkSection::Optimize() {
+  if (bits_ == 0) {
+    return;
+  }
+  std::vector<uint16_t> values(kVolume);
+  for (uint32_t i = 0; i < kVolume; i++) {
+    values[i] = Get(i);
+  }
+  std::vector<BlockId> palette = values;
+  std::sort(palette.begin(), palette.end());
+  palette.erase(std::unique(palette.begin(), palette.end()), palette.end());
+  if (palette.size() == 1) {
+    Collapse(palette[0]);
+    Sync();
+    return;
+  }
+  // everything is rewritten, a shared storage is left to the copies
+  auto storage = std::make_shared<Storage>();
+  if (palette.size() > 256) {
+    SetBits(kDirectBits);
+  } else {
+    SetBits(static_cast<uint8_t>(std::bit_ceil(
+        static_cast<unsigned>(std::bit_width(palette.size() - 1)))));
+    storage->counts.assign(palette.size(), 0);
+    for (auto &value : values) {
+      value = static_cast<uint16_t>(
+          std::lower_bound(palette.begin(), palette.end(), value) -
+          palette.begin());
+      storage->counts[value]++;
+    }
+    storage->palette = std::move(palette);
+    storage->palette.shrink_to_fit();
+  }
+  storage->data.assign(kVolume * bits_ / 64, 0);
+  storage_ = std::move(storage);
+  for (uint32_t i = 0; i < kVolume; i++) {
+    RawSet(i, values[i]);
+  }
+  Sync();
+}
+
+size_t ChunkSection::memory_usage() const noexcept {
+  return sizeof(*this) + sizeof(Storage) +
+         storage_->data.capacity() * sizeof(uint64_t) +
+         storage_->palette.capacity() * sizeof(BlockId) +
+         storage_->counts.capacity() * sizeof(uint16_t);
+}
+
+void ChunkSection::Detach() {
+  // use_count() is a relaxed load. Copies are released from other threads,
+  // the fence orders their last reads before the writes that follow.
+  if (storage_.use_count() == 1) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return;
+  }
+  storage_ = std::make_shared<Storage>(*storage_);
+  Sync();
+}
+
+uint32_t ChunkSection::PaletteSlot(BlockId block) {
+  std::vector<BlockId> &palette = storage_->palette;
+  std::vector<uint16_t> &counts = storage_->counts;
+  // the palette never has more than 256 entries, so this stays within a few
+  // cache lines; slots nothing refers to anymore are reused
+  uint32_t free_slot = UINT32_MAX;
+  for (uint32_t i = 0; i < palette.size(); i++) {
+    if (palette[i] == block) {
+      return i;
+    }
+    if (counts[i] == 0 && free_slot == UINT32_MAX) {
+      free_slot = i;
+    }
+  }
+  if (free_slot != UINT32_MAX) {
+    palette[free_slot] = block;
+    return free_slot;
+  }
+  const auto slot = static_cast<uint32_t>(palette.size());
+  if (slot >= (1u << bits_)) {
+    if (bits_ == 8) {
+      Resize(kDirectBits);
+      return block;
+    }
+    Resize(bits_ == 0 ? 1 : bits_ * 2);
+  }
+  palette.push_back(block);
+  counts.push_back(0);
+  return slot;
+}
+
+void ChunkSection::Resize(uint8_t bits) {
+  std::vector<uint16_t> values(kVolume);
+  const bool direct = bits == kDirectBits;
+  for (uint32_t i = 0; i < kVolume; i++) {
+    const uint32_t slot = bits_ == 0 ? 0 : RawGet(i);
+    values[i] = direct ? storage_->palette[slot] : static_cast<uint16_t>(slot);
+  }
+  SetBits(bits);
+  storage_->data.assign(kVolume * bits / 64, 0);
+  for (uint32_t i = 0; i < kVolume; i++) {
+    RawSet(i, values[i]);
+  }
+  if (direct) {
+    storage_->palette = {};
+    storage_->counts = {};
+  }
+}
+
+void ChunkSection::SetBits(uint8_t bits) noexcept {
+  bits_ = bits;
+  if (bits == 0) {
+    shift_ = entries_mask_ = 0;
+    value_mask_ = 0;
+    return;
+  }
+  const uint32_t entries_per_word = 64 / bits;
+  shift_ = static_cast<uint8_t>(std::countr_zero(entries_per_word));
+  entries_mask_ = static_cast<uint8_t>(entries_per_word - 1);
+  value_mask_ = (uint64_t(1) << bits) - 1;
+}
+
+void ChunkSection::Collapse(BlockId block) {
+  // nothing of the old storage is kept
+  if (!storage_ || storage_.use_count() > 1) {
+    storage_ = std::make_shared<Storage>();
+  } else {
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  storage_->data = {};
+  storage_->palette = {block};
+  storage_->counts = {static_cast<uint16_t>(kVolume)};
+  SetBits(0);
+}
+}  // namespace world
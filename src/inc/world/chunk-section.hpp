@@ -0,0 +1,133 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+/*
+ * 16x16x16 blocks stored as bit-packed indices into a per-section palette.
+ *
+ * bits_per_entry  | storage
+ * ----------------+----------------------------------------------------------
+ *  0              | single value: the palette holds the only block, no data
+ *  1, 2, 4, 8     | 4096 palette indices packed into 64-bit words
+ *  16             | direct: the words hold block ids, the palette is unused
+ *
+ * The width is always a power of two, so an entry never spans two words and
+ * locating it is a shift and a mask. Every palette entry keeps a reference
+ * count: entries that drop to zero are reused before the width grows, and a
+ * section that ends up holding a single block collapses back to 0 bits.
+ *
+ * Copies are copy-on-write: they share the palette and the words until one
+ * of them is written, which gives the writer its own storage first. A copy
+ * taken on the main thread is a consistent snapshot that other threads can
+ * read while the original keeps changing.
+ */
+namespace world {
+using BlockId = uint16_t;
+constexpr BlockId kAir = 0;
+
+class ChunkSection final {
+ public:
+  static constexpr int32_t kSize = 16;
+  static constexpr uint32_t kVolume = kSize * kSize * kSize;
+  static constexpr uint8_t kDirectBits = 16;
+
+  explicit ChunkSection(BlockId fill = kAir);
+
+  // y-major order, so a horizontal layer is contiguous
+  [[nodiscard]] static constexpr uint32_t Index(uint32_t x, uint32_t y,
+                                                uint32_t z) noexcept {
+    return (y << 8) | (z << 4) | x;
+  }
+
+  [[nodiscard]] BlockId Get(uint32_t index) const noexcept {
+    if (bits_ == 0) {
+      return palette_[0];
+    }
+    const uint64_t value = (words_[index >> shift_] >>
+                            ((index & entries_mask_) * bits_)) &
+                           value_mask_;
+    return bits_ == kDirectBits ? static_cast<BlockId>(value)
+                                : palette_[value];
+  }
+  [[nodiscard]] BlockId Get(uint32_t x, uint32_t y, uint32_t z) const noexcept {
+    return Get(Index(x, y, z));
+  }
+
+  // Returns the block that was replaced.
+  BlockId Set(uint32_t index, BlockId block);
+  BlockId Set(uint32_t x, uint32_t y, uint32_t z, BlockId block) {
+    return Set(Index(x, y, z), block);
+  }
+
+  void Fill(BlockId block);
+
+  // Drops unused palette entries and shrinks the width as far as possible.
+  void Optimize();
+
+  [[nodiscard]] bool uniform() const noexcept { return bits_ == 0; }
+  [[nodiscard]] bool empty() const noexcept { return non_air_ == 0; }
+  [[nodiscard]] uint32_t non_air_count() const noexcept { return non_air_; }
+  [[nodiscard]] uint8_t bits_per_entry() const noexcept { return bits_; }
+  [[nodiscard]] std::span<const BlockId> palette() const noexcept {
+    return storage_->palette;
+  }
+  [[nodiscard]] std::span<const uint64_t> data() const noexcept {
+    return storage_->data;
+  }
+  // Whether the storage is shared with a copy.
+  [[nodiscard]] bool shared() const noexcept {
+    return storage_.use_count() > 1;
+  }
+  // Heap and inline bytes held by the section, shared storage included.
+  [[nodiscard]] size_t memory_usage() const noexcept;
+
+ private:
+  struct Storage {
+    std::vector<uint64_t> data;
+    std::vector<BlockId> palette;
+    // how many entries reference every palette slot
+    std::vector<uint16_t> counts;
+  };
+
+  // Gives the section its own storage before it is written.
+  void Detach();
+  // Points Get() at the storage again after it was changed.
+  void Sync() noexcept {
+    words_ = storage_->data.data();
+    palette_ = storage_->palette.data();
+  }
+
+  [[nodiscard]] uint32_t RawGet(uint32_t index) const noexcept {
+    return static_cast<uint32_t>(
+        (storage_->data[index >> shift_] >>
+         ((index & entries_mask_) * bits_)) &
+        value_mask_);
+  }
+  void RawSet(uint32_t index, uint32_t value) noexcept {
+    const uint32_t offset = (index & entries_mask_) * bits_;
+    uint64_t &word = storage_->data[index >> shift_];
+    word = (word & ~(value_mask_ << offset)) | (uint64_t(value) << offset);
+  }
+
+  // Finds or allocates a palette slot, growing the width if needed.
+  uint32_t PaletteSlot(BlockId block);
+  // Repacks all entries with the given width, palette indices are kept.
+  void Resize(uint8_t bits);
+  void SetBits(uint8_t bits) noexcept;
+  void Collapse(BlockId block);
+
+  std::shared_ptr<Storage> storage_;
+  // into the storage, so Get() doesn't go through the pointer
+  uint64_t const *words_ = nullptr;
+  BlockId const *palette_ = nullptr;
+  uint64_t value_mask_ = 0;
+  uint32_t non_air_ = 0;
+  uint8_t bits_ = 0;
+  // index >> shift_ is the word, index & entries_mask_ the entry in the word
+  uint8_t shift_ = 0;
+  uint8_t entries_mask_ = 0;
+};
+}  // namespace world
@@ -0,0 +1,167 @@
+#include "chunk-serializer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <string>
+#include <utility>
+
+namespace world {
+namespace {
+constexpr uint32_t kVolume = ChunkSection::kVolume;
+
+template <typename T>
+T const &Field(nbt::TagCompound const &compound, std::string const &key) {
+  auto it = compound.base.find(key);
+  if (it == compound.base.end() || !std::holds_alternative<T>(it->second)) {
+    throw ChunkFormatException("Chunk NBT has no valid " + key);
+  }
+  return std::get<T>(it->second);
+}
+
+// Empty lists are decoded as lists of TAG_END.
+template <typename T>
+std::vector<T> const &Elements(nbt::TagList const &list,
+                               std::string const &key) {
+  static std::vector<T> const empty;
+  if (std::holds_alternative<std::vector<nbt::TagEnd>>(list.base)) {
+    return empty;
+  }
+  if (!std::holds_alternative<std::vector<T>>(list.base)) {
+    throw ChunkFormatException("Chunk NBT has an invalid " + key + " list");
+  }
+  return nbt::get_list<T>(list);
+}
+
+nbt::TagCompound EncodeSection(ChunkSection const &section, int32_t y,
+                               std::vector<std::string> const &names) {
+  std::vector<BlockId> blocks;
+  nbt::TagLongArray data;
+  if (section.bits_per_entry() == ChunkSection::kDirectBits) {
+    // a palette of what is there instead of the global ids
+    std::vector<BlockId> values(kVolume);
+    for (uint32_t i = 0; i < kVolume; i++) {
+      values[i] = section.Get(i);
+    }
+    blocks = values;
+    std::ranges::sort(blocks);
+    blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+    data.assign(kVolume * ChunkSection::kDirectBits / 64, 0);
+    for (uint32_t i = 0; i < kVolume; i++) {
+      const auto index = static_cast<uint64_t>(
+          std::ranges::lower_bound(blocks, values[i]) - blocks.begin());
+      data[i / 4] = std::bit_cast<nbt::TagLong>(
+          std::bit_cast<uint64_t>(data[i / 4]) | index << (i % 4 * 16));
+    }
+  } else {
+    blocks.assign(section.palette().begin(), section.palette().end());
+    data.reserve(section.data().size());
+    for (uint64_t word : section.data()) {
+      data.push_back(std::bit_cast<nbt::TagLong>(word));
+    }
+  }
+  std::vector<nbt::TagCompound> palette;
+  palette.reserve(blocks.size());
+  for (BlockId block : blocks) {
+    palette.push_back({{"Name", nbt::TagString(names.at(block))}});
+  }
+  nbt::TagCompound states;
+  states["palette"] = nbt::TagList(palette);
+  if (!data.empty()) {
+    states["data"] = std::move(data);
+  }
+  return {{"Y", static_cast<nbt::TagByte>(y)}, {"block_states", states}};
+}
+
+void DecodeSection(nbt::TagCompound const &states, ChunkSection &section,
+                   BlockRegistry const &registry) {
+  const auto &palette = Elements<nbt::TagCompound>(
+      Field<nbt::TagList>(states, "palette"), "palette");
+  if (palette.empty()) {
+    throw ChunkFormatException("Chunk NBT has a section without palette");
+  }
+  std::vector<BlockId> blocks;
+  blocks.reserve(palette.size());
+  for (nbt::TagCompound const &entry : palette) {
+    blocks.push_back(registry.Find(Field<nbt::TagString>(entry, "Name"))
+                         .value_or(kAir));
+  }
+  if (!states.base.contains("data")) {
+    section.Fill(blocks[0]);
+    return;
+  }
+  const auto &data = Field<nbt::TagLongArray>(states, "data");
+  const size_t bits = data.size() * 64 / kVolume;
+  if (data.size() * 64 % kVolume != 0 || !std::has_single_bit(bits) ||
+      bits > ChunkSection::kDirectBits) {
+    throw ChunkFormatException("Chunk NBT has a section of " +
+                               std::to_string(data.size()) + " longs");
+  }
+  const size_t per_word = 64 / bits;
+  const uint64_t mask = (uint64_t(1) << bits) - 1;
+  for (uint32_t i = 0; i < kVolume; i++) {
+    const uint64_t index =
+        std::bit_cast<uint64_t>(data[i / per_word]) >> (i % per_word * bits) &
+        mask;
+    if (index >= blocks.size()) {
+      throw ChunkFormatException("Chunk NBT has a block outside the palette");
+    }
+    section.Set(i, blocks[index]);
+  }
+}
+}  // namespace
+
+ChunkSnapshot TakeSnapshot(Chunk const &chunk, BlockRegistry const &registry,
+                           TileEntityRegistry const &tiles) {
+  // copied in place, default sections would allocate storage of their own
+  auto copy = [&]<int32_t... kIndex>(
+                  std::integer_sequence<int32_t, kIndex...>) {
+    return std::array<ChunkSection, Chunk::kSectionCount>{
+        chunk.section(kIndex)...};
+  };
+  auto sections =
+      copy(std::make_integer_sequence<int32_t, Chunk::kSectionCount>());
+  return {.pos = chunk.pos(),
+          .sections = std::move(sections),
+          .names = registry.name_table(),
+          .tile_entities = chunk.tile_entities().Save(tiles)};
+}
+
+nbt::NBT EncodeChunk(ChunkSnapshot const &snapshot) {
+  nbt::NBT nbt{""};
+  nbt["xPos"] = nbt::TagInt{snapshot.pos.x};
+  nbt["zPos"] = nbt::TagInt{snapshot.pos.z};
+  std::vector<nbt::TagCompound> sections;
+  for (size_t y = 0; y < snapshot.sections.size(); y++) {
+    ChunkSection const &section = snapshot.sections[y];
+    if (!section.uniform() || section.Get(0) != kAir) {
+      sections.push_back(
+          EncodeSection(section, static_cast<int32_t>(y), *snapshot.names));
+    }
+  }
+  nbt["sections"] = nbt::TagList(sections);
+  const nbt::NBT tiles(std::span<const std::byte>(snapshot.tile_entities));
+  nbt["block_entities"] = tiles.at("block_entities");
+  return nbt;
+}
+
+Chunk DecodeChunk(nbt::NBT const &nbt, BlockRegistry const &registry,
+                  TileEntityRegistry const &tiles) {
+  Chunk chunk(
+      {Field<nbt::TagInt>(nbt, "xPos"), Field<nbt::TagInt>(nbt, "zPos")});
+  for (nbt::TagCompound const &section : Elements<nbt::TagCompound>(
+           Field<nbt::TagList>(nbt, "sections"), "sections")) {
+    const nbt::TagByte y = Field<nbt::TagByte>(section, "Y");
+    if (y < 0 || y >= Chunk::kSectionCount) {
+      throw ChunkFormatException("Chunk NBT has a section at " +
+                                 std::to_string(y));
+    }
+    DecodeSection(Field<nbt::TagCompound>(section, "block_states"),
+                  chunk.section(y), registry);
+  }
+  chunk.Optimize();
+  nbt::NBT root{""};
+  root["block_entities"] = Field<nbt::TagList>(nbt, "block_entities");
+  chunk.tile_entities().Load(tiles, root.encode());
+  return chunk;
+}
+}  // namespace world
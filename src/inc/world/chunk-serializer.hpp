@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "utils/nbt.hpp"
+#include "world/block-registry.hpp"
+#include "world/chunk-section.hpp"
+#include "world/chunk.hpp"
+#include "world/coordinates.hpp"
+#include "world/tile-entities.hpp"
+
+/*
+ * Chunks as NBT, in the layout of Anvil chunks:
+ *
+ *   xPos, zPos       TagInt
+ *   sections         a compound per section that isn't all air:
+ *                      Y             TagByte
+ *                      block_states  palette: compounds with the block
+ *                                    "Name", data: the palette indices
+ *                                    packed into longs, absent if the
+ *                                    palette has a single block
+ *   block_entities   as written by TileEntities::Save()
+ *
+ * An index never spans two longs, so the width is the data length times 64
+ * over 4096. Sections with direct storage are written with a palette of the
+ * blocks they hold and 16 bit indices.
+ *
+ * Saving is split so the main thread does almost nothing: TakeSnapshot()
+ * copies the sections, which only shares their storage until the chunk is
+ * written again, encodes the tile entities and keeps the block names of the
+ * registry. EncodeChunk() turns the snapshot into NBT on any thread, even
+ * while more blocks are registered.
+ */
+namespace world {
+class ChunkFormatException : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+struct ChunkSnapshot {
+  ChunkPos pos;
+  std::array<ChunkSection, Chunk::kSectionCount> sections;
+  // the names of the blocks by id, when the snapshot was taken
+  BlockRegistry::NameTable names;
+  // a root compound holding the "block_entities" list
+  std::vector<std::byte> tile_entities;
+};
+
+[[nodiscard]] ChunkSnapshot TakeSnapshot(Chunk const &chunk,
+                                         BlockRegistry const &registry,
+                                         TileEntityRegistry const &tiles);
+[[nodiscard]] nbt::NBT EncodeChunk(ChunkSnapshot const &snapshot);
+// Unknown blocks become air, unknown tile entities are dropped.
+[[nodiscard]] Chunk DecodeChunk(nbt::NBT const &nbt,
+                                BlockRegistry const &registry,
+                                TileEntityRegistry const &tiles);
+}  // namespace world
@@ -0,0 +1,111 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+
+#include "world/chunk-section.hpp"
+#include "world/coordinates.hpp"
+#include "world/tile-entities.hpp"
+
+namespace world {
+// A 16x256x16 column of blocks, split into 16 palette-compressed sections.
+//
+// Set() marks the chunk dirty when the block changes, writes through
+// section() are not tracked and call MarkDirty() themselves. The chunk is
+// dirty as well while its tile entities are. The on_dirty callback sees the
+// blocks and the tile entities turn dirty, so a saver doesn't have to poll.
+class Chunk final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr int32_t kHeight = 256;
+  static constexpr int32_t kSectionCount = kHeight / ChunkSection::kSize;
+
+  explicit Chunk(ChunkPos pos) noexcept : pos_(pos) {}
+
+  // Local coordinates: x and z in [0, 16), y in [0, 256).
+  [[nodiscard]] BlockId Get(uint32_t x, uint32_t y, uint32_t z) const noexcept {
+    return sections_[y >> 4].Get(x, y & 15, z);
+  }
+  BlockId Set(uint32_t x, uint32_t y, uint32_t z, BlockId block) {
+    const BlockId old = sections_[y >> 4].Set(x, y & 15, z, block);
+    if (old != block && !dirty_since_) {
+      MarkDirty();
+    }
+    return old;
+  }
+
+  [[nodiscard]] ChunkSection &section(int32_t index) noexcept {
+    return sections_[index];
+  }
+  [[nodiscard]] ChunkSection const &section(int32_t index) const noexcept {
+    return sections_[index];
+  }
+  [[nodiscard]] ChunkPos pos() const noexcept { return pos_; }
+  [[nodiscard]] TileEntities &tile_entities() noexcept {
+    return tile_entities_;
+  }
+  [[nodiscard]] TileEntities const &tile_entities() const noexcept {
+    return tile_entities_;
+  }
+
+  // Keeps the earliest time until ClearDirty().
+  void MarkDirty(Clock::time_point since = Clock::now()) {
+    const bool was_dirty = dirty_since_.has_value();
+    if (!was_dirty || since < *dirty_since_) {
+      dirty_since_ = since;
+    }
+    if (!was_dirty && on_dirty_) {
+      on_dirty_();
+    }
+  }
+  // Clears the tile entities as well, once a snapshot is taken.
+  void ClearDirty() noexcept {
+    dirty_since_.reset();
+    tile_entities_.ClearDirty();
+  }
+  [[nodiscard]] bool dirty() const noexcept {
+    return dirty_since_ || tile_entities_.dirty();
+  }
+  // The time of the oldest unsaved change, of the blocks or tile entities.
+  [[nodiscard]] std::optional<Clock::time_point> dirty_since() const noexcept {
+    const auto tiles = tile_entities_.dirty_since();
+    if (!dirty_since_ || !tiles) {
+      return dirty_since_ ? dirty_since_ : tiles;
+    }
+    return std::min(*dirty_since_, *tiles);
+  }
+
+  // Called whenever the blocks or the tile entities turn dirty, the chunk
+  // may be dirty already through the other one.
+  void set_on_dirty(std::function<void()> const &on_dirty) {
+    on_dirty_ = on_dirty;
+    tile_entities_.set_on_dirty(on_dirty);
+  }
+
+  void Optimize() {
+    for (auto &section : sections_) {
+      section.Optimize();
+    }
+  }
+
+  [[nodiscard]] size_t memory_usage() const noexcept {
+    size_t size = sizeof(*this) - sizeof(sections_);
+    for (auto const &section : sections_) {
+      size += section.memory_usage();
+    }
+    return size;
+  }
+
+ private:
+  ChunkPos pos_;
+  std::array<ChunkSection, kSectionCount> sections_;
+  TileEntities tile_entities_;
+  std::optional<Clock::time_point> dirty_since_;
+  std::function<void()> on_dirty_;
+};
+}  // namespace world
@@ -0,0 +1,102 @@
+#pragma once
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace world {
+// Chunks are 16x16 columns of blocks, regions are 32x32 chunks.
+constexpr int32_t kChunkSize = 16;
+constexpr int32_t kRegionSize = 32;
+
+struct ChunkPos {
+  int32_t x = 0;
+  int32_t z = 0;
+  auto operator<=>(ChunkPos const &) const = default;
+};
+
+struct RegionPos {
+  int32_t x = 0;
+  int32_t z = 0;
+  auto operator<=>(RegionPos const &) const = default;
+};
+
+// A 16x16x16 chunk section: chunk x and z, section index y.
+struct SectionPos {
+  int32_t x = 0;
+  int32_t y = 0;
+  int32_t z = 0;
+  auto operator<=>(SectionPos const &) const = default;
+};
+
+// Block faces, in the order used by every per-face table.
+enum class Direction : uint8_t {
+  kWest,    // -x
+  kEast,    // +x
+  kBottom,  // -y
+  kTop,     // +y
+  kNorth,   // -z
+  kSouth    // +z
+};
+constexpr size_t kDirectionCount = 6;
+
+// Block coordinates -> chunk coordinates, rounding towards negative infinity.
+[[nodiscard]] constexpr ChunkPos ToChunkPos(int32_t block_x,
+                                            int32_t block_z) noexcept {
+  return {block_x >> 4, block_z >> 4};
+}
+
+// The faces come in pairs, west and east, bottom and top, north and south.
+[[nodiscard]] constexpr Direction Opposite(Direction face) noexcept {
+  return static_cast<Direction>(static_cast<uint8_t>(face) ^ 1);
+}
+
+[[nodiscard]] constexpr SectionPos Neighbor(SectionPos pos,
+                                            Direction face) noexcept {
+  switch (face) {
+    case Direction::kWest:
+      return {pos.x - 1, pos.y, pos.z};
+    case Direction::kEast:
+      return {pos.x + 1, pos.y, pos.z};
+    case Direction::kBottom:
+      return {pos.x, pos.y - 1, pos.z};
+    case Direction::kTop:
+      return {pos.x, pos.y + 1, pos.z};
+    case Direction::kNorth:
+      return {pos.x, pos.y, pos.z - 1};
+    case Direction::kSouth:
+      return {pos.x, pos.y, pos.z + 1};
+  }
+  return pos;
+}
+
+[[nodiscard]] constexpr RegionPos ToRegionPos(ChunkPos const pos) noexcept {
+  return {pos.x >> 5, pos.z >> 5};
+}
+}  // namespace world
+
+template <>
+struct std::hash<world::ChunkPos> {
+  size_t operator()(world::ChunkPos const &pos) const noexcept {
+    return std::hash<uint64_t>{}((uint64_t(uint32_t(pos.x)) << 32) |
+                                 uint32_t(pos.z));
+  }
+};
+
+template <>
+struct std::hash<world::SectionPos> {
+  size_t operator()(world::SectionPos const &pos) const noexcept {
+    // 26 bits of x and z, 12 bits of y
+    return std::hash<uint64_t>{}((uint64_t(uint32_t(pos.x) & 0x3FFFFFF) << 38) |
+                                 (uint64_t(uint32_t(pos.z) & 0x3FFFFFF) << 12) |
+                                 (uint32_t(pos.y) & 0xFFF));
+  }
+};
+
+template <>
+struct std::hash<world::RegionPos> {
+  size_t operator()(world::RegionPos const &pos) const noexcept {
+    return std::hash<uint64_t>{}((uint64_t(uint32_t(pos.x)) << 32) |
+                                 uint32_t(pos.z));
+  }
+};
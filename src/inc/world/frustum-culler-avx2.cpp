@@ -0,0 +1,33 @@
+#include "frustum-kernels.hpp"
+
+// Compiled with AVX2 enabled (see CMakeLists.txt), only called once
+// utils::DetectSimdLevel found AVX2.
+#if UTILS_SIMD_X86
+#include <immintrin.h>
+
+namespace world::detail {
+namespace {
+struct Avx2Ops {
+  static constexpr size_t kWidth = 8;
+  using Float = __m256;
+  using Mask = __m256;
+
+  static Float Set(float value) { return _mm256_set1_ps(value); }
+  static Float Load(float const *in) { return _mm256_loadu_ps(in); }
+  static Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+  static Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+  static Mask Less(Float a, Float b) {
+    return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+  }
+  static Mask Or(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+  static uint32_t Bits(Mask mask) {
+    return static_cast<uint32_t>(_mm256_movemask_ps(mask));
+  }
+};
+}  // namespace
+
+size_t CullAvx2(CullInput const &input, uint32_t *out) noexcept {
+  return Cull<Avx2Ops>(input, out);
+}
+}  // namespace world::detail
+#endif
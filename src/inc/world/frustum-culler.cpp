@@ -0,0 +1,195 @@
+#include "frustum-culler.hpp"
+
+#include <cmath>
+#include <string>
+
+#include "frustum-kernels.hpp"
+
+#if UTILS_SIMD_X86
+#include <emmintrin.h>
+#endif
+
+namespace world {
+namespace detail {
+namespace {
+constexpr uint32_t kNone = UINT32_MAX;
+
+struct ScalarOps {
+  static constexpr size_t kWidth = 1;
+  using Float = float;
+  using Mask = bool;
+
+  static Float Set(float value) { return value; }
+  static Float Load(float const *in) { return *in; }
+  static Float Add(Float a, Float b) { return a + b; }
+  static Float Mul(Float a, Float b) { return a * b; }
+  static Mask Less(Float a, Float b) { return a < b; }
+  static Mask Or(Mask a, Mask b) { return a || b; }
+  static uint32_t Bits(Mask mask) { return mask ? 1 : 0; }
+};
+
+#if UTILS_SIMD_X86
+struct Sse2Ops {
+  static constexpr size_t kWidth = 4;
+  using Float = __m128;
+  using Mask = __m128;
+
+  static Float Set(float value) { return _mm_set1_ps(value); }
+  static Float Load(float const *in) { return _mm_loadu_ps(in); }
+  static Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+  static Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+  static Mask Less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+  static Mask Or(Mask a, Mask b) { return _mm_or_ps(a, b); }
+  static uint32_t Bits(Mask mask) {
+    return static_cast<uint32_t>(_mm_movemask_ps(mask));
+  }
+};
+#endif
+}  // namespace
+
+size_t CullScalar(CullInput const &input, uint32_t *out) noexcept {
+  return Cull<ScalarOps>(input, out);
+}
+
+#if UTILS_SIMD_X86
+size_t CullSse2(CullInput const &input, uint32_t *out) noexcept {
+  return Cull<Sse2Ops>(input, out);
+}
+#endif
+}  // namespace detail
+
+Aabb Aabb::Section(SectionPos pos, std::array<float, 3> origin) noexcept {
+  const std::array<int32_t, 3> position{pos.x, pos.y, pos.z};
+  Aabb box;
+  for (size_t axis = 0; axis < 3; axis++) {
+    box.min[axis] = static_cast<float>(position[axis] * 16) - origin[axis];
+    box.max[axis] = box.min[axis] + 16;
+  }
+  return box;
+}
+
+Frustum Frustum::FromMatrix(std::array<float, 16> const &matrix) noexcept {
+  auto row = [&](size_t i) {
+    return std::array<float, 4>{matrix[i], matrix[4 + i], matrix[8 + i],
+                                matrix[12 + i]};
+  };
+  const auto w = row(3);
+  Frustum frustum;
+  for (size_t i = 0; i < frustum.planes.size(); i++) {
+    // w + x, w - x, w + y, w - y, w + z, w - z
+    const auto axis = row(i / 2);
+    const float sign = i % 2 == 0 ? 1.0f : -1.0f;
+    std::array<float, 4> plane;
+    for (size_t j = 0; j < 4; j++) {
+      plane[j] = w[j] + sign * axis[j];
+    }
+    const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] +
+                                   plane[2] * plane[2]);
+    const float scale = length > 0 ? 1 / length : 1;
+    frustum.planes[i] = {{plane[0] * scale, plane[1] * scale, plane[2] * scale},
+                         plane[3] * scale};
+  }
+  return frustum;
+}
+
+FrustumCuller::FrustumCuller(utils::SimdLevel level) : level_(level) {
+  if (!utils::Supported(level)) {
+    throw CullingException("the CPU does not support " +
+                           std::string(utils::ToString(level)) + " culling");
+  }
+}
+
+FrustumCuller::Id FrustumCuller::Add(Aabb const &box) {
+  Id id;
+  if (free_ids_.empty()) {
+    id = static_cast<Id>(index_of_id_.size());
+    index_of_id_.push_back(detail::kNone);
+  } else {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  }
+  const size_t index = ids_.size();
+  ids_.push_back(id);
+  index_of_id_[id] = static_cast<uint32_t>(index);
+  Resize(ids_.size());
+  Store(index, box);
+  return id;
+}
+
+void FrustumCuller::Update(Id id, Aabb const &box) {
+  if (id >= index_of_id_.size() || index_of_id_[id] == detail::kNone) {
+    throw CullingException("Unknown box " + std::to_string(id));
+  }
+  Store(index_of_id_[id], box);
+}
+
+void FrustumCuller::Remove(Id id) {
+  if (id >= index_of_id_.size() || index_of_id_[id] == detail::kNone) {
+    throw CullingException("Unknown box " + std::to_string(id));
+  }
+  const uint32_t index = index_of_id_[id];
+  const size_t last = ids_.size() - 1;
+  if (index != last) {
+    for (auto &component : components_) {
+      component[index] = component[last];
+    }
+    ids_[index] = ids_[last];
+    index_of_id_[ids_[index]] = index;
+  }
+  ids_.pop_back();
+  index_of_id_[id] = detail::kNone;
+  free_ids_.push_back(id);
+}
+
+std::span<const FrustumCuller::Id> FrustumCuller::Cull(
+    Frustum const &frustum) {
+  detail::CullInput input{};
+  input.ids = ids_.data();
+  input.count = ids_.size();
+  for (size_t i = 0; i < components_.size(); i++) {
+    input.components[i] = components_[i].data();
+  }
+  for (size_t i = 0; i < frustum.planes.size(); i++) {
+    Plane const &plane = frustum.planes[i];
+    for (size_t axis = 0; axis < 3; axis++) {
+      input.planes[i][axis] = plane.normal[axis];
+      input.planes[i][3 + axis] = std::abs(plane.normal[axis]);
+    }
+    input.planes[i][6] = plane.distance;
+  }
+  if (visible_.size() < ids_.size()) {
+    visible_.resize(ids_.size());
+  }
+  size_t count = 0;
+  switch (level_) {
+#if UTILS_SIMD_X86
+    case utils::SimdLevel::kAvx2:
+      count = detail::CullAvx2(input, visible_.data());
+      break;
+    case utils::SimdLevel::kSse2:
+      count = detail::CullSse2(input, visible_.data());
+      break;
+#endif
+    default:
+      count = detail::CullScalar(input, visible_.data());
+      break;
+  }
+  return {visible_.data(), count};
+}
+
+void FrustumCuller::Store(size_t index, Aabb const &box) noexcept {
+  for (size_t axis = 0; axis < 3; axis++) {
+    components_[axis][index] = (box.min[axis] + box.max[axis]) * 0.5f;
+    components_[3 + axis][index] = (box.max[axis] - box.min[axis]) * 0.5f;
+  }
+}
+
+void FrustumCuller::Resize(size_t count) {
+  const size_t padded = (count + kPadding - 1) / kPadding * kPadding;
+  if (components_[0].size() < padded) {
+    for (auto &component : components_) {
+      component.resize(padded);
+    }
+  }
+}
+}  // namespace world
@@ -0,0 +1,95 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "utils/simd.hpp"
+#include "world/coordinates.hpp"
+
+/*
+ * Frustum culling of axis aligned boxes, usually the sections that have a
+ * mesh, before their draw calls are submitted.
+ *
+ * The boxes are kept as center and half extent in one array per component,
+ * padded to a multiple of eight. Cull() tests four (SSE2) or eight (AVX2)
+ * boxes at once against each of the six planes: a box is outside a plane if
+ * even its corner farthest along the normal is behind it, which is
+ *
+ *   dot(normal, center) + dot(|normal|, extent) + distance < 0
+ *
+ * without any per-box branch or select. The ids of the boxes left are
+ * written to a compact list in the order of the arrays. Like any plane test
+ * it is conservative: a large box near a corner of the frustum can pass
+ * while being outside.
+ *
+ * Coordinates are floats, so boxes and frustum should be relative to a
+ * nearby origin, e.g. the camera, far from the world origin.
+ */
+namespace world {
+class CullingException : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+struct Aabb {
+  std::array<float, 3> min{};
+  std::array<float, 3> max{};
+
+  // The blocks of a section, offset by -origin.
+  [[nodiscard]] static Aabb Section(SectionPos pos,
+                                    std::array<float, 3> origin = {}) noexcept;
+};
+
+// The inside is where dot(normal, point) + distance >= 0.
+struct Plane {
+  std::array<float, 3> normal{};
+  float distance = 0;
+};
+
+struct Frustum {
+  // left, right, bottom, top, near, far
+  std::array<Plane, 6> planes;
+
+  // From a view projection matrix in column-major order, as glm lays out a
+  // mat4, with OpenGL clip space (-w <= z <= w). The planes are normalized.
+  [[nodiscard]] static Frustum FromMatrix(
+      std::array<float, 16> const &matrix) noexcept;
+};
+
+class FrustumCuller final {
+ public:
+  using Id = uint32_t;
+
+  // Throws CullingException if the CPU does not support the level.
+  explicit FrustumCuller(utils::SimdLevel level = utils::DetectSimdLevel());
+
+  Id Add(Aabb const &box);
+  void Update(Id id, Aabb const &box);
+  void Remove(Id id);
+
+  // The ids of the boxes that intersect the frustum, valid until the next
+  // call.
+  std::span<const Id> Cull(Frustum const &frustum);
+
+  [[nodiscard]] size_t size() const noexcept { return ids_.size(); }
+  [[nodiscard]] utils::SimdLevel level() const noexcept { return level_; }
+
+ private:
+  // the widest vector, the arrays are padded to it
+  static constexpr size_t kPadding = 8;
+
+  void Store(size_t index, Aabb const &box) noexcept;
+  void Resize(size_t count);
+
+  utils::SimdLevel level_;
+  // center and half extent along x, y and z, by index
+  std::array<std::vector<float>, 6> components_;
+  std::vector<Id> ids_;
+  std::vector<uint32_t> index_of_id_;
+  std::vector<Id> free_ids_;
+  std::vector<Id> visible_;
+};
+}  // namespace world
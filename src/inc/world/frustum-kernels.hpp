@@ -0,0 +1,96 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/simd.hpp"
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+/*
+ * The culling kernel shared by the scalar, SSE2 and AVX2 builds in
+ * frustum-culler.cpp and frustum-culler-avx2.cpp. Only include it from those
+ * files: the AVX2 file is compiled with AVX2 enabled, so the kernel lives in
+ * an anonymous namespace and every file gets its own copy. For the same
+ * reason it uses no std templates or other inline functions with external
+ * linkage, the linker would keep one copy of them for all files, possibly
+ * the one built for AVX2.
+ *
+ * A backend V provides:
+ *   kWidth              lanes per vector
+ *   Float, Mask         a vector of floats and the result of a comparison
+ *   Set, Load           broadcast and unaligned load
+ *   Add, Mul            float arithmetic
+ *   Less, Or            comparison and the union of two masks
+ *   Bits                the mask as one bit per lane
+ */
+namespace world::detail {
+struct CullInput {
+  // center x, y, z and half extent x, y, z, padded to a multiple of 8
+  float const *components[6];
+  uint32_t const *ids;
+  size_t count;
+  // normal x, y, z, |normal| x, y, z and distance per plane
+  float planes[6][7];
+};
+
+// Write the ids of the visible boxes to out, which has room for count of
+// them, and return how many.
+size_t CullScalar(CullInput const &input, uint32_t *out) noexcept;
+#if UTILS_SIMD_X86
+size_t CullSse2(CullInput const &input, uint32_t *out) noexcept;
+size_t CullAvx2(CullInput const &input, uint32_t *out) noexcept;
+#endif
+
+namespace {
+// The index of the lowest set bit, bits isn't 0.
+inline uint32_t LowestBit(uint32_t bits) noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward(&index, bits);
+  return static_cast<uint32_t>(index);
+#else
+  return static_cast<uint32_t>(__builtin_ctz(bits));
+#endif
+}
+
+template <typename V>
+size_t Cull(CullInput const &input, uint32_t *out) noexcept {
+  using Float = typename V::Float;
+  Float planes[6][7];
+  for (size_t plane = 0; plane < 6; plane++) {
+    for (size_t i = 0; i < 7; i++) {
+      planes[plane][i] = V::Set(input.planes[plane][i]);
+    }
+  }
+  size_t visible = 0;
+  for (size_t base = 0; base < input.count; base += V::kWidth) {
+    Float box[6];
+    for (size_t i = 0; i < 6; i++) {
+      box[i] = V::Load(input.components[i] + base);
+    }
+    typename V::Mask outside = V::Less(V::Set(0), V::Set(0));
+    for (auto const &plane : planes) {
+      // the distance of the corner farthest along the normal
+      Float distance = V::Add(V::Mul(plane[0], box[0]), plane[6]);
+      distance = V::Add(distance, V::Mul(plane[1], box[1]));
+      distance = V::Add(distance, V::Mul(plane[2], box[2]));
+      distance = V::Add(distance, V::Mul(plane[3], box[3]));
+      distance = V::Add(distance, V::Mul(plane[4], box[4]));
+      distance = V::Add(distance, V::Mul(plane[5], box[5]));
+      outside = V::Or(outside, V::Less(distance, V::Set(0)));
+    }
+    uint32_t bits = ~V::Bits(outside) & ((1u << V::kWidth) - 1);
+    if (input.count - base < V::kWidth) {
+      // the padding
+      bits &= (1u << (input.count - base)) - 1;
+    }
+    for (; bits != 0; bits &= bits - 1) {
+      out[visible++] = input.ids[base + LowestBit(bits)];
+    }
+  }
+  return visible;
+}
+}  // namespace
+}  // namespace world::detail
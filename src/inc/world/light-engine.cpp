@@ -0,0 +1,573 @@
+#include "light-engine.hpp"
+
+#include <algorithm>
+#include <span>
+
+namespace world {
+namespace {
+constexpr uint8_t kMax = NibbleArray::kMax;
+constexpr int32_t kTop = Chunk::kHeight - 1;
+// the columns of the center chunk and the ring around it
+constexpr int32_t kRing = kChunkSize + 2;
+constexpr size_t kCenter = 4;
+constexpr size_t kRounds = 27 + 9;
+
+constexpr std::array<std::array<int32_t, 3>, kDirectionCount> kOffsets = {
+    {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}}};
+constexpr size_t kDown = static_cast<size_t>(Direction::kBottom);
+
+int32_t Mod3(int32_t value) noexcept { return (value % 3 + 3) % 3; }
+
+// Queue entries: x and z relative to the center chunk plus 16 in 6 bits
+// each, y in 8 bits and the level above.
+struct Cell {
+  int32_t x;
+  int32_t y;
+  int32_t z;
+};
+
+uint32_t Encode(int32_t x, int32_t y, int32_t z, uint8_t level) noexcept {
+  return static_cast<uint32_t>(x + kChunkSize) |
+         static_cast<uint32_t>(z + kChunkSize) << 6 |
+         static_cast<uint32_t>(y) << 12 | static_cast<uint32_t>(level) << 20;
+}
+
+Cell Decode(uint32_t entry) noexcept {
+  return {static_cast<int32_t>(entry & 63) - kChunkSize,
+          static_cast<int32_t>(entry >> 12 & 0xFF),
+          static_cast<int32_t>(entry >> 6 & 63) - kChunkSize};
+}
+
+// One light channel of the 3x3 chunks of a group, coordinates relative to
+// the center chunk.
+template <bool kSky>
+class View {
+ public:
+  View(std::array<Chunk const *, 9> const &chunks,
+       std::array<ChunkLight *, 9> const &light,
+       std::span<const uint8_t> opaque, std::span<const uint8_t> emission,
+       std::bitset<9 * Chunk::kSectionCount> &changed)
+      : chunks_(chunks),
+        light_(light),
+        opaque_(opaque),
+        emission_(emission),
+        changed_(changed) {}
+
+  // Inside the 3x3 chunks and loaded.
+  [[nodiscard]] bool Contains(int32_t x, int32_t y, int32_t z) const noexcept {
+    return x >= -kChunkSize && x < 2 * kChunkSize && z >= -kChunkSize &&
+           z < 2 * kChunkSize && y >= 0 && y < Chunk::kHeight &&
+           chunks_[Column(x, z)] != nullptr;
+  }
+  [[nodiscard]] BlockId Block(int32_t x, int32_t y, int32_t z) const noexcept {
+    return chunks_[Column(x, z)]->Get(static_cast<uint32_t>(x & 15),
+                                      static_cast<uint32_t>(y),
+                                      static_cast<uint32_t>(z & 15));
+  }
+  [[nodiscard]] bool Opaque(int32_t x, int32_t y, int32_t z) const noexcept {
+    return Opaque(Block(x, y, z));
+  }
+  // Blocks registered after the engine was constructed aren't in the tables,
+  // they are opaque and don't emit light.
+  [[nodiscard]] uint8_t Emission(BlockId block) const noexcept {
+    return block < emission_.size() ? emission_[block] : 0;
+  }
+  [[nodiscard]] bool Opaque(BlockId block) const noexcept {
+    return block >= opaque_.size() || opaque_[block];
+  }
+  [[nodiscard]] uint8_t Get(int32_t x, int32_t y, int32_t z) const noexcept {
+    return Nibbles(x, y, z).Get(static_cast<uint32_t>(x & 15),
+                                static_cast<uint32_t>(y & 15),
+                                static_cast<uint32_t>(z & 15));
+  }
+  void Set(int32_t x, int32_t y, int32_t z, uint8_t level) noexcept {
+    changed_.set(Column(x, z) * Chunk::kSectionCount +
+                 static_cast<size_t>(y >> 4));
+    Nibbles(x, y, z).Set(static_cast<uint32_t>(x & 15),
+                         static_cast<uint32_t>(y & 15),
+                         static_cast<uint32_t>(z & 15), level);
+  }
+  [[nodiscard]] Chunk const &center() const noexcept {
+    return *chunks_[kCenter];
+  }
+  [[nodiscard]] std::array<NibbleArray, Chunk::kSectionCount> &
+  center_light() const noexcept {
+    return kSky ? light_[kCenter]->sky : light_[kCenter]->block;
+  }
+
+  // The lowest y from which the column sees the sky.
+  [[nodiscard]] int32_t SkyTop(int32_t x, int32_t z) const noexcept {
+    Chunk const &chunk = *chunks_[Column(x, z)];
+    for (int32_t section = Chunk::kSectionCount - 1; section >= 0;
+         section--) {
+      ChunkSection const &blocks = chunk.section(section);
+      if (blocks.empty()) {
+        continue;
+      }
+      for (int32_t y = ChunkSection::kSize - 1; y >= 0; y--) {
+        if (Opaque(blocks.Get(static_cast<uint32_t>(x & 15),
+                              static_cast<uint32_t>(y),
+                              static_cast<uint32_t>(z & 15)))) {
+          return section * ChunkSection::kSize + y + 1;
+        }
+      }
+    }
+    return 0;
+  }
+
+ private:
+  [[nodiscard]] static size_t Column(int32_t x, int32_t z) noexcept {
+    return static_cast<size_t>((z + kChunkSize) >> 4) * 3 +
+           static_cast<size_t>((x + kChunkSize) >> 4);
+  }
+  [[nodiscard]] NibbleArray &Nibbles(int32_t x, int32_t y,
+                                     int32_t z) const noexcept {
+    ChunkLight &light = *light_[Column(x, z)];
+    return (kSky ? light.sky : light.block)[static_cast<size_t>(y >> 4)];
+  }
+
+  std::array<Chunk const *, 9> const &chunks_;
+  std::array<ChunkLight *, 9> const &light_;
+  std::span<const uint8_t> opaque_;
+  std::span<const uint8_t> emission_;
+  std::bitset<9 * Chunk::kSectionCount> &changed_;
+};
+
+// Seeds for the neighbours of a cell that stopped blocking the light.
+template <bool kSky>
+void PullNeighbors(View<kSky> &view, int32_t x, int32_t y, int32_t z,
+                   std::vector<uint32_t> &add) {
+  for (auto [dx, dy, dz] : kOffsets) {
+    if (view.Contains(x + dx, y + dy, z + dz)) {
+      const uint8_t level = view.Get(x + dx, y + dy, z + dz);
+      if (level > 0) {
+        add.push_back(Encode(x + dx, y + dy, z + dz, level));
+      }
+    }
+  }
+}
+
+// Seeds for the light of the chunks around flowing into the center.
+template <bool kSky>
+void PullRing(View<kSky> &view, int32_t layers, std::vector<uint32_t> &add) {
+  for (int32_t z = -1; z <= kChunkSize; z++) {
+    for (int32_t x = -1; x <= kChunkSize; x++) {
+      const bool inside_x = x >= 0 && x < kChunkSize;
+      const bool inside_z = z >= 0 && z < kChunkSize;
+      // the ring without its corners, which don't touch the center
+      if (inside_x == inside_z || !view.Contains(x, 0, z)) {
+        continue;
+      }
+      for (int32_t y = 0; y < layers; y++) {
+        const uint8_t level = view.Get(x, y, z);
+        if (level > 1) {
+          add.push_back(Encode(x, y, z, level));
+        }
+      }
+    }
+  }
+}
+
+// Sky light of the center chunk from scratch: full above the top of every
+// column, dark below, then spread from the cells next to a shaded column.
+void RelightSky(View<true> &view, std::vector<uint32_t> &add) {
+  std::array<int32_t, kRing * kRing> tops;
+  auto top = [&](int32_t x, int32_t z) -> int32_t & {
+    return tops[static_cast<size_t>((z + 1) * kRing + x + 1)];
+  };
+  int32_t highest = 0;
+  for (int32_t z = -1; z <= kChunkSize; z++) {
+    for (int32_t x = -1; x <= kChunkSize; x++) {
+      // unloaded chunks shade nothing
+      top(x, z) = view.Contains(x, 0, z) ? view.SkyTop(x, z) : 0;
+      highest = std::max(highest, top(x, z));
+    }
+  }
+
+  auto &light = view.center_light();
+  for (int32_t section = 0; section < Chunk::kSectionCount; section++) {
+    NibbleArray &sky = light[static_cast<size_t>(section)];
+    const int32_t bottom = section * ChunkSection::kSize;
+    if (bottom >= highest) {
+      sky.Fill(kMax);
+      continue;
+    }
+    for (uint32_t y = 0; y < ChunkSection::kSize; y++) {
+      for (int32_t z = 0; z < kChunkSize; z++) {
+        for (int32_t x = 0; x < kChunkSize; x++) {
+          const bool open = bottom + static_cast<int32_t>(y) >= top(x, z);
+          sky.Set(static_cast<uint32_t>(x), y, static_cast<uint32_t>(z),
+                  open ? kMax : 0);
+        }
+      }
+    }
+  }
+
+  for (int32_t z = 0; z < kChunkSize; z++) {
+    for (int32_t x = 0; x < kChunkSize; x++) {
+      const int32_t reach = std::max({top(x - 1, z), top(x + 1, z),
+                                      top(x, z - 1), top(x, z + 1)});
+      for (int32_t y = top(x, z); y < reach; y++) {
+        add.push_back(Encode(x, y, z, kMax));
+      }
+    }
+  }
+  // everything above the highest top is full on both sides
+  PullRing(view, std::min(highest + 1, Chunk::kHeight), add);
+}
+
+void RelightBlocks(View<false> &view, std::vector<uint32_t> &add) {
+  auto &light = view.center_light();
+  for (int32_t section = 0; section < Chunk::kSectionCount; section++) {
+    NibbleArray &nibbles = light[static_cast<size_t>(section)];
+    nibbles.Fill(0);
+    ChunkSection const &blocks = view.center().section(section);
+    // direct sections have no palette to look at
+    bool emits = blocks.bits_per_entry() == ChunkSection::kDirectBits;
+    for (BlockId block : blocks.palette()) {
+      emits |= view.Emission(block) > 0;
+    }
+    if (!emits) {
+      continue;
+    }
+    for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+      const uint8_t emission = view.Emission(blocks.Get(i));
+      if (emission > 0) {
+        nibbles.Set(i, emission);
+        add.push_back(Encode(static_cast<int32_t>(i & 15),
+                             section * ChunkSection::kSize +
+                                 static_cast<int32_t>(i >> 8),
+                             static_cast<int32_t>(i >> 4 & 15), emission));
+      }
+    }
+  }
+  PullRing(view, Chunk::kHeight, add);
+}
+
+// Runs the remove queue, then the add queue.
+template <bool kSky>
+void Propagate(View<kSky> &view, std::vector<uint32_t> &remove,
+               std::vector<uint32_t> &add, uint64_t &removed,
+               uint64_t &added) {
+  for (size_t head = 0; head < remove.size(); head++) {
+    const Cell cell = Decode(remove[head]);
+    const auto level = static_cast<uint8_t>(remove[head] >> 20);
+    for (size_t direction = 0; direction < kDirectionCount; direction++) {
+      const int32_t x = cell.x + kOffsets[direction][0];
+      const int32_t y = cell.y + kOffsets[direction][1];
+      const int32_t z = cell.z + kOffsets[direction][2];
+      if (!view.Contains(x, y, z)) {
+        continue;
+      }
+      const uint8_t neighbor = view.Get(x, y, z);
+      if (neighbor == 0) {
+        continue;
+      }
+      // full sky light under full sky light came from above
+      if (neighbor < level || (kSky && direction == kDown && level == kMax &&
+                               neighbor == kMax)) {
+        view.Set(x, y, z, 0);
+        remove.push_back(Encode(x, y, z, neighbor));
+        if constexpr (!kSky) {
+          const uint8_t emission = view.Emission(view.Block(x, y, z));
+          if (emission > 0) {
+            view.Set(x, y, z, emission);
+            add.push_back(Encode(x, y, z, emission));
+          }
+        }
+      } else {
+        // lit from somewhere else, it refills the darkened cells
+        add.push_back(Encode(x, y, z, neighbor));
+      }
+    }
+  }
+  removed += remove.size();
+
+  for (size_t head = 0; head < add.size(); head++) {
+    const Cell cell = Decode(add[head]);
+    // the level may have been raised since the cell was queued
+    const uint8_t level = view.Get(cell.x, cell.y, cell.z);
+    if (level <= 1) {
+      continue;
+    }
+    for (size_t direction = 0; direction < kDirectionCount; direction++) {
+      const int32_t x = cell.x + kOffsets[direction][0];
+      const int32_t y = cell.y + kOffsets[direction][1];
+      const int32_t z = cell.z + kOffsets[direction][2];
+      if (!view.Contains(x, y, z) || view.Opaque(x, y, z)) {
+        continue;
+      }
+      const uint8_t target =
+          kSky && direction == kDown && level == kMax ? kMax : level - 1;
+      if (view.Get(x, y, z) < target) {
+        view.Set(x, y, z, target);
+        add.push_back(Encode(x, y, z, target));
+      }
+    }
+  }
+  added += add.size();
+}
+}  // namespace
+
+LightEngine::LightEngine(BlockRegistry const &registry, jobs::JobSystem &jobs,
+                         SectionCallback on_changed)
+    : jobs_(jobs),
+      on_changed_(std::move(on_changed)),
+      emission_(registry.light_table().begin(),
+                registry.light_table().end()) {
+  auto transparent = registry.transparent_table();
+  opaque_.resize(transparent.size());
+  for (size_t id = 0; id < transparent.size(); id++) {
+    opaque_[id] = !transparent[id];
+  }
+}
+
+void LightEngine::AddChunk(Chunk const &chunk) {
+  columns_[chunk.pos()].chunk = &chunk;
+  Relight(chunk.pos());
+}
+
+void LightEngine::RemoveChunk(ChunkPos pos) { columns_.erase(pos); }
+
+void LightEngine::Relight(ChunkPos pos) {
+  auto it = columns_.find(pos);
+  if (it != columns_.end() && !it->second.relight) {
+    it->second.relight = true;
+    relights_.push_back(pos);
+  }
+}
+
+void LightEngine::OnBlockChanged(int32_t x, int32_t y, int32_t z,
+                                 BlockId old) {
+  if (y >= 0 && y < Chunk::kHeight && Find(ToChunkPos(x, z))) {
+    changes_.push_back({x, y, z, old});
+  }
+}
+
+LightStats LightEngine::Update(jobs::Priority priority) {
+  const auto begin = std::chrono::steady_clock::now();
+  LightStats stats;
+  stats.changes = changes_.size();
+
+  std::vector<Group> groups;
+  std::unordered_map<SectionPos, size_t> sections;
+  std::unordered_map<ChunkPos, size_t> chunks;
+  auto group = [&](ChunkPos center, bool sky, size_t round,
+                   auto &index, auto key) -> Group & {
+    auto [it, inserted] = index.try_emplace(key, groups.size());
+    if (inserted) {
+      Group &created = groups.emplace_back();
+      created.center = center;
+      created.sky = sky;
+      created.round = round;
+      for (int32_t dz = -1; dz <= 1; dz++) {
+        for (int32_t dx = -1; dx <= 1; dx++) {
+          auto column = columns_.find({center.x + dx, center.z + dz});
+          created.columns[static_cast<size_t>((dz + 1) * 3 + dx + 1)] =
+              column == columns_.end() ? nullptr : &column->second;
+        }
+      }
+    }
+    return groups[it->second];
+  };
+  auto chunk_group = [&](ChunkPos pos) -> Group & {
+    return group(pos, true, 27 + static_cast<size_t>(Mod3(pos.x) * 3 +
+                                                     Mod3(pos.z)),
+                 chunks, pos);
+  };
+
+  for (ChunkPos pos : relights_) {
+    auto it = columns_.find(pos);
+    // unloaded, or queued twice
+    if (it == columns_.end() || !it->second.relight) {
+      continue;
+    }
+    it->second.relight = false;
+    chunk_group(pos).relight = true;
+    stats.relit_chunks++;
+  }
+  for (Change const &change : changes_) {
+    const ChunkPos pos = ToChunkPos(change.x, change.z);
+    if (!columns_.contains(pos)) {
+      continue;
+    }
+    Group &sky = chunk_group(pos);
+    // relit from scratch anyway
+    if (sky.relight) {
+      continue;
+    }
+    sky.changes.push_back(change);
+    const SectionPos section = {pos.x, change.y >> 4, pos.z};
+    const auto round = static_cast<size_t>(
+        (Mod3(section.x) * 3 + Mod3(section.y)) * 3 + Mod3(section.z));
+    group(pos, false, round, sections, section).changes.push_back(change);
+  }
+  changes_.clear();
+  relights_.clear();
+
+  std::array<std::vector<Group *>, kRounds> rounds;
+  for (Group &entry : groups) {
+    rounds[entry.round].push_back(&entry);
+  }
+  for (auto const &round : rounds) {
+    if (round.empty()) {
+      continue;
+    }
+    stats.rounds++;
+    if (round.size() == 1) {
+      Run(*round[0]);
+      continue;
+    }
+    jobs_.Wait(jobs_.ParallelFor(
+        round.size(), 1,
+        [this, &round](size_t first, size_t last) {
+          for (size_t i = first; i < last; i++) {
+            Run(*round[i]);
+          }
+        },
+        priority));
+  }
+
+  std::vector<SectionPos> changed;
+  for (Group const &entry : groups) {
+    stats.removed += entry.removed;
+    stats.added += entry.added;
+    for (size_t bit = 0; bit < kGroupSections; bit++) {
+      if (entry.changed[bit]) {
+        const auto column = static_cast<int32_t>(bit / Chunk::kSectionCount);
+        changed.push_back({entry.center.x + column % 3 - 1,
+                           static_cast<int32_t>(bit % Chunk::kSectionCount),
+                           entry.center.z + column / 3 - 1});
+      }
+    }
+  }
+  std::sort(changed.begin(), changed.end());
+  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+  if (on_changed_) {
+    for (SectionPos pos : changed) {
+      on_changed_(pos);
+    }
+  }
+  stats.groups = groups.size();
+  stats.sections_changed = changed.size();
+  stats.time = std::chrono::steady_clock::now() - begin;
+  return stats;
+}
+
+uint8_t LightEngine::sky_light(int32_t x, int32_t y, int32_t z) const {
+  if (y >= Chunk::kHeight) {
+    return kMax;
+  }
+  Column const *column = Find(ToChunkPos(x, z));
+  if (y < 0 || !column) {
+    return 0;
+  }
+  return column->light.sky[static_cast<size_t>(y >> 4)].Get(
+      static_cast<uint32_t>(x & 15), static_cast<uint32_t>(y & 15),
+      static_cast<uint32_t>(z & 15));
+}
+
+uint8_t LightEngine::block_light(int32_t x, int32_t y, int32_t z) const {
+  Column const *column = Find(ToChunkPos(x, z));
+  if (y < 0 || y >= Chunk::kHeight || !column) {
+    return 0;
+  }
+  return column->light.block[static_cast<size_t>(y >> 4)].Get(
+      static_cast<uint32_t>(x & 15), static_cast<uint32_t>(y & 15),
+      static_cast<uint32_t>(z & 15));
+}
+
+ChunkLight const *LightEngine::light(ChunkPos pos) const {
+  Column const *column = Find(pos);
+  return column ? &column->light : nullptr;
+}
+
+SectionLight LightEngine::section_light(SectionPos pos) const {
+  Column const *column = Find({pos.x, pos.z});
+  if (pos.y < 0 || pos.y >= Chunk::kSectionCount || !column) {
+    return {};
+  }
+  const auto index = static_cast<size_t>(pos.y);
+  return {&column->light.sky[index], &column->light.block[index]};
+}
+
+LightEngine::Column const *LightEngine::Find(ChunkPos pos) const {
+  auto it = columns_.find(pos);
+  return it == columns_.end() ? nullptr : &it->second;
+}
+
+void LightEngine::Run(Group &group) const {
+  std::array<Chunk const *, 9> chunks;
+  std::array<ChunkLight *, 9> light;
+  for (size_t i = 0; i < group.columns.size(); i++) {
+    chunks[i] = group.columns[i] ? group.columns[i]->chunk : nullptr;
+    light[i] = group.columns[i] ? &group.columns[i]->light : nullptr;
+  }
+  // reused by every group the thread runs
+  thread_local std::vector<uint32_t> remove;
+  thread_local std::vector<uint32_t> add;
+  remove.clear();
+  add.clear();
+  const int32_t origin_x = group.center.x * kChunkSize;
+  const int32_t origin_z = group.center.z * kChunkSize;
+
+  if (group.sky) {
+    View<true> view(chunks, light, opaque_, emission_, group.changed);
+    if (group.relight) {
+      for (int32_t section = 0; section < Chunk::kSectionCount; section++) {
+        group.changed.set(kCenter * Chunk::kSectionCount +
+                          static_cast<size_t>(section));
+      }
+      RelightSky(view, add);
+    }
+    for (Change const &change : group.changes) {
+      const int32_t x = change.x - origin_x, y = change.y;
+      const int32_t z = change.z - origin_z;
+      const uint8_t level = view.Get(x, y, z);
+      const bool opaque = view.Opaque(x, y, z);
+      if (level > 0 && opaque) {
+        view.Set(x, y, z, 0);
+        remove.push_back(Encode(x, y, z, level));
+      } else if (!opaque && view.Opaque(change.old)) {
+        if (y == kTop) {
+          view.Set(x, y, z, kMax);
+          add.push_back(Encode(x, y, z, kMax));
+        } else {
+          PullNeighbors(view, x, y, z, add);
+        }
+      }
+    }
+    Propagate(view, remove, add, group.removed, group.added);
+    if (group.relight) {
+      View<false> blocks(chunks, light, opaque_, emission_, group.changed);
+      remove.clear();
+      add.clear();
+      RelightBlocks(blocks, add);
+      Propagate(blocks, remove, add, group.removed, group.added);
+    }
+    return;
+  }
+
+  View<false> view(chunks, light, opaque_, emission_, group.changed);
+  for (Change const &change : group.changes) {
+    const int32_t x = change.x - origin_x, y = change.y;
+    const int32_t z = change.z - origin_z;
+    const BlockId block = view.Block(x, y, z);
+    const uint8_t level = view.Get(x, y, z);
+    const bool opaque = view.Opaque(block);
+    if (level > 0 &&
+        (opaque || view.Emission(change.old) > view.Emission(block))) {
+      view.Set(x, y, z, 0);
+      remove.push_back(Encode(x, y, z, level));
+    }
+    if (view.Emission(block) > view.Get(x, y, z)) {
+      view.Set(x, y, z, view.Emission(block));
+      add.push_back(Encode(x, y, z, view.Emission(block)));
+    }
+    if (!opaque && view.Opaque(change.old)) {
+      PullNeighbors(view, x, y, z, add);
+    }
+  }
+  Propagate(view, remove, add, group.removed, group.added);
+}
+}  // namespace world
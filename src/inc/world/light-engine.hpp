@@ -0,0 +1,149 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "jobs/job-system.hpp"
+#include "world/block-registry.hpp"
+#include "world/chunk.hpp"
+#include "world/coordinates.hpp"
+#include "world/mesher.hpp"
+#include "world/nibble-array.hpp"
+
+/*
+ * Sky and block light of the loaded chunks, kept up to date while blocks
+ * change.
+ *
+ * Light is a flood fill: a cell gets the level of its brightest neighbour
+ * minus one, sky light keeps level 15 going straight down, opaque blocks
+ * stop it and emitting blocks start at their own level. An edit only
+ * revisits the cells whose light may have come through the block:
+ *
+ *   remove queue  cells that lost their source are darkened, along with
+ *                 every neighbour that got a lower level from them. The
+ *                 brighter neighbours at the edge of that region go to the
+ *                 add queue, they still have a source of their own.
+ *   add queue     spreads light from new sources and those edges into the
+ *                 cells that are darker than what they should get.
+ *
+ * Edits are only queued until Update(), once per tick. Light travels at
+ * most 15 blocks sideways, so the edits of one section never reach past
+ * the sections around it, and sky light edits never past the chunks
+ * around it. Block light is relit per section, in 27 rounds such that two
+ * sections of a round are at least three sections apart on some axis, so
+ * their 3x3x3 neighbourhoods don't overlap and run on the job system in
+ * parallel. Sky light and new chunks are relit per chunk column the same
+ * way, in 9 rounds.
+ *
+ * Unloaded chunks are dark and stop the light. Light that came from a chunk
+ * that was unloaded stays in its neighbours until the blocks there change,
+ * as in vanilla.
+ *
+ * Everything except the flood fills runs on the main thread.
+ */
+namespace world {
+struct ChunkLight {
+  std::array<NibbleArray, Chunk::kSectionCount> sky;
+  std::array<NibbleArray, Chunk::kSectionCount> block;
+};
+
+struct LightStats {
+  size_t changes = 0;
+  size_t relit_chunks = 0;
+  // sections and chunk columns relit independently, and the rounds used
+  size_t groups = 0;
+  size_t rounds = 0;
+  // cells taken from the queues
+  uint64_t removed = 0;
+  uint64_t added = 0;
+  size_t sections_changed = 0;
+  std::chrono::nanoseconds time{0};
+};
+
+class LightEngine final {
+ public:
+  using SectionCallback = std::function<void(SectionPos)>;
+
+  // on_changed is called from Update() for every section whose light was
+  // written, usually Remesher::OnLightChanged().
+  LightEngine(BlockRegistry const &registry, jobs::JobSystem &jobs,
+              SectionCallback on_changed = {});
+  LightEngine(LightEngine const &) = delete;
+  LightEngine &operator=(LightEngine const &) = delete;
+
+  // The chunk has to stay at the same address until RemoveChunk(). Adding
+  // a chunk again replaces it. Its light is computed by the next Update().
+  void AddChunk(Chunk const &chunk);
+  void RemoveChunk(ChunkPos pos);
+  // Computes the light of the chunk from scratch at the next Update().
+  void Relight(ChunkPos pos);
+  // Block coordinates. old is the block that was replaced, as returned by
+  // Chunk::Set(). Edits in unloaded chunks are ignored.
+  void OnBlockChanged(int32_t x, int32_t y, int32_t z, BlockId old);
+
+  // Relights everything queued since the last call and waits for it.
+  LightStats Update(jobs::Priority priority = jobs::Priority::kHigh);
+
+  // Block coordinates. 0 in unloaded chunks, full sky above the world.
+  [[nodiscard]] uint8_t sky_light(int32_t x, int32_t y, int32_t z) const;
+  [[nodiscard]] uint8_t block_light(int32_t x, int32_t y, int32_t z) const;
+  // nullptr if the chunk isn't loaded.
+  [[nodiscard]] ChunkLight const *light(ChunkPos pos) const;
+  // For the mesher, empty outside the loaded chunks.
+  [[nodiscard]] SectionLight section_light(SectionPos pos) const;
+  // edits and chunks waiting for Update()
+  [[nodiscard]] size_t pending() const noexcept {
+    return changes_.size() + relights_.size();
+  }
+
+ private:
+  static constexpr size_t kGroupSections = 9 * Chunk::kSectionCount;
+
+  struct Column {
+    Chunk const *chunk = nullptr;
+    ChunkLight light;
+    bool relight = false;
+  };
+  struct Change {
+    int32_t x;
+    int32_t y;
+    int32_t z;
+    BlockId old;
+  };
+  // Edits whose light stays within the 3x3 chunks around center.
+  struct Group {
+    ChunkPos center;
+    // indexed (dz + 1) * 3 + dx + 1, nullptr for unloaded chunks
+    std::array<Column *, 9> columns{};
+    size_t round = 0;
+    std::vector<Change> changes;
+    // a chunk column: sky light edits and relights of both channels, else
+    // block light edits
+    bool sky = false;
+    bool relight = false;
+    // sections written, column * 16 + section
+    std::bitset<kGroupSections> changed;
+    uint64_t removed = 0;
+    uint64_t added = 0;
+  };
+
+  [[nodiscard]] Column const *Find(ChunkPos pos) const;
+  void Run(Group &group) const;
+
+  jobs::JobSystem &jobs_;
+  SectionCallback on_changed_;
+  // indexed by BlockId, taken from the registry when constructed; later
+  // registrations are treated as opaque without emission
+  std::vector<uint8_t> opaque_;
+  std::vector<uint8_t> emission_;
+
+  std::unordered_map<ChunkPos, Column> columns_;
+  std::vector<Change> changes_;
+  std::vector<ChunkPos> relights_;
+};
+}  // namespace world
@@ -0,0 +1,458 @@
+#include "mesher.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace world {
+namespace {
+constexpr int32_t kSize = ChunkSection::kSize;
+
+struct Axes {
+  // axis of the normal, and the two axes spanning the face: 0 x, 1 y, 2 z
+  int32_t normal, u, v;
+  int32_t sign;
+  // the quad corners are wound counter-clockwise seen from outside
+  bool reverse;
+};
+
+constexpr Axes FaceAxes(Direction face) noexcept {
+  switch (face) {
+    case Direction::kWest:
+      return {0, 2, 1, -1, false};
+    case Direction::kEast:
+      return {0, 2, 1, 1, true};
+    case Direction::kBottom:
+      return {1, 0, 2, -1, false};
+    case Direction::kTop:
+      return {1, 0, 2, 1, true};
+    case Direction::kNorth:
+      return {2, 0, 1, -1, true};
+    case Direction::kSouth:
+      return {2, 0, 1, 1, false};
+  }
+  return {};
+}
+
+// strides of x, y and z in the padded array
+constexpr std::array<int32_t, 3> kStrides{
+    1, PaddedSection::kSize * PaddedSection::kSize, PaddedSection::kSize};
+
+// Calls cell(padded index, neighbour index) for every block of the border
+// layer on face, the neighbour index is the same block in the neighbour.
+template <typename Cell>
+void ForEachBorderCell(Direction face, Cell &&cell) {
+  const Axes axes = FaceAxes(face);
+  std::array<int32_t, 3> padded{}, neighbor{};
+  padded[axes.normal] = axes.sign < 0 ? -1 : kSize;
+  neighbor[axes.normal] = axes.sign < 0 ? kSize - 1 : 0;
+  for (int32_t v = 0; v < kSize; v++) {
+    padded[axes.v] = neighbor[axes.v] = v;
+    for (int32_t u = 0; u < kSize; u++) {
+      padded[axes.u] = neighbor[axes.u] = u;
+      cell(PaddedSection::Index(padded[0], padded[1], padded[2]),
+           ChunkSection::Index(static_cast<uint32_t>(neighbor[0]),
+                               static_cast<uint32_t>(neighbor[1]),
+                               static_cast<uint32_t>(neighbor[2])));
+    }
+  }
+}
+
+// One corner of a face: AO, then the sky and block light nibbles of a packed
+// PaddedSection light value.
+constexpr uint64_t Corner(uint32_t ao, uint32_t light) noexcept {
+  return ao | (light & 0xF) << 2 | (light >> 8 & 0xF) << 6;
+}
+
+// The 3x3 window of blocks in front of a face, index row * 3 + column with
+// rows along v. Every corner of the face, in the order EmitQuad walks them,
+// touches the front block, two side blocks and a diagonal one.
+constexpr int32_t kWindowFront = 4;
+struct WindowCorner {
+  int32_t side_u, side_v, diagonal;
+};
+constexpr std::array<WindowCorner, 4> kWindowCorners{
+    {{3, 1, 0}, {5, 1, 2}, {5, 7, 8}, {3, 7, 6}}};
+
+// AO of the four corners for every pattern of opaque blocks in the window.
+constexpr std::array<uint64_t, 512> OcclusionTable(uint32_t corner_bits) {
+  std::array<uint64_t, 512> table{};
+  for (uint32_t pattern = 0; pattern < table.size(); pattern++) {
+    for (size_t corner = 0; corner < kWindowCorners.size(); corner++) {
+      const auto [side_u, side_v, diagonal] = kWindowCorners[corner];
+      const uint32_t a = pattern >> side_u & 1;
+      const uint32_t b = pattern >> side_v & 1;
+      // two opaque sides hide the diagonal block as well
+      const uint32_t c = (pattern >> diagonal & 1) | (a & b);
+      table[pattern] |= uint64_t(3 - a - b - c) << (corner * corner_bits);
+    }
+  }
+  return table;
+}
+}  // namespace
+
+void PaddedSection::Copy(
+    ChunkSection const &center,
+    std::span<ChunkSection const *const, kDirectionCount> neighbors) {
+  if (center.uniform()) {
+    const BlockId block = center.Get(0);
+    for (int32_t y = 0; y < kSize - 2; y++) {
+      for (int32_t z = 0; z < kSize - 2; z++) {
+        std::fill_n(&blocks_[Index(0, y, z)], kSize - 2, block);
+      }
+    }
+  } else {
+    uint32_t index = 0;
+    for (int32_t y = 0; y < kSize - 2; y++) {
+      for (int32_t z = 0; z < kSize - 2; z++) {
+        BlockId *row = &blocks_[Index(0, y, z)];
+        for (int32_t x = 0; x < kSize - 2; x++) {
+          row[x] = center.Get(index++);
+        }
+      }
+    }
+  }
+
+  // only the faces are read, edges and corners stay air
+  for (size_t face = 0; face < kDirectionCount; face++) {
+    ChunkSection const *neighbor = neighbors[face];
+    ForEachBorderCell(static_cast<Direction>(face),
+                      [&](uint32_t padded, uint32_t index) {
+                        blocks_[padded] = neighbor ? neighbor->Get(index)
+                                                   : kAir;
+                      });
+  }
+}
+
+void PaddedSection::CopyLight(
+    SectionLight center,
+    std::span<const SectionLight, kDirectionCount> neighbors) {
+  auto value = [](SectionLight const &light, uint32_t index) {
+    return static_cast<uint16_t>(
+        (light.sky ? light.sky->Get(index) : kDaylight) |
+        (light.block ? light.block->Get(index) : 0) << 8);
+  };
+  uint32_t index = 0;
+  for (int32_t y = 0; y < kSize - 2; y++) {
+    for (int32_t z = 0; z < kSize - 2; z++) {
+      uint16_t *row = &light_[Index(0, y, z)];
+      for (int32_t x = 0; x < kSize - 2; x++) {
+        row[x] = value(center, index++);
+      }
+    }
+  }
+  for (size_t face = 0; face < kDirectionCount; face++) {
+    SectionLight const &neighbor = neighbors[face];
+    ForEachBorderCell(static_cast<Direction>(face),
+                      [&](uint32_t padded, uint32_t index) {
+                        light_[padded] = value(neighbor, index);
+                      });
+  }
+}
+
+SectionMesher::SectionMesher(BlockRegistry const &registry)
+    : registry_(registry) {}
+
+SectionMesher::FaceKey SectionMesher::TextureKey(
+    BlockId block, BlockId neighbor, Direction face) const noexcept {
+  if (block == kAir || block == neighbor || !transparent(neighbor)) {
+    return kNoFace;
+  }
+  const uint16_t texture = block < registry_.size()
+                               ? registry_.diffuse_texture(block, face)
+                               : BlockRegistry::kNoTexture;
+  return FaceKey(texture) + 1;
+}
+
+void SectionMesher::Mesh(
+    ChunkSection const &center,
+    std::span<ChunkSection const *const, kDirectionCount> neighbors,
+    SectionLight light,
+    std::span<const SectionLight, kDirectionCount> neighbor_light,
+    SectionMesh &mesh) {
+  mesh.clear();
+  transparent_ = registry_.transparent_table();
+  if (center.empty()) {
+    return;
+  }
+  // a solid block of stone surrounded by solid blocks of stone
+  auto buried = [this](ChunkSection const *section) {
+    return section && section->uniform() && !transparent(section->Get(0));
+  };
+  if (buried(&center) && std::all_of(neighbors.begin(), neighbors.end(),
+                                     [&](auto *section) {
+                                       return buried(section);
+                                     })) {
+    mesh.connectivity = {};
+    return;
+  }
+  padded_.Copy(center, neighbors);
+  padded_.CopyLight(light, neighbor_light);
+  Mesh(padded_, mesh);
+}
+
+void SectionMesher::Mesh(PaddedSection const &blocks, SectionMesh &mesh) {
+  mesh.clear();
+  for (size_t face = 0; face < kDirectionCount; face++) {
+    for (int32_t slice = 0; slice < kSize; slice++) {
+      MeshSlice(blocks, static_cast<Direction>(face), slice, mesh.vertices);
+    }
+  }
+  BuildIndices(mesh);
+  mesh.connectivity = Connectivity(blocks);
+}
+
+FaceConnectivity SectionMesher::Connectivity(PaddedSection const &blocks) {
+  transparent_ = registry_.transparent_table();
+  open_.fill(0);
+  uint32_t open_count = 0;
+  for (int32_t y = 0; y < kSize; y++) {
+    for (int32_t z = 0; z < kSize; z++) {
+      for (int32_t x = 0; x < kSize; x++) {
+        if (transparent(blocks.Get(x, y, z))) {
+          const uint32_t index = ChunkSection::Index(
+              static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+              static_cast<uint32_t>(z));
+          open_[index >> 6] |= uint64_t(1) << (index & 63);
+          open_count++;
+        }
+      }
+    }
+  }
+  // a wall between two faces takes at least a full layer of blocks
+  if (ChunkSection::kVolume - open_count < kSize * kSize) {
+    return FaceConnectivity::All();
+  }
+
+  FaceConnectivity connectivity;
+  auto visit = [this](uint32_t index) {
+    uint64_t &word = open_[index >> 6];
+    const uint64_t bit = uint64_t(1) << (index & 63);
+    if (word & bit) {
+      word &= ~bit;
+      stack_.push_back(static_cast<uint16_t>(index));
+    }
+  };
+  for (size_t word = 0; word < open_.size(); word++) {
+    while (open_[word] != 0 && connectivity != FaceConnectivity::All()) {
+      visit(static_cast<uint32_t>(word * 64) +
+            static_cast<uint32_t>(std::countr_zero(open_[word])));
+      // the faces this pocket of transparent blocks touches
+      uint32_t faces = 0;
+      while (!stack_.empty()) {
+        const uint32_t index = stack_.back();
+        stack_.pop_back();
+        const uint32_t x = index & 15, z = index >> 4 & 15, y = index >> 8;
+        faces |= uint32_t(x == 0) << static_cast<uint32_t>(Direction::kWest) |
+                 uint32_t(x == 15) << static_cast<uint32_t>(Direction::kEast) |
+                 uint32_t(y == 0) << static_cast<uint32_t>(Direction::kBottom) |
+                 uint32_t(y == 15) << static_cast<uint32_t>(Direction::kTop) |
+                 uint32_t(z == 0) << static_cast<uint32_t>(Direction::kNorth) |
+                 uint32_t(z == 15) << static_cast<uint32_t>(Direction::kSouth);
+        if (x > 0) visit(index - 1);
+        if (x < 15) visit(index + 1);
+        if (z > 0) visit(index - 16);
+        if (z < 15) visit(index + 16);
+        if (y > 0) visit(index - 256);
+        if (y < 15) visit(index + 256);
+      }
+      for (size_t a = 0; a < kDirectionCount; a++) {
+        for (size_t b = 0; b < kDirectionCount; b++) {
+          if (faces >> a & faces >> b & 1) {
+            connectivity.Connect(static_cast<Direction>(a),
+                                 static_cast<Direction>(b));
+          }
+        }
+      }
+    }
+  }
+  stack_.clear();
+  return connectivity;
+}
+
+void SectionMesher::MeshSlice(PaddedSection const &blocks, Direction face,
+                              int32_t slice,
+                              std::vector<MeshVertex> &vertices) {
+  // taken on every call, the registry may have grown in between
+  transparent_ = registry_.transparent_table();
+  const Axes axes = FaceAxes(face);
+  const BlockId *data = blocks.blocks().data();
+  const int32_t step = kStrides[axes.normal] * axes.sign;
+  const auto origin = static_cast<int32_t>(PaddedSection::Index(0, 0, 0)) +
+                      slice * kStrides[axes.normal];
+  // cells with a visible face, written unconditionally and counted
+  std::array<uint8_t, kSize * kSize> faces;
+  size_t face_count = 0;
+  for (int32_t v = 0; v < kSize; v++) {
+    const int32_t row = origin + v * kStrides[axes.v];
+    for (int32_t u = 0; u < kSize; u++) {
+      const int32_t index = row + u * kStrides[axes.u];
+      const FaceKey key = TextureKey(data[index], data[index + step], face);
+      mask_[v * kSize + u] = key;
+      faces[face_count] = static_cast<uint8_t>(v * kSize + u);
+      face_count += key != kNoFace;
+    }
+  }
+  if (face_count == 0) {
+    return;
+  }
+
+  if (smooth_lighting_) {
+    ShadeCorners(blocks, face, slice + axes.sign, {faces.data(), face_count});
+  } else {
+    // the light of the block in front on all four corners
+    const uint16_t *light = blocks.light().data();
+    for (size_t i = 0; i < face_count; i++) {
+      const int32_t u = faces[i] % kSize, v = faces[i] / kSize;
+      const int32_t front =
+          origin + u * kStrides[axes.u] + v * kStrides[axes.v] + step;
+      mask_[faces[i]] |= Corner(3, light[front]) * kAllCorners << kTextureBits;
+    }
+  }
+
+  // grow every quad along u first, then along v while whole rows match
+  for (int32_t v = 0; v < kSize; v++) {
+    for (int32_t u = 0; u < kSize;) {
+      const FaceKey key = mask_[v * kSize + u];
+      if (key == kNoFace) {
+        u++;
+        continue;
+      }
+      int32_t width = 1;
+      while (u + width < kSize && mask_[v * kSize + u + width] == key) {
+        width++;
+      }
+      int32_t height = 1;
+      for (; v + height < kSize; height++) {
+        const FaceKey *row = &mask_[(v + height) * kSize + u];
+        if (!std::all_of(row, row + width,
+                         [key](FaceKey other) { return other == key; })) {
+          break;
+        }
+      }
+      for (int32_t row = v; row < v + height; row++) {
+        std::fill_n(&mask_[row * kSize + u], width, kNoFace);
+      }
+      EmitQuad(face, slice, u, v, width, height, key, vertices);
+      u += width;
+    }
+  }
+}
+
+void SectionMesher::ShadeCorners(PaddedSection const &blocks, Direction face,
+                                 int32_t layer,
+                                 std::span<const uint8_t> faces) {
+  static constexpr auto kOcclusion = OcclusionTable(kCornerBits);
+  const Axes axes = FaceAxes(face);
+  const BlockId *data = blocks.blocks().data();
+  const uint16_t *light = blocks.light().data();
+  const int32_t stride_u = kStrides[axes.u];
+  const int32_t stride_v = kStrides[axes.v];
+  const auto origin = static_cast<int32_t>(PaddedSection::Index(0, 0, 0)) +
+                      layer * kStrides[axes.normal];
+
+  // the window around the block in front, opaque blocks as a bit pattern
+  uint32_t opaque = 0;
+  std::array<uint32_t, 9> window;
+  auto load = [&](int32_t u, int32_t v, int32_t column) {
+    for (int32_t row = 0; row < 3; row++) {
+      const int32_t index = origin + (u + column - 1) * stride_u +
+                            (v + row - 1) * stride_v;
+      opaque |= uint32_t(!transparent(data[index])) << (row * 3 + column);
+      window[row * 3 + column] = light[index];
+    }
+  };
+
+  // only visible faces are shaded, a slice rarely has more than a few dozen
+  int32_t loaded = -2;
+  for (const uint8_t cell : faces) {
+    const int32_t u = cell % kSize, v = cell / kSize;
+    // runs of faces slide the window along
+    if (loaded == cell - 1 && u != 0) {
+      opaque = opaque >> 1 & 0b011011011;
+      for (int32_t row = 0; row < 3; row++) {
+        window[row * 3] = window[row * 3 + 1];
+        window[row * 3 + 1] = window[row * 3 + 2];
+      }
+      load(u, v, 2);
+    } else {
+      opaque = 0;
+      for (int32_t column = 0; column < 3; column++) {
+        load(u, v, column);
+      }
+    }
+    loaded = cell;
+
+    const uint32_t own = window[kWindowFront];
+    uint32_t contrast = 0;
+    for (const uint32_t value : window) {
+      contrast |= value ^ own;
+    }
+    FaceKey corners = kOcclusion[opaque];
+    if (contrast == 0) {
+      corners |= Corner(0, own) * kAllCorners;
+    } else {
+      for (size_t corner = 0; corner < kWindowCorners.size(); corner++) {
+        const auto [side_u, side_v, diagonal] = kWindowCorners[corner];
+        const uint32_t a = opaque >> side_u & 1;
+        const uint32_t b = opaque >> side_v & 1;
+        const uint32_t c = (opaque >> diagonal & 1) | (a & b);
+        // both light nibbles are summed at once, opaque blocks count as the
+        // block in front
+        const uint32_t sum = own + (a ? own : window[side_u]) +
+                             (b ? own : window[side_v]) +
+                             (c ? own : window[diagonal]);
+        corners |= Corner(0, (sum + 0x0202) >> 2) << (corner * kCornerBits);
+      }
+    }
+    mask_[cell] |= corners << kTextureBits;
+  }
+}
+
+void SectionMesher::BuildIndices(SectionMesh &mesh) {
+  mesh.indices.resize(mesh.quad_count() * 6);
+  auto ao = [](MeshVertex vertex) {
+    return vertex.position >> vertex::kAoShift & vertex::kMaxAo;
+  };
+  for (size_t quad = 0; quad < mesh.quad_count(); quad++) {
+    const MeshVertex *vertices = &mesh.vertices[quad * 4];
+    // split along the darker diagonal, otherwise a single occluded corner
+    // shades the quad along a straight line through the middle
+    const bool flip = ao(vertices[0]) + ao(vertices[2]) >
+                      ao(vertices[1]) + ao(vertices[3]);
+    const auto base = static_cast<uint16_t>(quad * 4);
+    uint16_t *indices = &mesh.indices[quad * 6];
+    for (uint16_t index : {0, 1, 2, 0, 2, 3}) {
+      *indices++ = static_cast<uint16_t>(base + (index + flip) % 4);
+    }
+  }
+}
+
+void SectionMesher::EmitQuad(Direction face, int32_t slice, int32_t u,
+                             int32_t v, int32_t width, int32_t height,
+                             FaceKey key,
+                             std::vector<MeshVertex> &vertices) const {
+  const Axes axes = FaceAxes(face);
+  const auto plane = static_cast<uint8_t>(slice + (axes.sign > 0 ? 1 : 0));
+  const std::array<std::array<int32_t, 2>, 4> corners{
+      {{0, 0}, {width, 0}, {width, height}, {0, height}}};
+
+  VertexAttributes vertex;
+  constexpr FaceKey kTextureMask = (1u << kTextureBits) - 1;
+  vertex.texture = static_cast<uint16_t>((key & kTextureMask) - 1);
+  vertex.face = face;
+  vertex.position[axes.normal] = plane;
+  for (size_t i = 0; i < corners.size(); i++) {
+    const size_t corner = axes.reverse ? (4 - i) % 4 : i;
+    const auto shading = static_cast<uint32_t>(
+        key >> (kTextureBits + corner * kCornerBits));
+    vertex.position[axes.u] = static_cast<uint8_t>(u + corners[corner][0]);
+    vertex.position[axes.v] = static_cast<uint8_t>(v + corners[corner][1]);
+    vertex.uv = {static_cast<uint8_t>(corners[corner][0]),
+                 static_cast<uint8_t>(corners[corner][1])};
+    vertex.ao = static_cast<uint8_t>(shading & 3);
+    vertex.sky_light = static_cast<uint8_t>(shading >> 2 & 15);
+    vertex.block_light = static_cast<uint8_t>(shading >> 6 & 15);
+    vertices.push_back(Encode(vertex));
+  }
+}
+}  // namespace world
@@ -0,0 +1,225 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "world/block-registry.hpp"
+#include "world/chunk-section.hpp"
+#include "world/coordinates.hpp"
+#include "world/nibble-array.hpp"
+#include "world/vertex-format.hpp"
+
+/*
+ * CPU mesher for one 16x16x16 chunk section.
+ *
+ * The section and the border layers of its six neighbours are first copied
+ * into a padded 18x18x18 array, so the meshing loops never have to leave it
+ * or decode the palette again. A face is emitted when the neighbouring block
+ * is air, or transparent and of another type. Coplanar visible faces with the
+ * same texture layer are then merged greedily into rectangles, one quad each.
+ *
+ * With smooth lighting every vertex gets an ambient occlusion level from the
+ * two side blocks and the corner block in front of the face, and the average
+ * light of those and the block in front. Opaque blocks take the light of the
+ * block in front, so walls don't darken the floor twice. Faces only merge when
+ * all four corners agree, and quads are split along the diagonal that hides
+ * the AO gradient best. The edges and corners of the padding stay air, so
+ * diagonal neighbours across a section edge don't occlude.
+ *
+ * Vertices are packed as described in vertex-format.hpp. Positions are
+ * section-local in [0, 16], the texture coordinates are in blocks, so a merged
+ * quad repeats its texture once per block.
+ *
+ * Meshing also records which faces of the section can see each other through
+ * the transparent blocks, for the cave culling in visibility-graph.hpp. It is
+ * a flood fill of the transparent blocks; a section with fewer than 256
+ * opaque blocks can't wall off any face, so it connects everything without
+ * one.
+ */
+namespace world {
+// A symmetric 6x6 bit matrix indexed by Direction: whether a line of sight
+// can enter the section through one face and leave through the other.
+struct FaceConnectivity {
+  static constexpr uint64_t kAll = (uint64_t(1) << 36) - 1;
+  uint64_t bits = 0;
+
+  [[nodiscard]] static constexpr FaceConnectivity All() noexcept {
+    return {kAll};
+  }
+  void Connect(Direction a, Direction b) noexcept {
+    bits |= uint64_t(1) << Bit(a, b) | uint64_t(1) << Bit(b, a);
+  }
+  [[nodiscard]] bool connected(Direction a, Direction b) const noexcept {
+    return bits >> Bit(a, b) & 1;
+  }
+  bool operator==(FaceConnectivity const &) const = default;
+
+ private:
+  [[nodiscard]] static constexpr uint32_t Bit(Direction a,
+                                              Direction b) noexcept {
+    return static_cast<uint32_t>(a) * kDirectionCount +
+           static_cast<uint32_t>(b);
+  }
+};
+
+struct SectionMesh {
+  std::vector<MeshVertex> vertices;
+  // 4 vertices and 6 indices per quad, a section never needs more than 2^16
+  std::vector<uint16_t> indices;
+  // everything connects through an empty section
+  FaceConnectivity connectivity = FaceConnectivity::All();
+
+  void clear() noexcept {
+    vertices.clear();
+    indices.clear();
+    connectivity = FaceConnectivity::All();
+  }
+  [[nodiscard]] bool empty() const noexcept { return vertices.empty(); }
+  [[nodiscard]] size_t quad_count() const noexcept {
+    return vertices.size() / 4;
+  }
+};
+
+// Light of a section, nullptr for what isn't computed: full sky light and
+// no block light.
+struct SectionLight {
+  NibbleArray const *sky = nullptr;
+  NibbleArray const *block = nullptr;
+};
+
+// A section with a one block border taken from the neighbours.
+class PaddedSection final {
+ public:
+  static constexpr int32_t kSize = ChunkSection::kSize + 2;
+  static constexpr uint32_t kVolume = kSize * kSize * kSize;
+  // sky light in the low byte, block light in the high byte, so four values
+  // can be summed at once
+  static constexpr uint16_t kDaylight = NibbleArray::kMax;
+
+  // Coordinates in [-1, 16], same y-major order as ChunkSection.
+  [[nodiscard]] static constexpr uint32_t Index(int32_t x, int32_t y,
+                                                int32_t z) noexcept {
+    return static_cast<uint32_t>(((y + 1) * kSize + (z + 1)) * kSize + x + 1);
+  }
+
+  // Neighbours are indexed by Direction, missing ones count as air.
+  void Copy(ChunkSection const &center,
+            std::span<ChunkSection const *const, kDirectionCount> neighbors);
+
+  [[nodiscard]] BlockId Get(int32_t x, int32_t y, int32_t z) const noexcept {
+    return blocks_[Index(x, y, z)];
+  }
+  void Set(int32_t x, int32_t y, int32_t z, BlockId block) noexcept {
+    blocks_[Index(x, y, z)] = block;
+  }
+  [[nodiscard]] std::span<const BlockId, kVolume> blocks() const noexcept {
+    return blocks_;
+  }
+
+  // Same layout as Copy(), the border edges and corners get full daylight.
+  void CopyLight(SectionLight center,
+                 std::span<const SectionLight, kDirectionCount> neighbors);
+  [[nodiscard]] uint8_t sky_light(int32_t x, int32_t y,
+                                  int32_t z) const noexcept {
+    return static_cast<uint8_t>(light_[Index(x, y, z)] & 0xFF);
+  }
+  [[nodiscard]] uint8_t block_light(int32_t x, int32_t y,
+                                    int32_t z) const noexcept {
+    return static_cast<uint8_t>(light_[Index(x, y, z)] >> 8);
+  }
+  void SetLight(int32_t x, int32_t y, int32_t z, uint8_t sky,
+                uint8_t block) noexcept {
+    light_[Index(x, y, z)] = static_cast<uint16_t>(sky | block << 8);
+  }
+  [[nodiscard]] std::span<const uint16_t, kVolume> light() const noexcept {
+    return light_;
+  }
+
+ private:
+  std::array<BlockId, kVolume> blocks_{};
+  std::array<uint16_t, kVolume> light_ = [] {
+    std::array<uint16_t, kVolume> light;
+    light.fill(kDaylight);
+    return light;
+  }();
+};
+
+// Keeps its scratch buffers, use one mesher per thread.
+class SectionMesher final {
+ public:
+  explicit SectionMesher(BlockRegistry const &registry);
+
+  // Replaces the content of mesh.
+  void Mesh(PaddedSection const &blocks, SectionMesh &mesh);
+  // Skips the copy for sections that can't have visible faces.
+  void Mesh(ChunkSection const &center,
+            std::span<ChunkSection const *const, kDirectionCount> neighbors,
+            SectionLight light,
+            std::span<const SectionLight, kDirectionCount> neighbor_light,
+            SectionMesh &mesh);
+  // In full daylight.
+  void Mesh(ChunkSection const &center,
+            std::span<ChunkSection const *const, kDirectionCount> neighbors,
+            SectionMesh &mesh) {
+    Mesh(center, neighbors, {}, std::array<SectionLight, kDirectionCount>{},
+         mesh);
+  }
+
+  // Appends the quads of one layer of faces, slice is the coordinate of the
+  // blocks along the face normal. Quads only depend on their own slice and
+  // the layer in front of it, so a section can be remeshed one slice at a
+  // time.
+  void MeshSlice(PaddedSection const &blocks, Direction face, int32_t slice,
+                 std::vector<MeshVertex> &vertices);
+  // Fills the indices for the quads in mesh.vertices, flipping the diagonal
+  // of quads whose AO would interpolate along the wrong one.
+  static void BuildIndices(SectionMesh &mesh);
+  // The faces connected through the transparent blocks of the section, the
+  // border is ignored. Mesh() fills mesh.connectivity with it.
+  [[nodiscard]] FaceConnectivity Connectivity(PaddedSection const &blocks);
+
+  // Off: flat shading, no occlusion and the light of the block in front.
+  void set_smooth_lighting(bool smooth) noexcept { smooth_lighting_ = smooth; }
+  [[nodiscard]] bool smooth_lighting() const noexcept {
+    return smooth_lighting_;
+  }
+
+ private:
+  // texture layer + 1 in the low 17 bits, then 10 bits per corner:
+  // 2 bits AO, 4 bits sky light, 4 bits block light
+  using FaceKey = uint64_t;
+  static constexpr FaceKey kNoFace = 0;
+  static constexpr uint32_t kTextureBits = 17;
+  static constexpr uint32_t kCornerBits = 10;
+  // times the bits of one corner, the same value in all four
+  static constexpr FaceKey kAllCorners = 1 | 1ull << kCornerBits |
+                                         1ull << 2 * kCornerBits |
+                                         1ull << 3 * kCornerBits;
+
+  // unknown ids are drawn as opaque blocks without a texture
+  [[nodiscard]] bool transparent(BlockId block) const noexcept {
+    return block < transparent_.size() && transparent_[block];
+  }
+  // mask value of the face without the corners, kNoFace or the texture + 1
+  [[nodiscard]] FaceKey TextureKey(BlockId block, BlockId neighbor,
+                                   Direction face) const noexcept;
+  // Adds the corners to the mask of the given cells (v * 16 + u), layer is
+  // the coordinate of the blocks in front of the slice.
+  void ShadeCorners(PaddedSection const &blocks, Direction face,
+                    int32_t layer, std::span<const uint8_t> faces);
+  void EmitQuad(Direction face, int32_t slice, int32_t u, int32_t v,
+                int32_t width, int32_t height, FaceKey key,
+                std::vector<MeshVertex> &vertices) const;
+
+  BlockRegistry const &registry_;
+  std::span<const uint8_t> transparent_;
+  bool smooth_lighting_ = true;
+  PaddedSection padded_;
+  std::array<FaceKey, ChunkSection::kSize * ChunkSection::kSize> mask_{};
+  // transparent blocks not reached by the flood fill yet, by section index
+  std::array<uint64_t, ChunkSection::kVolume / 64> open_{};
+  std::vector<uint16_t> stack_;
+};
+}  // namespace world
@@ -0,0 +1,47 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "world/chunk-section.hpp"
+
+/*
+ * One 4-bit value per block of a section, two per byte, in the same y-major
+ * order as ChunkSection. Used for sky and block light, 2 KiB per section.
+ */
+namespace world {
+class NibbleArray final {
+ public:
+  static constexpr uint32_t kBytes = ChunkSection::kVolume / 2;
+  static constexpr uint8_t kMax = 15;
+
+  explicit NibbleArray(uint8_t fill = 0) noexcept { Fill(fill); }
+
+  [[nodiscard]] uint8_t Get(uint32_t index) const noexcept {
+    return data_[index >> 1] >> ((index & 1) * 4) & kMax;
+  }
+  [[nodiscard]] uint8_t Get(uint32_t x, uint32_t y,
+                            uint32_t z) const noexcept {
+    return Get(ChunkSection::Index(x, y, z));
+  }
+  void Set(uint32_t index, uint8_t value) noexcept {
+    const uint32_t shift = (index & 1) * 4;
+    uint8_t &byte = data_[index >> 1];
+    byte = static_cast<uint8_t>((byte & ~(kMax << shift)) |
+                                (value & kMax) << shift);
+  }
+  void Set(uint32_t x, uint32_t y, uint32_t z, uint8_t value) noexcept {
+    Set(ChunkSection::Index(x, y, z), value);
+  }
+  void Fill(uint8_t value) noexcept {
+    data_.fill(static_cast<uint8_t>((value & kMax) * 0x11));
+  }
+
+  [[nodiscard]] std::span<const uint8_t, kBytes> data() const noexcept {
+    return data_;
+  }
+
+ private:
+  std::array<uint8_t, kBytes> data_;
+};
+}  // namespace world
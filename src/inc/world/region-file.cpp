@@ -0,0 +1,383 @@
+#include "region-file.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+namespace world {
+namespace {
+constexpr uint32_t kLocationsOffset = 0;
+constexpr uint32_t kTimestampsOffset = RegionFile::kChunkCount * 4;
+// 4 bytes of length and 1 byte of compression type
+constexpr uint64_t kChunkHeaderSize = 5;
+
+constexpr uint32_t ToBigEndian(uint32_t value) noexcept {
+  if constexpr (std::endian::native == std::endian::little) {
+    return ((value & 0xff) << 24) | ((value & 0xff00) << 8) |
+           ((value >> 8) & 0xff00) | (value >> 24);
+  }
+  return value;
+}
+
+// The header is shared between readers and the writer through the mapping,
+// so every entry is accessed atomically.
+uint32_t LoadEntry(std::span<std::byte> header, uint32_t offset) noexcept {
+  auto *ptr = reinterpret_cast<uint32_t *>(header.data() + offset);
+  return ToBigEndian(std::atomic_ref{*ptr}.load(std::memory_order_acquire));
+}
+
+void StoreEntry(std::span<std::byte> header, uint32_t offset,
+                uint32_t value) noexcept {
+  auto *ptr = reinterpret_cast<uint32_t *>(header.data() + offset);
+  std::atomic_ref{*ptr}.store(ToBigEndian(value), std::memory_order_release);
+}
+
+uint8_t CompressionType(nbt::Compression compression) {
+  switch (compression) {
+    case nbt::Compression::kGzip:
+      return 1;
+    case nbt::Compression::kZlib:
+      return 2;
+    case nbt::Compression::kNone:
+      return 3;
+  }
+  throw RegionException("Unknown compression");
+}
+
+nbt::Compression CompressionFromType(uint8_t type) {
+  switch (type) {
+    case 1:
+      return nbt::Compression::kGzip;
+    case 2:
+      return nbt::Compression::kZlib;
+    case 3:
+      return nbt::Compression::kNone;
+  }
+  throw RegionException("Unknown chunk compression type " +
+                        std::to_string(type));
+}
+
+uint32_t Now() noexcept {
+  using namespace std::chrono;
+  return static_cast<uint32_t>(
+      duration_cast<seconds>(system_clock::now().time_since_epoch()).count());
+}
+}  // namespace
+
+RegionFile::RegionFile(std::filesystem::path const &path) : file_(path) {
+  constexpr uint64_t kHeaderSize = kHeaderSectors * kSectorSize;
+  uint64_t size = file_.size();
+  if (size < kHeaderSize || size % kSectorSize != 0) {
+    // new files get an empty header, truncated tails are padded to a sector
+    size = std::max(kHeaderSize,
+                    (size + kSectorSize - 1) / kSectorSize * kSectorSize);
+    file_.Resize(size);
+  }
+  header_ = utils::MappedView(file_, kHeaderSize);
+  sector_count_ = static_cast<uint32_t>(size / kSectorSize);
+  used_sectors_.assign((sector_count_ + 63) / 64, 0);
+  MarkSectors(0, kHeaderSectors, true);
+
+  for (uint32_t index = 0; index < kChunkCount; index++) {
+    const uint32_t entry = location(index);
+    if (entry == 0) {
+      continue;
+    }
+    const uint32_t sector = entry >> 8;
+    const uint32_t count = entry & 0xff;
+    if (count == 0 || sector < kHeaderSectors ||
+        uint64_t(sector) + count > sector_count_) {
+      // the entry points outside of the file, so the chunk is lost anyway
+      set_location(index, 0, 0);
+      continue;
+    }
+    MarkSectors(sector, count, true);
+  }
+}
+
+bool RegionFile::HasChunk(ChunkPos pos) const noexcept {
+  return location(Index(pos)) != 0;
+}
+
+uint32_t RegionFile::timestamp(ChunkPos pos) const noexcept {
+  return LoadEntry(header_.data(), kTimestampsOffset + Index(pos) * 4);
+}
+
+std::optional<nbt::NBT> RegionFile::ReadChunk(ChunkPos pos) const {
+  std::vector<std::byte> buffer;
+  {
+    std::shared_lock lock{mutex_};
+    const uint32_t entry = location(Index(pos));
+    if (entry == 0) {
+      return std::nullopt;
+    }
+    buffer.resize((entry & 0xff) * kSectorSize);
+    file_.ReadAt((entry >> 8) * kSectorSize, buffer);
+  }
+  uint32_t length;
+  std::memcpy(&length, buffer.data(), sizeof(length));
+  length = ToBigEndian(length);
+  // in 64 bits, a corrupted length must not wrap around
+  if (length == 0 || uint64_t(length) + 4 > buffer.size()) {
+    throw RegionException("Corrupted chunk in " + path().string());
+  }
+  const nbt::Compression compression =
+      CompressionFromType(std::to_integer<uint8_t>(buffer[4]));
+  auto payload = std::span<const std::byte>{buffer}.subspan(
+      kChunkHeaderSize, length - 1);
+  if (compression == nbt::Compression::kNone) {
+    return nbt::NBT{payload};
+  }
+  const std::vector<std::byte> raw = nbt::inflate(payload, compression);
+  return nbt::NBT{std::span<const std::byte>{raw}};
+}
+
+void RegionFile::WriteChunk(ChunkPos pos, nbt::NBT const &nbt,
+                            nbt::Compression compression) {
+  const std::vector<std::byte> data = nbt::encode_compressed(nbt, compression);
+  WriteChunkData(pos, data, compression);
+}
+
+void RegionFile::WriteChunkData(ChunkPos pos, std::span<const std::byte> data,
+                                nbt::Compression compression) {
+  const uint64_t length = data.size() + 1;
+  const uint64_t count = (4 + length + kSectorSize - 1) / kSectorSize;
+  if (count > kMaxChunkSectors) {
+    throw RegionException("Chunk is too large to be stored in a region file");
+  }
+  // the whole sector-aligned record is built in memory, so it can be written
+  // with a single call
+  std::vector<std::byte> buffer(count * kSectorSize);
+  const uint32_t be_length = ToBigEndian(static_cast<uint32_t>(length));
+  std::memcpy(buffer.data(), &be_length, sizeof(be_length));
+  buffer[4] = std::byte{CompressionType(compression)};
+  std::memcpy(buffer.data() + kChunkHeaderSize, data.data(), data.size());
+
+  const uint32_t index = Index(pos);
+  std::unique_lock lock{mutex_};
+  const uint32_t sector = Allocate(index, static_cast<uint32_t>(count));
+  file_.WriteAt(sector * kSectorSize, buffer);
+  set_location(index, sector, static_cast<uint32_t>(count));
+  set_timestamp(index, Now());
+}
+
+void RegionFile::RemoveChunk(ChunkPos pos) {
+  const uint32_t index = Index(pos);
+  std::unique_lock lock{mutex_};
+  const uint32_t entry = location(index);
+  if (entry == 0) {
+    return;
+  }
+  MarkSectors(entry >> 8, entry & 0xff, false);
+  set_location(index, 0, 0);
+  set_timestamp(index, 0);
+}
+
+void RegionFile::Flush() {
+  std::unique_lock lock{mutex_};
+  header_.Flush();
+  file_.Flush();
+}
+
+uint32_t RegionFile::used_sectors() const {
+  std::shared_lock lock{mutex_};
+  uint32_t result = 0;
+  for (uint64_t const word : used_sectors_) {
+    result += std::popcount(word);
+  }
+  return result;
+}
+
+uint32_t RegionFile::location(uint32_t index) const noexcept {
+  return LoadEntry(header_.data(), kLocationsOffset + index * 4);
+}
+
+void RegionFile::set_location(uint32_t index, uint32_t sector,
+                              uint32_t count) noexcept {
+  StoreEntry(header_.data(), kLocationsOffset + index * 4,
+             (sector << 8) | count);
+}
+
+void RegionFile::set_timestamp(uint32_t index, uint32_t value) noexcept {
+  StoreEntry(header_.data(), kTimestampsOffset + index * 4, value);
+}
+
+uint32_t RegionFile::Allocate(uint32_t index, uint32_t count) {
+  // release the old sectors first, so a chunk that still fits is rewritten
+  // in place
+  const uint32_t entry = location(index);
+  if (entry != 0) {
+    MarkSectors(entry >> 8, entry & 0xff, false);
+  }
+  // first fit; a free run at the end of the file can be extended
+  uint32_t run_start = kHeaderSectors;
+  for (uint32_t sector = kHeaderSectors; sector < sector_count_; sector++) {
+    if (IsSectorUsed(sector)) {
+      run_start = sector + 1;
+    } else if (sector + 1 - run_start == count) {
+      break;
+    }
+  }
+  MarkSectors(run_start, count, true);
+  return run_start;
+}
+
+void RegionFile::MarkSectors(uint32_t sector, uint32_t count, bool used) {
+  if (sector + count > sector_count_) {
+    sector_count_ = sector + count;
+    used_sectors_.resize((sector_count_ + 63) / 64, 0);
+  }
+  for (uint32_t i = sector; i < sector + count; i++) {
+    if (used) {
+      used_sectors_[i / 64] |= uint64_t(1) << (i % 64);
+    } else {
+      used_sectors_[i / 64] &= ~(uint64_t(1) << (i % 64));
+    }
+  }
+}
+
+RegionStorage::RegionStorage(std::filesystem::path const &directory,
+                             size_t max_open_regions)
+    : directory_(directory), max_open_regions_(max_open_regions) {
+  std::filesystem::create_directories(directory_);
+}
+
+bool RegionStorage::HasChunk(ChunkPos pos) {
+  const RegionPos region = ToRegionPos(pos);
+  if (auto file = FindRegion(region)) {
+    return file->HasChunk(pos);
+  }
+  return Exists(region) && GetRegion(region)->HasChunk(pos);
+}
+
+std::optional<nbt::NBT> RegionStorage::ReadChunk(ChunkPos pos) {
+  const RegionPos region = ToRegionPos(pos);
+  if (auto file = FindRegion(region)) {
+    return file->ReadChunk(pos);
+  }
+  if (!Exists(region)) {
+    return std::nullopt;
+  }
+  return GetRegion(region)->ReadChunk(pos);
+}
+
+void RegionStorage::WriteChunk(ChunkPos pos, nbt::NBT const &nbt) {
+  GetRegion(ToRegionPos(pos))->WriteChunk(pos, nbt);
+}
+
+std::shared_ptr<RegionFile> RegionStorage::GetRegion(RegionPos pos) {
+  if (auto file = FindRegion(pos)) {
+    return file;
+  }
+  std::shared_ptr<RegionFile> file;
+  std::shared_ptr<RegionFile> evicted;
+  {
+    std::unique_lock lock{mutex_};
+    auto [it, inserted] = regions_.try_emplace(pos);
+    if (!it->second.file) {
+      try {
+        it->second.file = std::make_shared<RegionFile>(RegionPath(pos));
+      } catch (...) {
+        regions_.erase(it);
+        throw;
+      }
+      missing_.erase(pos);
+      evicted = Evict(pos);
+    }
+    it->second.last_use.store(++uses_, std::memory_order_relaxed);
+    file = it->second.file;
+  }
+  // the data written to the evicted region still has to reach the disk on
+  // the next Flush(), which doesn't know about it anymore
+  if (evicted) {
+    evicted->Flush();
+  }
+  return file;
+}
+
+size_t RegionStorage::open_regions() {
+  std::shared_lock lock{mutex_};
+  return regions_.size();
+}
+
+size_t RegionStorage::missing_regions() {
+  std::shared_lock lock{mutex_};
+  return missing_.size();
+}
+
+std::shared_ptr<RegionFile> RegionStorage::FindRegion(RegionPos pos) {
+  std::shared_lock lock{mutex_};
+  auto it = regions_.find(pos);
+  if (it == regions_.end()) {
+    return nullptr;
+  }
+  it->second.last_use.store(++uses_, std::memory_order_relaxed);
+  return it->second.file;
+}
+
+bool RegionStorage::Exists(RegionPos pos) {
+  // checked and cached under the exclusive lock, so a region created in the
+  // meantime can't be cached as missing
+  std::unique_lock lock{mutex_};
+  if (regions_.contains(pos)) {
+    return true;
+  }
+  if (missing_.contains(pos)) {
+    return false;
+  }
+  if (std::filesystem::exists(RegionPath(pos))) {
+    return true;
+  }
+  // forgetting a missing region only costs one more lookup on the disk
+  if (missing_.size() >= kMaxMissingRegions) {
+    missing_.clear();
+  }
+  missing_.insert(pos);
+  return false;
+}
+
+std::shared_ptr<RegionFile> RegionStorage::Evict(RegionPos keep) {
+  if (regions_.size() <= max_open_regions_) {
+    return nullptr;
+  }
+  // a region still used by another thread stays open: opening its file a
+  // second time would allocate its sectors twice
+  auto victim = regions_.end();
+  for (auto it = regions_.begin(); it != regions_.end(); ++it) {
+    if (it->first != keep && it->second.file.use_count() == 1 &&
+        (victim == regions_.end() ||
+         it->second.last_use.load(std::memory_order_relaxed) <
+             victim->second.last_use.load(std::memory_order_relaxed))) {
+      victim = it;
+    }
+  }
+  if (victim == regions_.end()) {
+    return nullptr;
+  }
+  auto file = std::move(victim->second.file);
+  regions_.erase(victim);
+  return file;
+}
+
+std::filesystem::path RegionStorage::RegionPath(RegionPos pos) const {
+  return directory_ / ("r." + std::to_string(pos.x) + "." +
+                       std::to_string(pos.z) + ".mca");
+}
+
+void RegionStorage::Flush() {
+  std::vector<std::shared_ptr<RegionFile>> regions;
+  {
+    std::shared_lock lock{mutex_};
+    for (auto const &[pos, region] : regions_) {
+      regions.push_back(region.file);
+    }
+  }
+  for (auto const &region : regions) {
+    region->Flush();
+  }
+}
+}  // namespace world
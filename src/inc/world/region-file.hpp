@@ -0,0 +1,148 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <span>
+#include <vector>
+
+#include "utils/nbt-compression.hpp"
+#include "utils/nbt.hpp"
+#include "utils/random-access-file.hpp"
+#include "world/coordinates.hpp"
+
+/*
+ * Anvil-style region files. Every file stores 32x32 chunks.
+ *
+ * 0x0000 : 0x1000 - 1024 chunk locations, big endian:
+ *                   bits 8..31 - offset of the chunk in 4 KiB sectors
+ *                   bits 0..7  - amount of sectors used by the chunk
+ * 0x1000 : 0x2000 - 1024 big endian timestamps of the last chunk write
+ * 0x2000 : ...    - chunk payloads, each one starts at a sector boundary:
+ *                   0x00 : 0x04 - payload length n (big endian), including
+ *                                 the compression byte
+ *                   0x04 : 0x05 - compression type: 1 gzip, 2 zlib, 3 none
+ *                   0x05 : n+4  - compressed NBT
+ *
+ * The header is memory mapped, so presence checks don't touch the disk and
+ * header updates don't need separate writes. A chunk is read or written with
+ * exactly one contiguous I/O call.
+ */
+namespace world {
+class RegionException : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+class RegionFile final {
+ public:
+  static constexpr uint64_t kSectorSize = 4096;
+  static constexpr uint32_t kChunkCount = kRegionSize * kRegionSize;
+  static constexpr uint32_t kHeaderSectors = 2;
+  // the sector count of a location is stored in a single byte
+  static constexpr uint32_t kMaxChunkSectors = 255;
+
+  // Opens the region file, creating an empty one if it doesn't exist.
+  explicit RegionFile(std::filesystem::path const &path);
+
+  // Both local and absolute chunk coordinates are accepted,
+  // only the lower 5 bits of each coordinate are used.
+  [[nodiscard]] bool HasChunk(ChunkPos pos) const noexcept;
+  [[nodiscard]] uint32_t timestamp(ChunkPos pos) const noexcept;
+
+  // Returns nullopt if the chunk wasn't saved yet.
+  [[nodiscard]] std::optional<nbt::NBT> ReadChunk(ChunkPos pos) const;
+  void WriteChunk(ChunkPos pos, nbt::NBT const &nbt,
+                  nbt::Compression compression = nbt::Compression::kZlib);
+  // Writes an already compressed payload.
+  void WriteChunkData(ChunkPos pos, std::span<const std::byte> data,
+                      nbt::Compression compression);
+  void RemoveChunk(ChunkPos pos);
+
+  // Flushes both the header mapping and the chunk data to the disk.
+  void Flush();
+
+  [[nodiscard]] uint32_t used_sectors() const;
+  [[nodiscard]] std::filesystem::path const &path() const noexcept {
+    return file_.path();
+  }
+
+ private:
+  [[nodiscard]] static constexpr uint32_t Index(ChunkPos pos) noexcept {
+    return uint32_t(pos.x & (kRegionSize - 1)) +
+           uint32_t(pos.z & (kRegionSize - 1)) * kRegionSize;
+  }
+  [[nodiscard]] uint32_t location(uint32_t index) const noexcept;
+  void set_location(uint32_t index, uint32_t sector, uint32_t count) noexcept;
+  void set_timestamp(uint32_t index, uint32_t value) noexcept;
+
+  [[nodiscard]] uint32_t Allocate(uint32_t index, uint32_t count);
+  void MarkSectors(uint32_t sector, uint32_t count, bool used);
+  [[nodiscard]] bool IsSectorUsed(uint32_t sector) const noexcept {
+    return sector < sector_count_ &&
+           ((used_sectors_[sector / 64] >> (sector % 64)) & 1);
+  }
+
+  utils::RandomAccessFile file_;
+  utils::MappedView header_;
+  // one bit per sector of the file, set if the sector is in use
+  std::vector<uint64_t> used_sectors_;
+  uint32_t sector_count_ = 0;
+  // reads only take a shared lock, they are positioned and don't move
+  // anything in the file
+  mutable std::shared_mutex mutex_;
+};
+
+// Owns every region file of a world directory. Region files are opened on
+// demand and each of them has its own lock, so threads working with different
+// regions never wait for each other. At most max_open_regions files stay
+// open, the least recently used one is flushed and closed when another one
+// is opened. Regions known to be missing are remembered, so presence checks
+// of open or missing regions never touch the disk. At most
+// kMaxMissingRegions of them are remembered, then they are forgotten at once.
+class RegionStorage final {
+ public:
+  static constexpr size_t kDefaultMaxOpenRegions = 64;
+  static constexpr size_t kMaxMissingRegions = 4096;
+
+  explicit RegionStorage(std::filesystem::path const &directory,
+                         size_t max_open_regions = kDefaultMaxOpenRegions);
+
+  [[nodiscard]] bool HasChunk(ChunkPos pos);
+  [[nodiscard]] std::optional<nbt::NBT> ReadChunk(ChunkPos pos);
+  void WriteChunk(ChunkPos pos, nbt::NBT const &nbt);
+
+  [[nodiscard]] std::shared_ptr<RegionFile> GetRegion(RegionPos pos);
+  [[nodiscard]] std::filesystem::path RegionPath(RegionPos pos) const;
+
+  void Flush();
+
+  [[nodiscard]] size_t open_regions();
+  [[nodiscard]] size_t missing_regions();
+
+ private:
+  struct OpenRegion {
+    std::shared_ptr<RegionFile> file;
+    // the value of uses_ at the last access
+    std::atomic<uint64_t> last_use = 0;
+  };
+
+  // Returns nullptr if the region isn't open.
+  [[nodiscard]] std::shared_ptr<RegionFile> FindRegion(RegionPos pos);
+  [[nodiscard]] bool Exists(RegionPos pos);
+  // Takes the least recently used region out if there are too many open.
+  [[nodiscard]] std::shared_ptr<RegionFile> Evict(RegionPos keep);
+
+  std::filesystem::path directory_;
+  size_t max_open_regions_;
+  std::map<RegionPos, OpenRegion> regions_;
+  std::set<RegionPos> missing_;
+  std::atomic<uint64_t> uses_ = 0;
+  std::shared_mutex mutex_;
+};
+}  // namespace world
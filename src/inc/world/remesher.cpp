@@ -0,0 +1,249 @@
+#include "remesher.hpp"
+
+#include <mutex>
+#include <thread>
+
+namespace world {
+Remesher::Remesher(BlockRegistry const &registry, jobs::JobSystem &jobs,
+                   SectionLookup lookup, MeshCallback on_mesh,
+                   LightLookup light)
+    : registry_(registry),
+      jobs_(jobs),
+      lookup_(std::move(lookup)),
+      on_mesh_(std::move(on_mesh)),
+      light_(std::move(light)) {
+  for (size_t i = 0; i < jobs_.worker_count(); i++) {
+    meshers_.push_back(std::make_unique<SectionMesher>(registry_));
+  }
+}
+
+Remesher::~Remesher() {
+  closing_ = true;
+  // forgotten sections may still have jobs running
+  while (in_flight_ > 0) {
+    if (jobs_.RunMainThreadJobs() == 0) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void Remesher::OnBlockChanged(SectionPos section, uint32_t x, uint32_t y,
+                              uint32_t z) {
+  auto [it, inserted] = sections_.try_emplace(section);
+  if (inserted) {
+    it->second.dirty.MarkAll();
+  }
+  const std::array<int32_t, 3> position{static_cast<int32_t>(x),
+                                        static_cast<int32_t>(y),
+                                        static_cast<int32_t>(z)};
+  DirtySlices slices;
+  slices.Mark(position[0], position[1], position[2]);
+  MarkDirty(it->second, section, slices);
+
+  // a block on the border is in the padding of the neighbour, where it hides
+  // and shades faces; neighbours without a mesh yet get a full one later
+  constexpr int32_t kLast = ChunkSection::kSize - 1;
+  for (size_t axis = 0; axis < 3; axis++) {
+    if (position[axis] != 0 && position[axis] != kLast) {
+      continue;
+    }
+    const bool negative = position[axis] == 0;
+    const auto face = static_cast<Direction>(axis * 2 + (negative ? 0 : 1));
+    const SectionPos neighbor_pos = Neighbor(section, face);
+    auto neighbor = sections_.find(neighbor_pos);
+    if (neighbor == sections_.end()) {
+      continue;
+    }
+    std::array<int32_t, 3> padded = position;
+    padded[axis] = negative ? ChunkSection::kSize : -1;
+    DirtySlices border;
+    border.Mark(padded[0], padded[1], padded[2]);
+    MarkDirty(neighbor->second, neighbor_pos, border);
+  }
+}
+
+void Remesher::Invalidate(SectionPos section) {
+  DirtySlices all;
+  all.MarkAll();
+  MarkDirty(sections_[section], section, all);
+}
+
+void Remesher::OnLightChanged(SectionPos section) {
+  DirtySlices all;
+  all.MarkAll();
+  MarkDirty(sections_[section], section, all);
+  // the neighbours read the border light for their faces and corners, the
+  // ones without a mesh yet get a full one later anyway
+  for (size_t face = 0; face < kDirectionCount; face++) {
+    const SectionPos neighbor_pos =
+        Neighbor(section, static_cast<Direction>(face));
+    if (auto neighbor = sections_.find(neighbor_pos);
+        neighbor != sections_.end()) {
+      MarkDirty(neighbor->second, neighbor_pos, all);
+    }
+  }
+}
+
+void Remesher::Forget(SectionPos section) { sections_.erase(section); }
+
+void Remesher::MarkDirty(State &state, SectionPos section,
+                         DirtySlices const &slices) {
+  state.version = ++versions_;
+  state.dirty.Merge(slices);
+  if (state.queued) {
+    coalesced_++;
+  } else {
+    state.queued = true;
+    queue_.push_back(section);
+  }
+}
+
+size_t Remesher::Flush(jobs::Priority priority) {
+  size_t started = 0;
+  std::vector<SectionPos> waiting;
+  for (SectionPos pos : queue_) {
+    auto it = sections_.find(pos);
+    if (it == sections_.end()) {
+      continue;
+    }
+    State &state = it->second;
+    if (state.in_flight) {
+      // picked up again once the running job is done
+      waiting.push_back(pos);
+      continue;
+    }
+    state.queued = false;
+    ChunkSection const *center = lookup_(pos);
+    if (!center) {
+      sections_.erase(it);
+      continue;
+    }
+    if (center->empty()) {
+      state.dirty = {};
+      Install(pos, state, nullptr);
+      continue;
+    }
+
+    auto task = std::make_shared<Task>();
+    task->pos = pos;
+    task->version = state.version;
+    task->dirty = state.dirty;
+    state.dirty = {};
+    std::array<ChunkSection const *, kDirectionCount> neighbors;
+    for (size_t face = 0; face < kDirectionCount; face++) {
+      neighbors[face] = lookup_(Neighbor(pos, static_cast<Direction>(face)));
+    }
+    // the copy is taken now, the job never reads the live sections
+    task->blocks.Copy(*center, neighbors);
+    if (light_) {
+      std::array<SectionLight, kDirectionCount> neighbor_light;
+      for (size_t face = 0; face < kDirectionCount; face++) {
+        neighbor_light[face] =
+            light_(Neighbor(pos, static_cast<Direction>(face)));
+      }
+      task->blocks.CopyLight(light_(pos), neighbor_light);
+    }
+
+    state.in_flight = true;
+    state.task = task.get();
+    in_flight_++;
+    const jobs::JobHandle mesh =
+        jobs_.Schedule([this, task] { Run(*task); }, priority);
+    jobs_.ScheduleOnMainThread([this, task] { Complete(*task); }, {&mesh, 1});
+    dispatched_++;
+    started++;
+  }
+  queue_ = std::move(waiting);
+  return started;
+}
+
+void Remesher::Run(Task &task) {
+  if (auto worker = jobs_.current_worker()) {
+    Mesh(*meshers_[*worker], task);
+    return;
+  }
+  // any number of threads outside the pool may help from Wait() at once,
+  // each of them borrows a mesher of its own
+  std::unique_ptr<SectionMesher> mesher;
+  {
+    std::lock_guard lock{spare_mutex_};
+    if (!spare_meshers_.empty()) {
+      mesher = std::move(spare_meshers_.back());
+      spare_meshers_.pop_back();
+    }
+  }
+  if (!mesher) {
+    mesher = std::make_unique<SectionMesher>(registry_);
+  }
+  Mesh(*mesher, task);
+  std::lock_guard lock{spare_mutex_};
+  spare_meshers_.push_back(std::move(mesher));
+}
+
+void Remesher::Mesh(SectionMesher &mesher, Task &task) {
+  for (size_t face = 0; face < kDirectionCount; face++) {
+    for (int32_t slice = 0; slice < ChunkSection::kSize; slice++) {
+      if (task.dirty.dirty(static_cast<Direction>(face), slice)) {
+        mesher.MeshSlice(task.blocks, static_cast<Direction>(face), slice,
+                         task.slices[SliceIndex(static_cast<Direction>(face),
+                                                slice)]);
+      }
+    }
+  }
+  task.connectivity = mesher.Connectivity(task.blocks);
+}
+
+void Remesher::Complete(Task &task) {
+  in_flight_--;
+  auto it = sections_.find(task.pos);
+  if (it == sections_.end() || it->second.task != &task) {
+    return;
+  }
+  State &state = it->second;
+  state.in_flight = false;
+  state.task = nullptr;
+  if (closing_) {
+    return;
+  }
+  if (task.version != state.version) {
+    discarded_++;
+    state.dirty.Merge(task.dirty);
+    if (!state.queued) {
+      state.queued = true;
+      queue_.push_back(task.pos);
+    }
+    return;
+  }
+  Install(task.pos, state, &task);
+}
+
+void Remesher::Install(SectionPos pos, State &state, Task const *task) {
+  SectionMesh mesh;
+  std::array<uint32_t, kSliceCount + 1> offsets{};
+  if (task) {
+    mesh.vertices.reserve(state.mesh.vertices.size());
+    for (size_t face = 0; face < kDirectionCount; face++) {
+      for (int32_t slice = 0; slice < ChunkSection::kSize; slice++) {
+        const size_t index = SliceIndex(static_cast<Direction>(face), slice);
+        offsets[index] = static_cast<uint32_t>(mesh.vertices.size());
+        if (task->dirty.dirty(static_cast<Direction>(face), slice)) {
+          mesh.vertices.insert(mesh.vertices.end(),
+                               task->slices[index].begin(),
+                               task->slices[index].end());
+        } else {
+          mesh.vertices.insert(
+              mesh.vertices.end(),
+              state.mesh.vertices.begin() + state.offsets[index],
+              state.mesh.vertices.begin() + state.offsets[index + 1]);
+        }
+      }
+    }
+    offsets[kSliceCount] = static_cast<uint32_t>(mesh.vertices.size());
+    mesh.connectivity = task->connectivity;
+  }
+  SectionMesher::BuildIndices(mesh);
+  state.mesh = std::move(mesh);
+  state.offsets = offsets;
+  on_mesh_(pos, state.mesh);
+}
+}  // namespace world
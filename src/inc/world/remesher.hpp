@@ -0,0 +1,166 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "jobs/job-system.hpp"
+#include "world/block-registry.hpp"
+#include "world/chunk-section.hpp"
+#include "world/coordinates.hpp"
+#include "world/mesher.hpp"
+
+/*
+ * Keeps section meshes up to date while blocks change.
+ *
+ * An edit only marks the face slices around the block as dirty: the slices
+ * at the block and next to it along every axis, which covers the faces it
+ * occludes as well. Neighbouring sections are only touched when the block
+ * lies on the shared border. Edits are coalesced
+ * until Flush(), which starts at most one meshing job per section; the job
+ * remeshes just the dirty slices from a copy of the blocks and the result is
+ * spliced into the cached mesh on the main thread.
+ *
+ * The light is copied along with the blocks, from the light lookup. A light
+ * change isn't limited to the slices around one block, so OnLightChanged()
+ * remeshes the whole section, and the loaded sections next to it, which
+ * read its border for the smooth lighting.
+ *
+ * Every edit bumps the version of the section. A job that finishes after its
+ * section changed again is discarded, its slices are queued once more.
+ *
+ * Everything except the meshing itself runs on the main thread: edits,
+ * Flush(), and the mesh callback, from JobSystem::RunMainThreadJobs().
+ */
+namespace world {
+// One bit per slice along each axis.
+struct DirtySlices {
+  static constexpr uint16_t kAll = 0xFFFF;
+  // slices along x, y and z
+  std::array<uint16_t, 3> axes{};
+
+  // The faces of a block are in its own slice, the faces pointing at it and
+  // the faces it shades in the slices next to it. Coordinates in [-1, 16],
+  // for the border of a neighbour.
+  void Mark(int32_t x, int32_t y, int32_t z) noexcept {
+    const std::array<int32_t, 3> position{x, y, z};
+    for (size_t axis = 0; axis < 3; axis++) {
+      axes[axis] |=
+          static_cast<uint16_t>((0b111u << (position[axis] + 1)) >> 2);
+    }
+  }
+  void MarkAll() noexcept { axes.fill(kAll); }
+  void Merge(DirtySlices const &other) noexcept {
+    for (size_t axis = 0; axis < 3; axis++) {
+      axes[axis] |= other.axes[axis];
+    }
+  }
+  [[nodiscard]] bool empty() const noexcept {
+    return (axes[0] | axes[1] | axes[2]) == 0;
+  }
+  [[nodiscard]] bool dirty(Direction face, int32_t slice) const noexcept {
+    return axes[static_cast<size_t>(face) / 2] >> slice & 1;
+  }
+};
+
+class Remesher final {
+ public:
+  static constexpr size_t kSliceCount = kDirectionCount * ChunkSection::kSize;
+  // nullptr for sections that aren't loaded
+  using SectionLookup = std::function<ChunkSection const *(SectionPos)>;
+  // the arrays must stay valid until Flush() returns
+  using LightLookup = std::function<SectionLight(SectionPos)>;
+  using MeshCallback =
+      std::function<void(SectionPos, SectionMesh const &mesh)>;
+
+  // Without a light lookup every section is meshed in full daylight.
+  Remesher(BlockRegistry const &registry, jobs::JobSystem &jobs,
+           SectionLookup lookup, MeshCallback on_mesh,
+           LightLookup light = {});
+  // Waits for the running jobs, their results are dropped.
+  ~Remesher();
+  Remesher(Remesher const &) = delete;
+  Remesher &operator=(Remesher const &) = delete;
+
+  // Local block coordinates in the section.
+  void OnBlockChanged(SectionPos section, uint32_t x, uint32_t y, uint32_t z);
+  // Remeshes the whole section, after it was loaded or replaced.
+  void Invalidate(SectionPos section);
+  // The light of the section changed, for LightEngine's callback.
+  void OnLightChanged(SectionPos section);
+  // Drops the cached mesh of an unloaded section.
+  void Forget(SectionPos section);
+
+  // Starts a job for every dirty section that isn't being meshed already.
+  // Returns how many were started.
+  size_t Flush(jobs::Priority priority = jobs::Priority::kHigh);
+
+  [[nodiscard]] size_t dirty_count() const noexcept { return queue_.size(); }
+  [[nodiscard]] size_t in_flight_count() const noexcept { return in_flight_; }
+  // edits that landed on a section that was already waiting for a remesh
+  [[nodiscard]] uint64_t coalesced() const noexcept { return coalesced_; }
+  [[nodiscard]] uint64_t dispatched() const noexcept { return dispatched_; }
+  // results thrown away because the section changed while meshing
+  [[nodiscard]] uint64_t discarded() const noexcept { return discarded_; }
+
+ private:
+  struct Task {
+    SectionPos pos;
+    uint64_t version;
+    DirtySlices dirty;
+    PaddedSection blocks;
+    // only the dirty slices are filled
+    std::array<std::vector<MeshVertex>, kSliceCount> slices;
+    // always of the whole section
+    FaceConnectivity connectivity;
+  };
+  struct State {
+    uint64_t version = 0;
+    DirtySlices dirty;
+    bool queued = false;
+    bool in_flight = false;
+    // the running task, a forgotten and reloaded section must not take the
+    // result of the job started before
+    Task const *task = nullptr;
+    SectionMesh mesh;
+    // vertices of slice i are [offsets[i], offsets[i + 1])
+    std::array<uint32_t, kSliceCount + 1> offsets{};
+  };
+
+  [[nodiscard]] static size_t SliceIndex(Direction face,
+                                         int32_t slice) noexcept {
+    return static_cast<size_t>(face) * ChunkSection::kSize +
+           static_cast<size_t>(slice);
+  }
+  void MarkDirty(State &state, SectionPos section, DirtySlices const &slices);
+  void Run(Task &task);
+  void Mesh(SectionMesher &mesher, Task &task);
+  void Complete(Task &task);
+  void Install(SectionPos pos, State &state, Task const *task);
+
+  BlockRegistry const &registry_;
+  jobs::JobSystem &jobs_;
+  SectionLookup lookup_;
+  MeshCallback on_mesh_;
+  LightLookup light_;
+  // one per worker
+  std::vector<std::unique_ptr<SectionMesher>> meshers_;
+  // lent to the threads outside the pool
+  std::mutex spare_mutex_;
+  std::vector<std::unique_ptr<SectionMesher>> spare_meshers_;
+
+  std::unordered_map<SectionPos, State> sections_;
+  std::vector<SectionPos> queue_;
+  size_t in_flight_ = 0;
+  // shared by all sections, so a reloaded section never reuses a version
+  uint64_t versions_ = 0;
+  bool closing_ = false;
+  uint64_t coalesced_ = 0;
+  uint64_t dispatched_ = 0;
+  uint64_t discarded_ = 0;
+};
+}  // namespace world
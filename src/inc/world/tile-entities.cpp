@@ -0,0 +1,209 @@
+#include "tile-entities.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace world {
+TileEntityRegistry::Type const &TileEntityRegistry::type(uint16_t id) const {
+  if (id >= types_.size() || !types_[id].load) {
+    throw TileEntityException("Unregistered tile entity type");
+  }
+  return types_[id];
+}
+
+bool TileEntities::Remove(uint32_t x, uint32_t y, uint32_t z) {
+  const uint16_t index = Index(x, y, z);
+  if (!entries_.contains(index)) {
+    return false;
+  }
+  if (ticking_) {
+    removed_.push_back(index);
+  } else {
+    Erase(index);
+  }
+  return true;
+}
+
+void TileEntities::Erase(uint16_t index) {
+  auto it = entries_.find(index);
+  if (it == entries_.end()) {
+    return;
+  }
+  const Entry entry = it->second;
+  entries_.erase(it);
+  MarkDirty();
+  const uint32_t moved = pools_[entry.type]->Remove(entry.slot);
+  if (moved != detail::TilePoolBase::kNone) {
+    entries_.at(static_cast<uint16_t>(moved)).slot = entry.slot;
+  }
+  // compacting once half of the heap is stale keeps add and remove churn
+  // from growing it, at an amortized constant cost per wake up
+  stale_scheduled_ += entry.scheduled;
+  if (stale_scheduled_ * 2 > scheduled_.size()) {
+    CompactScheduled();
+  }
+}
+
+void TileEntities::CompactScheduled() {
+  std::erase_if(scheduled_, [this](Scheduled const &scheduled) {
+    auto it = entries_.find(scheduled.index);
+    return it == entries_.end() ||
+           it->second.generation != scheduled.generation;
+  });
+  std::make_heap(scheduled_.begin(), scheduled_.end(), std::greater{});
+  stale_scheduled_ = 0;
+}
+
+void TileEntities::Wake(uint32_t x, uint32_t y, uint32_t z) {
+  Wake(Index(x, y, z));
+}
+
+void TileEntities::Wake(uint16_t index) {
+  if (auto it = entries_.find(index); it != entries_.end()) {
+    pools_[it->second.type]->Wake(it->second.slot);
+  }
+}
+
+void TileEntities::ScheduleTick(uint32_t x, uint32_t y, uint32_t z,
+                                uint32_t delay) {
+  const uint16_t index = Index(x, y, z);
+  auto it = entries_.find(index);
+  if (it == entries_.end()) {
+    return;
+  }
+  it->second.scheduled++;
+  scheduled_.push_back(
+      {tick_ + std::max(delay, 1u), index, it->second.generation});
+  std::push_heap(scheduled_.begin(), scheduled_.end(), std::greater{});
+}
+
+void TileEntities::Tick(uint64_t tick) {
+  tick_ = tick;
+  while (!scheduled_.empty() && scheduled_.front().tick <= tick) {
+    std::pop_heap(scheduled_.begin(), scheduled_.end(), std::greater{});
+    const Scheduled due = scheduled_.back();
+    scheduled_.pop_back();
+    auto it = entries_.find(due.index);
+    if (it != entries_.end() && it->second.generation == due.generation) {
+      it->second.scheduled--;
+      pools_[it->second.type]->Wake(it->second.slot);
+    } else {
+      stale_scheduled_--;
+    }
+  }
+
+  ticking_ = true;
+  try {
+    for (auto &pool : pools_) {
+      if (pool && pool->active_count() > 0) {
+        pool->Tick(*this, tick);
+      }
+    }
+  } catch (...) {
+    ticking_ = false;
+    throw;
+  }
+  ticking_ = false;
+  for (uint16_t index : removed_) {
+    Erase(index);
+  }
+  removed_.clear();
+}
+
+size_t TileEntities::active_count() const noexcept {
+  size_t count = 0;
+  for (auto const &pool : pools_) {
+    if (pool) {
+      count += pool->active_count();
+    }
+  }
+  return count;
+}
+
+std::vector<std::byte> TileEntities::Save(
+    TileEntityRegistry const &registry) const {
+  using namespace nbt::detail;
+  std::vector<std::byte> buf;
+  encode<nbt::TagByte>(buf, static_cast<nbt::TagByte>(nbt::TAG_COMPOUND));
+  encode<nbt::TagShort>(buf, 0);
+  encode<nbt::TagByte>(buf, static_cast<nbt::TagByte>(nbt::TAG_LIST));
+  encode_string(buf, nbt::TagString("block_entities"));
+  encode<nbt::TagByte>(buf, static_cast<nbt::TagByte>(
+                               entries_.empty() ? nbt::TAG_END
+                                                : nbt::TAG_COMPOUND));
+  encode<nbt::TagInt>(buf, static_cast<nbt::TagInt>(entries_.size()));
+  for (uint16_t type = 0; type < pools_.size(); type++) {
+    if (pools_[type] && pools_[type]->size() > 0) {
+      pools_[type]->Save(buf, registry.type(type).name);
+    }
+  }
+  encode<nbt::TagByte>(buf, static_cast<nbt::TagByte>(nbt::TAG_END));
+  return buf;
+}
+
+size_t TileEntities::Load(TileEntityRegistry const &registry,
+                          std::span<const std::byte> data) {
+  using namespace nbt::detail;
+  if (ticking_) {
+    throw TileEntityException("Tile entities can't be loaded while ticking");
+  }
+  entries_.clear();
+  pools_.clear();
+  scheduled_.clear();
+  stale_scheduled_ = 0;
+
+  if (decode<nbt::TagByte>(data) != nbt::TAG_COMPOUND) {
+    throw TileEntityException("Tile entities must be stored in a compound");
+  }
+  (void)read_key(data);
+  size_t dropped = 0;
+  for (nbt::TagByte type = decode<nbt::TagByte>(data); type != nbt::TAG_END;
+       type = decode<nbt::TagByte>(data)) {
+    // every tag of the root is named, the name comes before the payload
+    const std::string_view key = read_key(data);
+    if (type != nbt::TAG_LIST || key != "block_entities") {
+      skip_tag(data, type);
+      continue;
+    }
+    const auto element = decode<nbt::TagByte>(data);
+    const auto count = decode<nbt::TagInt>(data);
+    if (count > 0 && element != nbt::TAG_COMPOUND) {
+      throw TileEntityException("block_entities must hold compounds");
+    }
+    for (nbt::TagInt i = 0; i < count; i++) {
+      // the id and the position can be anywhere in the compound, so it is
+      // scanned once for them and decoded into the struct afterwards
+      std::span<const std::byte> fields = data;
+      std::string id;
+      nbt::TagInt x = -1, y = -1, z = -1;
+      for (nbt::TagByte field = decode<nbt::TagByte>(data);
+           field != nbt::TAG_END; field = decode<nbt::TagByte>(data)) {
+        const std::string_view key = read_key(data);
+        if (key == "id" && field == nbt::TAG_STRING) {
+          id = decode_string(data);
+        } else if (key.size() == 1 && field == nbt::TAG_INT &&
+                   (key[0] == 'x' || key[0] == 'y' || key[0] == 'z')) {
+          (key[0] == 'x' ? x : key[0] == 'y' ? y : z) =
+              decode<nbt::TagInt>(data);
+        } else {
+          skip_tag(data, field);
+        }
+      }
+      auto it = registry.ids_.find(id);
+      if (it == registry.ids_.end()) {
+        dropped++;
+        continue;
+      }
+      if (x < 0 || x >= 16 || z < 0 || z >= 16 || y < 0 || y >= 256) {
+        throw TileEntityException(id + " has an invalid position");
+      }
+      registry.type(it->second)
+          .load(*this, Index(static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+                             static_cast<uint32_t>(z)),
+                fields);
+    }
+  }
+  ClearDirty();
+  return dropped;
+}
+}  // namespace world
@@ -0,0 +1,415 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "utils/nbt-bind.hpp"
+
+/*
+ * Per-chunk tile entity storage.
+ *
+ * Tile entities are kept by value in one pool per type. Only the awake ones
+ * are ticked: a tile entity calls Sleep() from its Tick() once it has nothing
+ * to do, and is woken again by Wake() (a neighbour changed, a player opened
+ * it) or by a scheduled tick. A chunk full of chests costs nothing per tick.
+ *
+ *   struct Furnace {
+ *     int32_t burn_time = 0;
+ *     void Tick(world::TileContext &context) {
+ *       if (burn_time == 0) return context.Sleep();
+ *       burn_time--;
+ *     }
+ *   };
+ *   template <> struct nbt::Schema<Furnace> { ... };
+ *
+ * The state lives in the structs while the chunk is loaded, NBT is only
+ * produced by Save() and read by Load() through the nbt::Schema bindings.
+ *
+ * For autosaving, the tile entities remember when they first changed after
+ * the last save. Adding and removing counts as a change; a tile entity that
+ * changes its own state calls TileContext::MarkDirty(), anything else that
+ * writes to one through Get() calls MarkDirty().
+ */
+namespace world {
+class TileEntityException : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+class TileEntities;
+class TileEntityRegistry;
+
+// Passed to Tick(), lets a tile entity put itself to sleep.
+class TileContext final {
+ public:
+  TileContext(TileEntities &tile_entities, uint64_t tick,
+              uint16_t index) noexcept
+      : tile_entities_(tile_entities), tick_(tick), index_(index) {}
+
+  // Sleeps until woken.
+  void Sleep() noexcept {
+    sleep_ = true;
+    wake_in_ = 0;
+  }
+  // Sleeps until woken, or for the given amount of ticks.
+  void SleepFor(uint32_t ticks) noexcept {
+    sleep_ = true;
+    wake_in_ = ticks;
+  }
+  // The state changed and needs to be saved.
+  void MarkDirty();
+
+  [[nodiscard]] TileEntities &tile_entities() const noexcept {
+    return tile_entities_;
+  }
+  [[nodiscard]] uint64_t tick() const noexcept { return tick_; }
+  [[nodiscard]] uint32_t x() const noexcept { return index_ & 15; }
+  [[nodiscard]] uint32_t y() const noexcept { return index_ >> 8; }
+  [[nodiscard]] uint32_t z() const noexcept { return (index_ >> 4) & 15; }
+  [[nodiscard]] bool sleeping() const noexcept { return sleep_; }
+  [[nodiscard]] uint32_t wake_in() const noexcept { return wake_in_; }
+
+ private:
+  TileEntities &tile_entities_;
+  uint64_t tick_;
+  uint16_t index_;
+  bool sleep_ = false;
+  uint32_t wake_in_ = 0;
+};
+
+template <typename T>
+concept TileEntity = nbt::Bound<T> && std::movable<T> &&
+                     requires(T &value, TileContext &context) {
+                       value.Tick(context);
+                     };
+
+namespace detail {
+inline std::atomic<uint16_t> next_tile_type{0};
+
+// Process wide id of a tile entity type, used to index the pools.
+template <TileEntity T>
+uint16_t TileTypeId() {
+  static const uint16_t id = next_tile_type++;
+  return id;
+}
+
+class TilePoolBase {
+ public:
+  static constexpr uint32_t kNone = UINT32_MAX;
+
+  virtual ~TilePoolBase() = default;
+  virtual void Tick(TileEntities &tile_entities, uint64_t tick) = 0;
+  virtual void Wake(uint32_t slot) = 0;
+  // Returns the block index of the tile entity moved into the slot, or kNone.
+  virtual uint32_t Remove(uint32_t slot) = 0;
+  virtual void Save(std::vector<std::byte> &buf, std::string_view id) const = 0;
+  [[nodiscard]] virtual size_t size() const noexcept = 0;
+  [[nodiscard]] virtual size_t active_count() const noexcept = 0;
+};
+
+template <TileEntity T>
+class TilePool final : public TilePoolBase {
+ public:
+  uint32_t Add(uint16_t index, T &&value) {
+    const auto slot = static_cast<uint32_t>(values_.size());
+    values_.push_back(std::move(value));
+    indices_.push_back(index);
+    active_position_.push_back(kNone);
+    Wake(slot);
+    return slot;
+  }
+
+  void Wake(uint32_t slot) override {
+    if (active_position_[slot] == kNone) {
+      active_position_[slot] = static_cast<uint32_t>(active_.size());
+      active_.push_back(slot);
+    }
+  }
+
+  // Backwards, so putting the current tile entity to sleep only moves ones
+  // that already ticked or were woken during this tick.
+  void Tick(TileEntities &tile_entities, uint64_t tick) override;
+
+  uint32_t Remove(uint32_t slot) override {
+    Sleep(slot);
+    const auto last = static_cast<uint32_t>(values_.size() - 1);
+    uint32_t moved = kNone;
+    if (slot != last) {
+      values_[slot] = std::move(values_[last]);
+      indices_[slot] = indices_[last];
+      active_position_[slot] = active_position_[last];
+      if (active_position_[slot] != kNone) {
+        active_[active_position_[slot]] = slot;
+      }
+      moved = indices_[slot];
+    }
+    values_.pop_back();
+    indices_.pop_back();
+    active_position_.pop_back();
+    return moved;
+  }
+
+  void Save(std::vector<std::byte> &buf, std::string_view id) const override {
+    using namespace nbt::detail;
+    for (size_t slot = 0; slot < values_.size(); slot++) {
+      const uint16_t index = indices_[slot];
+      encode_field(buf, "id", nbt::TagString(id));
+      encode_field(buf, "x", static_cast<nbt::TagInt>(index & 15));
+      encode_field(buf, "y", static_cast<nbt::TagInt>(index >> 8));
+      encode_field(buf, "z", static_cast<nbt::TagInt>((index >> 4) & 15));
+      encode_fields(buf, values_[slot]);
+    }
+  }
+
+  [[nodiscard]] T &at(uint32_t slot) noexcept { return values_[slot]; }
+  [[nodiscard]] size_t size() const noexcept override {
+    return values_.size();
+  }
+  [[nodiscard]] size_t active_count() const noexcept override {
+    return active_.size();
+  }
+
+ private:
+  void Sleep(uint32_t slot) {
+    const uint32_t position = active_position_[slot];
+    if (position == kNone) {
+      return;
+    }
+    active_[position] = active_.back();
+    active_position_[active_[position]] = position;
+    active_.pop_back();
+    active_position_[slot] = kNone;
+  }
+
+  std::vector<T> values_;
+  std::vector<uint16_t> indices_;
+  std::vector<uint32_t> active_position_;
+  std::vector<uint32_t> active_;
+};
+}  // namespace detail
+
+// Names used in the saved NBT, and how to load each type back.
+class TileEntityRegistry final {
+ public:
+  template <TileEntity T>
+  void Register(std::string name);
+
+  [[nodiscard]] bool contains(std::string_view name) const {
+    return ids_.contains(std::string(name));
+  }
+
+ private:
+  friend class TileEntities;
+  using Loader = void (*)(TileEntities &, uint16_t index,
+                          std::span<const std::byte> &fields);
+  struct Type {
+    std::string name;
+    Loader load = nullptr;
+  };
+
+  [[nodiscard]] Type const &type(uint16_t id) const;
+
+  std::vector<Type> types_;
+  std::unordered_map<std::string, uint16_t> ids_;
+};
+
+class TileEntities final {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  // Local block coordinates: x and z in [0, 16), y in [0, 256).
+  [[nodiscard]] static constexpr uint16_t Index(uint32_t x, uint32_t y,
+                                                uint32_t z) noexcept {
+    return static_cast<uint16_t>(y << 8 | z << 4 | x);
+  }
+
+  TileEntities() = default;
+  TileEntities(TileEntities &&) noexcept = default;
+  TileEntities &operator=(TileEntities &&) noexcept = default;
+
+  // Replaces the tile entity at the position. New tile entities start awake.
+  // Can't be called from a Tick(), the pools may reallocate.
+  template <TileEntity T, typename... Args>
+  T &Emplace(uint32_t x, uint32_t y, uint32_t z, Args &&...args) {
+    if (ticking_) {
+      throw TileEntityException("Tile entities can't be added while ticking");
+    }
+    const uint16_t index = Index(x, y, z);
+    Erase(index);
+    auto &pool = Pool<T>();
+    const uint32_t slot = pool.Add(index, T(std::forward<Args>(args)...));
+    entries_.emplace(index,
+                     Entry{detail::TileTypeId<T>(), slot, next_generation_++});
+    MarkDirty();
+    return pool.at(slot);
+  }
+
+  // Returns false if there is no tile entity. During a tick the removal is
+  // applied once the tick ends.
+  bool Remove(uint32_t x, uint32_t y, uint32_t z);
+
+  // nullptr if there is no tile entity of that type at the position.
+  template <TileEntity T>
+  [[nodiscard]] T *Get(uint32_t x, uint32_t y, uint32_t z) {
+    auto it = entries_.find(Index(x, y, z));
+    if (it == entries_.end() || it->second.type != detail::TileTypeId<T>()) {
+      return nullptr;
+    }
+    return &static_cast<detail::TilePool<T> &>(*pools_[it->second.type])
+                .at(it->second.slot);
+  }
+  [[nodiscard]] bool contains(uint32_t x, uint32_t y, uint32_t z) const {
+    return entries_.contains(Index(x, y, z));
+  }
+
+  // Both do nothing if there is no tile entity at the position.
+  void Wake(uint32_t x, uint32_t y, uint32_t z);
+  void ScheduleTick(uint32_t x, uint32_t y, uint32_t z, uint32_t delay);
+
+  // Runs the scheduled wake ups that are due, then ticks every awake
+  // tile entity once.
+  void Tick(uint64_t tick);
+
+  [[nodiscard]] size_t size() const noexcept { return entries_.size(); }
+  [[nodiscard]] size_t active_count() const noexcept;
+  // The queued wake ups. Ones of removed tile entities are dropped lazily,
+  // but never outnumber the others.
+  [[nodiscard]] size_t scheduled_count() const noexcept {
+    return scheduled_.size();
+  }
+
+  // Keeps the earliest time until ClearDirty().
+  void MarkDirty(Clock::time_point since = Clock::now()) {
+    const bool was_dirty = dirty_since_.has_value();
+    if (!was_dirty || since < *dirty_since_) {
+      dirty_since_ = since;
+    }
+    if (!was_dirty && on_dirty_) {
+      on_dirty_();
+    }
+  }
+  void ClearDirty() noexcept { dirty_since_.reset(); }
+  // Called whenever the tile entities turn dirty.
+  void set_on_dirty(std::function<void()> on_dirty) {
+    on_dirty_ = std::move(on_dirty);
+  }
+  [[nodiscard]] bool dirty() const noexcept { return dirty_since_.has_value(); }
+  // When the first change since the last save happened.
+  [[nodiscard]] std::optional<Clock::time_point> dirty_since() const noexcept {
+    return dirty_since_;
+  }
+
+  // A root compound with a "block_entities" list, every entry holds the "id",
+  // the local "x", "y" and "z" and the bound fields.
+  [[nodiscard]] std::vector<std::byte> Save(
+      TileEntityRegistry const &registry) const;
+  // Replaces the content and clears the dirty state. Entries of unknown types
+  // are dropped, returns how many were.
+  size_t Load(TileEntityRegistry const &registry,
+              std::span<const std::byte> data);
+
+ private:
+  friend class TileEntityRegistry;
+
+  struct Entry {
+    uint16_t type;
+    uint32_t slot;
+    // tells the wake ups of this tile entity from the ones of a removed tile
+    // entity at the same position
+    uint32_t generation;
+    // its wake ups in the heap
+    uint32_t scheduled = 0;
+  };
+  struct Scheduled {
+    uint64_t tick;
+    uint16_t index;
+    uint32_t generation;
+    bool operator>(Scheduled const &other) const noexcept {
+      return tick > other.tick;
+    }
+  };
+
+  template <TileEntity T>
+  detail::TilePool<T> &Pool() {
+    const uint16_t type = detail::TileTypeId<T>();
+    if (pools_.size() <= type) {
+      pools_.resize(type + 1);
+    }
+    if (!pools_[type]) {
+      pools_[type] = std::make_unique<detail::TilePool<T>>();
+    }
+    return static_cast<detail::TilePool<T> &>(*pools_[type]);
+  }
+  void Erase(uint16_t index);
+  void Wake(uint16_t index);
+  // Drops the wake ups of removed tile entities from the heap.
+  void CompactScheduled();
+
+  std::unordered_map<uint16_t, Entry> entries_;
+  std::vector<std::unique_ptr<detail::TilePoolBase>> pools_;
+  // min heap on the tick
+  std::vector<Scheduled> scheduled_;
+  // wake ups in the heap whose tile entity was removed
+  size_t stale_scheduled_ = 0;
+  uint32_t next_generation_ = 0;
+  std::vector<uint16_t> removed_;
+  uint64_t tick_ = 0;
+  bool ticking_ = false;
+  std::optional<Clock::time_point> dirty_since_;
+  std::function<void()> on_dirty_;
+};
+
+inline void TileContext::MarkDirty() { tile_entities_.MarkDirty(); }
+
+template <TileEntity T>
+void detail::TilePool<T>::Tick(TileEntities &tile_entities, uint64_t tick) {
+  for (size_t i = active_.size(); i-- > 0;) {
+    const uint32_t slot = active_[i];
+    TileContext context(tile_entities, tick, indices_[slot]);
+    values_[slot].Tick(context);
+    if (context.sleeping()) {
+      Sleep(slot);
+      if (context.wake_in() > 0) {
+        const uint16_t index = indices_[slot];
+        tile_entities.ScheduleTick(index & 15, index >> 8, (index >> 4) & 15,
+                                   context.wake_in());
+      }
+    }
+  }
+}
+
+template <TileEntity T>
+void TileEntityRegistry::Register(std::string name) {
+  if (ids_.contains(name)) {
+    throw TileEntityException("Tile entity " + name + " is already registered");
+  }
+  const uint16_t id = detail::TileTypeId<T>();
+  if (types_.size() <= id) {
+    types_.resize(id + 1);
+  }
+  if (types_[id].load) {
+    throw TileEntityException("Tile entity " + name +
+                              " is registered under another name");
+  }
+  types_[id].name = name;
+  types_[id].load = [](TileEntities &tile_entities, uint16_t index,
+                       std::span<const std::byte> &fields) {
+    T value{};
+    nbt::detail::decode_fields(fields, value);
+    tile_entities.Emplace<T>(index & 15, index >> 8, (index >> 4) & 15,
+                             std::move(value));
+  };
+  ids_.emplace(std::move(name), id);
+}
+}  // namespace world
@@ -0,0 +1,103 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+#include "world/coordinates.hpp"
+
+/*
+ * Vertex format of the chunk meshes: two 32-bit words per vertex.
+ *
+ *   position  bits  0-4   x        0..16, section-local
+ *             bits  5-9   y        0..16
+ *             bits 10-14  z        0..16
+ *             bits 15-19  u        0..16, in blocks
+ *             bits 20-24  v        0..16
+ *             bits 25-27  face     Direction, indexes the normal table
+ *             bits 28-29  ao       0 fully occluded .. 3 open
+ *   material  bits  0-15  texture  layer in the block texture array
+ *             bits 16-19  sky      sky light 0..15
+ *             bits 20-23  block    block light 0..15
+ *
+ * 8 bytes instead of the 36 of a float position, normal, uv and side. Both
+ * words are bound as unsigned integer attributes (glVertexAttribIPointer)
+ * and unpacked in chunkShader.vert, the section origin comes from the model
+ * matrix. The shader samples a texture array, so it isn't drawn with until
+ * the block textures move into one. The free bits are reserved and always 0.
+ */
+namespace world {
+struct VertexAttributes {
+  std::array<uint8_t, 3> position{};
+  std::array<uint8_t, 2> uv{};
+  Direction face = Direction::kWest;
+  uint8_t ao = 3;
+  // layer in the block texture array, BlockRegistry::kNoTexture if missing
+  uint16_t texture = 0;
+  uint8_t sky_light = 15;
+  uint8_t block_light = 0;
+  auto operator<=>(VertexAttributes const &) const = default;
+};
+
+struct MeshVertex {
+  uint32_t position = 0;
+  uint32_t material = 0;
+  auto operator<=>(MeshVertex const &) const = default;
+};
+static_assert(sizeof(MeshVertex) == 8);
+
+namespace vertex {
+constexpr uint32_t kCoordinateBits = 5;
+constexpr uint32_t kCoordinateMask = (1u << kCoordinateBits) - 1;
+constexpr uint32_t kUShift = 15;
+constexpr uint32_t kFaceShift = 25;
+constexpr uint32_t kAoShift = 28;
+constexpr uint32_t kSkyShift = 16;
+constexpr uint32_t kBlockShift = 20;
+// largest value of a coordinate, a section is 16 blocks wide
+constexpr uint8_t kMaxCoordinate = 16;
+constexpr uint8_t kMaxAo = 3;
+constexpr uint8_t kMaxLight = 15;
+}  // namespace vertex
+
+// Values out of range are masked, not clamped.
+[[nodiscard]] constexpr MeshVertex Encode(
+    VertexAttributes const &attributes) noexcept {
+  using namespace vertex;
+  MeshVertex packed;
+  for (uint32_t i = 0; i < 3; i++) {
+    packed.position |= (attributes.position[i] & kCoordinateMask)
+                       << (i * kCoordinateBits);
+  }
+  for (uint32_t i = 0; i < 2; i++) {
+    packed.position |= (attributes.uv[i] & kCoordinateMask)
+                       << (kUShift + i * kCoordinateBits);
+  }
+  packed.position |= (static_cast<uint32_t>(attributes.face) & 7u)
+                     << kFaceShift;
+  packed.position |= (attributes.ao & 3u) << kAoShift;
+  packed.material = attributes.texture |
+                    (attributes.sky_light & 15u) << kSkyShift |
+                    (attributes.block_light & 15u) << kBlockShift;
+  return packed;
+}
+
+[[nodiscard]] constexpr VertexAttributes Decode(MeshVertex packed) noexcept {
+  using namespace vertex;
+  VertexAttributes attributes;
+  for (uint32_t i = 0; i < 3; i++) {
+    attributes.position[i] = static_cast<uint8_t>(
+        packed.position >> (i * kCoordinateBits) & kCoordinateMask);
+  }
+  for (uint32_t i = 0; i < 2; i++) {
+    attributes.uv[i] = static_cast<uint8_t>(
+        packed.position >> (kUShift + i * kCoordinateBits) & kCoordinateMask);
+  }
+  attributes.face = static_cast<Direction>(packed.position >> kFaceShift & 7u);
+  attributes.ao = static_cast<uint8_t>(packed.position >> kAoShift & 3u);
+  attributes.texture = static_cast<uint16_t>(packed.material);
+  attributes.sky_light =
+      static_cast<uint8_t>(packed.material >> kSkyShift & 15u);
+  attributes.block_light =
+      static_cast<uint8_t>(packed.material >> kBlockShift & 15u);
+  return attributes;
+}
+}  // namespace world
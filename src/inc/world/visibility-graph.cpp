@@ -0,0 +1,57 @@
+#include "visibility-graph.hpp"
+
+namespace world {
+void VisibilityGraph::Set(SectionPos pos, FaceConnectivity connectivity) {
+  nodes_[pos].connectivity = connectivity;
+}
+
+bool VisibilityGraph::Remove(SectionPos pos) { return nodes_.erase(pos) > 0; }
+
+std::span<const SectionPos> VisibilityGraph::Traverse(SectionPos camera) {
+  visible_.clear();
+  auto start = nodes_.find(camera);
+  if (start == nodes_.end()) {
+    for (auto const &[pos, node] : nodes_) {
+      visible_.push_back(pos);
+    }
+    return visible_;
+  }
+  if (++walk_ == 0) {
+    // wrapped around, no node may look visited
+    for (auto &[pos, node] : nodes_) {
+      node.walk = 0;
+    }
+    walk_ = 1;
+  }
+
+  queue_.clear();
+  start->second.walk = walk_;
+  queue_.push_back({camera, &start->second, 0, 0});
+  for (size_t head = 0; head < queue_.size(); head++) {
+    const Step step = queue_[head];
+    visible_.push_back(step.pos);
+    for (size_t face = 0; face < kDirectionCount; face++) {
+      const auto exit = static_cast<Direction>(face);
+      if (step.directions >> static_cast<size_t>(Opposite(exit)) & 1) {
+        continue;
+      }
+      if (step.entry != 0 &&
+          !step.node->connectivity.connected(
+              static_cast<Direction>(step.entry - 1), exit)) {
+        continue;
+      }
+      const SectionPos pos = Neighbor(step.pos, exit);
+      auto it = nodes_.find(pos);
+      if (it == nodes_.end() || it->second.walk == walk_) {
+        continue;
+      }
+      it->second.walk = walk_;
+      queue_.push_back(
+          {pos, &it->second,
+           static_cast<uint8_t>(static_cast<uint8_t>(Opposite(exit)) + 1),
+           static_cast<uint8_t>(step.directions | 1u << face)});
+    }
+  }
+  return visible_;
+}
+}  // namespace world
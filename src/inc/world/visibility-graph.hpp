@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "world/coordinates.hpp"
+#include "world/mesher.hpp"
+
+/*
+ * Cave culling: the sections the camera may see at all, before frustum
+ * culling.
+ *
+ * Every loaded section has a node holding the face connectivity of its mesh.
+ * Traverse() walks the nodes breadth first from the camera section. A line
+ * of sight enters a section through one face and leaves through another only
+ * if the two are connected, and it never turns back towards the camera: a
+ * step in a direction is not taken once the path went the opposite way. So
+ * the sections behind a mountain or around the bend of a cave are never
+ * reached, while the frustum would still let them through.
+ *
+ * Every section is reached once, by its shortest path, which is what makes
+ * the result a cheap approximation: a section whose first path can't go on
+ * in some direction isn't tried again through another path. The order of the
+ * result is the order of the walk, near to far, and the same for the same
+ * nodes.
+ *
+ * Sections without a node, not loaded or outside the world, are never
+ * entered. A camera outside every node, e.g. above the world, culls nothing.
+ */
+namespace world {
+class VisibilityGraph final {
+ public:
+  // Adds or replaces the node of a section.
+  void Set(SectionPos pos, FaceConnectivity connectivity);
+  // Returns false if there was no node.
+  bool Remove(SectionPos pos);
+
+  // Valid until the next call.
+  std::span<const SectionPos> Traverse(SectionPos camera);
+
+  [[nodiscard]] size_t size() const noexcept { return nodes_.size(); }
+
+ private:
+  struct Node {
+    FaceConnectivity connectivity;
+    // the walk that reached it last
+    uint32_t walk = 0;
+  };
+  struct Step {
+    SectionPos pos;
+    Node const *node;
+    // Direction + 1 of the face the walk came in through, 0 for the camera
+    uint8_t entry;
+    // bit per Direction taken on the way here
+    uint8_t directions;
+  };
+
+  std::unordered_map<SectionPos, Node> nodes_;
+  uint32_t walk_ = 0;
+  std::vector<Step> queue_;
+  std::vector<SectionPos> visible_;
+};
+}  // namespace world
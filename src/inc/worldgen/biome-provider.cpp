@@ -0,0 +1,177 @@
+#include "biome-provider.hpp"
+
+#include <algorithm>
+
+namespace worldgen {
+namespace {
+using world::kChunkSize;
+
+constexpr int32_t kQuartSize = ChunkBiomes::kQuartSize;
+constexpr int32_t kQuarts = ChunkBiomes::kQuarts;
+// the temperature drops by kLapseRate per block above kLapseStart
+constexpr int32_t kLapseStart = 64;
+constexpr float kLapseRate = 1.0f / 256;
+
+Climate Lerp(float t, Climate const &a, Climate const &b) noexcept {
+  return {a.temperature + t * (b.temperature - a.temperature),
+          a.humidity + t * (b.humidity - a.humidity),
+          a.mountains + t * (b.mountains - a.mountains)};
+}
+
+// The chunks holding a rectangle of quarts, at most 3x3, fetched once.
+class QuartWindow {
+ public:
+  QuartWindow(BiomeProvider const &provider, int32_t qx0, int32_t qz0,
+              int32_t qx1, int32_t qz1)
+      : cx0_(qx0 >> 2), cz0_(qz0 >> 2), width_((qx1 >> 2) - cx0_ + 1) {
+    for (int32_t cz = cz0_; cz <= qz1 >> 2; cz++) {
+      for (int32_t cx = cx0_; cx <= qx1 >> 2; cx++) {
+        chunks_[static_cast<size_t>((cz - cz0_) * width_ + cx - cx0_)] =
+            provider.Get({cx, cz});
+      }
+    }
+  }
+
+  // Global quart coordinates.
+  [[nodiscard]] Climate const &climate(int32_t qx, int32_t qz) const {
+    ChunkBiomes const &chunk =
+        *chunks_[static_cast<size_t>(((qz >> 2) - cz0_) * width_ +
+                                     (qx >> 2) - cx0_)];
+    return chunk.climate(static_cast<uint32_t>(qx & 3),
+                         static_cast<uint32_t>(qz & 3));
+  }
+
+  // Bilinear between the centers of the quarts around the block.
+  [[nodiscard]] Climate Interpolate(int32_t x, int32_t z) const {
+    // centers are at 4q + 2
+    const int32_t gx = x - kQuartSize / 2;
+    const int32_t gz = z - kQuartSize / 2;
+    const int32_t qx = gx >> 2, qz = gz >> 2;
+    const float tx = static_cast<float>(gx & 3) / kQuartSize;
+    const float tz = static_cast<float>(gz & 3) / kQuartSize;
+    return Lerp(tz,
+                Lerp(tx, climate(qx, qz), climate(qx + 1, qz)),
+                Lerp(tx, climate(qx, qz + 1), climate(qx + 1, qz + 1)));
+  }
+
+ private:
+  int32_t cx0_;
+  int32_t cz0_;
+  int32_t width_;
+  std::array<std::shared_ptr<const ChunkBiomes>, 9> chunks_;
+};
+
+// Barycentric blend of the corners of the colour map triangle.
+uint32_t Tint(Climate const &climate, uint32_t wet, uint32_t dry,
+              uint32_t cold) noexcept {
+  const float t = std::clamp(0.5f + climate.temperature, 0.0f, 1.0f);
+  const float h = std::clamp(0.5f + climate.humidity, 0.0f, 1.0f) * t;
+  uint32_t color = 0;
+  for (uint32_t shift = 0; shift < 24; shift += 8) {
+    const float channel = h * static_cast<float>(wet >> shift & 0xFF) +
+                          (t - h) * static_cast<float>(dry >> shift & 0xFF) +
+                          (1 - t) * static_cast<float>(cold >> shift & 0xFF);
+    color |= static_cast<uint32_t>(channel + 0.5f) << shift;
+  }
+  return color;
+}
+}  // namespace
+
+BiomeProvider::BiomeProvider(int32_t seed, size_t capacity)
+    : temperature_({.seed = DeriveSeed(seed, 1),
+                    .frequency = 1.0f / 512,
+                    .octaves = 3}),
+      humidity_({.seed = DeriveSeed(seed, 2),
+                 .frequency = 1.0f / 512,
+                 .octaves = 3}),
+      mountains_({.seed = DeriveSeed(seed, 3),
+                  .frequency = 1.0f / 768,
+                  .octaves = 3}),
+      cache_(capacity) {}
+
+std::shared_ptr<const ChunkBiomes> BiomeProvider::Get(
+    world::ChunkPos pos) const {
+  return cache_.GetOrCreate(
+      pos, [this](world::ChunkPos key) { return Sample(key); });
+}
+
+Biome BiomeProvider::GetBiome(int32_t x, int32_t y, int32_t z) const {
+  const auto qy = static_cast<uint32_t>(
+      std::clamp(y, 0, world::Chunk::kHeight - 1) / kQuartSize);
+  return Get(world::ToChunkPos(x, z))
+      ->biome(static_cast<uint32_t>(x & 15) / kQuartSize, qy,
+              static_cast<uint32_t>(z & 15) / kQuartSize);
+}
+
+Climate BiomeProvider::GetClimate(int32_t x, int32_t y, int32_t z) const {
+  const int32_t qx = (x - kQuartSize / 2) >> 2;
+  const int32_t qz = (z - kQuartSize / 2) >> 2;
+  const QuartWindow window(*this, qx, qz, qx + 1, qz + 1);
+  return AtHeight(window.Interpolate(x, z), y);
+}
+
+void BiomeProvider::FillClimate(
+    world::ChunkPos pos, int32_t y,
+    std::span<Climate, kChunkSize * kChunkSize> out) const {
+  const int32_t block_x = pos.x * kChunkSize;
+  const int32_t block_z = pos.z * kChunkSize;
+  // the columns reach one quart into the chunks on either side
+  const QuartWindow window(*this, pos.x * kQuarts - 1, pos.z * kQuarts - 1,
+                           (pos.x + 1) * kQuarts, (pos.z + 1) * kQuarts);
+  for (int32_t z = 0; z < kChunkSize; z++) {
+    for (int32_t x = 0; x < kChunkSize; x++) {
+      out[static_cast<size_t>(z * kChunkSize + x)] =
+          AtHeight(window.Interpolate(block_x + x, block_z + z), y);
+    }
+  }
+}
+
+Biome BiomeProvider::Classify(Climate const &climate) noexcept {
+  if (climate.mountains > 0.25f) {
+    return Biome::kMountains;
+  }
+  if (climate.temperature > 0.2f && climate.humidity < 0.1f) {
+    return Biome::kDesert;
+  }
+  if (climate.humidity > 0.05f) {
+    return Biome::kForest;
+  }
+  return Biome::kPlains;
+}
+
+Climate BiomeProvider::AtHeight(Climate climate, int32_t y) noexcept {
+  climate.temperature -=
+      kLapseRate * static_cast<float>(std::max(y - kLapseStart, 0));
+  return climate;
+}
+
+ChunkBiomes BiomeProvider::Sample(world::ChunkPos pos) const {
+  ChunkBiomes chunk;
+  const std::array<float, 2> origin = {
+      static_cast<float>(pos.x * kChunkSize + kQuartSize / 2),
+      static_cast<float>(pos.z * kChunkSize + kQuartSize / 2)};
+  std::array<float, kQuarts * kQuarts> temperature, humidity, mountains;
+  temperature_.FillPlane(origin, {kQuarts, kQuarts}, kQuartSize, temperature);
+  humidity_.FillPlane(origin, {kQuarts, kQuarts}, kQuartSize, humidity);
+  mountains_.FillPlane(origin, {kQuarts, kQuarts}, kQuartSize, mountains);
+  for (size_t i = 0; i < chunk.climate_.size(); i++) {
+    chunk.climate_[i] = {temperature[i], humidity[i], mountains[i]};
+  }
+  for (uint32_t qy = 0; qy < ChunkBiomes::kQuartLayers; qy++) {
+    const auto y = static_cast<int32_t>(qy) * kQuartSize + kQuartSize / 2;
+    for (uint32_t i = 0; i < kQuarts * kQuarts; i++) {
+      chunk.biomes_[qy * kQuarts * kQuarts + i] =
+          Classify(AtHeight(chunk.climate_[i], y));
+    }
+  }
+  return chunk;
+}
+
+uint32_t GrassColor(Climate const &climate) noexcept {
+  return Tint(climate, 0x47CD33, 0xBFB755, 0x80B497);
+}
+
+uint32_t FoliageColor(Climate const &climate) noexcept {
+  return Tint(climate, 0x1ABF00, 0xAEA42A, 0x60A17B);
+}
+}  // namespace worldgen
@@ -0,0 +1,104 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "utils/concurrent-cache.hpp"
+#include "world/chunk.hpp"
+#include "world/coordinates.hpp"
+#include "worldgen/biome.hpp"
+#include "worldgen/noise.hpp"
+
+/*
+ * Biomes and climate for any block, at a fraction of the cost of sampling
+ * the noise there.
+ *
+ * The climate noise is sampled once per quart, a 4x4x4 cell of blocks: at
+ * the center of every 4x4 column of a chunk, and the temperature drops
+ * linearly with the height above that. The samples of a chunk and the biome
+ * of each of its 4x64x4 quarts are computed together on first use and kept
+ * in a cache of fixed size shared by all threads, so a chunk that is
+ * queried again while it's still cached costs a lookup.
+ *
+ * GetBiome() returns the biome of the quart holding the block. GetClimate()
+ * interpolates between the centers of the four nearest columns, which may
+ * belong to neighbouring chunks, so the climate, and the grass and foliage
+ * colours derived from it, change smoothly across chunk borders.
+ *
+ * The provider is a pure function of the seed: evicted chunks come back
+ * with the same values, whatever the capacity and the order of the queries.
+ */
+namespace worldgen {
+struct Climate {
+  float temperature = 0;
+  float humidity = 0;
+  // above 0.25 the terrain turns into mountains
+  float mountains = 0;
+};
+
+// The samples of one chunk.
+class ChunkBiomes final {
+ public:
+  static constexpr uint32_t kQuartSize = 4;
+  static constexpr uint32_t kQuarts = world::kChunkSize / kQuartSize;
+  static constexpr uint32_t kQuartLayers = world::Chunk::kHeight / kQuartSize;
+
+  // Quart coordinates inside the chunk.
+  [[nodiscard]] Biome biome(uint32_t qx, uint32_t qy,
+                            uint32_t qz) const noexcept {
+    return biomes_[(qy * kQuarts + qz) * kQuarts + qx];
+  }
+  // At the height of the terrain, the lapse isn't applied.
+  [[nodiscard]] Climate const &climate(uint32_t qx,
+                                       uint32_t qz) const noexcept {
+    return climate_[qz * kQuarts + qx];
+  }
+
+ private:
+  friend class BiomeProvider;
+
+  std::array<Climate, kQuarts * kQuarts> climate_;
+  std::array<Biome, kQuarts * kQuartLayers * kQuarts> biomes_;
+};
+
+class BiomeProvider final {
+ public:
+  // ~5 MB, the chunks of a render distance of 32
+  static constexpr size_t kDefaultCapacity = 4096;
+
+  explicit BiomeProvider(int32_t seed, size_t capacity = kDefaultCapacity);
+
+  // Computes the chunk if it isn't cached.
+  [[nodiscard]] std::shared_ptr<const ChunkBiomes> Get(
+      world::ChunkPos pos) const;
+  [[nodiscard]] Biome GetBiome(int32_t x, int32_t y, int32_t z) const;
+  [[nodiscard]] Climate GetClimate(int32_t x, int32_t y, int32_t z) const;
+  // The climate of every column of the chunk at height y, indexed
+  // z * 16 + x. Cheaper than 256 calls to GetClimate().
+  void FillClimate(world::ChunkPos pos, int32_t y,
+                   std::span<Climate, world::kChunkSize * world::kChunkSize>
+                       out) const;
+
+  [[nodiscard]] static Biome Classify(Climate const &climate) noexcept;
+  // The climate at height y given the one at the terrain.
+  [[nodiscard]] static Climate AtHeight(Climate climate, int32_t y) noexcept;
+
+  [[nodiscard]] utils::CacheStats cache_stats() const {
+    return cache_.stats();
+  }
+
+ private:
+  [[nodiscard]] ChunkBiomes Sample(world::ChunkPos pos) const;
+
+  FractalNoise temperature_;
+  FractalNoise humidity_;
+  FractalNoise mountains_;
+  mutable utils::ConcurrentCache<world::ChunkPos, ChunkBiomes> cache_;
+};
+
+// Tints as 0xRRGGBB, blended like the vanilla colour maps: hot and wet is
+// lush, hot and dry is yellow, cold is bluish.
+[[nodiscard]] uint32_t GrassColor(Climate const &climate) noexcept;
+[[nodiscard]] uint32_t FoliageColor(Climate const &climate) noexcept;
+}  // namespace worldgen
@@ -0,0 +1,50 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/*
+ * Biomes and the terrain shape they ask for. Terrain blends the parameters
+ * of the biomes around a column, so borders between biomes are smooth.
+ */
+namespace worldgen {
+enum class Biome : uint8_t { kPlains, kForest, kDesert, kMountains };
+inline constexpr size_t kBiomeCount = 4;
+
+struct BiomeShape {
+  // height of the surface around which the terrain noise varies
+  float base_height;
+  // blocks the 2D height noise moves the surface up or down
+  float height_variation;
+  // blocks per unit of 3D density noise, smaller gives more overhangs
+  float squash;
+  // trees per chunk
+  uint32_t trees;
+};
+
+inline constexpr std::array<BiomeShape, kBiomeCount> kBiomeShapes = {{
+    {68, 6, 24, 1},    // plains
+    {70, 10, 20, 7},   // forest
+    {66, 4, 28, 0},    // desert
+    {92, 36, 10, 1},   // mountains
+}};
+
+[[nodiscard]] constexpr BiomeShape const &Shape(Biome biome) noexcept {
+  return kBiomeShapes[static_cast<size_t>(biome)];
+}
+
+[[nodiscard]] constexpr std::string_view ToString(Biome biome) noexcept {
+  switch (biome) {
+    case Biome::kPlains:
+      return "plains";
+    case Biome::kForest:
+      return "forest";
+    case Biome::kDesert:
+      return "desert";
+    case Biome::kMountains:
+      return "mountains";
+  }
+  return "unknown";
+}
+}  // namespace worldgen
@@ -0,0 +1,498 @@
+#include "chunk-generator.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <utility>
+
+namespace worldgen {
+namespace {
+using world::BlockId;
+using world::Chunk;
+using world::ChunkSection;
+using world::kChunkSize;
+
+// density and cave noise are sampled every kCell blocks and interpolated
+constexpr int32_t kCell = 4;
+constexpr int32_t kCorners = kChunkSize / kCell + 1;
+constexpr int32_t kCornerLayers = Chunk::kHeight / kCell + 1;
+// caves stay below this height
+constexpr int32_t kCaveTop = 128;
+constexpr int32_t kCaveLayers = kCaveTop / kCell + 1;
+constexpr float kCaveWidth = 0.003f;
+// mountain tops above this stay bare stone
+constexpr int32_t kSnowLine = 120;
+constexpr int32_t kDirtDepth = 3;
+// trees tried per chunk, kept with a chance of trees / kTreeAttempts
+constexpr uint32_t kTreeAttempts = 8;
+// sky light is computed for the chunk and kLightPadding blocks around it
+constexpr int32_t kLightPadding = kChunkSize;
+constexpr int32_t kLightWidth = kChunkSize + 2 * kLightPadding;
+
+uint64_t Mix(uint64_t value) noexcept {
+  value ^= value >> 30;
+  value *= 0xBF58476D1CE4E5B9ull;
+  value ^= value >> 27;
+  value *= 0x94D049BB133111EBull;
+  return value ^ (value >> 31);
+}
+
+uint64_t Hash(int32_t seed, int32_t x, int32_t y, int32_t z) noexcept {
+  uint64_t hash = Mix(static_cast<uint32_t>(seed));
+  hash = Mix(hash ^ static_cast<uint32_t>(x));
+  hash = Mix(hash ^ static_cast<uint64_t>(static_cast<uint32_t>(y)) << 32);
+  return Mix(hash ^ static_cast<uint32_t>(z));
+}
+
+NoiseSettings Settings(int32_t seed, float frequency, uint32_t octaves) {
+  NoiseSettings settings;
+  settings.seed = seed;
+  settings.frequency = frequency;
+  settings.octaves = octaves;
+  return settings;
+}
+
+float Lerp(float t, float a, float b) noexcept { return a + t * (b - a); }
+
+// Trilinear interpolation of a grid sampled every kCell blocks, indexed
+// (y * kCorners + z) * kCorners + x.
+float Interpolate(std::span<const float> grid, int32_t x, int32_t y,
+                  int32_t z) noexcept {
+  const int32_t cx = x / kCell, cy = y / kCell, cz = z / kCell;
+  const float fx = static_cast<float>(x % kCell) / kCell;
+  const float fy = static_cast<float>(y % kCell) / kCell;
+  const float fz = static_cast<float>(z % kCell) / kCell;
+  auto at = [&](int32_t dx, int32_t dy, int32_t dz) {
+    return grid[static_cast<size_t>(((cy + dy) * kCorners + cz + dz) *
+                                        kCorners +
+                                    cx + dx)];
+  };
+  const float bottom = Lerp(fz, Lerp(fx, at(0, 0, 0), at(1, 0, 0)),
+                            Lerp(fx, at(0, 0, 1), at(1, 0, 1)));
+  const float top = Lerp(fz, Lerp(fx, at(0, 1, 0), at(1, 1, 0)),
+                         Lerp(fx, at(0, 1, 1), at(1, 1, 1)));
+  return Lerp(fy, bottom, top);
+}
+
+Biome ColumnBiome(ProtoChunk const &chunk, int32_t x, int32_t z) noexcept {
+  return chunk.biome(static_cast<uint32_t>(x / ProtoChunk::kQuartSize),
+                     static_cast<uint32_t>(z / ProtoChunk::kQuartSize));
+}
+
+// Whether the surface stage put grass on the column, features only see the
+// heights of the neighbours and not their blocks.
+bool Grassy(Biome biome, int32_t height) noexcept {
+  return biome != Biome::kDesert && height <= kSnowLine;
+}
+
+// The highest non-air block of the column, -1 if there is none.
+int32_t Top(Chunk const &chunk, int32_t x, int32_t z) noexcept {
+  for (int32_t section = Chunk::kSectionCount - 1; section >= 0; section--) {
+    ChunkSection const &blocks = chunk.section(section);
+    if (blocks.empty()) {
+      continue;
+    }
+    for (int32_t y = ChunkSection::kSize - 1; y >= 0; y--) {
+      if (blocks.Get(static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+                     static_cast<uint32_t>(z)) != world::kAir) {
+        return section * ChunkSection::kSize + y;
+      }
+    }
+  }
+  return -1;
+}
+}  // namespace
+
+GeneratorBlocks GeneratorBlocks::Resolve(
+    world::BlockRegistry const &registry) {
+  return {registry.id("minecraft:stone"),   registry.id("minecraft:dirt"),
+          registry.id("minecraft:grass"),   registry.id("minecraft:sand"),
+          registry.id("minecraft:bedrock"), registry.id("minecraft:oak_log"),
+          registry.id("minecraft:oak_leaves")};
+}
+
+ChunkGenerator::ChunkGenerator(world::BlockRegistry const &registry,
+                               int32_t seed)
+    : seed_(seed),
+      blocks_(GeneratorBlocks::Resolve(registry)),
+      biomes_(seed),
+      height_(Settings(DeriveSeed(seed, 4), 1.0f / 128, 4)),
+      density_(Settings(DeriveSeed(seed, 5), 1.0f / 64, 3)),
+      cave_a_(Settings(DeriveSeed(seed, 6), 1.0f / 48, 2)),
+      cave_b_(Settings(DeriveSeed(seed, 7), 1.0f / 48, 2)) {
+  auto transparent = registry.transparent_table();
+  opaque_.resize(transparent.size());
+  for (size_t id = 0; id < transparent.size(); id++) {
+    opaque_[id] = !transparent[id];
+  }
+}
+
+void ChunkGenerator::Run(ChunkStatus status,
+                         ChunkNeighborhood const &chunks) const {
+  ProtoChunk &chunk = chunks.center();
+  switch (status) {
+    case ChunkStatus::kEmpty:
+      break;
+    case ChunkStatus::kBiomes:
+      Biomes(chunk);
+      break;
+    case ChunkStatus::kTerrain:
+      Terrain(chunks);
+      break;
+    case ChunkStatus::kCaves:
+      Caves(chunk);
+      break;
+    case ChunkStatus::kSurface:
+      Surface(chunk);
+      break;
+    case ChunkStatus::kFeatures:
+      Features(chunks);
+      break;
+    case ChunkStatus::kFull:
+      Light(chunks);
+      break;
+  }
+  chunk.set_status(status);
+}
+
+void ChunkGenerator::Biomes(ProtoChunk &chunk) const {
+  constexpr uint32_t kQuarts = ProtoChunk::kQuarts;
+  constexpr uint32_t kLayer = kSeaLevel / ChunkBiomes::kQuartSize;
+  const auto biomes = biomes_.Get(chunk.pos());
+  for (uint32_t z = 0; z < kQuarts; z++) {
+    for (uint32_t x = 0; x < kQuarts; x++) {
+      chunk.set_biome(x, z, biomes->biome(x, kLayer, z));
+    }
+  }
+}
+
+void ChunkGenerator::Terrain(ChunkNeighborhood const &chunks) const {
+  ProtoChunk &chunk = chunks.center();
+  const int32_t block_x = chunk.pos().x * kChunkSize;
+  const int32_t block_z = chunk.pos().z * kChunkSize;
+
+  // the shape at every corner, averaged over the 4x4 quarts around it
+  std::array<float, kCorners * kCorners> height, squash;
+  std::array<float, kCorners * kCorners> variation;
+  height_.FillPlane({static_cast<float>(block_x), static_cast<float>(block_z)},
+                    {kCorners, kCorners}, kCell, variation);
+  for (int32_t cz = 0; cz < kCorners; cz++) {
+    for (int32_t cx = 0; cx < kCorners; cx++) {
+      float base = 0, amplitude = 0, squash_sum = 0;
+      for (int32_t qz = cz - 2; qz < cz + 2; qz++) {
+        for (int32_t qx = cx - 2; qx < cx + 2; qx++) {
+          // quarts -2..5 reach into the neighbours
+          const int32_t dx = qx < 0 ? -1 : qx >= ProtoChunk::kQuarts ? 1 : 0;
+          const int32_t dz = qz < 0 ? -1 : qz >= ProtoChunk::kQuarts ? 1 : 0;
+          BiomeShape const &shape = Shape(chunks.at(dx, dz).biome(
+              static_cast<uint32_t>(qx - dx * ProtoChunk::kQuarts),
+              static_cast<uint32_t>(qz - dz * ProtoChunk::kQuarts)));
+          base += shape.base_height;
+          amplitude += shape.height_variation;
+          squash_sum += shape.squash;
+        }
+      }
+      const size_t i = static_cast<size_t>(cz * kCorners + cx);
+      height[i] = (base + amplitude * variation[i]) / 16;
+      squash[i] = squash_sum / 16;
+    }
+  }
+
+  std::vector<float> density(kCorners * kCornerLayers * kCorners);
+  density_.FillGrid({static_cast<float>(block_x), 0,
+                     static_cast<float>(block_z)},
+                    {kCorners, kCornerLayers, kCorners}, kCell, density);
+  for (int32_t y = 0; y < kCornerLayers; y++) {
+    for (size_t i = 0; i < height.size(); i++) {
+      float &value = density[static_cast<size_t>(y) * height.size() + i];
+      value += (height[i] - static_cast<float>(y * kCell)) / squash[i];
+    }
+  }
+
+  std::array<uint8_t, ChunkSection::kVolume> solid;
+  for (int32_t index = 0; index < Chunk::kSectionCount; index++) {
+    uint32_t count = 0;
+    for (int32_t y = 0; y < ChunkSection::kSize; y++) {
+      for (int32_t z = 0; z < kChunkSize; z++) {
+        for (int32_t x = 0; x < kChunkSize; x++) {
+          const bool stone =
+              Interpolate(density, x, index * ChunkSection::kSize + y, z) > 0;
+          solid[ChunkSection::Index(static_cast<uint32_t>(x),
+                                    static_cast<uint32_t>(y),
+                                    static_cast<uint32_t>(z))] = stone;
+          count += stone;
+        }
+      }
+    }
+    ChunkSection &section = chunk.chunk().section(index);
+    if (count == ChunkSection::kVolume) {
+      section.Fill(blocks_.stone);
+    } else if (count > 0) {
+      for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+        if (solid[i]) {
+          section.Set(i, blocks_.stone);
+        }
+      }
+    }
+  }
+
+  // a flat floor with a few bedrock blocks above it
+  for (uint32_t z = 0; z < kChunkSize; z++) {
+    for (uint32_t x = 0; x < kChunkSize; x++) {
+      chunk.chunk().Set(x, 0, z, blocks_.bedrock);
+      for (uint32_t y = 1; y < 4; y++) {
+        if (Hash(seed_, block_x + static_cast<int32_t>(x),
+                 static_cast<int32_t>(y),
+                 block_z + static_cast<int32_t>(z)) %
+                (y + 1) ==
+            0) {
+          chunk.chunk().Set(x, y, z, blocks_.bedrock);
+        }
+      }
+    }
+  }
+}
+
+void ChunkGenerator::Caves(ProtoChunk &chunk) const {
+  const std::array<float, 3> origin = {
+      static_cast<float>(chunk.pos().x * kChunkSize), 0,
+      static_cast<float>(chunk.pos().z * kChunkSize)};
+  std::vector<float> a(kCorners * kCaveLayers * kCorners);
+  std::vector<float> b(a.size());
+  cave_a_.FillGrid(origin, {kCorners, kCaveLayers, kCorners}, kCell, a);
+  cave_b_.FillGrid(origin, {kCorners, kCaveLayers, kCorners}, kCell, b);
+
+  // tunnels where both fields are close to 0, above the bedrock
+  for (int32_t index = 0; index < kCaveTop / ChunkSection::kSize; index++) {
+    ChunkSection &section = chunk.chunk().section(index);
+    if (section.empty()) {
+      continue;
+    }
+    for (int32_t y = 0; y < ChunkSection::kSize; y++) {
+      const int32_t block_y = index * ChunkSection::kSize + y;
+      if (block_y < 4) {
+        continue;
+      }
+      for (int32_t z = 0; z < kChunkSize; z++) {
+        for (int32_t x = 0; x < kChunkSize; x++) {
+          const float va = Interpolate(a, x, block_y, z);
+          const float vb = Interpolate(b, x, block_y, z);
+          const auto ux = static_cast<uint32_t>(x);
+          const auto uy = static_cast<uint32_t>(y);
+          const auto uz = static_cast<uint32_t>(z);
+          if (va * va + vb * vb < kCaveWidth &&
+              section.Get(ux, uy, uz) == blocks_.stone) {
+            section.Set(ux, uy, uz, world::kAir);
+          }
+        }
+      }
+    }
+  }
+}
+
+void ChunkGenerator::Surface(ProtoChunk &chunk) const {
+  Chunk &blocks = chunk.chunk();
+  for (int32_t z = 0; z < kChunkSize; z++) {
+    for (int32_t x = 0; x < kChunkSize; x++) {
+      const int32_t top = Top(blocks, x, z);
+      chunk.set_height(static_cast<uint32_t>(x), static_cast<uint32_t>(z),
+                       static_cast<uint8_t>(std::max(top, 0)));
+      const Biome biome = ColumnBiome(chunk, x, z);
+      if (top < 0 || (biome != Biome::kDesert && !Grassy(biome, top))) {
+        continue;
+      }
+      const auto ux = static_cast<uint32_t>(x);
+      const auto uz = static_cast<uint32_t>(z);
+      // only the stone right under the surface is covered
+      for (int32_t y = top; y >= std::max(top - kDirtDepth, 0); y--) {
+        const auto uy = static_cast<uint32_t>(y);
+        if (blocks.Get(ux, uy, uz) != blocks_.stone) {
+          break;
+        }
+        BlockId block = blocks_.dirt;
+        if (biome == Biome::kDesert) {
+          block = blocks_.sand;
+        } else if (y == top) {
+          block = blocks_.grass;
+        }
+        blocks.Set(ux, uy, uz, block);
+      }
+    }
+  }
+}
+
+void ChunkGenerator::Features(ChunkNeighborhood const &chunks) const {
+  Chunk &blocks = chunks.center().chunk();
+  auto place = [&](int32_t x, int32_t y, int32_t z, BlockId block) {
+    if (x < 0 || x >= kChunkSize || z < 0 || z >= kChunkSize || y < 0 ||
+        y >= Chunk::kHeight) {
+      return;
+    }
+    const auto ux = static_cast<uint32_t>(x);
+    const auto uy = static_cast<uint32_t>(y);
+    const auto uz = static_cast<uint32_t>(z);
+    // logs win over leaves, so overlapping trees look the same whatever
+    // chunk they came from
+    const BlockId current = blocks.Get(ux, uy, uz);
+    if (current == world::kAir ||
+        (block == blocks_.log && current == blocks_.leaves)) {
+      blocks.Set(ux, uy, uz, block);
+    }
+  };
+
+  // the trees of every chunk around, in a fixed order
+  for (int32_t dz = -1; dz <= 1; dz++) {
+    for (int32_t dx = -1; dx <= 1; dx++) {
+      ProtoChunk const &owner = chunks.at(dx, dz);
+      for (uint32_t attempt = 0; attempt < kTreeAttempts; attempt++) {
+        const uint64_t hash =
+            Hash(DeriveSeed(seed_, 8), owner.pos().x,
+                 static_cast<int32_t>(attempt), owner.pos().z);
+        const auto x = static_cast<int32_t>(hash & 15);
+        const auto z = static_cast<int32_t>(hash >> 4 & 15);
+        const Biome biome = ColumnBiome(owner, x, z);
+        const int32_t ground =
+            owner.height(static_cast<uint32_t>(x), static_cast<uint32_t>(z));
+        const int32_t trunk = 4 + static_cast<int32_t>(hash >> 8 & 3) % 3;
+        const int32_t top = ground + trunk;
+        if ((hash >> 16) % kTreeAttempts >= Shape(biome).trees ||
+            !Grassy(biome, ground) || top + 2 > Chunk::kHeight) {
+          continue;
+        }
+        // relative to the center chunk
+        const int32_t cx = dx * kChunkSize + x;
+        const int32_t cz = dz * kChunkSize + z;
+        for (int32_t y = top - 2; y <= top + 1; y++) {
+          const int32_t radius = y < top ? 2 : 1;
+          for (int32_t oz = -radius; oz <= radius; oz++) {
+            for (int32_t ox = -radius; ox <= radius; ox++) {
+              const bool corner = std::abs(ox) == radius &&
+                                  std::abs(oz) == radius;
+              // bare corners, and a plus shape on the very top
+              if (corner && (radius == 2 || y == top + 1)) {
+                continue;
+              }
+              place(cx + ox, y, cz + oz, blocks_.leaves);
+            }
+          }
+        }
+        for (int32_t y = ground + 1; y <= top; y++) {
+          place(cx, y, cz, blocks_.log);
+        }
+      }
+    }
+  }
+  // neighbours only read the blocks from now on
+  blocks.Optimize();
+}
+
+void ChunkGenerator::Light(ChunkNeighborhood const &chunks) const {
+  // Light levels of the chunk and the padding around it, cells at or above
+  // the top of their column see the sky. Light reaches at most 15 blocks, so
+  // every source that can light the center is inside the padding.
+  constexpr int32_t kArea = kLightWidth * kLightWidth;
+  thread_local std::vector<uint8_t> light;
+  thread_local std::vector<uint32_t> queue;
+  std::array<int32_t, kArea> tops;
+
+  auto chunk_at = [&](int32_t x, int32_t z) -> Chunk const & {
+    return chunks.at(x / kChunkSize - 1, z / kChunkSize - 1).chunk();
+  };
+  auto opaque = [&](int32_t x, int32_t y, int32_t z) {
+    return opaque_[chunk_at(x, z).Get(static_cast<uint32_t>(x % kChunkSize),
+                                      static_cast<uint32_t>(y),
+                                      static_cast<uint32_t>(z % kChunkSize))];
+  };
+
+  int32_t max_top = 0;
+  for (int32_t z = 0; z < kLightWidth; z++) {
+    for (int32_t x = 0; x < kLightWidth; x++) {
+      int32_t top = Top(chunk_at(x, z), x % kChunkSize, z % kChunkSize);
+      while (top >= 0 && !opaque(x, top, z)) {
+        top--;
+      }
+      tops[static_cast<size_t>(z * kLightWidth + x)] = top + 1;
+      max_top = std::max(max_top, top + 1);
+    }
+  }
+
+  // only the layers up to the highest top can be darker than 15
+  const int32_t layers = std::min(max_top + 1, Chunk::kHeight);
+  light.assign(static_cast<size_t>(layers * kArea), 0);
+  queue.clear();
+  auto index = [](int32_t x, int32_t y, int32_t z) {
+    return static_cast<uint32_t>((y * kLightWidth + z) * kLightWidth + x);
+  };
+  for (int32_t z = 0; z < kLightWidth; z++) {
+    for (int32_t x = 0; x < kLightWidth; x++) {
+      const int32_t top = tops[static_cast<size_t>(z * kLightWidth + x)];
+      int32_t reach = top;
+      for (auto [nx, nz] : {std::pair{x - 1, z}, std::pair{x + 1, z},
+                            std::pair{x, z - 1}, std::pair{x, z + 1}}) {
+        if (nx >= 0 && nx < kLightWidth && nz >= 0 && nz < kLightWidth) {
+          reach = std::max(reach, tops[static_cast<size_t>(nz * kLightWidth +
+                                                           nx)]);
+        }
+      }
+      for (int32_t y = top; y < layers; y++) {
+        light[index(x, y, z)] = world::NibbleArray::kMax;
+        // sky cells next to a column that is shaded at this height
+        if (y < reach) {
+          queue.push_back(index(x, y, z));
+        }
+      }
+    }
+  }
+
+  for (size_t head = 0; head < queue.size(); head++) {
+    const uint32_t cell = queue[head];
+    const uint8_t level = light[cell];
+    if (level <= 1) {
+      continue;
+    }
+    const auto x = static_cast<int32_t>(cell % kLightWidth);
+    const auto z = static_cast<int32_t>(cell / kLightWidth % kLightWidth);
+    const auto y = static_cast<int32_t>(cell / kArea);
+    const std::array<std::array<int32_t, 3>, 6> neighbors = {{{x - 1, y, z},
+                                                              {x + 1, y, z},
+                                                              {x, y - 1, z},
+                                                              {x, y + 1, z},
+                                                              {x, y, z - 1},
+                                                              {x, y, z + 1}}};
+    for (auto [nx, ny, nz] : neighbors) {
+      if (nx < 0 || nx >= kLightWidth || nz < 0 || nz >= kLightWidth ||
+          ny < 0 || ny >= layers) {
+        continue;
+      }
+      const uint32_t next = index(nx, ny, nz);
+      if (light[next] + 1 < level && !opaque(nx, ny, nz)) {
+        light[next] = static_cast<uint8_t>(level - 1);
+        queue.push_back(next);
+      }
+    }
+  }
+
+  ProtoChunk &center = chunks.center();
+  for (int32_t section = 0; section < Chunk::kSectionCount; section++) {
+    world::NibbleArray &sky = center.sky_light(section);
+    const int32_t bottom = section * ChunkSection::kSize;
+    if (bottom >= layers) {
+      sky.Fill(world::NibbleArray::kMax);
+      continue;
+    }
+    for (int32_t y = 0; y < ChunkSection::kSize; y++) {
+      for (int32_t z = 0; z < kChunkSize; z++) {
+        for (int32_t x = 0; x < kChunkSize; x++) {
+          const int32_t block_y = bottom + y;
+          const uint8_t level =
+              block_y >= layers
+                  ? world::NibbleArray::kMax
+                  : light[index(x + kLightPadding, block_y, z + kLightPadding)];
+          sky.Set(static_cast<uint32_t>(x), static_cast<uint32_t>(y),
+                  static_cast<uint32_t>(z), level);
+        }
+      }
+    }
+  }
+}
+}  // namespace worldgen
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "world/block-registry.hpp"
+#include "worldgen/biome-provider.hpp"
+#include "worldgen/noise.hpp"
+#include "worldgen/proto-chunk.hpp"
+
+/*
+ * The stages of terrain generation, see proto-chunk.hpp for what they read.
+ *
+ *   biomes    the biome of every 4x4 column at sea level, from the
+ *             BiomeProvider
+ *   terrain   stone where the 3D density is positive: the blended surface
+ *             height of the biomes minus y, plus 3D noise scaled by the
+ *             squash of the biome. Sampled every 4 blocks and interpolated.
+ *   caves     carves the tunnels where two noise fields are both near 0
+ *   surface   grass or sand over a few blocks of dirt, records the heights
+ *   features  trees, including the parts of the trees of the neighbours
+ *   light     sky light, spread through the chunk and its neighbours
+ *
+ * Every stage is a pure function of the seed and the chunks it reads, the
+ * generator itself is immutable and shared by all worker threads.
+ */
+namespace worldgen {
+// The blocks placed by the generator.
+struct GeneratorBlocks {
+  world::BlockId stone;
+  world::BlockId dirt;
+  world::BlockId grass;
+  world::BlockId sand;
+  world::BlockId bedrock;
+  world::BlockId log;
+  world::BlockId leaves;
+
+  // Throws world::BlockRegistryException if one of them isn't registered.
+  [[nodiscard]] static GeneratorBlocks Resolve(
+      world::BlockRegistry const &registry);
+};
+
+class ChunkGenerator final {
+ public:
+  static constexpr int32_t kSeaLevel = 63;
+
+  ChunkGenerator(world::BlockRegistry const &registry, int32_t seed);
+
+  // Runs the stage producing the status on the center of the neighbourhood,
+  // which has the previous status.
+  void Run(ChunkStatus status, ChunkNeighborhood const &chunks) const;
+
+  [[nodiscard]] int32_t seed() const noexcept { return seed_; }
+  // Shared with whoever needs the biomes of this world, like the mesher.
+  [[nodiscard]] BiomeProvider const &biomes() const noexcept {
+    return biomes_;
+  }
+
+ private:
+  void Biomes(ProtoChunk &chunk) const;
+  void Terrain(ChunkNeighborhood const &chunks) const;
+  void Caves(ProtoChunk &chunk) const;
+  void Surface(ProtoChunk &chunk) const;
+  void Features(ChunkNeighborhood const &chunks) const;
+  void Light(ChunkNeighborhood const &chunks) const;
+
+  int32_t seed_;
+  GeneratorBlocks blocks_;
+  // 1 for the blocks sky light can't pass
+  std::vector<uint8_t> opaque_;
+  BiomeProvider biomes_;
+  FractalNoise height_;
+  FractalNoise density_;
+  FractalNoise cave_a_;
+  FractalNoise cave_b_;
+};
+}  // namespace worldgen
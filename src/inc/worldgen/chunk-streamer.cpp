@@ -0,0 +1,280 @@
+#include "chunk-streamer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iterator>
+#include <limits>
+
+namespace worldgen {
+namespace {
+using world::kChunkSize;
+
+// a chunk straight ahead counts as this much nearer, one behind as farther
+constexpr float kLookBias = 0.5f;
+// the queue is rebuilt once the look direction moved this far, about 25°
+constexpr float kReplanTurn = 0.45f;
+}  // namespace
+
+ChunkStreamer::ChunkStreamer(ChunkGenerator const &generator,
+                             jobs::JobSystem &jobs, StreamingSettings settings,
+                             ChunkCallback on_load, ChunkCallback on_unload)
+    : settings_(settings),
+      max_in_flight_(settings.max_in_flight > 0
+                         ? settings.max_in_flight
+                         : 2 * std::max<size_t>(jobs.worker_count(), 1)),
+      on_load_(std::move(on_load)),
+      on_unload_(std::move(on_unload)),
+      pipeline_(generator, jobs, [this](std::unique_ptr<ProtoChunk> chunk) {
+        {
+          std::lock_guard lock(arrived_mutex_);
+          arrived_.push_back(std::move(chunk));
+        }
+        arrived_changed_.notify_all();
+      }) {}
+
+void ChunkStreamer::Update(float x, float z, float look_x, float look_z) {
+  const auto begin = Clock::now();
+  // returns at once, only to rethrow a failed stage
+  pipeline_.Wait(std::numeric_limits<size_t>::max());
+  x_ = x;
+  z_ = z;
+  const float length = std::hypot(look_x, look_z);
+  look_x_ = length > 0 ? look_x / length : 0;
+  look_z_ = length > 0 ? look_z / length : 0;
+
+  CancelOutOfRange();
+  Load();
+  UnloadOutOfRange();
+  Plan();
+  Submit();
+  update_time_ = Clock::now() - begin;
+}
+
+bool ChunkStreamer::Wait(std::chrono::nanoseconds timeout) {
+  // a chunk on the way either arrives or is cancelled by Update()
+  if (!ready_.empty() || in_flight_.empty()) {
+    return true;
+  }
+  std::unique_lock lock(arrived_mutex_);
+  return arrived_changed_.wait_for(lock, timeout,
+                                   [this] { return !arrived_.empty(); });
+}
+
+void ChunkStreamer::OnChunkChanged(world::ChunkPos pos) {
+  auto it = loaded_.find(pos);
+  if (it == loaded_.end()) {
+    return;
+  }
+  const size_t memory = it->second.chunk->memory_usage();
+  memory_ = memory_ - it->second.memory + memory;
+  it->second.memory = memory;
+}
+
+world::Chunk *ChunkStreamer::Find(world::ChunkPos pos) noexcept {
+  auto it = loaded_.find(pos);
+  return it != loaded_.end() ? &it->second.chunk->chunk() : nullptr;
+}
+
+world::Chunk const *ChunkStreamer::Find(world::ChunkPos pos) const noexcept {
+  auto it = loaded_.find(pos);
+  return it != loaded_.end() ? &it->second.chunk->chunk() : nullptr;
+}
+
+StreamingStats ChunkStreamer::stats() const {
+  StreamingStats stats;
+  {
+    std::lock_guard lock(arrived_mutex_);
+    stats.arrived = arrived_.size() + ready_.size();
+  }
+  stats.queued = queue_.size();
+  stats.in_flight = in_flight_.size() - stats.arrived;
+  stats.loaded = loaded_.size();
+  stats.memory = memory_;
+  stats.loads = loads_;
+  stats.unloads = unloads_;
+  stats.cancelled = cancelled_;
+  stats.discarded = discarded_;
+  const size_t samples =
+      static_cast<size_t>(std::min<uint64_t>(loads_, kLatencyWindow));
+  for (size_t i = 0; i < samples; i++) {
+    stats.latency_average += latencies_[i];
+    stats.latency_max = std::max(stats.latency_max, latencies_[i]);
+  }
+  if (samples > 0) {
+    stats.latency_average /= samples;
+  }
+  stats.update_time = update_time_;
+  return stats;
+}
+
+float ChunkStreamer::Distance(world::ChunkPos pos) const noexcept {
+  const float dx =
+      static_cast<float>(pos.x * kChunkSize + kChunkSize / 2) - x_;
+  const float dz =
+      static_cast<float>(pos.z * kChunkSize + kChunkSize / 2) - z_;
+  return std::hypot(dx, dz) / kChunkSize;
+}
+
+void ChunkStreamer::Plan() {
+  const world::ChunkPos center =
+      world::ToChunkPos(static_cast<int32_t>(std::floor(x_)),
+                        static_cast<int32_t>(std::floor(z_)));
+  if (planned_ && center == planned_center_ &&
+      std::hypot(look_x_ - planned_look_x_, look_z_ - planned_look_z_) <
+          kReplanTurn) {
+    return;
+  }
+  planned_ = true;
+  planned_center_ = center;
+  planned_look_x_ = look_x_;
+  planned_look_z_ = look_z_;
+
+  queue_.clear();
+  const auto view = static_cast<float>(settings_.view_distance);
+  // the player may stand anywhere in the center chunk
+  const int32_t radius = settings_.view_distance + 1;
+  for (int32_t dz = -radius; dz <= radius; dz++) {
+    for (int32_t dx = -radius; dx <= radius; dx++) {
+      const world::ChunkPos pos = {center.x + dx, center.z + dz};
+      const float distance = Distance(pos);
+      if (distance > view || loaded_.contains(pos) ||
+          in_flight_.contains(pos)) {
+        continue;
+      }
+      float facing = 0;
+      if (distance > 0) {
+        facing = ((static_cast<float>(pos.x * kChunkSize + kChunkSize / 2) -
+                   x_) * look_x_ +
+                  (static_cast<float>(pos.z * kChunkSize + kChunkSize / 2) -
+                   z_) * look_z_) /
+                 (distance * kChunkSize);
+      }
+      queue_.push_back({distance * (1 - kLookBias * facing), pos});
+    }
+  }
+  // the lowest priority first
+  std::ranges::make_heap(queue_, std::greater<>{}, &Candidate::priority);
+}
+
+void ChunkStreamer::CancelOutOfRange() {
+  const auto range =
+      static_cast<float>(settings_.view_distance + settings_.unload_margin);
+  for (auto it = in_flight_.begin(); it != in_flight_.end();) {
+    // fails for the chunks that were handed out already, they are discarded
+    // when they are loaded
+    if (Distance(it->first) > range && pipeline_.Cancel(it->first)) {
+      cancelled_++;
+      it = in_flight_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void ChunkStreamer::Load() {
+  {
+    std::lock_guard lock(arrived_mutex_);
+    std::ranges::move(arrived_, std::back_inserter(ready_));
+    arrived_.clear();
+  }
+  const auto begin = Clock::now();
+  const auto range =
+      static_cast<float>(settings_.view_distance + settings_.unload_margin);
+  size_t taken = 0;
+  while (taken < ready_.size() &&
+         (taken == 0 || Clock::now() - begin < settings_.load_budget)) {
+    std::unique_ptr<ProtoChunk> chunk = std::move(ready_[taken++]);
+    const world::ChunkPos pos = chunk->pos();
+    auto requested = in_flight_.find(pos);
+    const Clock::duration latency = Clock::now() - requested->second;
+    in_flight_.erase(requested);
+    if (Distance(pos) > range) {
+      discarded_++;
+      continue;
+    }
+    const size_t memory = chunk->memory_usage();
+    memory_ += memory;
+    // a moving average, chunks of the same area take about the same
+    chunk_memory_ = chunk_memory_ > 0 ? (chunk_memory_ * 7 + memory) / 8
+                                      : memory;
+    latencies_[loads_ % kLatencyWindow] = latency;
+    loads_++;
+    Loaded &loaded = loaded_[pos];
+    loaded = {std::move(chunk), memory};
+    if (on_load_) {
+      on_load_(*loaded.chunk);
+    }
+  }
+  ready_.erase(ready_.begin(),
+               ready_.begin() + static_cast<std::ptrdiff_t>(taken));
+}
+
+void ChunkStreamer::UnloadOutOfRange() {
+  const auto range =
+      static_cast<float>(settings_.view_distance + settings_.unload_margin);
+  for (auto it = loaded_.begin(); it != loaded_.end();) {
+    auto next = std::next(it);
+    if (Distance(it->first) > range) {
+      Unload(it);
+    }
+    it = next;
+  }
+  // edits reported by OnChunkChanged() may have grown the loaded chunks
+  while (memory_ > settings_.memory_budget &&
+         Evict(-std::numeric_limits<float>::infinity())) {
+  }
+}
+
+bool ChunkStreamer::Evict(float distance) {
+  auto farthest = loaded_.end();
+  float farthest_distance = distance;
+  for (auto it = loaded_.begin(); it != loaded_.end(); ++it) {
+    const float candidate = Distance(it->first);
+    if (candidate > farthest_distance) {
+      farthest = it;
+      farthest_distance = candidate;
+    }
+  }
+  if (farthest == loaded_.end()) {
+    return false;
+  }
+  Unload(farthest);
+  return true;
+}
+
+void ChunkStreamer::Submit() {
+  const auto view = static_cast<float>(settings_.view_distance);
+  while (!queue_.empty() && in_flight_.size() < max_in_flight_) {
+    const world::ChunkPos pos = queue_.front().pos;
+    const float distance = Distance(pos);
+    // the player moved within the chunk since the queue was built
+    if (distance <= view && !loaded_.contains(pos)) {
+      // nothing to estimate with before the first chunk arrived
+      if (chunk_memory_ == 0 && !in_flight_.empty()) {
+        return;
+      }
+      while (memory_ + (in_flight_.size() + 1) * chunk_memory_ >
+             settings_.memory_budget) {
+        if (!Evict(distance)) {
+          return;
+        }
+      }
+      in_flight_.emplace(pos, Clock::now());
+      pipeline_.Request(pos);
+    }
+    std::ranges::pop_heap(queue_, std::greater<>{}, &Candidate::priority);
+    queue_.pop_back();
+  }
+}
+
+void ChunkStreamer::Unload(
+    std::unordered_map<world::ChunkPos, Loaded>::iterator it) {
+  if (on_unload_) {
+    on_unload_(*it->second.chunk);
+  }
+  memory_ -= it->second.memory;
+  unloads_++;
+  loaded_.erase(it);
+}
+}  // namespace worldgen
@@ -0,0 +1,185 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "jobs/job-system.hpp"
+#include "world/chunk.hpp"
+#include "world/coordinates.hpp"
+#include "worldgen/chunk-generator.hpp"
+#include "worldgen/generation-pipeline.hpp"
+
+/*
+ * Keeps the chunks around the player loaded while they move.
+ *
+ * Update() runs once per tick on the main thread and never waits for a
+ * chunk:
+ *
+ *   queue      the missing chunks within the view distance, nearest first.
+ *              Chunks in the direction the player looks count as nearer,
+ *              so they appear first when flying. Rebuilt when the player
+ *              enters another chunk or turns.
+ *   in flight  at most max_in_flight chunks are requested from the
+ *              generation pipeline at once, the rest stay queued. Requests
+ *              that left the range are cancelled before they finish.
+ *   arrived    finished chunks wait for the main thread, which hands them
+ *              to on_load for at most load_budget per tick, with the sky
+ *              light and the biomes the pipeline generated.
+ *   loaded     chunks are unloaded once they are unload_margin chunks past
+ *              the view distance, so moving back and forth over a border
+ *              doesn't reload them.
+ *
+ * Loaded chunks plus an estimate for those on the way never exceed the
+ * memory budget: a chunk is only requested if it fits, or if a loaded chunk
+ * farther away can be unloaded to make room. The memory of the loaded chunks
+ * is a running total, counted when they are loaded and when OnChunkChanged()
+ * reports an edit.
+ */
+namespace worldgen {
+struct StreamingSettings {
+  // in chunks, the chunks whose center is within it are loaded
+  int32_t view_distance = 8;
+  int32_t unload_margin = 2;
+  // bytes of loaded and requested chunks
+  size_t memory_budget = size_t{256} << 20;
+  // 0 for two per worker
+  size_t max_in_flight = 0;
+  // main thread time per Update() spent in on_load, at least one chunk
+  std::chrono::microseconds load_budget{2000};
+};
+
+struct StreamingStats {
+  // in range, not requested yet
+  size_t queued = 0;
+  // requested, not generated yet
+  size_t in_flight = 0;
+  // generated, waiting for the main thread
+  size_t arrived = 0;
+  size_t loaded = 0;
+  // bytes held by the loaded chunks
+  size_t memory = 0;
+  uint64_t loads = 0;
+  uint64_t unloads = 0;
+  // requests withdrawn from the pipeline, and chunks that were out of range
+  // by the time they arrived
+  uint64_t cancelled = 0;
+  uint64_t discarded = 0;
+  // from the request to on_load, over the last kLatencyWindow chunks
+  std::chrono::nanoseconds latency_average{0};
+  std::chrono::nanoseconds latency_max{0};
+  // main thread time of the last Update()
+  std::chrono::nanoseconds update_time{0};
+};
+
+class ChunkStreamer final {
+ public:
+  using ChunkCallback = std::function<void(ProtoChunk &)>;
+  static constexpr size_t kLatencyWindow = 256;
+
+  // Both callbacks are called from Update(). on_unload gets the chunk just
+  // before it is freed.
+  ChunkStreamer(ChunkGenerator const &generator, jobs::JobSystem &jobs,
+                StreamingSettings settings, ChunkCallback on_load = {},
+                ChunkCallback on_unload = {});
+  // Drops the chunks on the way, without calling on_unload for the loaded
+  // ones.
+  ~ChunkStreamer() = default;
+  ChunkStreamer(ChunkStreamer const &) = delete;
+  ChunkStreamer &operator=(ChunkStreamer const &) = delete;
+
+  // Block coordinates of the player and the horizontal direction they look
+  // at, which doesn't need to be normalized. Rethrows the first exception
+  // thrown by a generation stage.
+  void Update(float x, float z, float look_x, float look_z);
+  // Blocks until a generated chunk waits for Update(), or nothing is on the
+  // way. Returns false if the timeout passed first.
+  bool Wait(std::chrono::nanoseconds timeout);
+  // Counts the memory of a loaded chunk again after it was edited.
+  void OnChunkChanged(world::ChunkPos pos);
+
+  // nullptr if the chunk isn't loaded.
+  [[nodiscard]] world::Chunk *Find(world::ChunkPos pos) noexcept;
+  [[nodiscard]] world::Chunk const *Find(world::ChunkPos pos) const noexcept;
+  template <typename Function>
+  void ForEachLoaded(Function &&function) const {
+    for (auto const &[pos, loaded] : loaded_) {
+      function(static_cast<world::Chunk const &>(loaded.chunk->chunk()));
+    }
+  }
+
+  [[nodiscard]] StreamingStats stats() const;
+  [[nodiscard]] StreamingSettings const &settings() const noexcept {
+    return settings_;
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Candidate {
+    float priority;
+    world::ChunkPos pos;
+  };
+  struct Loaded {
+    std::unique_ptr<ProtoChunk> chunk;
+    size_t memory = 0;
+  };
+
+  // in chunks, from the player to the center of the chunk
+  [[nodiscard]] float Distance(world::ChunkPos pos) const noexcept;
+  void Plan();
+  void CancelOutOfRange();
+  void Load();
+  void UnloadOutOfRange();
+  // Unloads the farthest chunk if it is farther than distance.
+  bool Evict(float distance);
+  void Submit();
+  void Unload(std::unordered_map<world::ChunkPos, Loaded>::iterator it);
+
+  StreamingSettings settings_;
+  size_t max_in_flight_;
+  ChunkCallback on_load_;
+  ChunkCallback on_unload_;
+
+  float x_ = 0;
+  float z_ = 0;
+  // normalized, zero when the player looks straight up or down
+  float look_x_ = 0;
+  float look_z_ = 0;
+  // what the queue was built for
+  world::ChunkPos planned_center_;
+  float planned_look_x_ = 0;
+  float planned_look_z_ = 0;
+  bool planned_ = false;
+
+  // a min-heap on priority
+  std::vector<Candidate> queue_;
+  // requested chunks, arrived or not, and when they were requested
+  std::unordered_map<world::ChunkPos, Clock::time_point> in_flight_;
+  std::unordered_map<world::ChunkPos, Loaded> loaded_;
+  size_t memory_ = 0;
+  // what the next chunk is expected to take, 0 until one arrived
+  size_t chunk_memory_ = 0;
+  std::vector<std::unique_ptr<ProtoChunk>> ready_;
+
+  std::array<std::chrono::nanoseconds, kLatencyWindow> latencies_{};
+  uint64_t loads_ = 0;
+  uint64_t unloads_ = 0;
+  uint64_t cancelled_ = 0;
+  uint64_t discarded_ = 0;
+  std::chrono::nanoseconds update_time_{0};
+
+  // filled from the worker threads
+  mutable std::mutex arrived_mutex_;
+  std::condition_variable arrived_changed_;
+  std::vector<std::unique_ptr<ProtoChunk>> arrived_;
+  // last, destroyed first: it waits for the stages that still deliver
+  GenerationPipeline pipeline_;
+};
+}  // namespace worldgen
@@ -0,0 +1,315 @@
+#include "generation-pipeline.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace worldgen {
+namespace {
+// The highest status any planned stage of a neighbour needs.
+template <typename Pins>
+ChunkStatus Needed(Pins const &pins) noexcept {
+  for (size_t status = pins.size(); status-- > 0;) {
+    if (pins[status] > 0) {
+      return static_cast<ChunkStatus>(status);
+    }
+  }
+  return ChunkStatus::kEmpty;
+}
+}  // namespace
+
+GenerationPipeline::GenerationPipeline(ChunkGenerator const &generator,
+                                       jobs::JobSystem &jobs,
+                                       ChunkCallback on_chunk,
+                                       jobs::Priority priority)
+    : generator_(generator),
+      jobs_(jobs),
+      on_chunk_(std::move(on_chunk)),
+      priority_(priority) {}
+
+GenerationPipeline::~GenerationPipeline() {
+  std::unique_lock lock(mutex_);
+  closing_ = true;
+  changed_.wait(lock, [this] { return running_ == 0; });
+}
+
+void GenerationPipeline::Request(world::ChunkPos pos) {
+  std::vector<world::ChunkPos> touched;
+  std::vector<Task> tasks;
+  {
+    std::lock_guard lock(mutex_);
+    Require(pos, ChunkStatus::kFull, touched);
+    Entry &entry = entries_.at(pos);
+    if (!entry.requested) {
+      entry.requested = true;
+      pending_++;
+    }
+    Collect(touched, tasks);
+  }
+  Start(tasks);
+}
+
+bool GenerationPipeline::Cancel(world::ChunkPos pos) {
+  std::vector<world::ChunkPos> touched;
+  std::vector<std::unique_ptr<ProtoChunk>> finished;
+  {
+    std::lock_guard lock(mutex_);
+    auto it = entries_.find(pos);
+    if (it == entries_.end() || !it->second.requested) {
+      return false;
+    }
+    it->second.requested = false;
+    pending_--;
+    cancelled_++;
+    touched.push_back(pos);
+    Unplan(pos, touched);
+    for (world::ChunkPos chunk : touched) {
+      Retire(chunk, finished);
+    }
+  }
+  // only requested chunks are handed out
+  changed_.notify_all();
+  return true;
+}
+
+void GenerationPipeline::Wait(size_t max_pending) {
+  std::unique_lock lock(mutex_);
+  changed_.wait(lock,
+                [&] { return error_ != nullptr || pending_ <= max_pending; });
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+size_t GenerationPipeline::pending() const {
+  std::lock_guard lock(mutex_);
+  return pending_;
+}
+
+size_t GenerationPipeline::resident() const {
+  std::lock_guard lock(mutex_);
+  return entries_.size();
+}
+
+uint64_t GenerationPipeline::cancelled() const {
+  std::lock_guard lock(mutex_);
+  return cancelled_;
+}
+
+std::array<uint64_t, kChunkStatusCount> GenerationPipeline::stages_run()
+    const {
+  std::lock_guard lock(mutex_);
+  return stages_run_;
+}
+
+void GenerationPipeline::Require(world::ChunkPos pos, ChunkStatus status,
+                                 std::vector<world::ChunkPos> &touched) {
+  // references to unordered_map elements survive rehashing
+  Entry &entry = entries_[pos];
+  if (!entry.chunk) {
+    entry.chunk = std::make_unique<ProtoChunk>(pos);
+  }
+  if (entry.target >= status) {
+    return;
+  }
+  touched.push_back(pos);
+  while (entry.target < status) {
+    const ChunkStatus stage = Next(entry.target);
+    // set first, the neighbours may require this chunk at a lower status
+    entry.target = stage;
+    ForEachNeighbor(pos, StageRadius(stage), [&](world::ChunkPos neighbor) {
+      Require(neighbor, Previous(stage), touched);
+      entries_.at(neighbor).pins[static_cast<size_t>(Previous(stage))]++;
+    });
+  }
+}
+
+void GenerationPipeline::Unplan(world::ChunkPos pos,
+                                std::vector<world::ChunkPos> &touched) {
+  Entry &entry = entries_.at(pos);
+  // a running stage can't be taken back
+  const ChunkStatus started = entry.running ? Next(entry.status) : entry.status;
+  const ChunkStatus target = std::max(
+      {entry.requested ? ChunkStatus::kFull : ChunkStatus::kEmpty,
+       Needed(entry.pins), started});
+  if (target >= entry.target) {
+    return;
+  }
+  touched.push_back(pos);
+  const ChunkStatus planned = entry.target;
+  // set first, the neighbours may unplan this chunk again
+  entry.target = target;
+  for (ChunkStatus stage = planned; stage > target; stage = Previous(stage)) {
+    ForEachNeighbor(pos, StageRadius(stage), [&](world::ChunkPos neighbor) {
+      entries_.at(neighbor).pins[static_cast<size_t>(Previous(stage))]--;
+      Unplan(neighbor, touched);
+    });
+  }
+}
+
+void GenerationPipeline::Collect(std::vector<world::ChunkPos> const &positions,
+                                 std::vector<Task> &tasks) {
+  if (closing_ || error_) {
+    return;
+  }
+  for (world::ChunkPos pos : positions) {
+    auto it = entries_.find(pos);
+    if (it == entries_.end()) {
+      continue;
+    }
+    Entry &entry = it->second;
+    if (entry.running || entry.status >= entry.target) {
+      continue;
+    }
+    const ChunkStatus stage = Next(entry.status);
+    const int32_t radius = StageRadius(stage);
+    bool ready = true;
+    std::array<ProtoChunk *, ChunkNeighborhood::kWidth *
+                                 ChunkNeighborhood::kWidth>
+        chunks{};
+    for (int32_t dz = -radius; dz <= radius && ready; dz++) {
+      for (int32_t dx = -radius; dx <= radius; dx++) {
+        // pinned by this stage, so it exists
+        Entry &neighbor = entries_.at({pos.x + dx, pos.z + dz});
+        if (neighbor.status < entry.status) {
+          ready = false;
+          break;
+        }
+        chunks[static_cast<size_t>((dz + kMaxStageRadius) *
+                                       ChunkNeighborhood::kWidth +
+                                   dx + kMaxStageRadius)] =
+            neighbor.chunk.get();
+      }
+    }
+    if (ready) {
+      entry.running = true;
+      running_++;
+      tasks.push_back({&entry, stage, ChunkNeighborhood(chunks)});
+    }
+  }
+}
+
+void GenerationPipeline::Retire(
+    world::ChunkPos pos, std::vector<std::unique_ptr<ProtoChunk>> &finished) {
+  auto it = entries_.find(pos);
+  if (it == entries_.end()) {
+    return;
+  }
+  Entry &entry = it->second;
+  if (entry.running || entry.status < entry.target ||
+      std::ranges::any_of(entry.pins, [](uint32_t pins) { return pins > 0; })) {
+    return;
+  }
+  if (entry.requested) {
+    finished.push_back(std::move(entry.chunk));
+  }
+  entries_.erase(it);
+}
+
+void GenerationPipeline::Start(std::vector<Task> &tasks) {
+  for (Task const &task : tasks) {
+    jobs_.Schedule([this, task] { Run(task); }, priority_);
+  }
+  tasks.clear();
+}
+
+void GenerationPipeline::Run(Task const &task) {
+  std::exception_ptr error;
+  try {
+    generator_.Run(task.status, task.chunks);
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  std::vector<world::ChunkPos> touched;
+  std::vector<Task> tasks;
+  std::vector<std::unique_ptr<ProtoChunk>> finished;
+  {
+    std::lock_guard lock(mutex_);
+    Entry &entry = *task.entry;
+    const world::ChunkPos pos = entry.chunk->pos();
+    entry.running = false;
+    if (error) {
+      if (!error_) {
+        error_ = error;
+      }
+    } else {
+      entry.status = task.status;
+      stages_run_[static_cast<size_t>(task.status)]++;
+    }
+
+    // chunks around may have waited for this one
+    touched.push_back(pos);
+    ForEachNeighbor(pos, kMaxStageRadius,
+                    [&](world::ChunkPos neighbor) {
+                      touched.push_back(neighbor);
+                    });
+    Collect(touched, tasks);
+
+    if (!error) {
+      std::vector<world::ChunkPos> released = {pos};
+      ForEachNeighbor(pos, StageRadius(task.status),
+                      [&](world::ChunkPos neighbor) {
+                        entries_.at(neighbor)
+                            .pins[static_cast<size_t>(Previous(task.status))]--;
+                        released.push_back(neighbor);
+                        // planned stages only a cancelled chunk needed
+                        Unplan(neighbor, released);
+                      });
+      Unplan(pos, released);
+      for (world::ChunkPos chunk : released) {
+        Retire(chunk, finished);
+      }
+    }
+  }
+  Start(tasks);
+
+  for (auto &chunk : finished) {
+    on_chunk_(std::move(chunk));
+  }
+  std::lock_guard lock(mutex_);
+  pending_ -= finished.size();
+  // only now, the destructor waits for this
+  running_--;
+  changed_.notify_all();
+}
+
+PregenerationStats Pregenerate(ChunkGenerator const &generator,
+                               jobs::JobSystem &jobs, world::ChunkPos center,
+                               int32_t radius,
+                               GenerationPipeline::ChunkCallback on_chunk) {
+  PregenerationStats stats;
+  std::atomic<size_t> chunks = 0;
+  const auto begin = std::chrono::steady_clock::now();
+  {
+    GenerationPipeline pipeline(
+        generator, jobs,
+        [&](std::unique_ptr<ProtoChunk> chunk) {
+          chunks++;
+          if (on_chunk) {
+            on_chunk(std::move(chunk));
+          }
+        },
+        jobs::Priority::kNormal);
+    // Ring r holds 8r chunks. Its neighbours in the next ring must be
+    // requested before it finishes, or they are generated twice, so three
+    // rings stay in flight, and enough chunks to keep every worker busy.
+    const size_t busy = 8 * (jobs.worker_count() + 1);
+    for (int32_t ring = 0; ring <= radius; ring++) {
+      pipeline.Wait(std::max(busy, static_cast<size_t>(16 * ring)));
+      for (int32_t dz = -ring; dz <= ring; dz++) {
+        for (int32_t dx = -ring; dx <= ring; dx++) {
+          if (std::max(std::abs(dx), std::abs(dz)) == ring) {
+            pipeline.Request({center.x + dx, center.z + dz});
+          }
+        }
+      }
+    }
+    pipeline.Wait();
+    stats.stages_run = pipeline.stages_run();
+  }
+  stats.chunks = chunks;
+  stats.time = std::chrono::steady_clock::now() - begin;
+  return stats;
+}
+}  // namespace worldgen
@@ -0,0 +1,151 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "jobs/job-system.hpp"
+#include "world/coordinates.hpp"
+#include "worldgen/chunk-generator.hpp"
+#include "worldgen/proto-chunk.hpp"
+
+/*
+ * Moves chunks through the generation stages on the job system.
+ *
+ * Request() asks for a finished chunk. The pipeline plans the status every
+ * chunk around it needs: a full chunk needs its neighbours at features,
+ * those need theirs at surface for the trees, and so on, so proto-chunks are
+ * created for them as well. A stage is scheduled as soon as the neighbours
+ * in its radius reached the previous status, and a chunk runs one stage at a
+ * time.
+ *
+ * Every planned stage pins the neighbours it reads. A chunk that reached its
+ * planned status and isn't pinned anymore leaves the pipeline: requested
+ * chunks are handed to the callback, the others are dropped. A dropped chunk
+ * that is needed again later is generated again, with the same result.
+ *
+ * Cancel() withdraws a request. The stages that didn't start yet are taken
+ * back, along with the stages of the neighbours that only this chunk needed,
+ * and chunks that aren't needed anymore leave the pipeline right away.
+ *
+ * The bookkeeping runs under one mutex, the stages without it. The callback
+ * is called from the worker threads.
+ */
+namespace worldgen {
+class GenerationPipeline final {
+ public:
+  using ChunkCallback = std::function<void(std::unique_ptr<ProtoChunk>)>;
+
+  GenerationPipeline(ChunkGenerator const &generator, jobs::JobSystem &jobs,
+                     ChunkCallback on_chunk,
+                     jobs::Priority priority = jobs::Priority::kLow);
+  // Waits for the running stages, unfinished chunks are dropped.
+  ~GenerationPipeline();
+  GenerationPipeline(GenerationPipeline const &) = delete;
+  GenerationPipeline &operator=(GenerationPipeline const &) = delete;
+
+  // Generates the chunk up to ChunkStatus::kFull. Requesting a chunk that
+  // is still being generated does nothing.
+  void Request(world::ChunkPos pos);
+  // Returns false if the chunk wasn't requested or was already handed out.
+  bool Cancel(world::ChunkPos pos);
+  // Blocks until at most max_pending requested chunks weren't handed out.
+  // Rethrows the first exception thrown by a stage.
+  void Wait(size_t max_pending = 0);
+
+  // requested chunks that weren't handed out yet
+  [[nodiscard]] size_t pending() const;
+  // proto-chunks held, requested or not
+  [[nodiscard]] size_t resident() const;
+  [[nodiscard]] uint64_t cancelled() const;
+  // how often the stage producing each status ran, chunks generated again
+  // count twice
+  [[nodiscard]] std::array<uint64_t, kChunkStatusCount> stages_run() const;
+
+ private:
+  struct Entry {
+    std::unique_ptr<ProtoChunk> chunk;
+    ChunkStatus status = ChunkStatus::kEmpty;
+    // the status the chunk is generated up to
+    ChunkStatus target = ChunkStatus::kEmpty;
+    // planned stages of neighbours reading this chunk, by the status they
+    // need it at
+    std::array<uint32_t, kChunkStatusCount> pins{};
+    bool running = false;
+    bool requested = false;
+  };
+  struct Task {
+    Entry *entry;
+    ChunkStatus status;
+    ChunkNeighborhood chunks;
+  };
+
+  template <typename Function>
+  static void ForEachNeighbor(world::ChunkPos pos, int32_t radius,
+                              Function &&function) {
+    for (int32_t dz = -radius; dz <= radius; dz++) {
+      for (int32_t dx = -radius; dx <= radius; dx++) {
+        if (dx != 0 || dz != 0) {
+          function(world::ChunkPos{pos.x + dx, pos.z + dz});
+        }
+      }
+    }
+  }
+
+  void Require(world::ChunkPos pos, ChunkStatus status,
+               std::vector<world::ChunkPos> &touched);
+  // Lowers the target to what the chunk is still needed for.
+  void Unplan(world::ChunkPos pos, std::vector<world::ChunkPos> &touched);
+  // Marks the chunks that can run their next stage as running.
+  void Collect(std::vector<world::ChunkPos> const &positions,
+               std::vector<Task> &tasks);
+  // Removes the chunk if nothing needs it anymore.
+  void Retire(world::ChunkPos pos,
+              std::vector<std::unique_ptr<ProtoChunk>> &finished);
+  void Start(std::vector<Task> &tasks);
+  void Run(Task const &task);
+
+  ChunkGenerator const &generator_;
+  jobs::JobSystem &jobs_;
+  ChunkCallback on_chunk_;
+  jobs::Priority priority_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable changed_;
+  std::unordered_map<world::ChunkPos, Entry> entries_;
+  size_t pending_ = 0;
+  size_t running_ = 0;
+  uint64_t cancelled_ = 0;
+  std::array<uint64_t, kChunkStatusCount> stages_run_{};
+  std::exception_ptr error_;
+  bool closing_ = false;
+};
+
+struct PregenerationStats {
+  size_t chunks = 0;
+  std::chrono::nanoseconds time{0};
+  std::array<uint64_t, kChunkStatusCount> stages_run{};
+
+  [[nodiscard]] double chunks_per_second() const noexcept {
+    return time.count() > 0 ? static_cast<double>(chunks) * 1e9 /
+                                  static_cast<double>(time.count())
+                            : 0;
+  }
+};
+
+// Generates every chunk in the square of the given radius around the center
+// and hands them to on_chunk, which may be empty. Chunks are requested ring
+// by ring, a few rings ahead of the finished ones, so the memory held stays
+// proportional to the radius rather than the area.
+PregenerationStats Pregenerate(
+    ChunkGenerator const &generator, jobs::JobSystem &jobs,
+    world::ChunkPos center, int32_t radius,
+    GenerationPipeline::ChunkCallback on_chunk = {});
+}  // namespace worldgen
@@ -0,0 +1,64 @@
+#include "noise-kernels.hpp"
+
+// Compiled with AVX2 enabled (see CMakeLists.txt), only called once
+// DetectSimdLevel found AVX2.
+#if UTILS_SIMD_X86
+#include <immintrin.h>
+
+namespace worldgen::detail {
+namespace {
+struct Avx2Ops {
+  static constexpr size_t kWidth = 8;
+  using Float = __m256;
+  using Int = __m256i;
+
+  static Float Set(float value) { return _mm256_set1_ps(value); }
+  static Int SetI(int32_t value) { return _mm256_set1_epi32(value); }
+  static Float Load(float const *in) { return _mm256_loadu_ps(in); }
+  static void Store(float *out, Float value) { _mm256_storeu_ps(out, value); }
+  static Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+  static Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+  static Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+  // the same truncation as SSE2 rather than _mm256_floor_ps, which keeps
+  // the sign of -0
+  static Float Floor(Float x) {
+    const __m256 truncated = _mm256_cvtepi32_ps(_mm256_cvttps_epi32(x));
+    const __m256 above = _mm256_cmp_ps(truncated, x, _CMP_GT_OQ);
+    return _mm256_sub_ps(truncated, _mm256_and_ps(above, _mm256_set1_ps(1)));
+  }
+  static Int ToInt(Float x) { return _mm256_cvttps_epi32(x); }
+  static Int AddI(Int a, Int b) { return _mm256_add_epi32(a, b); }
+  static Int MulI(Int a, Int b) { return _mm256_mullo_epi32(a, b); }
+  static Int Xor(Int a, Int b) { return _mm256_xor_si256(a, b); }
+  static Int And(Int a, Int b) { return _mm256_and_si256(a, b); }
+  static Int Or(Int a, Int b) { return _mm256_or_si256(a, b); }
+  template <int kBits>
+  static Int ShiftLeft(Int a) {
+    return _mm256_slli_epi32(a, kBits);
+  }
+  template <int kBits>
+  static Int ShiftRight(Int a) {
+    return _mm256_srli_epi32(a, kBits);
+  }
+  static Int Less(Int a, Int b) { return _mm256_cmpgt_epi32(b, a); }
+  static Int Equal(Int a, Int b) { return _mm256_cmpeq_epi32(a, b); }
+  static Float Select(Int mask, Float a, Float b) {
+    return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask));
+  }
+  static Float FlipSign(Float f, Int bits) {
+    return _mm256_xor_ps(f, _mm256_castsi256_ps(bits));
+  }
+};
+}  // namespace
+
+void Fractal2Avx2(Fractal const &fractal, float const *x, float const *z,
+                  float *out, size_t count) {
+  Fractal2<Avx2Ops>(fractal, x, z, out, count);
+}
+
+void Fractal3Avx2(Fractal const &fractal, float const *x, float const *y,
+                  float const *z, float *out, size_t count) {
+  Fractal3<Avx2Ops>(fractal, x, y, z, out, count);
+}
+}  // namespace worldgen::detail
+#endif
@@ -0,0 +1,249 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/simd.hpp"
+
+/*
+ * Noise kernels shared by the scalar, SSE2 and AVX2 builds in noise.cpp and
+ * noise-avx2.cpp. Only include it from those files: the AVX2 file is
+ * compiled with AVX2 enabled, so the kernels live in an anonymous namespace
+ * and every file gets its own copy.
+ *
+ * A backend V provides:
+ *   kWidth                      lanes per vector
+ *   Float, Int                  vectors of float and 32-bit integers, masks
+ *                               are Int with all bits set or clear
+ *   Set, SetI, Load, Store      broadcast and unaligned memory access
+ *   Add, Sub, Mul               float arithmetic, never fused
+ *   Floor, ToInt                floor for |x| < 2^31, truncating conversion;
+ *                               beyond that and for NaN both give -2^31, the
+ *                               result of the x86 conversions
+ *   AddI, MulI, Xor, And, Or    integer arithmetic, wrapping
+ *   ShiftLeft, ShiftRight       logical shifts by a constant
+ *   Less, Equal                 signed integer comparisons giving a mask
+ *   Select(mask, a, b)          a where the mask is set, b elsewhere
+ *   FlipSign(f, bits)           f with its sign bit xored with bit 31
+ */
+namespace worldgen::detail {
+struct Fractal {
+  int32_t seed;
+  uint32_t octaves;
+  float frequency;
+  float lacunarity;
+  float gain;
+  float normalize;
+};
+
+#if UTILS_SIMD_X86
+void Fractal2Avx2(Fractal const &fractal, float const *x, float const *z,
+                  float *out, size_t count);
+void Fractal3Avx2(Fractal const &fractal, float const *x, float const *y,
+                  float const *z, float *out, size_t count);
+#endif
+
+namespace {
+constexpr int32_t kPrimeX = 501125321;
+constexpr int32_t kPrimeY = 1136930381;
+constexpr int32_t kPrimeZ = 1720413743;
+constexpr int32_t kHashMultiplier = 0x27d4eb2d;
+// bring the extremes of the gradient sets close to +-1, 2D peaks near 1.51
+constexpr float kScale2 = 0.65f;
+constexpr float kScale3 = 0.9649214f;
+
+template <typename V>
+typename V::Int Hash(typename V::Int seed, typename V::Int x,
+                     typename V::Int y, typename V::Int z) {
+  typename V::Int hash = V::Xor(V::Xor(seed, x), V::Xor(y, z));
+  hash = V::MulI(hash, V::SetI(kHashMultiplier));
+  return V::Xor(hash, V::template ShiftRight<15>(hash));
+}
+
+// Gradients (+-1, +-2) and (+-2, +-1), picked by the low three bits.
+template <typename V>
+typename V::Float Gradient2(typename V::Int hash, typename V::Float x,
+                            typename V::Float y) {
+  const typename V::Int h = V::And(hash, V::SetI(7));
+  const typename V::Int first = V::Less(h, V::SetI(4));
+  const typename V::Float u = V::Select(first, x, y);
+  const typename V::Float v = V::Select(first, y, x);
+  return V::Add(
+      V::FlipSign(u, V::template ShiftLeft<31>(h)),
+      V::FlipSign(V::Add(v, v),
+                  V::template ShiftLeft<31>(V::template ShiftRight<1>(h))));
+}
+
+// The twelve cube edge gradients of improved Perlin noise, four of them
+// twice to fill the low four bits.
+template <typename V>
+typename V::Float Gradient3(typename V::Int hash, typename V::Float x,
+                            typename V::Float y, typename V::Float z) {
+  const typename V::Int h = V::And(hash, V::SetI(15));
+  const typename V::Float u = V::Select(V::Less(h, V::SetI(8)), x, y);
+  const typename V::Int x_axis =
+      V::Or(V::Equal(h, V::SetI(12)), V::Equal(h, V::SetI(14)));
+  const typename V::Float v =
+      V::Select(V::Less(h, V::SetI(4)), y, V::Select(x_axis, x, z));
+  return V::Add(
+      V::FlipSign(u, V::template ShiftLeft<31>(h)),
+      V::FlipSign(v, V::template ShiftLeft<31>(V::template ShiftRight<1>(h))));
+}
+
+// 6t^5 - 15t^4 + 10t^3
+template <typename V>
+typename V::Float Fade(typename V::Float t) {
+  const typename V::Float inner =
+      V::Add(V::Mul(t, V::Sub(V::Mul(t, V::Set(6)), V::Set(15))), V::Set(10));
+  return V::Mul(V::Mul(V::Mul(t, t), t), inner);
+}
+
+template <typename V>
+typename V::Float Lerp(typename V::Float t, typename V::Float a,
+                       typename V::Float b) {
+  return V::Add(a, V::Mul(t, V::Sub(b, a)));
+}
+
+template <typename V>
+typename V::Float Perlin2(typename V::Float x, typename V::Float y,
+                          typename V::Int seed) {
+  using Float = typename V::Float;
+  using Int = typename V::Int;
+  const Float x0 = V::Floor(x);
+  const Float y0 = V::Floor(y);
+  const Float fx0 = V::Sub(x, x0);
+  const Float fy0 = V::Sub(y, y0);
+  const Float fx1 = V::Sub(fx0, V::Set(1));
+  const Float fy1 = V::Sub(fy0, V::Set(1));
+  const Int px0 = V::MulI(V::ToInt(x0), V::SetI(kPrimeX));
+  const Int py0 = V::MulI(V::ToInt(y0), V::SetI(kPrimeY));
+  const Int px1 = V::AddI(px0, V::SetI(kPrimeX));
+  const Int py1 = V::AddI(py0, V::SetI(kPrimeY));
+  // the z term of the hash is unused in 2D
+  const Int none = V::SetI(0);
+
+  const Float u = Fade<V>(fx0);
+  const Float v = Fade<V>(fy0);
+  const Float bottom =
+      Lerp<V>(u, Gradient2<V>(Hash<V>(seed, px0, py0, none), fx0, fy0),
+              Gradient2<V>(Hash<V>(seed, px1, py0, none), fx1, fy0));
+  const Float top =
+      Lerp<V>(u, Gradient2<V>(Hash<V>(seed, px0, py1, none), fx0, fy1),
+              Gradient2<V>(Hash<V>(seed, px1, py1, none), fx1, fy1));
+  return V::Mul(Lerp<V>(v, bottom, top), V::Set(kScale2));
+}
+
+template <typename V>
+typename V::Float Perlin3(typename V::Float x, typename V::Float y,
+                          typename V::Float z, typename V::Int seed) {
+  using Float = typename V::Float;
+  using Int = typename V::Int;
+  const Float x0 = V::Floor(x);
+  const Float y0 = V::Floor(y);
+  const Float z0 = V::Floor(z);
+  const Float fx0 = V::Sub(x, x0);
+  const Float fy0 = V::Sub(y, y0);
+  const Float fz0 = V::Sub(z, z0);
+  const Float fx1 = V::Sub(fx0, V::Set(1));
+  const Float fy1 = V::Sub(fy0, V::Set(1));
+  const Float fz1 = V::Sub(fz0, V::Set(1));
+  const Int px0 = V::MulI(V::ToInt(x0), V::SetI(kPrimeX));
+  const Int py0 = V::MulI(V::ToInt(y0), V::SetI(kPrimeY));
+  const Int pz0 = V::MulI(V::ToInt(z0), V::SetI(kPrimeZ));
+  const Int px1 = V::AddI(px0, V::SetI(kPrimeX));
+  const Int py1 = V::AddI(py0, V::SetI(kPrimeY));
+  const Int pz1 = V::AddI(pz0, V::SetI(kPrimeZ));
+
+  // the edge along x at (y, z)
+  auto edge = [&](Float u, Int py, Int pz, Float fy, Float fz) {
+    return Lerp<V>(u, Gradient3<V>(Hash<V>(seed, px0, py, pz), fx0, fy, fz),
+                   Gradient3<V>(Hash<V>(seed, px1, py, pz), fx1, fy, fz));
+  };
+  const Float u = Fade<V>(fx0);
+  const Float v = Fade<V>(fy0);
+  const Float w = Fade<V>(fz0);
+  const Float near = Lerp<V>(v, edge(u, py0, pz0, fy0, fz0),
+                             edge(u, py1, pz0, fy1, fz0));
+  const Float far = Lerp<V>(v, edge(u, py0, pz1, fy0, fz1),
+                            edge(u, py1, pz1, fy1, fz1));
+  return V::Mul(Lerp<V>(w, near, far), V::Set(kScale3));
+}
+
+// Runs sample(lane coordinates) over count points, the last vector is
+// padded with zeros and only partially stored.
+template <typename V, size_t kDimensions, typename Sample>
+void ForEachVector(float const *const (&in)[kDimensions], float *out,
+                   size_t count, Sample &&sample) {
+  typename V::Float lanes[kDimensions];
+  size_t i = 0;
+  for (; i + V::kWidth <= count; i += V::kWidth) {
+    for (size_t d = 0; d < kDimensions; d++) {
+      lanes[d] = V::Load(in[d] + i);
+    }
+    V::Store(out + i, sample(lanes));
+  }
+  if (i == count) {
+    return;
+  }
+  float padded[kDimensions][V::kWidth] = {};
+  for (size_t d = 0; d < kDimensions; d++) {
+    for (size_t lane = 0; i + lane < count; lane++) {
+      padded[d][lane] = in[d][i + lane];
+    }
+    lanes[d] = V::Load(padded[d]);
+  }
+  float result[V::kWidth];
+  V::Store(result, sample(lanes));
+  for (size_t lane = 0; i + lane < count; lane++) {
+    out[i + lane] = result[lane];
+  }
+}
+
+// The octaves are summed from the first to the last, the amplitudes and
+// frequencies are computed in scalar code so every backend sees the same.
+template <typename V, size_t kDimensions, typename Noise>
+typename V::Float Octaves(Fractal const &fractal,
+                          typename V::Float const (&position)[kDimensions],
+                          Noise &&noise) {
+  typename V::Float sum = V::Set(0);
+  float amplitude = 1;
+  float frequency = fractal.frequency;
+  for (uint32_t octave = 0; octave < fractal.octaves; octave++) {
+    typename V::Float scaled[kDimensions];
+    for (size_t d = 0; d < kDimensions; d++) {
+      scaled[d] = V::Mul(position[d], V::Set(frequency));
+    }
+    const typename V::Int seed =
+        V::SetI(static_cast<int32_t>(static_cast<uint32_t>(fractal.seed) +
+                                     octave));
+    sum = V::Add(sum, V::Mul(noise(scaled, seed), V::Set(amplitude)));
+    amplitude *= fractal.gain;
+    frequency *= fractal.lacunarity;
+  }
+  return V::Mul(sum, V::Set(fractal.normalize));
+}
+
+template <typename V>
+void Fractal2(Fractal const &fractal, float const *x, float const *z,
+              float *out, size_t count) {
+  float const *const in[2] = {x, z};
+  ForEachVector<V>(in, out, count, [&](typename V::Float const(&lanes)[2]) {
+    return Octaves<V>(fractal, lanes,
+                      [](typename V::Float const(&p)[2], typename V::Int seed) {
+                        return Perlin2<V>(p[0], p[1], seed);
+                      });
+  });
+}
+
+template <typename V>
+void Fractal3(Fractal const &fractal, float const *x, float const *y,
+              float const *z, float *out, size_t count) {
+  float const *const in[3] = {x, y, z};
+  ForEachVector<V>(in, out, count, [&](typename V::Float const(&lanes)[3]) {
+    return Octaves<V>(fractal, lanes,
+                      [](typename V::Float const(&p)[3], typename V::Int seed) {
+                        return Perlin3<V>(p[0], p[1], p[2], seed);
+                      });
+  });
+}
+}  // namespace
+}  // namespace worldgen::detail
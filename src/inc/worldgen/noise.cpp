@@ -0,0 +1,273 @@
+#include "noise.hpp"
+
+#include <bit>
+#include <cmath>
+#include <string>
+
+#include "noise-kernels.hpp"
+
+#if UTILS_SIMD_X86
+#include <emmintrin.h>
+#endif
+
+namespace worldgen {
+namespace {
+// coordinates generated per kernel call by the Fill functions
+constexpr size_t kBatch = 256;
+
+struct ScalarOps {
+  static constexpr size_t kWidth = 1;
+  using Float = float;
+  using Int = uint32_t;
+
+  static Float Set(float value) { return value; }
+  static Int SetI(int32_t value) { return static_cast<uint32_t>(value); }
+  static Float Load(float const *in) { return *in; }
+  static void Store(float *out, Float value) { *out = value; }
+  static Float Add(Float a, Float b) { return a + b; }
+  static Float Sub(Float a, Float b) { return a - b; }
+  static Float Mul(Float a, Float b) { return a * b; }
+  // Out of range and NaN give INT32_MIN, like cvttps2dq does, instead of
+  // the undefined conversion.
+  static Float Floor(Float x) {
+    const float truncated = static_cast<float>(static_cast<int32_t>(ToInt(x)));
+    return truncated > x ? truncated - 1 : truncated;
+  }
+  static Int ToInt(Float x) {
+    if (!(x >= -2147483648.0f && x < 2147483648.0f)) {
+      return 0x80000000u;
+    }
+    return static_cast<uint32_t>(static_cast<int32_t>(x));
+  }
+  static Int AddI(Int a, Int b) { return a + b; }
+  static Int MulI(Int a, Int b) { return a * b; }
+  static Int Xor(Int a, Int b) { return a ^ b; }
+  static Int And(Int a, Int b) { return a & b; }
+  static Int Or(Int a, Int b) { return a | b; }
+  template <int kBits>
+  static Int ShiftLeft(Int a) {
+    return a << kBits;
+  }
+  template <int kBits>
+  static Int ShiftRight(Int a) {
+    return a >> kBits;
+  }
+  static Int Less(Int a, Int b) {
+    return static_cast<int32_t>(a) < static_cast<int32_t>(b) ? ~0u : 0u;
+  }
+  static Int Equal(Int a, Int b) { return a == b ? ~0u : 0u; }
+  static Float Select(Int mask, Float a, Float b) { return mask ? a : b; }
+  static Float FlipSign(Float f, Int bits) {
+    return std::bit_cast<float>(std::bit_cast<uint32_t>(f) ^
+                                (bits & 0x80000000u));
+  }
+};
+
+#if UTILS_SIMD_X86
+struct Sse2Ops {
+  static constexpr size_t kWidth = 4;
+  using Float = __m128;
+  using Int = __m128i;
+
+  static Float Set(float value) { return _mm_set1_ps(value); }
+  static Int SetI(int32_t value) { return _mm_set1_epi32(value); }
+  static Float Load(float const *in) { return _mm_loadu_ps(in); }
+  static void Store(float *out, Float value) { _mm_storeu_ps(out, value); }
+  static Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+  static Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+  static Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+  static Float Floor(Float x) {
+    const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    const __m128 above = _mm_cmpgt_ps(truncated, x);
+    return _mm_sub_ps(truncated, _mm_and_ps(above, _mm_set1_ps(1)));
+  }
+  static Int ToInt(Float x) { return _mm_cvttps_epi32(x); }
+  static Int AddI(Int a, Int b) { return _mm_add_epi32(a, b); }
+  // SSE2 only multiplies the even lanes into 64 bits
+  static Int MulI(Int a, Int b) {
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd =
+        _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+  }
+  static Int Xor(Int a, Int b) { return _mm_xor_si128(a, b); }
+  static Int And(Int a, Int b) { return _mm_and_si128(a, b); }
+  static Int Or(Int a, Int b) { return _mm_or_si128(a, b); }
+  template <int kBits>
+  static Int ShiftLeft(Int a) {
+    return _mm_slli_epi32(a, kBits);
+  }
+  template <int kBits>
+  static Int ShiftRight(Int a) {
+    return _mm_srli_epi32(a, kBits);
+  }
+  static Int Less(Int a, Int b) { return _mm_cmplt_epi32(a, b); }
+  static Int Equal(Int a, Int b) { return _mm_cmpeq_epi32(a, b); }
+  static Float Select(Int mask, Float a, Float b) {
+    const __m128 m = _mm_castsi128_ps(mask);
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+  }
+  static Float FlipSign(Float f, Int bits) {
+    return _mm_xor_ps(f, _mm_castsi128_ps(bits));
+  }
+};
+#endif
+
+bool Valid(float value) { return std::isfinite(value) && value > 0; }
+
+detail::Fractal Parameters(NoiseSettings const &settings, float normalize) {
+  return {settings.seed,       settings.octaves, settings.frequency,
+          settings.lacunarity, settings.gain,    normalize};
+}
+}  // namespace
+
+FractalNoise::FractalNoise(NoiseSettings const &settings, SimdLevel level)
+    : settings_(settings), level_(level) {
+  if (settings.octaves == 0 || settings.octaves > kMaxOctaves) {
+    throw NoiseException("noise needs 1 to " + std::to_string(kMaxOctaves) +
+                         " octaves");
+  }
+  if (!Valid(settings.frequency) || !Valid(settings.lacunarity) ||
+      !Valid(settings.gain)) {
+    throw NoiseException(
+        "noise frequency, lacunarity and gain must be positive");
+  }
+  if (!Supported(level)) {
+    throw NoiseException("the CPU does not support " +
+                         std::string(ToString(level)) + " noise");
+  }
+  // the amplitudes exactly as the kernels compute them
+  float amplitude = 1;
+  float total = 0;
+  for (uint32_t octave = 0; octave < settings.octaves; octave++) {
+    total += amplitude;
+    amplitude *= settings.gain;
+  }
+  normalize_ = 1 / total;
+}
+
+float FractalNoise::Sample(float x, float z) const {
+  float out;
+  Run2(&x, &z, &out, 1);
+  return out;
+}
+
+float FractalNoise::Sample(float x, float y, float z) const {
+  float out;
+  Run3(&x, &y, &z, &out, 1);
+  return out;
+}
+
+void FractalNoise::Sample(std::span<const float> x, std::span<const float> z,
+                          std::span<float> out) const {
+  if (x.size() != out.size() || z.size() != out.size()) {
+    throw NoiseException("noise coordinates and output differ in size");
+  }
+  Run2(x.data(), z.data(), out.data(), out.size());
+}
+
+void FractalNoise::Sample(std::span<const float> x, std::span<const float> y,
+                          std::span<const float> z,
+                          std::span<float> out) const {
+  if (x.size() != out.size() || y.size() != out.size() ||
+      z.size() != out.size()) {
+    throw NoiseException("noise coordinates and output differ in size");
+  }
+  Run3(x.data(), y.data(), z.data(), out.data(), out.size());
+}
+
+void FractalNoise::FillGrid(std::array<float, 3> origin,
+                            std::array<uint32_t, 3> size, float step,
+                            std::span<float> out) const {
+  if (out.size() != static_cast<size_t>(size[0]) * size[1] * size[2]) {
+    throw NoiseException("noise grid and output differ in size");
+  }
+  std::array<std::array<float, kBatch>, 3> batch;
+  size_t filled = 0;
+  size_t done = 0;
+  auto flush = [&] {
+    Run3(batch[0].data(), batch[1].data(), batch[2].data(),
+         out.data() + done, filled);
+    done += filled;
+    filled = 0;
+  };
+  for (uint32_t y = 0; y < size[1]; y++) {
+    for (uint32_t z = 0; z < size[2]; z++) {
+      for (uint32_t x = 0; x < size[0]; x++) {
+        batch[0][filled] = origin[0] + static_cast<float>(x) * step;
+        batch[1][filled] = origin[1] + static_cast<float>(y) * step;
+        batch[2][filled] = origin[2] + static_cast<float>(z) * step;
+        if (++filled == kBatch) {
+          flush();
+        }
+      }
+    }
+  }
+  if (filled > 0) {
+    flush();
+  }
+}
+
+void FractalNoise::FillPlane(std::array<float, 2> origin,
+                             std::array<uint32_t, 2> size, float step,
+                             std::span<float> out) const {
+  if (out.size() != static_cast<size_t>(size[0]) * size[1]) {
+    throw NoiseException("noise plane and output differ in size");
+  }
+  std::array<std::array<float, kBatch>, 2> batch;
+  size_t filled = 0;
+  size_t done = 0;
+  auto flush = [&] {
+    Run2(batch[0].data(), batch[1].data(), out.data() + done, filled);
+    done += filled;
+    filled = 0;
+  };
+  for (uint32_t z = 0; z < size[1]; z++) {
+    for (uint32_t x = 0; x < size[0]; x++) {
+      batch[0][filled] = origin[0] + static_cast<float>(x) * step;
+      batch[1][filled] = origin[1] + static_cast<float>(z) * step;
+      if (++filled == kBatch) {
+        flush();
+      }
+    }
+  }
+  if (filled > 0) {
+    flush();
+  }
+}
+
+void FractalNoise::Run2(float const *x, float const *z, float *out,
+                        size_t count) const {
+  const detail::Fractal fractal = Parameters(settings_, normalize_);
+  switch (level_) {
+#if UTILS_SIMD_X86
+    case SimdLevel::kAvx2:
+      detail::Fractal2Avx2(fractal, x, z, out, count);
+      return;
+    case SimdLevel::kSse2:
+      detail::Fractal2<Sse2Ops>(fractal, x, z, out, count);
+      return;
+#endif
+    default:
+      detail::Fractal2<ScalarOps>(fractal, x, z, out, count);
+  }
+}
+
+void FractalNoise::Run3(float const *x, float const *y, float const *z,
+                        float *out, size_t count) const {
+  const detail::Fractal fractal = Parameters(settings_, normalize_);
+  switch (level_) {
+#if UTILS_SIMD_X86
+    case SimdLevel::kAvx2:
+      detail::Fractal3Avx2(fractal, x, y, z, out, count);
+      return;
+    case SimdLevel::kSse2:
+      detail::Fractal3<Sse2Ops>(fractal, x, y, z, out, count);
+      return;
+#endif
+    default:
+      detail::Fractal3<ScalarOps>(fractal, x, y, z, out, count);
+  }
+}
+}  // namespace worldgen
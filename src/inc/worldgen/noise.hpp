@@ -0,0 +1,101 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+
+#include "utils/simd.hpp"
+
+/*
+ * Gradient noise for terrain generation: 2D and 3D Perlin noise summed over
+ * octaves (fBm).
+ *
+ * Noise is evaluated in batches, a whole 16x16 height map, column or
+ * 16x16x16 grid per call. The kernels are written once against a small set
+ * of vector operations and instantiated for plain scalar code, SSE2 and
+ * AVX2; the best level the CPU supports is picked at runtime. Gradients come
+ * from an integer hash of the lattice point instead of a permutation table,
+ * so the vector code never has to gather.
+ *
+ * All levels run the same float operations in the same order, without fused
+ * multiply-adds, so a seed gives bit-identical terrain on every machine.
+ * Values are in [-1, 1].
+ */
+namespace worldgen {
+class NoiseException : public std::runtime_error {
+ public:
+  using std::runtime_error::runtime_error;
+};
+
+using utils::DetectSimdLevel;
+using utils::SimdLevel;
+using utils::Supported;
+using utils::ToString;
+
+// Seeds for independent noise fields of one world seed, so that no two
+// fields share octaves (octave i of a field uses seed + i).
+[[nodiscard]] constexpr int32_t DeriveSeed(int32_t seed,
+                                           uint32_t salt) noexcept {
+  return static_cast<int32_t>(static_cast<uint32_t>(seed) * 0x9E3779B9u +
+                              salt * 0x85EBCA6Bu);
+}
+
+struct NoiseSettings {
+  int32_t seed = 0;
+  // of the first octave, in 1 / blocks
+  float frequency = 1.0f / 64;
+  uint32_t octaves = 4;
+  // frequency and amplitude factor from one octave to the next
+  float lacunarity = 2.0f;
+  float gain = 0.5f;
+};
+
+class FractalNoise final {
+ public:
+  static constexpr uint32_t kMaxOctaves = 16;
+
+  // Throws NoiseException for invalid settings or an unsupported level.
+  explicit FractalNoise(NoiseSettings const &settings,
+                        SimdLevel level = DetectSimdLevel());
+
+  [[nodiscard]] float Sample(float x, float z) const;
+  [[nodiscard]] float Sample(float x, float y, float z) const;
+
+  // out[i] is the noise at (x[i], z[i]) or (x[i], y[i], z[i]), all spans
+  // have the same size.
+  void Sample(std::span<const float> x, std::span<const float> z,
+              std::span<float> out) const;
+  void Sample(std::span<const float> x, std::span<const float> y,
+              std::span<const float> z, std::span<float> out) const;
+
+  // Samples origin + index * step, out is indexed like a ChunkSection:
+  // (y * size z + z) * size x + x.
+  void FillGrid(std::array<float, 3> origin, std::array<uint32_t, 3> size,
+                float step, std::span<float> out) const;
+  // A 2D height map of x and z, out[z * size x + x].
+  void FillPlane(std::array<float, 2> origin, std::array<uint32_t, 2> size,
+                 float step, std::span<float> out) const;
+  // size samples going up from origin.
+  void FillColumn(std::array<float, 3> origin, uint32_t size, float step,
+                  std::span<float> out) const {
+    FillGrid(origin, {1, size, 1}, step, out);
+  }
+
+  [[nodiscard]] NoiseSettings const &settings() const noexcept {
+    return settings_;
+  }
+  [[nodiscard]] SimdLevel level() const noexcept { return level_; }
+
+ private:
+  void Run2(float const *x, float const *z, float *out, size_t count) const;
+  void Run3(float const *x, float const *y, float const *z, float *out,
+            size_t count) const;
+
+  NoiseSettings settings_;
+  SimdLevel level_;
+  // 1 / the sum of the octave amplitudes
+  float normalize_ = 1;
+};
+}  // namespace worldgen
@@ -0,0 +1,149 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "world/chunk.hpp"
+#include "world/nibble-array.hpp"
+#include "worldgen/biome.hpp"
+
+/*
+ * A chunk while it is being generated.
+ *
+ * Generation runs in stages and the status is the last stage a chunk went
+ * through. Some stages read the chunks around it, which then must have
+ * reached the previous status:
+ *
+ *   stage      radius  reads from the neighbours
+ *   biomes     0
+ *   terrain    1       biomes, to blend the terrain shape across borders
+ *   caves      0
+ *   surface    0
+ *   features   1       biomes and height maps, trees cross chunk borders
+ *   light      1       blocks, sky light spreads across borders
+ *
+ * A stage only ever writes its own chunk and only reads neighbour data that
+ * no later stage changes, so the result never depends on which chunks were
+ * generated first or on how many threads did it.
+ */
+namespace worldgen {
+enum class ChunkStatus : uint8_t {
+  kEmpty,
+  kBiomes,
+  kTerrain,
+  kCaves,
+  kSurface,
+  kFeatures,
+  // lit, the chunk is done
+  kFull
+};
+inline constexpr size_t kChunkStatusCount = 7;
+
+// Neighbours in this radius must have the previous status before the stage
+// producing a status can run.
+inline constexpr std::array<int32_t, kChunkStatusCount> kStageRadius = {
+    0, 0, 1, 0, 0, 1, 1};
+inline constexpr int32_t kMaxStageRadius = 1;
+
+[[nodiscard]] constexpr ChunkStatus Next(ChunkStatus status) noexcept {
+  return static_cast<ChunkStatus>(static_cast<uint8_t>(status) + 1);
+}
+[[nodiscard]] constexpr ChunkStatus Previous(ChunkStatus status) noexcept {
+  return static_cast<ChunkStatus>(static_cast<uint8_t>(status) - 1);
+}
+[[nodiscard]] constexpr int32_t StageRadius(ChunkStatus status) noexcept {
+  return kStageRadius[static_cast<size_t>(status)];
+}
+// The name of the stage producing the status.
+[[nodiscard]] constexpr std::string_view StageName(
+    ChunkStatus status) noexcept {
+  switch (status) {
+    case ChunkStatus::kEmpty:
+      return "empty";
+    case ChunkStatus::kBiomes:
+      return "biomes";
+    case ChunkStatus::kTerrain:
+      return "terrain";
+    case ChunkStatus::kCaves:
+      return "caves";
+    case ChunkStatus::kSurface:
+      return "surface";
+    case ChunkStatus::kFeatures:
+      return "features";
+    case ChunkStatus::kFull:
+      return "light";
+  }
+  return "unknown";
+}
+
+class ProtoChunk final {
+ public:
+  // biomes are stored per 4x4 column of blocks
+  static constexpr int32_t kQuartSize = 4;
+  static constexpr int32_t kQuarts = world::kChunkSize / kQuartSize;
+
+  explicit ProtoChunk(world::ChunkPos pos) noexcept : chunk_(pos) {}
+
+  [[nodiscard]] Biome biome(uint32_t quart_x, uint32_t quart_z) const noexcept {
+    return biomes_[quart_z * kQuarts + quart_x];
+  }
+  void set_biome(uint32_t quart_x, uint32_t quart_z, Biome biome) noexcept {
+    biomes_[quart_z * kQuarts + quart_x] = biome;
+  }
+  // The y of the highest block after the surface stage, before trees.
+  [[nodiscard]] uint8_t height(uint32_t x, uint32_t z) const noexcept {
+    return heights_[z * world::kChunkSize + x];
+  }
+  void set_height(uint32_t x, uint32_t z, uint8_t height) noexcept {
+    heights_[z * world::kChunkSize + x] = height;
+  }
+
+  [[nodiscard]] world::Chunk &chunk() noexcept { return chunk_; }
+  [[nodiscard]] world::Chunk const &chunk() const noexcept { return chunk_; }
+  [[nodiscard]] world::NibbleArray &sky_light(int32_t section) noexcept {
+    return sky_light_[section];
+  }
+  [[nodiscard]] world::NibbleArray const &sky_light(
+      int32_t section) const noexcept {
+    return sky_light_[section];
+  }
+  [[nodiscard]] world::ChunkPos pos() const noexcept { return chunk_.pos(); }
+  [[nodiscard]] ChunkStatus status() const noexcept { return status_; }
+  // the blocks along with the light, biomes and heights
+  [[nodiscard]] size_t memory_usage() const noexcept {
+    return sizeof(*this) - sizeof(chunk_) + chunk_.memory_usage();
+  }
+  void set_status(ChunkStatus status) noexcept { status_ = status; }
+
+ private:
+  world::Chunk chunk_;
+  ChunkStatus status_ = ChunkStatus::kEmpty;
+  std::array<Biome, kQuarts * kQuarts> biomes_{};
+  std::array<uint8_t, world::kChunkSize * world::kChunkSize> heights_{};
+  std::array<world::NibbleArray, world::Chunk::kSectionCount> sky_light_;
+};
+
+// The chunk a stage runs on and the chunks around it, in kMaxStageRadius.
+// Only the center may be written.
+class ChunkNeighborhood final {
+ public:
+  static constexpr int32_t kWidth = 2 * kMaxStageRadius + 1;
+
+  // chunks[(dz + radius) * width + dx + radius], nullptr where the stage
+  // doesn't need a neighbour
+  explicit ChunkNeighborhood(
+      std::array<ProtoChunk *, kWidth * kWidth> chunks) noexcept
+      : chunks_(chunks) {}
+
+  [[nodiscard]] ProtoChunk &center() const noexcept {
+    return *chunks_[kMaxStageRadius * kWidth + kMaxStageRadius];
+  }
+  [[nodiscard]] ProtoChunk const &at(int32_t dx, int32_t dz) const noexcept {
+    return *chunks_[(dz + kMaxStageRadius) * kWidth + dx + kMaxStageRadius];
+  }
+
+ private:
+  std::array<ProtoChunk *, kWidth * kWidth> chunks_;
+};
+}  // namespace worldgen
@@ -1,31 +1,51 @@
 #include "core.hpp"
+
+#include <chrono>
+#include <resources/definitions.hpp>
+
 namespace minecraft::core {
-void RecursiveItemLoader(resource::Entry const &folder, BlockBaseMap &blocks,
-                         ItemBaseMap &items, std::string current_string = "") {
-  for (resource::Entry const &entry : folder) {
-    if (entry.is_folder()) {
-      RecursiveItemLoader(entry, blocks, items,
-                          current_string.empty()
-                              ? current_string + entry.name()
-                              : current_string + ":" + entry.name());
-      return;
+// Files are read and parsed in parallel; registration happens afterwards in
+// name order, so ids don't depend on the thread scheduling.
+void LoadContent(resource::Entry const &folder, ItemBaseMap &items,
+                 world::BlockRegistry &registry) {
+  const auto begin = std::chrono::steady_clock::now();
+  resource::DefinitionSet set = resource::LoadDefinitions(folder);
+  for (std::string const &error : set.errors) {
+    spdlog::error("Failed to load {}", error);
+  }
+  uint32_t item_id = 0;
+  for (resource::Definition &definition : set.definitions) {
+    yaml::Entry &yaml = definition.yaml;
+    if (!yaml.is_map() || !yaml.contains("type")) {
+      spdlog::info("Failed to load {}: no type", definition.name);
+      continue;
     }
-    std::string data = entry.string();
-    auto yaml = yaml::Parse(entry.string());
-    if (yaml.contains("type")) {
-      if (yaml["type"] == "block") {
-        // BlockBase::Load(yaml);
-      } else if (yaml["type"] == "item") {
-        // ItemBase::Load(yaml);
+    if (yaml["type"] == "block") {
+      // BlockBase::Load(yaml);
+      try {
+        registry.Register(definition.name, yaml);
+      } catch (world::BlockRegistryException const &e) {
+        spdlog::error("Failed to load {}", e.what());
       }
-    } else {
-      spdlog::info("Failed to load {}\n", entry.name());
+    } else if (yaml["type"] == "item") {
+      items.insert_or_assign(definition.name,
+                             ItemBase(definition.name, item_id++));
     }
   }
+  spdlog::info(
+      "Loaded {} blocks and {} items in {} ms", registry.size(), items.size(),
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - begin)
+          .count());
 }
 Core::Core()
-    : resources_(resource::LoadResources("resources.pack") / "resources") {
-  RecursiveItemLoader(resources_ / "data", *blocks_, *items_);
+    : jobs_(std::make_shared<jobs::JobSystem>()),
+      blocks_(std::make_shared<BlockBaseMap>()),
+      items_(std::make_shared<ItemBaseMap>()),
+      block_registry_(std::make_shared<world::BlockRegistry>()),
+      ticks_(std::make_shared<tick::TickScheduler>()),
+      resources_(resource::LoadResources("resources.pack") / "resources") {
+  LoadContent(resources_ / "data", *items_, *block_registry_);
 }
 void Core::LoadInstance() {
   static std::mutex mutex;
@@ -2,13 +2,15 @@
 
 #include <spdlog/spdlog.h>
 
+#include <jobs/job-system.hpp>
 #include <map>
 #include <parsers/yaml/yaml.hpp>
 #include <resources/resources.hpp>
+#include <tick/tick-scheduler.hpp>
 #include <vector>
+#include <world/block-registry.hpp>
 
 #include "core/block-base.hpp"
-#include "core/interfaces/updatable.hpp"
 #include "core/item-base.hpp"
 
 namespace minecraft::core {
@@ -31,13 +33,23 @@ class Core final {
 
   inline BlockBaseMap const &blocks() const noexcept { return *blocks_; }
   inline ItemBaseMap const &items() const noexcept { return *items_; }
+  // dense ids and property tables for the hot paths
+  inline world::BlockRegistry const &block_registry() const noexcept {
+    return *block_registry_;
+  }
+  // shared by meshing, generation, lighting and asset loading
+  inline jobs::JobSystem &jobs() const noexcept { return *jobs_; }
+  // 20 TPS game logic, driven from the main loop
+  inline tick::TickScheduler &ticks() const noexcept { return *ticks_; }
 
  private:
   Core();
   static void LoadInstance();
+  std::shared_ptr<jobs::JobSystem> jobs_;
   std::shared_ptr<BlockBaseMap> blocks_;
   std::shared_ptr<ItemBaseMap> items_;
-  std::shared_ptr<std::set<Updatable>> update_list_;
+  std::shared_ptr<world::BlockRegistry> block_registry_;
+  std::shared_ptr<tick::TickScheduler> ticks_;
 
   resource::Entry const &resources_;
   static std::shared_ptr<Core> instance_;
@@ -1,6 +1,56 @@
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+#include <worldgen/generation-pipeline.hpp>
+
 #include "core/core.hpp"
-int main() {
+
+namespace {
+bool ParseInt(std::string_view text, int32_t &value) {
+  auto [end, error] = std::from_chars(text.data(), text.data() + text.size(),
+                                      value);
+  return error == std::errc() && end == text.data() + text.size();
+}
+
+// minecraft --pregenerate <radius> [seed]
+// Headless: generates the chunks around the origin on every core.
+int Pregenerate(int argc, char **argv) {
+  int32_t radius = 0;
+  int32_t seed = 0;
+  if (argc < 3 || !ParseInt(argv[2], radius) || radius < 0 ||
+      (argc > 3 && !ParseInt(argv[3], seed))) {
+    spdlog::error("Usage: {} --pregenerate <radius> [seed]", argv[0]);
+    return 1;
+  }
+  using namespace minecraft::core;
+  Core &core = Core::instance();
+  const worldgen::ChunkGenerator generator(core.block_registry(), seed);
+  // the workers of the core, the main thread only waits on the pipeline
+  jobs::JobSystem &jobs = core.jobs();
+  const int64_t width = 2 * int64_t{radius} + 1;
+  spdlog::info("Pregenerating {} chunks with {} workers", width * width,
+               jobs.worker_count());
+  const worldgen::PregenerationStats stats =
+      worldgen::Pregenerate(generator, jobs, {0, 0}, radius);
+  spdlog::info(
+      "Generated {} chunks in {} ms, {:.1f} chunks/s", stats.chunks,
+      std::chrono::duration_cast<std::chrono::milliseconds>(stats.time)
+          .count(),
+      stats.chunks_per_second());
+  for (size_t status = 1; status < worldgen::kChunkStatusCount; status++) {
+    const auto stage = static_cast<worldgen::ChunkStatus>(status);
+    spdlog::info("  {}: {} runs", worldgen::StageName(stage),
+                 stats.stages_run[status]);
+  }
+  return 0;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc > 1 && std::string_view(argv[1]) == "--pregenerate") {
+    return Pregenerate(argc, argv);
+  }
   using namespace minecraft::core;
   Core core = Core::instance();
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,321 @@
+#include <filesystem>
+#include <parsers/yaml/yaml.hpp>
+#include <world/autosave-scheduler.hpp>
+#include <world/chunk-serializer.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+namespace fs = std::filesystem;
+using namespace world;
+using namespace std::chrono_literals;
+
+namespace {
+struct Counter {
+  int32_t count = 0;
+  int32_t limit = 0;
+  void Tick(TileContext &context) {
+    if (count == limit) {
+      return context.Sleep();
+    }
+    count++;
+    context.MarkDirty();
+  }
+};
+}  // namespace
+
+template <>
+struct nbt::Schema<Counter> {
+  static constexpr auto fields =
+      std::make_tuple(nbt::field("Count", &Counter::count),
+                      nbt::field("Limit", &Counter::limit));
+};
+
+namespace {
+class TestAutosaveScheduler : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = fs::temp_directory_path() / "minecraft_test/TestAutosave";
+    fs::remove_all(dir_);
+    stone_ = registry_.Register("minecraft:stone",
+                                yaml::Parse("sides:\n  default: stone.png"));
+    tiles_.Register<Counter>("minecraft:counter");
+  }
+  void TearDown() override { fs::remove_all(dir_); }
+
+  // Clean chunks, as if they were just loaded.
+  std::vector<std::unique_ptr<Chunk>> MakeChunks(int32_t count) {
+    std::vector<std::unique_ptr<Chunk>> chunks;
+    for (int32_t i = 0; i < count; i++) {
+      chunks.push_back(std::make_unique<Chunk>(ChunkPos{i % 32, i / 32}));
+      chunks.back()->section(0).Fill(stone_);
+    }
+    return chunks;
+  }
+
+  fs::path dir_;
+  BlockRegistry registry_;
+  TileEntityRegistry tiles_;
+  BlockId stone_ = kAir;
+};
+}  // namespace
+
+TEST_F(TestAutosaveScheduler, DirtyTracking) {
+  Chunk chunk({0, 0});
+  ASSERT_FALSE(chunk.dirty());
+  // writes through the section aren't tracked, setting the same block isn't
+  // a change
+  chunk.section(1).Fill(stone_);
+  chunk.Set(0, 16, 0, stone_);
+  ASSERT_FALSE(chunk.dirty());
+
+  const auto before = Chunk::Clock::now();
+  chunk.Set(0, 0, 0, stone_);
+  ASSERT_TRUE(chunk.dirty());
+  const auto since = *chunk.dirty_since();
+  ASSERT_GE(since, before);
+  // the first change counts
+  chunk.Set(1, 0, 0, stone_);
+  ASSERT_EQ(*chunk.dirty_since(), since);
+  chunk.MarkDirty(since - 1s);
+  ASSERT_EQ(*chunk.dirty_since(), since - 1s);
+  chunk.ClearDirty();
+  ASSERT_FALSE(chunk.dirty());
+
+  // tile entities are dirty when added, removed or changed while ticking
+  TileEntities &tiles = chunk.tile_entities();
+  tiles.Emplace<Counter>(1, 1, 1, Counter{.limit = 2});
+  ASSERT_TRUE(tiles.dirty());
+  ASSERT_TRUE(chunk.dirty());
+  ASSERT_EQ(chunk.dirty_since(), tiles.dirty_since());
+  chunk.ClearDirty();
+  ASSERT_FALSE(tiles.dirty());
+  tiles.Tick(1);
+  ASSERT_TRUE(chunk.dirty());
+  chunk.ClearDirty();
+  tiles.Tick(2);
+  tiles.Tick(3);
+  ASSERT_TRUE(chunk.dirty());
+  chunk.ClearDirty();
+  // asleep, nothing changes
+  tiles.Tick(4);
+  ASSERT_FALSE(chunk.dirty());
+  tiles.Remove(1, 1, 1);
+  ASSERT_TRUE(chunk.dirty());
+
+  // the oldest of both
+  chunk.ClearDirty();
+  tiles.MarkDirty(since);
+  chunk.MarkDirty(since + 1s);
+  ASSERT_EQ(*chunk.dirty_since(), since);
+
+  // the callback sees each part turn dirty once
+  chunk.ClearDirty();
+  int turned_dirty = 0;
+  chunk.set_on_dirty([&] { turned_dirty++; });
+  chunk.Set(2, 0, 0, stone_);
+  chunk.Set(3, 0, 0, stone_);
+  chunk.MarkDirty(since);
+  ASSERT_EQ(turned_dirty, 1);
+  tiles.Emplace<Counter>(3, 3, 3);
+  tiles.Tick(5);
+  ASSERT_EQ(turned_dirty, 2);
+  chunk.ClearDirty();
+  chunk.MarkDirty();
+  ASSERT_EQ(turned_dirty, 3);
+  chunk.set_on_dirty({});
+  tiles.Remove(3, 3, 3);
+
+  // a decoded chunk is clean
+  tiles.Emplace<Counter>(2, 2, 2);
+  const Chunk decoded = DecodeChunk(
+      EncodeChunk(TakeSnapshot(chunk, registry_, tiles_)), registry_, tiles_);
+  ASSERT_FALSE(decoded.dirty());
+  ASSERT_EQ(decoded.tile_entities().size(), 1u);
+}
+
+TEST_F(TestAutosaveScheduler, OldestFirst) {
+  ChunkIO io(dir_);
+  // a budget of 0 still saves one chunk per tick
+  AutosaveScheduler autosave(io, registry_, tiles_, {.tick_budget = 0us});
+  auto chunks = MakeChunks(20);
+  const auto now = Chunk::Clock::now();
+  for (size_t i = 0; i < chunks.size(); i++) {
+    autosave.Track(*chunks[i]);
+    // the last chunk changed first
+    chunks[i]->MarkDirty(now - std::chrono::seconds(static_cast<int64_t>(i)));
+  }
+  for (size_t tick = 0; tick < chunks.size(); tick++) {
+    autosave.Tick(now);
+    const AutosaveStats &stats = autosave.stats();
+    ASSERT_EQ(stats.dirty, chunks.size() - tick - 1);
+    for (size_t i = 0; i < chunks.size(); i++) {
+      ASSERT_EQ(chunks[i]->dirty(), i < chunks.size() - tick - 1) << tick;
+    }
+    // the saves may not be written yet
+    if (stats.dirty > 0) {
+      ASSERT_GE(stats.oldest_change,
+                std::chrono::seconds(static_cast<int64_t>(stats.dirty) - 1));
+    }
+  }
+  ASSERT_EQ(autosave.stats().saves, chunks.size());
+  ASSERT_EQ(autosave.stats().dirty_tile_entities, 0u);
+
+  // a large budget saves the backlog at once
+  autosave.set_settings({.tick_budget = 1s});
+  for (auto &chunk : chunks) {
+    chunk->Set(0, 100, 0, stone_);
+  }
+  autosave.Tick();
+  ASSERT_EQ(autosave.stats().dirty, 0u);
+  ASSERT_EQ(autosave.stats().saves, 2 * chunks.size());
+
+  io.Flush();
+  autosave.Tick();
+  ASSERT_EQ(autosave.stats().writing, 0u);
+  ASSERT_EQ(autosave.stats().oldest_change, 0ns);
+  ASSERT_EQ(autosave.stats().failed_writes, 0u);
+}
+
+TEST_F(TestAutosaveScheduler, SaveDelay) {
+  ChunkIO io(dir_);
+  AutosaveScheduler autosave(io, registry_, tiles_,
+                             {.tick_budget = 1s, .save_delay = 5s});
+  auto chunks = MakeChunks(10);
+  const auto now = Chunk::Clock::now();
+  for (size_t i = 0; i < chunks.size(); i++) {
+    autosave.Track(*chunks[i]);
+    chunks[i]->MarkDirty(now - std::chrono::seconds(static_cast<int64_t>(i)));
+  }
+  chunks[9]->tile_entities().Emplace<Counter>(0, 0, 0);
+  autosave.Tick(now);
+  // changed 5 seconds ago or more
+  ASSERT_EQ(autosave.stats().saves, 5u);
+  ASSERT_EQ(autosave.stats().dirty, 5u);
+  ASSERT_EQ(autosave.stats().dirty_tile_entities, 0u);
+  ASSERT_EQ(autosave.stats().oldest_change, 9s);
+  for (size_t i = 0; i < chunks.size(); i++) {
+    ASSERT_EQ(chunks[i]->dirty(), i < 5);
+  }
+  chunks[0]->tile_entities().Emplace<Counter>(0, 0, 0);
+  autosave.Tick(now);
+  ASSERT_EQ(autosave.stats().dirty_tile_entities, 1u);
+  autosave.Tick(now + 10s);
+  ASSERT_EQ(autosave.stats().dirty, 0u);
+  ASSERT_EQ(autosave.stats().saves, 10u);
+}
+
+TEST_F(TestAutosaveScheduler, DirtyQueue) {
+  ChunkIO io(dir_);
+  AutosaveScheduler autosave(io, registry_, tiles_, {.tick_budget = 1s});
+  auto chunks = MakeChunks(8);
+  // dirty before it is tracked
+  chunks[0]->Set(0, 0, 0, kAir);
+  for (auto &chunk : chunks) {
+    autosave.Track(*chunk);
+  }
+  autosave.Tick();
+  ASSERT_EQ(autosave.stats().saves, 1u);
+
+  // only the tile entities changed
+  chunks[1]->tile_entities().Emplace<Counter>(0, 0, 0);
+  // cleared without the scheduler, nothing to save
+  chunks[2]->Set(0, 0, 0, kAir);
+  chunks[2]->ClearDirty();
+  autosave.Tick();
+  ASSERT_EQ(autosave.stats().saves, 2u);
+  ASSERT_FALSE(chunks[1]->dirty());
+  ASSERT_EQ(autosave.stats().dirty, 0u);
+
+  // tracked again as another chunk object, the old one is forgotten
+  Chunk replacement(chunks[3]->pos());
+  autosave.Track(replacement);
+  chunks[3]->Set(0, 0, 0, kAir);
+  replacement.Set(0, 0, 0, stone_);
+  autosave.Tick();
+  ASSERT_EQ(autosave.stats().saves, 3u);
+  ASSERT_TRUE(chunks[3]->dirty());
+  ASSERT_FALSE(replacement.dirty());
+  ASSERT_EQ(autosave.stats().tracked, 8u);
+  io.Flush();
+}
+
+TEST_F(TestAutosaveScheduler, UntrackAndSaveAll) {
+  auto chunks = MakeChunks(64);
+  {
+    ChunkIO io(dir_);
+    AutosaveScheduler autosave(io, registry_, tiles_,
+                               {.save_delay = std::chrono::hours(1)});
+    for (auto &chunk : chunks) {
+      autosave.Track(*chunk);
+      chunk->Set(static_cast<uint32_t>(chunk->pos().x % 16), 50,
+                 static_cast<uint32_t>(chunk->pos().z), stone_);
+    }
+    chunks[3]->tile_entities().Emplace<Counter>(4, 5, 6,
+                                                Counter{.count = 7});
+    autosave.Tick();
+    ASSERT_EQ(autosave.stats().saves, 0u);
+    ASSERT_EQ(autosave.stats().dirty, 64u);
+    ASSERT_EQ(autosave.stats().dirty_tile_entities, 1u);
+
+    // an unloaded chunk is saved on the way out
+    ASSERT_TRUE(autosave.Untrack(chunks[3]->pos()));
+    ASSERT_FALSE(autosave.Untrack(chunks[3]->pos()));
+    ASSERT_FALSE(chunks[3]->dirty());
+    chunks[3]->Set(1, 20, 1, stone_);
+    ASSERT_EQ(autosave.stats().tracked, 63u);
+
+    ASSERT_EQ(autosave.SaveAll(), 63u);
+    ASSERT_EQ(autosave.SaveAll(), 0u);
+    io.Flush();
+  }
+  RegionStorage storage(dir_);
+  for (auto const &chunk : chunks) {
+    const Chunk saved =
+        DecodeChunk(*storage.ReadChunk(chunk->pos()), registry_, tiles_);
+    for (uint32_t y = 0; y < 64; y++) {
+      ASSERT_EQ(saved.Get(static_cast<uint32_t>(chunk->pos().x % 16), y,
+                          static_cast<uint32_t>(chunk->pos().z)),
+                chunk->Get(static_cast<uint32_t>(chunk->pos().x % 16), y,
+                           static_cast<uint32_t>(chunk->pos().z)));
+    }
+  }
+  // saved before the later change
+  const Chunk untracked =
+      DecodeChunk(*storage.ReadChunk(chunks[3]->pos()), registry_, tiles_);
+  ASSERT_EQ(untracked.Get(1, 1, 1), stone_);
+  ASSERT_EQ(untracked.Get(1, 20, 1), kAir);
+  ASSERT_EQ(untracked.tile_entities().size(), 1u);
+}
+
+TEST_F(TestAutosaveScheduler, Benchmark) {
+  ChunkIO io(dir_);
+  AutosaveScheduler autosave(io, registry_, tiles_, {.tick_budget = 2ms});
+  auto chunks = MakeChunks(4096);
+  for (auto &chunk : chunks) {
+    autosave.Track(*chunk);
+  }
+  // every chunk changes at once, as after an explosion of edits
+  for (auto &chunk : chunks) {
+    chunk->Set(1, 1, 1, kAir);
+  }
+  size_t ticks = 0;
+  const auto begin = std::chrono::high_resolution_clock::now();
+  do {
+    autosave.Tick();
+    ticks++;
+  } while (autosave.stats().dirty > 0);
+  const auto end = std::chrono::high_resolution_clock::now();
+  // and an idle tick, the clean chunks cost nothing
+  autosave.Tick();
+  const AutosaveStats stats = autosave.stats();
+  std::cout << "Autosaving 4096 chunks: " << ticks << " ticks, "
+            << time_diff(begin, end) << " ms, "
+            << std::chrono::duration<double, std::milli>(stats.tick_time_max)
+                   .count()
+            << " ms per tick at most, "
+            << std::chrono::duration<double, std::milli>(stats.tick_time)
+                   .count()
+            << " ms idle" << std::endl;
+  io.Flush();
+}
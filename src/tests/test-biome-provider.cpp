@@ -0,0 +1,163 @@
+#include <atomic>
+#include <thread>
+#include <worldgen/biome-provider.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace worldgen;
+
+namespace {
+bool Equal(Climate const &a, Climate const &b) {
+  return a.temperature == b.temperature && a.humidity == b.humidity &&
+         a.mountains == b.mountains;
+}
+}  // namespace
+
+TEST(TestBiomeProvider, CacheCapacity) {
+  const int32_t seed = RandomInt32();
+  // evicts on almost every query
+  const BiomeProvider small(seed, 1);
+  const BiomeProvider large(seed);
+  for (int i = 0; i < 2000; i++) {
+    const int32_t x = RandomInt32(-100000, 100000);
+    const int32_t y = RandomInt32(-10, 300);
+    const int32_t z = RandomInt32(-100000, 100000);
+    ASSERT_EQ(small.GetBiome(x, y, z), large.GetBiome(x, y, z));
+    ASSERT_TRUE(Equal(small.GetClimate(x, y, z), large.GetClimate(x, y, z)));
+  }
+  ASSERT_EQ(small.cache_stats().hits + small.cache_stats().misses,
+            large.cache_stats().hits + large.cache_stats().misses);
+  ASSERT_GT(small.cache_stats().evictions,
+            large.cache_stats().evictions);
+  ASSERT_GT(large.cache_stats().hits, 0u);
+}
+
+TEST(TestBiomeProvider, Quarts) {
+  const BiomeProvider provider(RandomInt32());
+  for (int i = 0; i < 50; i++) {
+    const world::ChunkPos pos = {RandomInt32(-5000, 5000),
+                                 RandomInt32(-5000, 5000)};
+    const auto chunk = provider.Get(pos);
+    ASSERT_EQ(provider.Get(pos), chunk);
+    for (uint32_t qz = 0; qz < ChunkBiomes::kQuarts; qz++) {
+      for (uint32_t qx = 0; qx < ChunkBiomes::kQuarts; qx++) {
+        const int32_t x = pos.x * 16 + static_cast<int32_t>(qx * 4);
+        const int32_t z = pos.z * 16 + static_cast<int32_t>(qz * 4);
+        // exact at the centers of the columns, at the height of the terrain
+        ASSERT_TRUE(Equal(provider.GetClimate(x + 2, 64, z + 2),
+                          chunk->climate(qx, qz)));
+        for (uint32_t qy = 0; qy < ChunkBiomes::kQuartLayers; qy++) {
+          const Biome biome = chunk->biome(qx, qy, qz);
+          const auto y = static_cast<int32_t>(qy * 4);
+          ASSERT_EQ(biome, provider.GetBiome(x, y, z));
+          ASSERT_EQ(biome, provider.GetBiome(x + 3, y + 3, z + 3));
+          ASSERT_EQ(biome, BiomeProvider::Classify(BiomeProvider::AtHeight(
+                               chunk->climate(qx, qz), y + 2)));
+        }
+      }
+    }
+  }
+  // the lapse only lowers the temperature
+  const Climate climate = provider.GetClimate(0, 64, 0);
+  ASSERT_TRUE(Equal(provider.GetClimate(0, 0, 0), climate));
+  ASSERT_LT(provider.GetClimate(0, 200, 0).temperature, climate.temperature);
+  ASSERT_EQ(provider.GetClimate(0, 200, 0).humidity, climate.humidity);
+}
+
+TEST(TestBiomeProvider, Smooth) {
+  const BiomeProvider provider(RandomInt32());
+  for (int i = 0; i < 20; i++) {
+    const world::ChunkPos pos = {RandomInt32(-5000, 5000),
+                                 RandomInt32(-5000, 5000)};
+    const int32_t y = RandomInt32(0, 255);
+    std::array<Climate, 256> columns;
+    provider.FillClimate(pos, y, columns);
+    for (int32_t z = 0; z < 16; z++) {
+      for (int32_t x = 0; x < 16; x++) {
+        const int32_t bx = pos.x * 16 + x, bz = pos.z * 16 + z;
+        const Climate climate = provider.GetClimate(bx, y, bz);
+        ASSERT_TRUE(Equal(columns[static_cast<size_t>(z * 16 + x)], climate));
+        // neighbouring blocks are close, across chunk borders too
+        for (auto [dx, dz] : {std::pair{1, 0}, std::pair{0, 1}}) {
+          const Climate next = provider.GetClimate(bx + dx, y, bz + dz);
+          ASSERT_NEAR(next.temperature, climate.temperature, 0.02f);
+          ASSERT_NEAR(next.humidity, climate.humidity, 0.02f);
+          ASSERT_NEAR(next.mountains, climate.mountains, 0.02f);
+        }
+      }
+    }
+  }
+}
+
+TEST(TestBiomeProvider, Threads) {
+  const int32_t seed = RandomInt32();
+  const BiomeProvider expected(seed);
+  // small enough to evict while the threads run
+  const BiomeProvider shared(seed, 64);
+  std::vector<std::thread> threads;
+  std::atomic<size_t> mismatches = 0;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&, t] {
+      for (int32_t i = 0; i < 20000; i++) {
+        const int32_t x = (i * 7 + t * 1000) % 4000 - 2000;
+        const int32_t z = (i * 13) % 3000 - 1500;
+        if (shared.GetBiome(x, 70, z) != expected.GetBiome(x, 70, z) ||
+            !Equal(shared.GetClimate(x, 70, z),
+                   expected.GetClimate(x, 70, z))) {
+          mismatches++;
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(mismatches, 0u);
+  ASSERT_GT(shared.cache_stats().evictions, 0u);
+}
+
+TEST(TestBiomeProvider, Colors) {
+  // hot and wet is the lush corner of the map, cold is the bluish one
+  ASSERT_EQ(GrassColor({0.5f, 0.5f, 0}), 0x47CD33u);
+  ASSERT_EQ(GrassColor({-0.5f, 0.5f, 0}), 0x80B497u);
+  ASSERT_EQ(FoliageColor({0.5f, -0.5f, 0}), 0xAEA42Au);
+}
+
+TEST(TestBiomeProvider, Benchmark) {
+  const BiomeProvider provider(1234);
+  constexpr int32_t kWidth = 512;
+  constexpr double kQueries = kWidth * kWidth;
+  // ns per block of the square
+  auto measure = [&](auto &&query) {
+    const auto begin = std::chrono::high_resolution_clock::now();
+    for (int32_t z = 0; z < kWidth; z++) {
+      for (int32_t x = 0; x < kWidth; x++) {
+        query(x, z);
+      }
+    }
+    return time_diff(begin, std::chrono::high_resolution_clock::now()) * 1e6 /
+           kQueries;
+  };
+  uint32_t forests = 0;
+  float temperature = 0;
+  auto biome = [&](int32_t x, int32_t z) {
+    forests += provider.GetBiome(x, 70, z) == Biome::kForest;
+  };
+  const double uncached = measure(biome);
+  const double cached = measure(biome);
+  const double climate = measure([&](int32_t x, int32_t z) {
+    temperature += provider.GetClimate(x, 70, z).temperature;
+  });
+  std::array<Climate, 256> columns;
+  const double fill = measure([&](int32_t x, int32_t z) {
+    if (x % 16 == 0 && z % 16 == 0) {
+      provider.FillClimate({x / 16, z / 16}, 70, columns);
+      temperature += columns[0].temperature;
+    }
+  });
+  std::cout << "Biome: " << uncached << " ns uncached, " << cached
+            << " ns cached. Climate: " << climate << " ns, " << fill
+            << " ns with FillClimate (" << forests << ", " << temperature
+            << ")" << std::endl;
+}
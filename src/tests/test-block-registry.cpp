@@ -0,0 +1,103 @@
+#include <parsers/yaml/yaml.hpp>
+#include <world/block-registry.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace world;
+
+namespace {
+constexpr std::string_view kGrass = R"(type: block
+sides:
+  default: grass_side.png
+  top: grass_top.png
+  bottom: dirt.png
+specular:
+  default: not_specular.png
+hardness: 2)";
+
+constexpr std::string_view kChest = R"(type: block
+sides:
+  default: planks.png
+  sides: chest_side.png
+  north: chest_front.png
+hardness: 2.5
+transparent: true
+interactable: true
+solid: true
+breakable: true
+tile: true)";
+}  // namespace
+
+TEST(TestBlockRegistry, AirIsZero) {
+  BlockRegistry registry;
+  ASSERT_EQ(registry.size(), 1u);
+  ASSERT_EQ(registry.id(BlockRegistry::kAirName), kAir);
+  ASSERT_FALSE(registry.solid(kAir));
+  ASSERT_TRUE(registry.transparent(kAir));
+  ASSERT_FALSE(registry.breakable(kAir));
+  ASSERT_EQ(registry.diffuse_texture(kAir, Direction::kTop),
+            BlockRegistry::kNoTexture);
+}
+
+TEST(TestBlockRegistry, LoadsDefinitions) {
+  BlockRegistry registry;
+  const BlockId grass = registry.Register("minecraft:grass", yaml::Parse(kGrass));
+  const BlockId chest = registry.Register("minecraft:chest", yaml::Parse(kChest));
+  ASSERT_EQ(grass, 1);
+  ASSERT_EQ(chest, 2);
+  ASSERT_EQ(registry.name(chest), "minecraft:chest");
+  ASSERT_EQ(registry.Find("minecraft:grass"), grass);
+  ASSERT_FALSE(registry.Find("minecraft:stone").has_value());
+  ASSERT_THROW((void)registry.id("minecraft:stone"), BlockRegistryException);
+
+  ASSERT_EQ(registry.hardness(grass), 2.0f);
+  ASSERT_TRUE(registry.solid(grass));
+  ASSERT_FALSE(registry.transparent(grass));
+  ASSERT_FALSE(registry.tile(grass));
+  ASSERT_EQ(registry.hardness(chest), 2.5f);
+  ASSERT_TRUE(registry.transparent(chest));
+  ASSERT_TRUE(registry.interactable(chest));
+  ASSERT_TRUE(registry.tile(chest));
+  ASSERT_EQ(registry.light(chest), 0);
+  ASSERT_EQ(registry.solid_table().size(), 3u);
+
+  auto texture = [&registry](BlockId id, Direction face) {
+    return registry.texture_names()[registry.diffuse_texture(id, face)];
+  };
+  ASSERT_EQ(texture(grass, Direction::kTop), "grass_top.png");
+  ASSERT_EQ(texture(grass, Direction::kBottom), "dirt.png");
+  ASSERT_EQ(texture(grass, Direction::kEast), "grass_side.png");
+  ASSERT_EQ(texture(chest, Direction::kNorth), "chest_front.png");
+  ASSERT_EQ(texture(chest, Direction::kSouth), "chest_side.png");
+  ASSERT_EQ(texture(chest, Direction::kTop), "planks.png");
+  // the same texture is stored once
+  ASSERT_EQ(registry.specular_texture(grass, Direction::kTop),
+            registry.specular_texture(grass, Direction::kWest));
+  ASSERT_EQ(registry.specular_texture(chest, Direction::kTop),
+            BlockRegistry::kNoTexture);
+}
+
+TEST(TestBlockRegistry, RedefinitionKeepsId) {
+  BlockRegistry registry;
+  const BlockId grass = registry.Register("minecraft:grass", yaml::Parse(kGrass));
+  BlockDefinition definition =
+      BlockDefinition::Parse("minecraft:grass", yaml::Parse(kGrass));
+  definition.hardness = 7;
+  ASSERT_EQ(registry.Register(definition), grass);
+  ASSERT_EQ(registry.size(), 2u);
+  ASSERT_EQ(registry.hardness(grass), 7.0f);
+
+  ASSERT_THROW(
+      (void)registry.Register("minecraft:bad", yaml::Parse("solid: 12")),
+      BlockRegistryException);
+  const BlockId glowstone =
+      registry.Register("minecraft:glowstone", yaml::Parse("light: 15"));
+  ASSERT_EQ(registry.light(glowstone), 15);
+  ASSERT_EQ(registry.light_table()[glowstone], 15);
+  for (const char *light : {"light: 16", "light: -1", "light: 2.5"}) {
+    ASSERT_THROW(
+        (void)registry.Register("minecraft:bad", yaml::Parse(light)),
+        BlockRegistryException);
+  }
+}
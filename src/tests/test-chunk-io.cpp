@@ -0,0 +1,194 @@
+#include <atomic>
+#include <filesystem>
+#include <future>
+#include <sstream>
+#include <thread>
+#include <world/chunk-io.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+namespace fs = std::filesystem;
+using namespace world;
+
+namespace {
+nbt::NBT MakeChunk(ChunkPos pos, int32_t version) {
+  nbt::NBT nbt{""};
+  nbt["xPos"] = nbt::TagInt{pos.x};
+  nbt["zPos"] = nbt::TagInt{pos.z};
+  nbt["version"] = nbt::TagInt{version};
+  nbt::TagByteArray data(RandomSizeT(100, 5000));
+  for (auto &value : data) {
+    value = static_cast<nbt::TagByte>(RandomInt16(-128, 127));
+  }
+  nbt["data"] = data;
+  return nbt;
+}
+
+std::string Encode(nbt::NBT const &nbt) {
+  std::ostringstream stream;
+  nbt.encode(stream);
+  return stream.str();
+}
+}  // namespace
+
+class TestChunkIO : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = fs::temp_directory_path() / "minecraft_test/TestChunkIO";
+    fs::remove_all(dir_);
+  }
+  void TearDown() override { fs::remove_all(dir_); }
+  fs::path dir_;
+};
+
+TEST_F(TestChunkIO, SaveAndLoad) {
+  std::map<ChunkPos, std::string> expected;
+  {
+    ChunkIO io(dir_);
+    std::vector<std::future<void>> saved;
+    // a few chunks in each of several regions
+    for (int32_t i = 0; i < 100; i++) {
+      const ChunkPos pos = {RandomInt32(-80, 80), RandomInt32(-80, 80)};
+      nbt::NBT nbt = MakeChunk(pos, i);
+      expected[pos] = Encode(nbt);
+      saved.push_back(io.Save(pos, std::move(nbt)));
+    }
+    ASSERT_FALSE(io.Load({1000, 1000}).get().has_value());
+    for (auto &future : saved) {
+      future.get();
+    }
+    for (auto const &[pos, data] : expected) {
+      auto nbt = io.Load(pos).get();
+      ASSERT_TRUE(nbt.has_value());
+      ASSERT_EQ(Encode(*nbt), data);
+    }
+    const ChunkIOStats stats = io.stats();
+    ASSERT_EQ(stats.saves, 100u);
+    ASSERT_EQ(stats.chunks_written + stats.coalesced, 100u);
+    // every batch holds the chunks of one region
+    ASSERT_LE(stats.batches, stats.chunks_written);
+    ASSERT_EQ(stats.queued_saves, 0u);
+  }
+  // the destructor wrote and flushed everything
+  RegionStorage storage(dir_);
+  for (auto const &[pos, data] : expected) {
+    ASSERT_EQ(Encode(*storage.ReadChunk(pos)), data);
+  }
+}
+
+TEST_F(TestChunkIO, Coalesce) {
+  ChunkIO io(dir_);
+  const ChunkPos pos = {3, -4};
+  std::vector<std::future<void>> saved;
+  std::string last;
+  for (int32_t version = 0; version < 50; version++) {
+    nbt::NBT nbt = MakeChunk(pos, version);
+    last = Encode(nbt);
+    saved.push_back(io.Save(pos, std::move(nbt)));
+    // a load sees the latest save, queued or written
+    ASSERT_EQ(Encode(*io.Load(pos).get()), last);
+  }
+  io.Flush();
+  for (auto &future : saved) {
+    ASSERT_EQ(future.wait_for(std::chrono::seconds(0)),
+              std::future_status::ready);
+  }
+  ASSERT_EQ(Encode(*io.Load(pos).get()), last);
+
+  // saves queued behind a long batch are coalesced
+  for (int32_t i = 0; i < 300; i++) {
+    io.Save({i, 0}, MakeChunk({i, 0}, i));
+  }
+  for (int32_t version = 0; version < 20; version++) {
+    io.Save(pos, MakeChunk(pos, version));
+  }
+  io.Flush();
+  const ChunkIOStats stats = io.stats();
+  ASSERT_EQ(stats.saves, 370u);
+  ASSERT_EQ(stats.chunks_written + stats.coalesced, 370u);
+  ASSERT_GT(stats.coalesced, 0u);
+}
+
+TEST_F(TestChunkIO, Shutdown) {
+  ChunkIO io(dir_);
+  auto saved = io.Save({0, 0}, MakeChunk({0, 0}, 1));
+  io.Shutdown();
+  ASSERT_EQ(saved.wait_for(std::chrono::seconds(0)),
+            std::future_status::ready);
+  ASSERT_THROW(io.Save({0, 0}, MakeChunk({0, 0}, 2)), ChunkIOException);
+  ASSERT_THROW(io.Load({0, 0}), ChunkIOException);
+  ASSERT_THROW(io.Flush(), ChunkIOException);
+  // again from the destructor
+  io.Shutdown();
+  ASSERT_TRUE(RegionStorage(dir_).HasChunk({0, 0}));
+}
+
+TEST_F(TestChunkIO, Threads) {
+  ChunkIO io(dir_);
+  std::vector<std::thread> threads;
+  std::atomic<size_t> mismatches = 0;
+  for (int32_t t = 0; t < 4; t++) {
+    threads.emplace_back([&, t] {
+      // every thread owns a column of chunks across two regions
+      for (int32_t i = 0; i < 50; i++) {
+        const ChunkPos pos = {t, i % 40};
+        nbt::NBT nbt = MakeChunk(pos, i);
+        const std::string data = Encode(nbt);
+        io.Save(pos, std::move(nbt));
+        if (Encode(*io.Load(pos).get()) != data) {
+          mismatches++;
+        }
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  io.Flush();
+  ASSERT_EQ(mismatches, 0u);
+  ASSERT_EQ(io.stats().queued_saves, 0u);
+}
+
+TEST_F(TestChunkIO, FlushWhileLoading) {
+  ChunkIO io(dir_);
+  for (int32_t i = 0; i < 200; i++) {
+    io.Save({i % 64, i / 64}, MakeChunk({i % 64, i / 64}, i));
+  }
+  // loads keep coming faster than they are read, the flush still gets
+  // through
+  std::atomic<bool> flushed = false;
+  std::thread loader([&] {
+    for (int32_t i = 0; !flushed; i++) {
+      (void)io.Load({1000 + i % 100, 0});
+    }
+  });
+  auto flush = std::async(std::launch::async, [&] { io.Flush(); });
+  const bool done =
+      flush.wait_for(std::chrono::seconds(30)) == std::future_status::ready;
+  flushed = true;
+  loader.join();
+  ASSERT_TRUE(done);
+  ASSERT_EQ(io.stats().queued_saves, 0u);
+  ASSERT_TRUE(RegionStorage(dir_).HasChunk({7, 3}));
+}
+
+TEST_F(TestChunkIO, Benchmark) {
+  ChunkIO io(dir_);
+  std::vector<nbt::NBT> chunks;
+  for (int32_t i = 0; i < 1000; i++) {
+    chunks.push_back(MakeChunk({i % 64, i / 64}, i));
+  }
+  const auto begin = std::chrono::high_resolution_clock::now();
+  for (int32_t i = 0; i < 1000; i++) {
+    io.Save({i % 64, i / 64}, std::move(chunks[static_cast<size_t>(i)]));
+  }
+  const auto queued = std::chrono::high_resolution_clock::now();
+  io.Flush();
+  const auto flushed = std::chrono::high_resolution_clock::now();
+  const ChunkIOStats stats = io.stats();
+  std::cout << "Saving 1000 chunks: " << time_diff(begin, queued)
+            << " ms to queue, " << time_diff(begin, flushed)
+            << " ms until flushed, " << stats.batches << " batches, "
+            << stats.coalesced << " coalesced" << std::endl;
+}
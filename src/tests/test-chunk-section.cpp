@@ -0,0 +1,161 @@
+#include <thread>
+#include <world/chunk-section.hpp>
+#include <world/chunk.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace world;
+
+TEST(TestChunkSection, SingleValue) {
+  ChunkSection air;
+  ASSERT_TRUE(air.uniform());
+  ASSERT_TRUE(air.empty());
+  ASSERT_EQ(air.bits_per_entry(), 0);
+  ASSERT_TRUE(air.data().empty());
+  ASSERT_EQ(air.Get(5, 6, 7), kAir);
+
+  ChunkSection stone{1};
+  ASSERT_TRUE(stone.uniform());
+  ASSERT_EQ(stone.non_air_count(), ChunkSection::kVolume);
+  ASSERT_EQ(stone.Get(15, 15, 15), 1);
+  // a section that goes back to one block drops its storage
+  ASSERT_EQ(stone.Set(1, 2, 3, 2), 1);
+  ASSERT_EQ(stone.bits_per_entry(), 1);
+  ASSERT_EQ(stone.Set(1, 2, 3, 1), 2);
+  ASSERT_TRUE(stone.uniform());
+  ASSERT_TRUE(stone.data().empty());
+}
+
+TEST(TestChunkSection, MatchesDenseArray) {
+  ChunkSection section;
+  std::vector<BlockId> dense(ChunkSection::kVolume, kAir);
+  // the number of distinct blocks grows to force every width
+  for (BlockId distinct : {2, 3, 5, 17, 200, 1000}) {
+    for (int i = 0; i < 20000; i++) {
+      const uint32_t index = RandomSizeT(0, ChunkSection::kVolume - 1);
+      const auto block = static_cast<BlockId>(RandomSizeT(0, distinct - 1));
+      ASSERT_EQ(section.Set(index, block), dense[index]);
+      dense[index] = block;
+    }
+    uint32_t non_air = 0;
+    for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+      ASSERT_EQ(section.Get(i), dense[i]) << i;
+      non_air += dense[i] != kAir;
+    }
+    ASSERT_EQ(section.non_air_count(), non_air);
+    ASSERT_TRUE(section.bits_per_entry() == ChunkSection::kDirectBits ||
+                section.palette().size() <= (1u << section.bits_per_entry()));
+  }
+  ASSERT_EQ(section.bits_per_entry(), ChunkSection::kDirectBits);
+}
+
+TEST(TestChunkSection, ReusesAndOptimizesPalette) {
+  ChunkSection section;
+  for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+    section.Set(i, static_cast<BlockId>(i % 100 + 1));
+  }
+  ASSERT_EQ(section.bits_per_entry(), 8);
+  // replacing everything with few blocks frees old palette slots for reuse
+  for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+    section.Set(i, static_cast<BlockId>(i % 3 + 1000));
+  }
+  ASSERT_EQ(section.bits_per_entry(), 8);
+  ASSERT_LE(section.palette().size(), 103u);
+  const size_t before = section.memory_usage();
+  section.Optimize();
+  ASSERT_EQ(section.bits_per_entry(), 2);
+  ASSERT_EQ(section.palette().size(), 3u);
+  ASSERT_LT(section.memory_usage(), before);
+  for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+    ASSERT_EQ(section.Get(i), i % 3 + 1000);
+  }
+  section.Fill(kAir);
+  ASSERT_TRUE(section.empty());
+  ASSERT_TRUE(section.uniform());
+}
+
+TEST(TestChunkSection, ChunkMemoryUsage) {
+  Chunk chunk{{3, -4}};
+  // a typical column: stone at the bottom, a few ores, dirt, grass, then air
+  for (uint32_t x = 0; x < 16; x++) {
+    for (uint32_t z = 0; z < 16; z++) {
+      for (uint32_t y = 0; y < 64; y++) {
+        BlockId block = 1;
+        if (y >= 60) {
+          block = y == 63 ? 3 : 2;
+        } else if (RandomSizeT(0, 50) == 0) {
+          block = static_cast<BlockId>(RandomSizeT(10, 15));
+        }
+        chunk.Set(x, y, z, block);
+      }
+    }
+  }
+  ASSERT_EQ(chunk.Get(4, 63, 7), 3);
+  ASSERT_EQ(chunk.Get(4, 64, 7), kAir);
+  ASSERT_EQ(chunk.pos(), (ChunkPos{3, -4}));
+  chunk.Optimize();
+  const size_t dense = Chunk::kHeight * 16 * 16 * sizeof(uint32_t);
+  std::cout << "chunk: " << chunk.memory_usage() << " bytes, dense uint32_t: "
+            << dense << " bytes\n";
+  ASSERT_LT(chunk.memory_usage() * 8, dense);
+  for (int i = 4; i < Chunk::kSectionCount; i++) {
+    ASSERT_TRUE(chunk.section(i).empty());
+  }
+}
+
+TEST(TestChunkSection, CopyOnWrite) {
+  ChunkSection section;
+  for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+    section.Set(i, static_cast<BlockId>(i % 7));
+  }
+  const ChunkSection snapshot = section;
+  ASSERT_TRUE(section.shared());
+  ASSERT_EQ(snapshot.data().data(), section.data().data());
+
+  // the first write copies, the snapshot keeps the old blocks
+  ASSERT_EQ(section.Set(5, 100), 5);
+  ASSERT_FALSE(section.shared());
+  ASSERT_FALSE(snapshot.shared());
+  ASSERT_NE(snapshot.data().data(), section.data().data());
+  ASSERT_EQ(snapshot.Get(5), 5);
+  ASSERT_EQ(section.Get(5), 100);
+  ASSERT_EQ(snapshot.non_air_count(), section.non_air_count());
+  // setting the same block again doesn't copy
+  ChunkSection copy = section;
+  copy.Set(5, 100);
+  ASSERT_TRUE(copy.shared());
+
+  // rewriting everything leaves a shared storage alone as well
+  section.Optimize();
+  section.Fill(3);
+  ASSERT_EQ(copy.Get(5), 100);
+  ASSERT_EQ(copy.Get(6), 6);
+  ASSERT_EQ(section.Get(6), 3);
+  for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+    if (i != 5) {
+      ASSERT_EQ(snapshot.Get(i), i % 7);
+    }
+  }
+
+  // a snapshot read on another thread while the section changes
+  ChunkSection changing;
+  for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+    changing.Set(i, static_cast<BlockId>(i % 3 + 1));
+  }
+  for (int round = 0; round < 20; round++) {
+    auto shared = std::make_shared<const ChunkSection>(changing);
+    std::thread reader([shared, round] {
+      for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+        ASSERT_EQ(shared->Get(i), round == 0 ? i % 3 + 1 : 50 + round - 1)
+            << i;
+      }
+    });
+    shared.reset();
+    changing.Set(1, 1);
+    changing.Fill(static_cast<BlockId>(50 + round));
+    changing.Set(1, 1);
+    changing.Set(1, static_cast<BlockId>(50 + round));
+    reader.join();
+  }
+}
@@ -0,0 +1,216 @@
+#include <filesystem>
+#include <parsers/yaml/yaml.hpp>
+#include <thread>
+#include <world/chunk-io.hpp>
+#include <world/chunk-serializer.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+namespace fs = std::filesystem;
+using namespace world;
+
+namespace {
+struct Sign {
+  std::string text;
+  void Tick(TileContext &context) { context.Sleep(); }
+};
+}  // namespace
+
+template <>
+struct nbt::Schema<Sign> {
+  static constexpr auto fields =
+      std::make_tuple(nbt::field("Text", &Sign::text));
+};
+
+namespace {
+class TestChunkSerializer : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    for (int i = 0; i < 300; i++) {
+      blocks_.push_back(registry_.Register(
+          "minecraft:block_" + std::to_string(i),
+          yaml::Parse("sides:\n  default: block.png")));
+    }
+    tiles_.Register<Sign>("minecraft:sign");
+  }
+
+  // Sections of every storage width, and a few tile entities.
+  std::unique_ptr<Chunk> MakeChunk(ChunkPos pos) {
+    auto chunk = std::make_unique<Chunk>(pos);
+    chunk->section(0).Fill(blocks_[0]);
+    for (int32_t section = 1; section < 6; section++) {
+      const size_t distinct = std::array<size_t, 5>{2, 4, 16, 200, 300}
+          [static_cast<size_t>(section - 1)];
+      for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+        chunk->section(section).Set(i, blocks_[RandomSizeT(0, distinct - 1)]);
+      }
+    }
+    chunk->section(6).Set(100, blocks_[7]);
+    chunk->tile_entities().Emplace<Sign>(1, 2, 3, Sign{"hello"});
+    chunk->tile_entities().Emplace<Sign>(15, 255, 15, Sign{"world"});
+    return chunk;
+  }
+
+  static void ExpectEqual(Chunk const &a, Chunk const &b) {
+    ASSERT_EQ(a.pos(), b.pos());
+    for (int32_t section = 0; section < Chunk::kSectionCount; section++) {
+      for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+        ASSERT_EQ(a.section(section).Get(i), b.section(section).Get(i))
+            << section << " " << i;
+      }
+    }
+  }
+
+  BlockRegistry registry_;
+  TileEntityRegistry tiles_;
+  std::vector<BlockId> blocks_;
+};
+}  // namespace
+
+TEST_F(TestChunkSerializer, RoundTrip) {
+  auto chunk = MakeChunk({-7, 12});
+  ASSERT_EQ(chunk->section(5).bits_per_entry(), ChunkSection::kDirectBits);
+  const nbt::NBT nbt = EncodeChunk(TakeSnapshot(*chunk, registry_, tiles_));
+  // the air sections are left out
+  ASSERT_EQ(nbt::get_list<nbt::TagCompound>(
+                std::get<nbt::TagList>(nbt.at("sections")))
+                .size(),
+            7u);
+  Chunk decoded = DecodeChunk(nbt, registry_, tiles_);
+  ExpectEqual(*chunk, decoded);
+  ASSERT_EQ(decoded.tile_entities().Get<Sign>(1, 2, 3)->text, "hello");
+  ASSERT_EQ(decoded.tile_entities().Get<Sign>(15, 255, 15)->text, "world");
+
+  // through the bytes of a region file
+  const nbt::NBT reread(std::span<const std::byte>(nbt.encode()));
+  ExpectEqual(*chunk, DecodeChunk(reread, registry_, tiles_));
+
+  // blocks the registry doesn't know anymore become air
+  BlockRegistry fewer;
+  for (int i = 0; i < 10; i++) {
+    fewer.Register("minecraft:block_" + std::to_string(i),
+                   yaml::Parse("sides:\n  default: block.png"));
+  }
+  const Chunk partial = DecodeChunk(nbt, fewer, tiles_);
+  for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+    const BlockId block = chunk->section(4).Get(i);
+    ASSERT_EQ(partial.section(4).Get(i),
+              block <= blocks_[9] ? fewer.id(registry_.name(block)) : kAir);
+  }
+
+  nbt::NBT broken = nbt;
+  broken.base.erase("xPos");
+  ASSERT_THROW((void)DecodeChunk(broken, registry_, tiles_),
+               ChunkFormatException);
+  broken = nbt;
+  auto &sections =
+      nbt::get_list<nbt::TagCompound>(broken.at<nbt::TagList>("sections"));
+  std::get<nbt::TagCompound>(sections[1].at("block_states"))
+      .at<nbt::TagLongArray>("data")
+      .pop_back();
+  ASSERT_THROW((void)DecodeChunk(broken, registry_, tiles_),
+               ChunkFormatException);
+}
+
+TEST_F(TestChunkSerializer, Snapshot) {
+  auto chunk = MakeChunk({0, 0});
+  const nbt::NBT before = EncodeChunk(TakeSnapshot(*chunk, registry_, tiles_));
+  ChunkSnapshot snapshot = TakeSnapshot(*chunk, registry_, tiles_);
+  for (int32_t section = 0; section < Chunk::kSectionCount; section++) {
+    ASSERT_TRUE(chunk->section(section).shared());
+  }
+  // the chunk keeps changing, the snapshot doesn't
+  for (int i = 0; i < 1000; i++) {
+    chunk->Set(static_cast<uint32_t>(RandomSizeT(0, 15)),
+               static_cast<uint32_t>(RandomSizeT(0, 127)),
+               static_cast<uint32_t>(RandomSizeT(0, 15)),
+               blocks_[RandomSizeT(0, 20)]);
+  }
+  chunk->tile_entities().Emplace<Sign>(4, 4, 4, Sign{"later"});
+  chunk->section(0).Fill(kAir);
+  ASSERT_EQ(EncodeChunk(snapshot).encode(), before.encode());
+  // untouched sections are still shared
+  ASSERT_TRUE(chunk->section(15).shared());
+
+  // the snapshot keeps the names it was taken with, registrations while it
+  // is encoded don't touch them
+  const size_t names = registry_.size();
+  std::thread encoder(
+      [&] { ASSERT_EQ(EncodeChunk(snapshot).encode(), before.encode()); });
+  for (int i = 0; i < 100; i++) {
+    registry_.Register("minecraft:late_" + std::to_string(i),
+                       yaml::Parse("sides:\n  default: block.png"));
+  }
+  encoder.join();
+  ASSERT_EQ(snapshot.names->size(), names);
+  ASSERT_EQ(registry_.size(), names + 100);
+}
+
+TEST_F(TestChunkSerializer, SaveWithEncoder) {
+  const fs::path dir = fs::temp_directory_path() /
+                       "minecraft_test/TestChunkSerializer";
+  fs::remove_all(dir);
+  std::atomic<int> encoded = 0;
+  auto chunk = MakeChunk({5, 5});
+  {
+    ChunkIO io(dir);
+    auto save = [&] {
+      return io.Save(chunk->pos(),
+                     [&, snapshot = TakeSnapshot(*chunk, registry_, tiles_)] {
+                       encoded++;
+                       return EncodeChunk(snapshot);
+                     });
+    };
+    // every save but the last may be replaced before its encoder runs
+    for (int i = 0; i < 10; i++) {
+      chunk->Set(0, 200, 0, blocks_[static_cast<size_t>(i)]);
+      save();
+    }
+    io.Flush();
+    ASSERT_LE(encoded, 10);
+    ASSERT_EQ(io.stats().encoded, static_cast<uint64_t>(encoded.load()));
+    const auto loaded = io.Load(chunk->pos()).get();
+    ExpectEqual(*chunk, DecodeChunk(*loaded, registry_, tiles_));
+  }
+  fs::remove_all(dir);
+}
+
+TEST_F(TestChunkSerializer, Benchmark) {
+  // 10k chunks with a few blocks in most of their sections
+  std::vector<std::unique_ptr<Chunk>> chunks;
+  for (int32_t i = 0; i < 10000; i++) {
+    auto chunk = std::make_unique<Chunk>(ChunkPos{i % 100, i / 100});
+    for (int32_t section = 0; section < 8; section++) {
+      chunk->section(section).Fill(blocks_[0]);
+      chunk->section(section).Set(static_cast<uint32_t>(i % 4096),
+                                  blocks_[1]);
+    }
+    chunks.push_back(std::move(chunk));
+  }
+  std::vector<ChunkSnapshot> snapshots;
+  snapshots.reserve(chunks.size());
+  const auto begin = std::chrono::high_resolution_clock::now();
+  for (auto const &chunk : chunks) {
+    snapshots.push_back(TakeSnapshot(*chunk, registry_, tiles_));
+  }
+  const auto taken = std::chrono::high_resolution_clock::now();
+  // the next tick writes a block in every chunk, copying one section each
+  for (auto &chunk : chunks) {
+    chunk->Set(0, 0, 0, blocks_[2]);
+  }
+  const auto written = std::chrono::high_resolution_clock::now();
+  size_t sections = 0;
+  for (size_t i = 0; i < 1000; i++) {
+    const nbt::NBT nbt = EncodeChunk(snapshots[i]);
+    sections += nbt::get_list<nbt::TagCompound>(
+                    std::get<nbt::TagList>(nbt.at("sections")))
+                    .size();
+  }
+  const auto encoded = std::chrono::high_resolution_clock::now();
+  std::cout << "Snapshots of 10000 chunks: " << time_diff(begin, taken)
+            << " ms on the main thread, " << time_diff(taken, written)
+            << " ms for the first writes after. Encoding: "
+            << time_diff(written, encoded) / 1000 << " ms per chunk ("
+            << sections << " sections)" << std::endl;
+}
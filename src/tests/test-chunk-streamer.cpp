@@ -0,0 +1,241 @@
+#include <cmath>
+#include <functional>
+#include <set>
+#include <worldgen/chunk-streamer.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace worldgen;
+using world::ChunkPos;
+
+namespace {
+class TestChunkStreamer : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    RegisterTerrainBlocks(registry_);
+    generator_ = std::make_unique<ChunkGenerator>(registry_, 1234);
+  }
+
+  // Updates until nothing is on the way anymore, chunks that don't fit in
+  // the memory budget stay queued. check runs after every update.
+  static void Settle(ChunkStreamer &streamer, float x, float z,
+                     float look_x = 0, float look_z = 0,
+                     std::function<void()> const &check = {}) {
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::minutes(1);
+    while (true) {
+      streamer.Update(x, z, look_x, look_z);
+      if (check) {
+        check();
+      }
+      const StreamingStats stats = streamer.stats();
+      if (stats.in_flight + stats.arrived == 0) {
+        return;
+      }
+      ASSERT_TRUE(
+          streamer.Wait(deadline - std::chrono::steady_clock::now()))
+          << "chunks still on the way";
+    }
+  }
+
+  // The chunks whose center is within distance of the block.
+  static std::set<ChunkPos> InRange(float x, float z, float distance) {
+    std::set<ChunkPos> chunks;
+    const auto radius = static_cast<int32_t>(distance) + 1;
+    const ChunkPos center = world::ToChunkPos(static_cast<int32_t>(x),
+                                              static_cast<int32_t>(z));
+    for (int32_t dz = -radius; dz <= radius; dz++) {
+      for (int32_t dx = -radius; dx <= radius; dx++) {
+        const ChunkPos pos = {center.x + dx, center.z + dz};
+        if (Distance(pos, x, z) <= distance) {
+          chunks.insert(pos);
+        }
+      }
+    }
+    return chunks;
+  }
+
+  static float Distance(ChunkPos pos, float x, float z) {
+    return std::hypot(static_cast<float>(pos.x * 16 + 8) - x,
+                      static_cast<float>(pos.z * 16 + 8) - z) /
+           16;
+  }
+
+  static std::set<ChunkPos> Loaded(ChunkStreamer const &streamer) {
+    std::set<ChunkPos> chunks;
+    streamer.ForEachLoaded(
+        [&](world::Chunk const &chunk) { chunks.insert(chunk.pos()); });
+    return chunks;
+  }
+
+  world::BlockRegistry registry_;
+  std::unique_ptr<ChunkGenerator> generator_;
+};
+}  // namespace
+
+TEST_F(TestChunkStreamer, LoadsAndUnloads) {
+  jobs::JobSystem jobs(2);
+  std::set<ChunkPos> loaded;
+  size_t unloads = 0;
+  ChunkStreamer streamer(
+      *generator_, jobs, {.view_distance = 3, .unload_margin = 1},
+      [&](ProtoChunk &chunk) {
+        ASSERT_TRUE(loaded.insert(chunk.pos()).second);
+        // generated up to the light, which comes along
+        ASSERT_EQ(chunk.status(), ChunkStatus::kFull);
+        ASSERT_EQ(chunk.sky_light(world::Chunk::kSectionCount - 1).Get(0),
+                  world::NibbleArray::kMax);
+      },
+      [&](ProtoChunk &chunk) {
+        ASSERT_EQ(loaded.erase(chunk.pos()), 1u);
+        unloads++;
+      });
+  Settle(streamer, 8, 8);
+  ASSERT_EQ(loaded, InRange(8, 8, 3));
+  ASSERT_EQ(Loaded(streamer), loaded);
+  ASSERT_NE(streamer.Find({3, 0}), nullptr);
+  ASSERT_EQ(streamer.Find({4, 0}), nullptr);
+
+  // one chunk over and back: the margin keeps the chunks behind
+  Settle(streamer, 24, 8);
+  Settle(streamer, 8, 8);
+  ASSERT_EQ(unloads, 0u);
+  ASSERT_EQ(loaded.size(), streamer.stats().loaded);
+  ASSERT_NE(streamer.Find({4, 0}), nullptr);
+
+  // far enough, and the old ones go
+  Settle(streamer, 8 + 16 * 6, 8);
+  ASSERT_GT(unloads, 0u);
+  ASSERT_EQ(loaded, Loaded(streamer));
+  for (ChunkPos pos : loaded) {
+    ASSERT_LE(Distance(pos, 8 + 16 * 6, 8), 4);
+  }
+  ASSERT_TRUE(std::ranges::includes(loaded, InRange(8 + 16 * 6, 8, 3)));
+  const StreamingStats stats = streamer.stats();
+  ASSERT_EQ(stats.unloads, unloads);
+  ASSERT_EQ(stats.loads, loaded.size() + unloads);
+  ASSERT_GT(stats.latency_average.count(), 0);
+  ASSERT_GE(stats.latency_max, stats.latency_average);
+}
+
+TEST_F(TestChunkStreamer, MemoryBudget) {
+  jobs::JobSystem jobs(2);
+  size_t chunk_memory = 0;
+  {
+    ChunkStreamer streamer(*generator_, jobs, {.view_distance = 2});
+    Settle(streamer, 8, 8);
+    chunk_memory = streamer.stats().memory / streamer.stats().loaded;
+  }
+  const size_t budget = chunk_memory * 8;
+  ChunkStreamer streamer(*generator_, jobs,
+                         {.view_distance = 4, .memory_budget = budget});
+  auto within_budget = [&] { ASSERT_LE(streamer.stats().memory, budget); };
+  Settle(streamer, 8, 8, 0, 0, within_budget);
+  const StreamingStats stats = streamer.stats();
+  ASSERT_GE(stats.loaded, 4u);
+  ASSERT_LT(stats.loaded, InRange(8, 8, 4).size());
+  // the nearest ones
+  for (ChunkPos pos : Loaded(streamer)) {
+    ASSERT_LE(Distance(pos, 8, 8), 2.5f);
+  }
+  ASSERT_NE(streamer.Find({0, 0}), nullptr);
+
+  // farther chunks make room for the nearer ones when the player moves
+  Settle(streamer, 8 + 16 * 3, 8, 0, 0, within_budget);
+  ASSERT_NE(streamer.Find({3, 0}), nullptr);
+  ASSERT_EQ(streamer.Find({0, 0}), nullptr);
+
+  // edits are counted once they are reported
+  world::Chunk &chunk = *streamer.Find({3, 0});
+  const size_t before = streamer.stats().memory;
+  for (uint32_t y = 0; y < 16; y++) {
+    for (uint32_t i = 0; i < 256; i++) {
+      const auto block = static_cast<world::BlockId>(i % 7 + 1);
+      chunk.Set(i & 15, 192 + y, i >> 4, block);
+    }
+  }
+  ASSERT_EQ(streamer.stats().memory, before);
+  streamer.OnChunkChanged({3, 0});
+  ASSERT_GT(streamer.stats().memory, before);
+}
+
+TEST_F(TestChunkStreamer, LookDirection) {
+  jobs::JobSystem jobs(1);
+  // one at a time, so the order shows
+  ChunkStreamer streamer(*generator_, jobs,
+                         {.view_distance = 5, .max_in_flight = 1});
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::minutes(1);
+  while (streamer.stats().loads < 30) {
+    streamer.Update(8, 8, 1, 0);
+    ASSERT_TRUE(streamer.Wait(deadline - std::chrono::steady_clock::now()));
+  }
+  int32_t ahead = 0;
+  int32_t behind = 0;
+  for (ChunkPos pos : Loaded(streamer)) {
+    ahead += pos.x > 0;
+    behind += pos.x < 0;
+  }
+  ASSERT_GT(ahead, 2 * behind);
+}
+
+TEST_F(TestChunkStreamer, FastFlight) {
+  jobs::JobSystem jobs(2);
+  ChunkStreamer streamer(*generator_, jobs,
+                         {.view_distance = 3, .unload_margin = 1});
+  // two chunks per tick, much faster than the chunks are generated
+  float x = 8;
+  for (int32_t tick = 0; tick < 100; tick++) {
+    x += 32;
+    streamer.Update(x, 8, 1, 0);
+    for (ChunkPos pos : Loaded(streamer)) {
+      ASSERT_LE(Distance(pos, x, 8), 4);
+    }
+  }
+  StreamingStats stats = streamer.stats();
+  ASSERT_GT(stats.cancelled, 0u);
+  ASSERT_LE(stats.in_flight + stats.arrived, 4u);
+
+  Settle(streamer, x, 8, 1, 0);
+  ASSERT_EQ(Loaded(streamer), InRange(x, 8, 3));
+}
+
+TEST_F(TestChunkStreamer, Benchmark) {
+  jobs::JobSystem jobs;
+  ChunkStreamer streamer(*generator_, jobs, {.view_distance = 8});
+  Settle(streamer, 8, 8);
+  // flying at 2 blocks per tick, twice as fast as vanilla's fastest flight,
+  // with the ticks back to back, then waiting for the streamer to catch up
+  std::chrono::nanoseconds worst{0};
+  std::chrono::nanoseconds total{0};
+  int32_t ticks = 0;
+  auto measure = [&] {
+    const std::chrono::nanoseconds time = streamer.stats().update_time;
+    worst = std::max(worst, time);
+    total += time;
+    ticks++;
+  };
+  float x = 8;
+  for (int32_t tick = 0; tick < 100; tick++) {
+    x += 2;
+    streamer.Update(x, 8, 1, 0);
+    measure();
+  }
+  const auto begin = std::chrono::high_resolution_clock::now();
+  Settle(streamer, x, 8, 1, 0, measure);
+  const double catch_up =
+      time_diff(begin, std::chrono::high_resolution_clock::now());
+  const StreamingStats stats = streamer.stats();
+  auto ms = [](std::chrono::nanoseconds time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+  };
+  std::cout << "Streamed " << stats.loads << " chunks with "
+            << jobs.worker_count() << " workers, " << stats.loaded
+            << " loaded (" << (stats.memory >> 20) << " MiB), "
+            << stats.cancelled << " cancelled. Update "
+            << ms(total / ticks) << " ms average, " << ms(worst)
+            << " ms worst. Latency " << ms(stats.latency_average)
+            << " ms average, " << ms(stats.latency_max)
+            << " ms worst. Caught up in " << catch_up << " ms" << std::endl;
+}
@@ -0,0 +1,222 @@
+#include <cmath>
+#include <numbers>
+#include <set>
+#include <world/frustum-culler.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace world;
+
+namespace {
+using Matrix = std::array<float, 16>;
+
+// Column-major, as glm::perspective and glm::lookAt build them.
+Matrix Multiply(Matrix const &a, Matrix const &b) {
+  Matrix result{};
+  for (size_t column = 0; column < 4; column++) {
+    for (size_t row = 0; row < 4; row++) {
+      for (size_t i = 0; i < 4; i++) {
+        result[column * 4 + row] += a[i * 4 + row] * b[column * 4 + i];
+      }
+    }
+  }
+  return result;
+}
+
+Matrix Perspective(float fov, float aspect, float near, float far) {
+  const float f = 1 / std::tan(fov / 2);
+  Matrix m{};
+  m[0] = f / aspect;
+  m[5] = f;
+  m[10] = (far + near) / (near - far);
+  m[11] = -1;
+  m[14] = 2 * far * near / (near - far);
+  return m;
+}
+
+// A camera at the position, turned by yaw around y and looking down -z
+// before that.
+Matrix View(std::array<float, 3> position, float yaw) {
+  const float c = std::cos(yaw);
+  const float s = std::sin(yaw);
+  Matrix m{};
+  // the inverse rotation, then the inverse translation
+  m[0] = c;
+  m[2] = s;
+  m[5] = 1;
+  m[8] = -s;
+  m[10] = c;
+  m[15] = 1;
+  m[12] = -(c * position[0] - s * position[2]);
+  m[13] = -position[1];
+  m[14] = -(s * position[0] + c * position[2]);
+  return m;
+}
+
+Frustum MakeFrustum(std::array<float, 3> position, float yaw,
+                    float far = 100) {
+  return Frustum::FromMatrix(
+      Multiply(Perspective(std::numbers::pi_v<float> / 2, 1, 0.1f, far),
+               View(position, yaw)));
+}
+
+Aabb Box(float x, float y, float z, float half) {
+  return {{x - half, y - half, z - half}, {x + half, y + half, z + half}};
+}
+
+// Outside if all corners are behind one plane.
+bool Visible(Frustum const &frustum, Aabb const &box) {
+  for (Plane const &plane : frustum.planes) {
+    bool inside = false;
+    for (int corner = 0; corner < 8; corner++) {
+      float distance = plane.distance;
+      for (size_t axis = 0; axis < 3; axis++) {
+        distance += plane.normal[axis] *
+                    (corner >> axis & 1 ? box.max[axis] : box.min[axis]);
+      }
+      inside |= distance >= 0;
+    }
+    if (!inside) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<utils::SimdLevel> SupportedLevels() {
+  std::vector<utils::SimdLevel> levels;
+  for (auto level : {utils::SimdLevel::kScalar, utils::SimdLevel::kSse2,
+                     utils::SimdLevel::kAvx2}) {
+    if (utils::Supported(level)) {
+      levels.push_back(level);
+    }
+  }
+  return levels;
+}
+}  // namespace
+
+TEST(TestFrustumCuller, Frustum) {
+  const Frustum frustum = MakeFrustum({0, 0, 0}, 0);
+  for (auto level : SupportedLevels()) {
+    FrustumCuller culler(level);
+    const auto ahead = culler.Add(Box(0, 0, -10, 1));
+    (void)culler.Add(Box(0, 0, 10, 1));
+    // right of the 90 degree cone, and beyond the far plane
+    (void)culler.Add(Box(20, 0, -10, 1));
+    (void)culler.Add(Box(0, 0, -150, 1));
+    // straddling the left plane and the near plane
+    const auto left = culler.Add(Box(-10, 0, -10, 1));
+    const auto near = culler.Add(Box(0, 0, 0, 0.5f));
+    const auto visible = culler.Cull(frustum);
+    ASSERT_EQ(std::vector<FrustumCuller::Id>(visible.begin(), visible.end()),
+              (std::vector<FrustumCuller::Id>{ahead, left, near}))
+        << utils::ToString(level);
+  }
+
+  // turned around, what was behind is ahead
+  FrustumCuller culler;
+  (void)culler.Add(Box(0, 0, -10, 1));
+  const auto behind = culler.Add(Box(5, 0, 20, 1));
+  const auto visible = culler.Cull(MakeFrustum({5, 0, 5},
+                                               std::numbers::pi_v<float>));
+  ASSERT_EQ(visible.size(), 1u);
+  ASSERT_EQ(visible[0], behind);
+}
+
+TEST(TestFrustumCuller, Levels) {
+  std::vector<Aabb> boxes;
+  for (int i = 0; i < 10001; i++) {
+    boxes.push_back(Box(static_cast<float>(RandomInt32(-200, 200)),
+                        static_cast<float>(RandomInt32(-200, 200)),
+                        static_cast<float>(RandomInt32(-200, 200)),
+                        static_cast<float>(RandomInt32(1, 8))));
+  }
+  for (int round = 0; round < 8; round++) {
+    const Frustum frustum = MakeFrustum(
+        {static_cast<float>(RandomInt32(-50, 50)), 0,
+         static_cast<float>(RandomInt32(-50, 50))},
+        static_cast<float>(RandomInt32(0, 628)) / 100);
+    std::vector<FrustumCuller::Id> expected;
+    for (size_t i = 0; i < boxes.size(); i++) {
+      if (Visible(frustum, boxes[i])) {
+        expected.push_back(static_cast<FrustumCuller::Id>(i));
+      }
+    }
+    ASSERT_GT(expected.size(), 0u);
+    ASSERT_LT(expected.size(), boxes.size());
+    for (auto level : SupportedLevels()) {
+      FrustumCuller culler(level);
+      for (Aabb const &box : boxes) {
+        (void)culler.Add(box);
+      }
+      const auto visible = culler.Cull(frustum);
+      ASSERT_EQ(std::vector<FrustumCuller::Id>(visible.begin(), visible.end()),
+                expected)
+          << utils::ToString(level);
+    }
+  }
+}
+
+TEST(TestFrustumCuller, AddAndRemove) {
+  const Frustum frustum = MakeFrustum({0, 0, 0}, 0);
+  FrustumCuller culler;
+  std::vector<FrustumCuller::Id> ids;
+  for (int i = 0; i < 20; i++) {
+    ids.push_back(culler.Add(Box(0, 0, -5 - static_cast<float>(i), 0.5f)));
+  }
+  ASSERT_EQ(culler.Cull(frustum).size(), 20u);
+  // the last box moves into the removed slots
+  culler.Remove(ids[3]);
+  culler.Remove(ids[7]);
+  ASSERT_THROW(culler.Remove(ids[7]), CullingException);
+  ASSERT_THROW(culler.Update(1000, Box(0, 0, 0, 1)), CullingException);
+  culler.Update(ids[19], Box(0, 0, 10, 1));
+  auto visible = culler.Cull(frustum);
+  std::set<FrustumCuller::Id> seen(visible.begin(), visible.end());
+  ASSERT_EQ(seen.size(), 17u);
+  ASSERT_FALSE(seen.contains(ids[3]));
+  ASSERT_FALSE(seen.contains(ids[7]));
+  ASSERT_FALSE(seen.contains(ids[19]));
+  // ids are reused
+  const auto reused = culler.Add(Box(0, 0, -3, 1));
+  ASSERT_TRUE(reused == ids[3] || reused == ids[7]);
+  ASSERT_EQ(culler.size(), 19u);
+  ASSERT_EQ(culler.Cull(frustum).size(), 18u);
+
+  // sections are relative to the origin
+  const Aabb section = Aabb::Section({2, -1, 3}, {30, 0, 0});
+  ASSERT_EQ(section.min, (std::array<float, 3>{2, -16, 48}));
+  ASSERT_EQ(section.max, (std::array<float, 3>{18, 0, 64}));
+}
+
+TEST(TestFrustumCuller, Benchmark) {
+  // a 16 chunk view distance of sections: 33 x 16 x 33 is about 17k, so
+  // 50k sections is far beyond it
+  std::vector<Aabb> boxes;
+  for (int32_t x = -28; x < 28; x++) {
+    for (int32_t z = -28; z < 28; z++) {
+      for (int32_t y = 0; y < 16; y++) {
+        boxes.push_back(Aabb::Section({x, y, z}, {0, 64, 0}));
+      }
+    }
+  }
+  boxes.resize(50000);
+  for (auto level : SupportedLevels()) {
+    FrustumCuller culler(level);
+    for (Aabb const &box : boxes) {
+      (void)culler.Add(box);
+    }
+    size_t visible = 0;
+    const auto begin = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < 100; i++) {
+      visible +=
+          culler.Cull(MakeFrustum({0, 0, 0}, static_cast<float>(i), 512))
+              .size();
+    }
+    const auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Culling 50000 boxes (" << utils::ToString(level)
+              << "): " << time_diff(begin, end) / 100 << " ms, "
+              << visible / 100 << " visible" << std::endl;
+  }
+}
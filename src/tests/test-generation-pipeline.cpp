@@ -0,0 +1,234 @@
+#include <set>
+#include <thread>
+#include <worldgen/generation-pipeline.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace worldgen;
+using world::ChunkPos;
+
+namespace {
+class TestGenerationPipeline : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    RegisterTerrainBlocks(registry_);
+    generator_ = std::make_unique<ChunkGenerator>(registry_, 1234);
+  }
+
+  // Blocks, light, biomes and heights of the chunk.
+  static uint64_t Fingerprint(ProtoChunk const &chunk) {
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&](uint64_t value) {
+      hash = (hash ^ value) * 1099511628211ull;
+    };
+    for (int32_t section = 0; section < world::Chunk::kSectionCount;
+         section++) {
+      for (uint32_t i = 0; i < world::ChunkSection::kVolume; i++) {
+        add(chunk.chunk().section(section).Get(i));
+        add(chunk.sky_light(section).Get(i));
+      }
+    }
+    for (uint32_t z = 0; z < world::kChunkSize; z++) {
+      for (uint32_t x = 0; x < world::kChunkSize; x++) {
+        add(chunk.height(x, z));
+        add(static_cast<uint64_t>(chunk.biome(x / 4, z / 4)));
+      }
+    }
+    return hash;
+  }
+
+  // Generates the chunks, requesting them in the given order.
+  std::map<ChunkPos, uint64_t> Generate(std::vector<ChunkPos> const &order,
+                                        unsigned workers,
+                                        bool one_at_a_time = false) {
+    jobs::JobSystem jobs(workers);
+    std::mutex mutex;
+    std::map<ChunkPos, uint64_t> fingerprints;
+    GenerationPipeline pipeline(
+        *generator_, jobs, [&](std::unique_ptr<ProtoChunk> chunk) {
+          EXPECT_EQ(chunk->status(), ChunkStatus::kFull);
+          const uint64_t fingerprint = Fingerprint(*chunk);
+          std::lock_guard lock(mutex);
+          EXPECT_TRUE(fingerprints.emplace(chunk->pos(), fingerprint).second);
+        });
+    for (ChunkPos pos : order) {
+      pipeline.Request(pos);
+      if (one_at_a_time) {
+        pipeline.Wait();
+      }
+    }
+    pipeline.Wait();
+    EXPECT_EQ(pipeline.pending(), 0u);
+    return fingerprints;
+  }
+
+  world::BlockRegistry registry_;
+  std::unique_ptr<ChunkGenerator> generator_;
+};
+}  // namespace
+
+TEST_F(TestGenerationPipeline, Deterministic) {
+  std::vector<ChunkPos> order;
+  for (int32_t z = -3; z <= 3; z++) {
+    for (int32_t x = -3; x <= 3; x++) {
+      order.push_back({x, z});
+    }
+  }
+  const auto expected = Generate(order, 1);
+  ASSERT_EQ(expected.size(), order.size());
+
+  std::shuffle(order.begin(), order.end(), std::mt19937(RandomUint32()));
+  ASSERT_EQ(Generate(order, 4), expected);
+  // every chunk leaves the pipeline before the next one is requested, so
+  // the neighbours are generated again each time
+  std::reverse(order.begin(), order.end());
+  ASSERT_EQ(Generate(order, 3, true), expected);
+
+  jobs::JobSystem jobs(2);
+  std::map<ChunkPos, uint64_t> pregenerated;
+  std::mutex mutex;
+  const PregenerationStats stats =
+      Pregenerate(*generator_, jobs, {0, 0}, 3,
+                  [&](std::unique_ptr<ProtoChunk> chunk) {
+                    std::lock_guard lock(mutex);
+                    pregenerated[chunk->pos()] = Fingerprint(*chunk);
+                  });
+  ASSERT_EQ(stats.chunks, order.size());
+  ASSERT_EQ(pregenerated, expected);
+}
+
+TEST_F(TestGenerationPipeline, PlansNeighbors) {
+  jobs::JobSystem jobs(2);
+  std::unique_ptr<ProtoChunk> result;
+  GenerationPipeline pipeline(*generator_, jobs,
+                              [&](std::unique_ptr<ProtoChunk> chunk) {
+                                result = std::move(chunk);
+                              });
+  pipeline.Request({10, -7});
+  pipeline.Request({10, -7});
+  pipeline.Wait();
+  ASSERT_TRUE(result);
+  ASSERT_EQ(result->pos(), (ChunkPos{10, -7}));
+  // light needs the 3x3 chunks at features, which need 5x5 at surface,
+  // terrain needs the biomes one chunk further
+  const std::array<uint64_t, kChunkStatusCount> expected = {0,  49, 25, 25,
+                                                            25, 9,  1};
+  ASSERT_EQ(pipeline.stages_run(), expected);
+  // the helpers are gone
+  ASSERT_EQ(pipeline.resident(), 0u);
+}
+
+TEST_F(TestGenerationPipeline, Cancel) {
+  std::vector<ChunkPos> order;
+  for (int32_t z = -3; z <= 3; z++) {
+    for (int32_t x = -3; x <= 3; x++) {
+      order.push_back({x, z});
+    }
+  }
+  const auto expected = Generate(order, 1);
+
+  jobs::JobSystem jobs(2);
+  std::mutex mutex;
+  std::map<ChunkPos, uint64_t> fingerprints;
+  GenerationPipeline pipeline(
+      *generator_, jobs, [&](std::unique_ptr<ProtoChunk> chunk) {
+        const uint64_t fingerprint = Fingerprint(*chunk);
+        std::lock_guard lock(mutex);
+        fingerprints.emplace(chunk->pos(), fingerprint);
+      });
+  for (ChunkPos pos : order) {
+    pipeline.Request(pos);
+  }
+  // a checkerboard of them is taken back, what they needed goes with them
+  std::set<ChunkPos> cancelled;
+  for (ChunkPos pos : order) {
+    if ((pos.x + pos.z) % 2 != 0 && pipeline.Cancel(pos)) {
+      cancelled.insert(pos);
+    }
+  }
+  ASSERT_FALSE(pipeline.Cancel({100, 100}));
+  ASSERT_EQ(pipeline.cancelled(), cancelled.size());
+  pipeline.Wait();
+  for (ChunkPos pos : order) {
+    if (cancelled.contains(pos)) {
+      ASSERT_FALSE(fingerprints.contains(pos));
+    } else {
+      ASSERT_EQ(fingerprints.at(pos), expected.at(pos));
+    }
+  }
+  // the stages still running when the last chunk was handed out finish
+  const auto begin = std::chrono::steady_clock::now();
+  while (pipeline.resident() > 0 &&
+         std::chrono::steady_clock::now() - begin < std::chrono::seconds(10)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  ASSERT_EQ(pipeline.resident(), 0u);
+
+  // cancelled right away, far from everything else
+  for (int32_t i = 0; i < 20; i++) {
+    pipeline.Request({1000 + i * 10, 0});
+  }
+  for (int32_t i = 0; i < 20; i++) {
+    ASSERT_TRUE(pipeline.Cancel({1000 + i * 10, 0}));
+  }
+  pipeline.Wait();
+  // only the chunks handed out were finished
+  ASSERT_EQ(pipeline.stages_run()[static_cast<size_t>(ChunkStatus::kFull)],
+            order.size() - cancelled.size());
+}
+
+TEST_F(TestGenerationPipeline, Terrain) {
+  jobs::JobSystem jobs(2);
+  std::vector<std::unique_ptr<ProtoChunk>> chunks;
+  std::mutex mutex;
+  Pregenerate(*generator_, jobs, {0, 0}, 2,
+              [&](std::unique_ptr<ProtoChunk> chunk) {
+                std::lock_guard lock(mutex);
+                chunks.push_back(std::move(chunk));
+              });
+  const GeneratorBlocks blocks = GeneratorBlocks::Resolve(registry_);
+  size_t leaves = 0;
+  for (auto const &proto : chunks) {
+    world::Chunk const &chunk = proto->chunk();
+    for (uint32_t z = 0; z < world::kChunkSize; z++) {
+      for (uint32_t x = 0; x < world::kChunkSize; x++) {
+        ASSERT_EQ(chunk.Get(x, 0, z), blocks.bedrock);
+        const uint32_t height = proto->height(x, z);
+        ASSERT_GT(height, 0u);
+        const world::BlockId top = chunk.Get(x, height, z);
+        ASSERT_TRUE(top == blocks.grass || top == blocks.sand ||
+                    top == blocks.stone || top == blocks.dirt)
+            << registry_.name(top);
+        for (uint32_t y = height + 1; y < world::Chunk::kHeight; y++) {
+          const world::BlockId block = chunk.Get(x, y, z);
+          ASSERT_TRUE(block == world::kAir || block == blocks.leaves ||
+                      block == blocks.log);
+          leaves += block == blocks.leaves;
+        }
+        // open sky above, darkness in the bedrock
+        ASSERT_EQ(proto->sky_light(15).Get(x, 15, z), 15);
+        ASSERT_EQ(proto->sky_light(0).Get(x, 0, z), 0);
+      }
+    }
+  }
+  ASSERT_GT(leaves, 0u);
+}
+
+TEST_F(TestGenerationPipeline, Benchmark) {
+  jobs::JobSystem jobs;
+  const PregenerationStats stats =
+      Pregenerate(*generator_, jobs, {100, 100}, 8);
+  std::cout << "Pregenerated " << stats.chunks << " chunks with "
+            << jobs.worker_count() << " workers in "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(
+                   stats.time)
+                   .count()
+            << " ms: " << stats.chunks_per_second() << " chunks/s" << std::endl;
+  std::cout << "Stages run:";
+  for (size_t status = 1; status < kChunkStatusCount; status++) {
+    std::cout << " " << StageName(static_cast<ChunkStatus>(status)) << " "
+              << stats.stages_run[status];
+  }
+  std::cout << std::endl;
+}
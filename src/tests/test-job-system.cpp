@@ -0,0 +1,174 @@
+#include <jobs/job-system.hpp>
+#include <numeric>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace jobs;
+
+TEST(TestJobSystem, Dependencies) {
+  JobSystem system(3);
+  std::mutex mutex;
+  std::vector<std::string> order;
+  auto log = [&](std::string name) {
+    return [&, name] {
+      std::lock_guard lock(mutex);
+      order.push_back(name);
+    };
+  };
+  // a diamond: root -> left, right -> join
+  JobHandle root = system.Schedule(log("root"));
+  JobHandle left = system.Then(root, log("left"));
+  JobHandle right = system.Then(root, log("right"), Priority::kLow);
+  const std::array<JobHandle, 3> parents{left, right, JobHandle{}};
+  JobHandle join = system.Schedule(log("join"), Priority::kHigh, parents);
+  system.Wait(join);
+
+  ASSERT_TRUE(root.done() && left.done() && right.done());
+  ASSERT_EQ(order.size(), 4u);
+  ASSERT_EQ(order.front(), "root");
+  ASSERT_EQ(order.back(), "join");
+  // a finished job can still be depended on
+  std::atomic<bool> late = false;
+  system.Wait(system.Then(join, [&] { late = true; }));
+  ASSERT_TRUE(late);
+}
+
+TEST(TestJobSystem, Priorities) {
+  JobSystem system(1);
+  std::atomic<bool> started = false;
+  std::atomic<bool> release = false;
+  system.Schedule([&] {
+    started = true;
+    while (!release) {
+      std::this_thread::yield();
+    }
+  });
+  // the only worker is busy, so every job is queued when it gets to them
+  while (!started) {
+    std::this_thread::yield();
+  }
+  std::mutex mutex;
+  std::vector<Priority> order;
+  std::vector<JobHandle> handles;
+  for (Priority priority : {Priority::kLow, Priority::kNormal, Priority::kHigh}) {
+    handles.push_back(system.Schedule(
+        [&, priority] {
+          std::lock_guard lock(mutex);
+          order.push_back(priority);
+        },
+        priority));
+  }
+  release = true;
+  // don't help, the order has to come from the worker
+  while (!std::all_of(handles.begin(), handles.end(),
+                      [](JobHandle const &job) { return job.done(); })) {
+    std::this_thread::yield();
+  }
+  ASSERT_EQ(order, (std::vector<Priority>{Priority::kHigh, Priority::kNormal,
+                                          Priority::kLow}));
+}
+
+TEST(TestJobSystem, MainThreadQueue) {
+  JobSystem system(2);
+  ASSERT_TRUE(system.is_main_thread());
+  std::atomic<int> worker_side = 0;
+  std::thread::id ran_on;
+  JobHandle prepare = system.Schedule([&] { worker_side = 1; });
+  JobHandle upload = system.ScheduleOnMainThread(
+      [&] { ran_on = std::this_thread::get_id(); }, {&prepare, 1});
+  while (!prepare.done()) {
+    std::this_thread::yield();
+  }
+  // nothing runs main thread jobs behind our back
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  ASSERT_FALSE(upload.done());
+  ASSERT_EQ(system.RunMainThreadJobs(), 1u);
+  ASSERT_TRUE(upload.done());
+  ASSERT_EQ(ran_on, std::this_thread::get_id());
+
+  // waiting on the main thread runs its queue too
+  JobHandle chained = system.Then(
+      system.ScheduleOnMainThread([&] { worker_side = 2; }),
+      [&] { worker_side = worker_side * 10; });
+  system.Wait(chained);
+  ASSERT_EQ(worker_side, 20);
+}
+
+TEST(TestJobSystem, Exceptions) {
+  JobSystem system(2);
+  std::atomic<bool> continued = false;
+  JobHandle failing =
+      system.Schedule([] { throw std::runtime_error("job failed"); });
+  JobHandle next = system.Then(failing, [&] { continued = true; });
+  ASSERT_THROW(system.Wait(failing), std::runtime_error);
+  system.Wait(next);
+  ASSERT_TRUE(continued);
+}
+
+TEST(TestJobSystem, ParallelFor) {
+  JobSystem system;
+  constexpr size_t kCount = 1'000'000;
+  std::vector<uint64_t> values(kCount);
+  std::iota(values.begin(), values.end(), 0);
+  std::atomic<uint64_t> sum = 0;
+  system.Wait(system.ParallelFor(kCount, 4096, [&](size_t begin, size_t end) {
+    uint64_t local = 0;
+    for (size_t i = begin; i < end; i++) {
+      local += values[i];
+    }
+    sum += local;
+  }));
+  ASSERT_EQ(sum, uint64_t{kCount} * (kCount - 1) / 2);
+  system.Wait(system.ParallelFor(0, 16, [](size_t, size_t) { FAIL(); }));
+
+  // the other ranges still run
+  std::atomic<size_t> processed = 0;
+  JobHandle failing = system.ParallelFor(100, 10, [&](size_t begin, size_t) {
+    if (begin == 50) {
+      throw std::runtime_error("range failed");
+    }
+    processed++;
+  });
+  ASSERT_THROW(system.Wait(failing), std::runtime_error);
+  ASSERT_EQ(processed, 9u);
+}
+
+TEST(TestJobSystem, Shutdown) {
+  std::atomic<size_t> ran = 0;
+  {
+    JobSystem system(2);
+    for (int i = 0; i < 100; i++) {
+      JobHandle first = system.Schedule([&] {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        ran++;
+      });
+      system.Then(first, [&] { ran++; });
+    }
+    system.ScheduleOnMainThread([&] { ran += 1000; });
+  }
+  // queued jobs and their continuations ran, the main thread job didn't
+  ASSERT_EQ(ran, 200u);
+}
+
+TEST(TestJobSystem, Benchmark) {
+  JobSystem system;
+  constexpr size_t kJobs = 100'000;
+  std::atomic<size_t> counter = 0;
+  auto begin = std::chrono::high_resolution_clock::now();
+  std::vector<JobHandle> handles;
+  handles.reserve(kJobs);
+  for (size_t i = 0; i < kJobs; i++) {
+    handles.push_back(system.Schedule([&counter] { counter++; }));
+  }
+  system.Wait(system.Schedule([] {}, Priority::kNormal, handles));
+  auto end = std::chrono::high_resolution_clock::now();
+  ASSERT_EQ(counter, kJobs);
+
+  const WorkerStats stats = system.total_stats();
+  std::cout << kJobs << " jobs on " << system.worker_count()
+            << " workers: " << time_diff(begin, end) << " ms, "
+            << stats.stolen << "/" << stats.steal_attempts << " steals, "
+            << std::chrono::duration<double, std::milli>(stats.idle).count()
+            << " ms idle" << std::endl;
+}
@@ -0,0 +1,298 @@
+#include <parsers/yaml/yaml.hpp>
+#include <set>
+#include <world/light-engine.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace world;
+
+namespace {
+class TestLightEngine : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    stone_ = registry_.Register("minecraft:stone",
+                                yaml::Parse("sides:\n  default: stone.png"));
+    glass_ = registry_.Register(
+        "minecraft:glass",
+        yaml::Parse("transparent: true\nsides:\n  default: glass.png"));
+    glowstone_ = registry_.Register(
+        "minecraft:glowstone",
+        yaml::Parse("light: 15\nsides:\n  default: glowstone.png"));
+    torch_ = registry_.Register(
+        "minecraft:torch",
+        yaml::Parse("light: 14\ntransparent: true\nsides:\n  default: "
+                    "torch_on.png"));
+  }
+
+  // The chunks in [-radius, radius]^2, stone below y = ground.
+  void Load(LightEngine &engine, int32_t radius, int32_t ground) {
+    for (int32_t z = -radius; z <= radius; z++) {
+      for (int32_t x = -radius; x <= radius; x++) {
+        auto chunk = std::make_unique<Chunk>(ChunkPos{x, z});
+        for (int32_t section = 0; section < ground / 16; section++) {
+          chunk->section(section).Fill(stone_);
+        }
+        for (uint32_t y = static_cast<uint32_t>(ground / 16 * 16);
+             y < static_cast<uint32_t>(ground); y++) {
+          for (uint32_t bz = 0; bz < 16; bz++) {
+            for (uint32_t bx = 0; bx < 16; bx++) {
+              chunk->Set(bx, y, bz, stone_);
+            }
+          }
+        }
+        engine.AddChunk(*chunk);
+        chunks_[{x, z}] = std::move(chunk);
+      }
+    }
+  }
+
+  void Set(LightEngine &engine, int32_t x, int32_t y, int32_t z,
+           BlockId block) {
+    Chunk &chunk = *chunks_.at(ToChunkPos(x, z));
+    const BlockId old = chunk.Set(static_cast<uint32_t>(x & 15),
+                                  static_cast<uint32_t>(y),
+                                  static_cast<uint32_t>(z & 15), block);
+    engine.OnBlockChanged(x, y, z, old);
+  }
+
+  // Carves an air box, both corners included.
+  void Carve(LightEngine &engine, std::array<int32_t, 3> from,
+             std::array<int32_t, 3> to) {
+    for (int32_t y = from[1]; y <= to[1]; y++) {
+      for (int32_t z = from[2]; z <= to[2]; z++) {
+        for (int32_t x = from[0]; x <= to[0]; x++) {
+          Set(engine, x, y, z, kAir);
+        }
+      }
+    }
+  }
+
+  // The incremental result must match lighting the same blocks at once.
+  void ExpectFromScratch(LightEngine const &engine) {
+    jobs::JobSystem jobs(2);
+    LightEngine scratch(registry_, jobs);
+    for (auto const &[pos, chunk] : chunks_) {
+      scratch.AddChunk(*chunk);
+    }
+    scratch.Update();
+    for (auto const &[pos, chunk] : chunks_) {
+      ChunkLight const &expected = *scratch.light(pos);
+      ChunkLight const &actual = *engine.light(pos);
+      for (size_t section = 0; section < Chunk::kSectionCount; section++) {
+        for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+          ASSERT_EQ(actual.sky[section].Get(i), expected.sky[section].Get(i))
+              << "sky at " << pos.x << " " << pos.z << " " << section << " "
+              << i;
+          ASSERT_EQ(actual.block[section].Get(i),
+                    expected.block[section].Get(i))
+              << "block at " << pos.x << " " << pos.z << " " << section
+              << " " << i;
+        }
+      }
+    }
+  }
+
+  BlockRegistry registry_;
+  BlockId stone_ = 0;
+  BlockId glass_ = 0;
+  BlockId glowstone_ = 0;
+  BlockId torch_ = 0;
+  std::map<ChunkPos, std::unique_ptr<Chunk>> chunks_;
+};
+}  // namespace
+
+TEST_F(TestLightEngine, Sky) {
+  jobs::JobSystem jobs(2);
+  LightEngine engine(registry_, jobs);
+  Load(engine, 1, 64);
+  const LightStats stats = engine.Update();
+  ASSERT_EQ(stats.relit_chunks, 9u);
+  ASSERT_EQ(engine.sky_light(5, 64, 5), 15);
+  ASSERT_EQ(engine.sky_light(5, 63, 5), 0);
+  ASSERT_EQ(engine.sky_light(5, 300, 5), 15);
+  ASSERT_EQ(engine.sky_light(100, 64, 5), 0);
+
+  // a shaft gets full sky light, its sides none
+  Carve(engine, {5, 20, 5}, {5, 63, 5});
+  engine.Update();
+  ASSERT_EQ(engine.sky_light(5, 20, 5), 15);
+  ASSERT_EQ(engine.sky_light(6, 20, 5), 0);
+  // a room at the bottom is lit from the shaft
+  Carve(engine, {-3, 10, -3}, {12, 19, 12});
+  engine.Update();
+  ASSERT_EQ(engine.sky_light(5, 19, 5), 15);
+  ASSERT_EQ(engine.sky_light(5, 10, 5), 15);
+  ASSERT_EQ(engine.sky_light(8, 19, 5), 12);
+  ASSERT_EQ(engine.sky_light(-3, 10, 5), 7);
+  ExpectFromScratch(engine);
+
+  // glass lets it through, stone caps it
+  Set(engine, 5, 63, 5, glass_);
+  engine.Update();
+  ASSERT_EQ(engine.sky_light(5, 10, 5), 15);
+  Set(engine, 5, 63, 5, stone_);
+  engine.Update();
+  ASSERT_EQ(engine.sky_light(5, 62, 5), 0);
+  ASSERT_EQ(engine.sky_light(5, 10, 5), 0);
+  ExpectFromScratch(engine);
+}
+
+TEST_F(TestLightEngine, BlockLight) {
+  jobs::JobSystem jobs(2);
+  std::set<SectionPos> changed;
+  LightEngine engine(registry_, jobs,
+                     [&](SectionPos pos) { changed.insert(pos); });
+  Load(engine, 1, 96);
+  Carve(engine, {-8, 40, -8}, {24, 60, 24});
+  engine.Update();
+  ASSERT_EQ(engine.block_light(8, 50, 8), 0);
+  ASSERT_EQ(engine.sky_light(8, 50, 8), 0);
+
+  changed.clear();
+  Set(engine, 8, 50, 8, glowstone_);
+  const LightStats placed = engine.Update();
+  ASSERT_EQ(placed.changes, 1u);
+  for (int32_t d = 0; d < 15; d++) {
+    ASSERT_EQ(engine.block_light(8 + d, 50, 8), 15 - d);
+    ASSERT_EQ(engine.block_light(8, 50 - d / 2, 8 - (d + 1) / 2), 15 - d);
+  }
+  ASSERT_TRUE(changed.contains({0, 3, 0}));
+  // the light reaches into the neighbours
+  ASSERT_TRUE(changed.contains({1, 3, 0}));
+  ASSERT_FALSE(changed.contains({0, 0, 0}));
+  ExpectFromScratch(engine);
+
+  // a torch keeps part of it
+  Set(engine, 12, 50, 8, torch_);
+  engine.Update();
+  ASSERT_EQ(engine.block_light(12, 50, 8), 14);
+  ASSERT_EQ(engine.block_light(8, 50, 8), 15);
+  Set(engine, 8, 50, 8, kAir);
+  const LightStats removed = engine.Update();
+  ASSERT_GT(removed.removed, 0u);
+  ASSERT_EQ(engine.block_light(8, 50, 8), 10);
+  ASSERT_EQ(engine.block_light(12, 50, 8), 14);
+  ExpectFromScratch(engine);
+
+  Set(engine, 12, 50, 8, kAir);
+  engine.Update();
+  for (int32_t x = -8; x <= 24; x++) {
+    ASSERT_EQ(engine.block_light(x, 50, 8), 0);
+  }
+  ExpectFromScratch(engine);
+}
+
+TEST_F(TestLightEngine, LateRegistrations) {
+  jobs::JobSystem jobs(2);
+  LightEngine engine(registry_, jobs);
+  // not in the tables of the engine, so opaque and dark
+  const BlockId lantern = registry_.Register(
+      "minecraft:sea_lantern",
+      yaml::Parse("light: 15\ntransparent: true\nsides:\n  default: "
+                  "sea_lantern.png"));
+  Load(engine, 1, 64);
+  Carve(engine, {5, 20, 5}, {5, 63, 5});
+  engine.Update();
+  ASSERT_EQ(engine.sky_light(5, 20, 5), 15);
+  Set(engine, 5, 40, 5, lantern);
+  engine.Update();
+  ASSERT_EQ(engine.sky_light(5, 40, 5), 0);
+  ASSERT_EQ(engine.sky_light(5, 39, 5), 0);
+  ASSERT_EQ(engine.block_light(5, 39, 5), 0);
+  Set(engine, 5, 40, 5, kAir);
+  engine.Update();
+  ASSERT_EQ(engine.sky_light(5, 20, 5), 15);
+}
+
+TEST_F(TestLightEngine, RandomEdits) {
+  jobs::JobSystem jobs(3);
+  LightEngine engine(registry_, jobs);
+  Load(engine, 2, 70);
+  engine.Update();
+  const std::array<BlockId, 6> blocks = {kAir,   kAir,       stone_,
+                                         glass_, glowstone_, torch_};
+  for (int round = 0; round < 6; round++) {
+    for (int i = 0; i < 300; i++) {
+      // clusters, so edits interact
+      const int32_t x = RandomInt32(-32, 40) / 4 * 4 + RandomInt32(0, 3);
+      const int32_t y = RandomInt32(40, 80);
+      const int32_t z = RandomInt32(-32, 40) / 4 * 4 + RandomInt32(0, 3);
+      Set(engine, x, y, z, blocks[RandomSizeT(0, blocks.size() - 1)]);
+    }
+    const LightStats stats = engine.Update();
+    ASSERT_GT(stats.groups, stats.rounds);
+    ExpectFromScratch(engine);
+  }
+}
+
+TEST_F(TestLightEngine, Chunks) {
+  jobs::JobSystem jobs(2);
+  LightEngine engine(registry_, jobs);
+  Load(engine, 0, 64);
+  Carve(engine, {14, 40, 4}, {15, 50, 4});
+  Set(engine, 14, 45, 4, glowstone_);
+  engine.Update();
+  ASSERT_EQ(engine.block_light(15, 45, 4), 14);
+  // the light and the edits of unloaded chunks are dropped
+  ASSERT_EQ(engine.block_light(16, 45, 4), 0);
+  ASSERT_EQ(engine.section_light({1, 2, 0}).sky, nullptr);
+  engine.OnBlockChanged(20, 45, 4, stone_);
+  ASSERT_EQ(engine.pending(), 0u);
+
+  // a new neighbour pulls the light in
+  auto chunk = std::make_unique<Chunk>(ChunkPos{1, 0});
+  for (uint32_t y = 0; y < 64; y++) {
+    for (uint32_t z = 0; z < 16; z++) {
+      for (uint32_t x = 0; x < 16; x++) {
+        chunk->Set(x, y, z, y < 40 || y > 50 || z != 4 ? stone_ : kAir);
+      }
+    }
+  }
+  engine.AddChunk(*chunk);
+  chunks_[{1, 0}] = std::move(chunk);
+  engine.Update();
+  ASSERT_EQ(engine.block_light(16, 45, 4), 13);
+  ASSERT_EQ(engine.block_light(20, 45, 4), 9);
+  ASSERT_EQ(engine.section_light({1, 2, 0}).sky, &engine.light({1, 0})->sky[2]);
+  ExpectFromScratch(engine);
+
+  engine.RemoveChunk({1, 0});
+  ASSERT_EQ(engine.light({1, 0}), nullptr);
+  ASSERT_EQ(engine.block_light(16, 45, 4), 0);
+}
+
+TEST_F(TestLightEngine, Benchmark) {
+  jobs::JobSystem jobs;
+  LightEngine engine(registry_, jobs);
+  Load(engine, 1, 128);
+  // a cave as large as the light reaches
+  Carve(engine, {-8, 20, -8}, {24, 60, 24});
+  engine.Update();
+  auto measure = [&](char const *name, auto &&edit) {
+    edit();
+    const LightStats stats = engine.Update();
+    std::cout << name << ": "
+              << std::chrono::duration<double, std::micro>(stats.time).count()
+              << " us, " << stats.removed << " cells removed, " << stats.added
+              << " added, " << stats.sections_changed << " sections changed"
+              << std::endl;
+  };
+  measure("Glowstone placed in a cave",
+          [&] { Set(engine, 8, 40, 8, glowstone_); });
+  measure("Glowstone removed in a cave", [&] { Set(engine, 8, 40, 8, kAir); });
+
+  // a shaft from the surface down to the cave
+  Carve(engine, {0, 61, 0}, {0, 126, 0});
+  engine.Update();
+  measure("Shaft opened to the sky", [&] { Set(engine, 0, 127, 0, kAir); });
+  measure("Shaft closed", [&] { Set(engine, 0, 127, 0, stone_); });
+
+  measure("Chunk relit from scratch", [&] { engine.Relight({0, 0}); });
+  // edits spread over many sections run in parallel
+  measure("100 torches over 4 chunks", [&] {
+    for (int32_t i = 0; i < 100; i++) {
+      Set(engine, -8 + i % 10 * 3, 21 + i / 10 * 4, -8 + i % 7 * 4, torch_);
+    }
+  });
+}
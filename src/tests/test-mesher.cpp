@@ -0,0 +1,319 @@
+#include <parsers/yaml/yaml.hpp>
+#include <world/mesher.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace world;
+
+namespace {
+class TestMesher : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    stone_ = registry_.Register("minecraft:stone",
+                                yaml::Parse("sides:\n  default: stone.png"));
+    grass_ = registry_.Register("minecraft:grass", yaml::Parse(R"(sides:
+  default: dirt.png
+  sides: grass_side.png
+  top: grass_top.png)"));
+    glass_ = registry_.Register(
+        "minecraft:glass",
+        yaml::Parse("transparent: true\nsides:\n  default: glass.png"));
+  }
+
+  // every face a naive mesher would emit, one per block
+  [[nodiscard]] size_t VisibleFaces(PaddedSection const &blocks) const {
+    size_t faces = 0;
+    constexpr std::array<std::array<int32_t, 3>, kDirectionCount> kOffsets{
+        {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, -1}, {0, 0, 1}}};
+    for (int32_t y = 0; y < 16; y++) {
+      for (int32_t z = 0; z < 16; z++) {
+        for (int32_t x = 0; x < 16; x++) {
+          const BlockId block = blocks.Get(x, y, z);
+          for (auto const &offset : kOffsets) {
+            const BlockId neighbor =
+                blocks.Get(x + offset[0], y + offset[1], z + offset[2]);
+            faces += block != kAir && block != neighbor &&
+                     registry_.transparent(neighbor);
+          }
+        }
+      }
+    }
+    return faces;
+  }
+
+  // quads cover exactly the visible faces, and face outwards
+  static size_t CheckQuads(SectionMesh const &mesh) {
+    EXPECT_EQ(mesh.indices.size(), mesh.quad_count() * 6);
+    size_t area = 0;
+    for (size_t quad = 0; quad < mesh.quad_count(); quad++) {
+      std::array<VertexAttributes, 4> v;
+      for (size_t i = 0; i < v.size(); i++) {
+        v[i] = Decode(mesh.vertices[quad * 4 + i]);
+      }
+      std::array<float, 3> a, b;
+      for (int i = 0; i < 3; i++) {
+        a[i] = float(v[1].position[i]) - float(v[0].position[i]);
+        b[i] = float(v[2].position[i]) - float(v[0].position[i]);
+      }
+      const std::array<float, 3> normal{a[1] * b[2] - a[2] * b[1],
+                                        a[2] * b[0] - a[0] * b[2],
+                                        a[0] * b[1] - a[1] * b[0]};
+      const auto face = static_cast<size_t>(v[0].face);
+      const float expected = face % 2 ? 1.0f : -1.0f;
+      EXPECT_GT(normal[face / 2] * expected, 0.0f) << "quad " << quad;
+      area += static_cast<size_t>(v[2].uv[0] * v[2].uv[1]);
+
+      // the shared edge of the two triangles is the darker diagonal
+      const uint16_t *indices = &mesh.indices[quad * 6];
+      auto ao = [&](uint16_t index) { return v[index - quad * 4].ao; };
+      const int split = ao(indices[0]) + ao(indices[2]);
+      const int other = ao(indices[1]) + ao(indices[5]);
+      EXPECT_LE(split, other) << "quad " << quad;
+    }
+    return area;
+  }
+
+  // calls check(attributes) for the top faces of a floor at y = 0
+  template <typename Check>
+  static void ForEachFloorVertex(SectionMesh const &mesh, Check &&check) {
+    for (MeshVertex const packed : mesh.vertices) {
+      const VertexAttributes vertex = Decode(packed);
+      if (vertex.face == Direction::kTop && vertex.position[1] == 1) {
+        check(vertex);
+      }
+    }
+  }
+
+  BlockRegistry registry_;
+  BlockId stone_ = 0, grass_ = 0, glass_ = 0;
+  SectionMesher mesher_{registry_};
+  SectionMesh mesh_;
+  std::array<ChunkSection const *, kDirectionCount> no_neighbors_{};
+};
+}  // namespace
+
+TEST_F(TestMesher, SingleBlock) {
+  ChunkSection section;
+  section.Set(3, 4, 5, grass_);
+  mesher_.Mesh(section, no_neighbors_, mesh_);
+  ASSERT_EQ(mesh_.quad_count(), 6u);
+  ASSERT_EQ(mesh_.vertices.size(), 24u);
+  ASSERT_EQ(CheckQuads(mesh_), 6u);
+  for (MeshVertex const packed : mesh_.vertices) {
+    const VertexAttributes vertex = Decode(packed);
+    ASSERT_GE(vertex.position[0], 3);
+    ASSERT_LE(vertex.position[0], 4);
+    ASSERT_GE(vertex.position[1], 4);
+    ASSERT_LE(vertex.position[2], 6);
+    const Direction face = vertex.face;
+    ASSERT_EQ(vertex.texture, registry_.diffuse_texture(grass_, face));
+  }
+
+  ChunkSection air;
+  mesher_.Mesh(air, no_neighbors_, mesh_);
+  ASSERT_TRUE(mesh_.empty());
+}
+
+TEST_F(TestMesher, GreedyMerging) {
+  // a full section is six quads, or nothing when buried
+  ChunkSection stone(stone_);
+  mesher_.Mesh(stone, no_neighbors_, mesh_);
+  ASSERT_EQ(mesh_.quad_count(), 6u);
+  ASSERT_EQ(CheckQuads(mesh_), 6u * 256);
+  std::array<ChunkSection const *, kDirectionCount> buried;
+  buried.fill(&stone);
+  mesher_.Mesh(stone, buried, mesh_);
+  ASSERT_TRUE(mesh_.empty());
+
+  // the top neighbour hides the top faces
+  std::array<ChunkSection const *, kDirectionCount> covered{};
+  covered[static_cast<size_t>(Direction::kTop)] = &stone;
+  mesher_.Mesh(stone, covered, mesh_);
+  ASSERT_EQ(mesh_.quad_count(), 5u);
+
+  // different textures don't merge: a grass floor on top of stone
+  ChunkSection floor;
+  for (uint32_t z = 0; z < 16; z++) {
+    for (uint32_t x = 0; x < 16; x++) {
+      floor.Set(x, 0, z, stone_);
+      floor.Set(x, 1, z, grass_);
+    }
+  }
+  mesher_.Mesh(floor, no_neighbors_, mesh_);
+  // top, bottom, and 4 sides of each layer
+  ASSERT_EQ(mesh_.quad_count(), 10u);
+  ASSERT_EQ(CheckQuads(mesh_), 2u * 256 + 8u * 16);
+}
+
+TEST_F(TestMesher, Transparency) {
+  ChunkSection section;
+  section.Set(0, 0, 0, glass_);
+  section.Set(1, 0, 0, glass_);
+  section.Set(2, 0, 0, stone_);
+  PaddedSection padded;
+  padded.Copy(section, no_neighbors_);
+  ASSERT_EQ(padded.Get(-1, 0, 0), kAir);
+  // glass against glass is hidden, stone against glass isn't,
+  // glass against stone is
+  ASSERT_EQ(VisibleFaces(padded), 4u + 4u + 1u + 1u + 5u);
+  mesher_.Mesh(padded, mesh_);
+  ASSERT_EQ(CheckQuads(mesh_), VisibleFaces(padded));
+}
+
+TEST_F(TestMesher, MatchesNaiveFaces) {
+  ChunkSection section, east;
+  const std::array<BlockId, 4> blocks{kAir, stone_, grass_, glass_};
+  for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+    section.Set(i, blocks[RandomSizeT(0, 3)]);
+    east.Set(i, blocks[RandomSizeT(0, 3)]);
+  }
+  std::array<ChunkSection const *, kDirectionCount> neighbors{};
+  neighbors[static_cast<size_t>(Direction::kEast)] = &east;
+  PaddedSection padded;
+  padded.Copy(section, neighbors);
+  ASSERT_EQ(padded.Get(16, 7, 9), east.Get(0, 7, 9));
+  ASSERT_EQ(padded.Get(15, 7, 9), section.Get(15, 7, 9));
+  mesher_.Mesh(section, neighbors, mesh_);
+  ASSERT_EQ(CheckQuads(mesh_), VisibleFaces(padded));
+  ASSERT_LT(mesh_.quad_count(), VisibleFaces(padded));
+}
+
+TEST_F(TestMesher, AmbientOcclusion) {
+  // a floor with a pillar on it, everything around the pillar is occluded
+  ChunkSection section;
+  for (uint32_t z = 0; z < 16; z++) {
+    for (uint32_t x = 0; x < 16; x++) {
+      section.Set(x, 0, z, stone_);
+    }
+  }
+  section.Set(5, 1, 5, stone_);
+  section.Set(5, 2, 5, stone_);
+  mesher_.Mesh(section, no_neighbors_, mesh_);
+  CheckQuads(mesh_);
+  size_t occluded = 0;
+  ForEachFloorVertex(mesh_, [&](VertexAttributes const &vertex) {
+    const bool near = (vertex.position[0] == 5 || vertex.position[0] == 6) &&
+                      (vertex.position[2] == 5 || vertex.position[2] == 6);
+    ASSERT_EQ(vertex.ao, near ? 2 : 3);
+    occluded += near;
+  });
+  // every corner of the pillar is shared by the three visible floor faces
+  // around it
+  ASSERT_EQ(occluded, 4u * 3);
+  const size_t smooth = mesh_.quad_count();
+
+  // an inner corner between two walls is fully occluded
+  section.Set(4, 1, 6, stone_);
+  mesher_.Mesh(section, no_neighbors_, mesh_);
+  CheckQuads(mesh_);
+  ForEachFloorVertex(mesh_, [&](VertexAttributes const &vertex) {
+    if (vertex.position[0] == 5 && vertex.position[2] == 6) {
+      ASSERT_EQ(vertex.ao, 0);
+    }
+  });
+
+  // flat shading merges the whole floor again
+  section.Set(4, 1, 6, kAir);
+  mesher_.set_smooth_lighting(false);
+  mesher_.Mesh(section, no_neighbors_, mesh_);
+  ForEachFloorVertex(mesh_,
+                     [](VertexAttributes const &vertex) {
+                       ASSERT_EQ(vertex.ao, 3);
+                     });
+  ASSERT_LT(mesh_.quad_count(), smooth);
+}
+
+TEST_F(TestMesher, SmoothLight) {
+  ChunkSection section;
+  for (uint32_t z = 0; z < 16; z++) {
+    for (uint32_t x = 0; x < 16; x++) {
+      section.Set(x, 0, z, stone_);
+    }
+  }
+  // a torch-like block light on the floor, the sky is left out
+  NibbleArray block_light;
+  block_light.Set(8, 1, 8, 15);
+  block_light.Set(9, 1, 8, 3);
+  block_light.Set(9, 1, 8, 0);
+  ASSERT_EQ(block_light.Get(8, 1, 8), 15);
+  ASSERT_EQ(block_light.Get(9, 1, 8), 0);
+  const std::array<SectionLight, kDirectionCount> no_light{};
+  mesher_.Mesh(section, no_neighbors_, {nullptr, &block_light}, no_light,
+               mesh_);
+  CheckQuads(mesh_);
+  ForEachFloorVertex(mesh_, [](VertexAttributes const &vertex) {
+    // one lit block out of the four in front of the corner
+    const bool lit = (vertex.position[0] == 8 || vertex.position[0] == 9) &&
+                     (vertex.position[2] == 8 || vertex.position[2] == 9);
+    ASSERT_EQ(vertex.block_light, lit ? 4 : 0);
+    ASSERT_EQ(vertex.sky_light, 15);
+  });
+
+  // flat: the light of the block in front, on the lit face only
+  mesher_.set_smooth_lighting(false);
+  mesher_.Mesh(section, no_neighbors_, {nullptr, &block_light}, no_light,
+               mesh_);
+  size_t lit = 0;
+  ForEachFloorVertex(mesh_, [&](VertexAttributes const &vertex) {
+    ASSERT_TRUE(vertex.block_light == 0 || vertex.block_light == 15);
+    lit += vertex.block_light == 15;
+  });
+  ASSERT_EQ(lit, 4u);
+}
+
+TEST_F(TestMesher, Benchmark) {
+  // rolling hills: stone, three layers of dirt-like grass, air above
+  constexpr int kSections = 256;
+  std::vector<ChunkSection> sections(kSections);
+  for (int s = 0; s < kSections; s++) {
+    const int base = RandomInt32(2, 10);
+    for (uint32_t z = 0; z < 16; z++) {
+      for (uint32_t x = 0; x < 16; x++) {
+        const int height =
+            base + static_cast<int>(3 * std::sin((x + s) * 0.4) +
+                                    2 * std::cos((z + s) * 0.3));
+        for (int y = 0; y < std::clamp(height, 0, 16); y++) {
+          sections[s].Set(x, static_cast<uint32_t>(y), z,
+                          y + 3 < height ? stone_ : grass_);
+        }
+      }
+    }
+  }
+
+  // returns the time per section in us
+  size_t vertices = 0, naive = 0;
+  auto run = [&](bool smooth) {
+    mesher_.set_smooth_lighting(smooth);
+    vertices = 0;
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (ChunkSection const &section : sections) {
+      mesher_.Mesh(section, no_neighbors_, mesh_);
+      vertices += mesh_.vertices.size();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return time_diff(begin, end) * 1000 / kSections;
+  };
+  // best of five, alternating so both see the same machine
+  double flat = std::numeric_limits<double>::max();
+  double smooth = flat;
+  size_t flat_vertices = 0;
+  for (int i = 0; i < 5; i++) {
+    flat = std::min(flat, run(false));
+    flat_vertices = vertices;
+    smooth = std::min(smooth, run(true));
+  }
+  PaddedSection padded;
+  for (ChunkSection const &section : sections) {
+    padded.Copy(section, no_neighbors_);
+    naive += VisibleFaces(padded) * 4;
+  }
+  std::cout << "greedy meshing: " << vertices / kSections
+            << " vertices per section (" << naive / kSections
+            << " without merging), " << smooth << " us per section"
+            << std::endl;
+  std::cout << "flat shading: " << flat_vertices / kSections
+            << " vertices per section, " << flat
+            << " us per section, smooth lighting costs "
+            << (smooth / flat - 1) * 100 << "% more" << std::endl;
+}
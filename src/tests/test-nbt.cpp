@@ -0,0 +1,481 @@
+#include <filesystem>
+#include <sstream>
+#include <utils/nbt-bind.hpp>
+#include <utils/nbt-compression.hpp>
+#include <utils/nbt.hpp>
+#include <utils/snbt.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+nbt::NBT SampleDocument() {
+  nbt::NBT nbt{"Level"};
+  nbt["byte"] = nbt::TagByte{-12};
+  nbt["short"] = nbt::TagShort{1234};
+  nbt["int"] = nbt::TagInt{-123456};
+  nbt["long"] = nbt::TagLong{1234567890123};
+  nbt["float"] = nbt::TagFloat{0.5f};
+  nbt["double"] = nbt::TagDouble{-1e100};
+  nbt["string"] = nbt::TagString{"Hello, world!"};
+  nbt["bytes"] = nbt::TagByteArray{1, -2, 3};
+  nbt["ints"] = nbt::TagIntArray{1, -2, 3, 1 << 30};
+  nbt["longs"] = nbt::TagLongArray{1, -2, int64_t(1) << 60};
+  nbt["list"] = nbt::TagList{1.0, 2.0, 3.0};
+  nbt["strings"] = nbt::TagList{"a", "b", "c"};
+  nbt::TagCompound nested{{"name", nbt::TagString{"stone"}},
+                          {"count", nbt::TagByte{64}}};
+  nbt["nested"] = nested;
+  nbt["compounds"] = nbt::TagList{nested, nested};
+  std::vector<nbt::TagLong> heightmap(256);
+  for (size_t i = 0; i < heightmap.size(); i++) {
+    heightmap[i] = RandomInt64();
+  }
+  nbt["heightmap"] = heightmap;
+  return nbt;
+}
+
+std::string Encode(nbt::NBT const &nbt) {
+  std::ostringstream stream;
+  nbt.encode(stream);
+  return stream.str();
+}
+
+enum class Facing : int8_t { kNorth, kEast, kSouth, kWest };
+
+struct Item {
+  std::string id;
+  int8_t count = 0;
+  std::optional<std::string> custom_name;
+};
+
+struct Furnace {
+  int32_t x = 0, y = 0, z = 0;
+  Facing facing = Facing::kNorth;
+  bool lit = false;
+  int16_t burn_time = 0;
+  float experience = 0;
+  std::vector<Item> items;
+  std::vector<int32_t> recipes;
+  std::vector<int64_t> history;
+  std::vector<std::string> tags;
+  std::optional<Item> output;
+};
+}  // namespace
+
+template <>
+struct nbt::Schema<Item> {
+  static constexpr auto fields = std::make_tuple(
+      nbt::field("id", &Item::id), nbt::field("Count", &Item::count),
+      nbt::field("CustomName", &Item::custom_name));
+};
+
+template <>
+struct nbt::Schema<Furnace> {
+  static constexpr auto fields = std::make_tuple(
+      nbt::field("x", &Furnace::x), nbt::field("y", &Furnace::y),
+      nbt::field("z", &Furnace::z), nbt::field("facing", &Furnace::facing),
+      nbt::field("lit", &Furnace::lit),
+      nbt::field("BurnTime", &Furnace::burn_time),
+      nbt::field("Experience", &Furnace::experience),
+      nbt::field("Items", &Furnace::items),
+      nbt::field("RecipesUsed", &Furnace::recipes),
+      nbt::field("History", &Furnace::history),
+      nbt::field("Tags", &Furnace::tags),
+      nbt::field("Output", &Furnace::output));
+};
+
+namespace {
+Furnace SampleFurnace() {
+  Furnace furnace;
+  furnace.x = -12;
+  furnace.y = 64;
+  furnace.z = 1 << 20;
+  furnace.facing = Facing::kWest;
+  furnace.lit = true;
+  furnace.burn_time = 1600;
+  furnace.experience = 0.7f;
+  furnace.items = {{"minecraft:iron_ore", 12, std::nullopt},
+                   {"minecraft:coal", 3, "Fuel"}};
+  furnace.recipes = {1, -2, 3};
+  furnace.history = {int64_t(1) << 40, -1};
+  furnace.tags = {"hot", "busy"};
+  return furnace;
+}
+
+std::string EncodeStruct(Furnace const &furnace) {
+  std::ostringstream stream;
+  nbt::encode_struct(stream, furnace, "Furnace");
+  return stream.str();
+}
+}  // namespace
+
+TEST(TestNBT, SpanDecodingMatchesStream) {
+  const nbt::NBT nbt = SampleDocument();
+  const std::string raw = Encode(nbt);
+  const nbt::NBT from_stream{std::istringstream{raw}};
+  const nbt::NBT from_span{std::as_bytes(std::span{raw})};
+  ASSERT_EQ(from_span.name, nbt.name);
+  ASSERT_EQ(Encode(from_stream), raw);
+  ASSERT_EQ(Encode(from_span), raw);
+}
+
+TEST(TestNBT, TruncatedSpanThrows) {
+  const std::string raw = Encode(SampleDocument());
+  for (size_t size : {size_t(1), size_t(5), raw.size() / 2, raw.size() - 1}) {
+    auto data = std::as_bytes(std::span{raw}).first(size);
+    ASSERT_THROW(nbt::NBT{data}, std::runtime_error) << size;
+  }
+}
+
+TEST(TestNBT, BufferEncodingMatchesStream) {
+  for (nbt::NBT const &nbt :
+       {SampleDocument(), nbt::NBT{}, nbt::NBT{"empty"}}) {
+    const std::string raw = Encode(nbt);
+    ASSERT_EQ(nbt.encoded_size(), raw.size());
+    const std::vector<std::byte> encoded = nbt.encode();
+    ASSERT_TRUE(std::ranges::equal(encoded, std::as_bytes(std::span{raw})));
+
+    std::vector<std::byte> buffer(raw.size() + 10, std::byte{0xff});
+    ASSERT_EQ(nbt.encode(buffer), raw.size());
+    ASSERT_TRUE(std::ranges::equal(std::span{buffer}.first(raw.size()),
+                                   encoded));
+    ASSERT_EQ(buffer.back(), std::byte{0xff});
+    ASSERT_THROW(
+        (void)nbt.encode(std::span{buffer}.first(raw.size() - 1)),
+        std::runtime_error);
+  }
+}
+
+TEST(TestNBT, CompressionRoundTrip) {
+  const nbt::NBT nbt = SampleDocument();
+  const std::string raw = Encode(nbt);
+  for (auto compression : {nbt::Compression::kNone, nbt::Compression::kGzip,
+                           nbt::Compression::kZlib}) {
+    auto data = nbt::encode_compressed(nbt, compression);
+    ASSERT_EQ(nbt::detect_compression(data), compression);
+    ASSERT_EQ(Encode(nbt::decode_compressed(data)), raw);
+  }
+}
+
+TEST(TestNBT, InflateSizeHints) {
+  std::string raw = RandomString(1 << 20, "abcdef");
+  auto bytes = std::as_bytes(std::span{raw});
+  auto compressed = nbt::deflate(bytes, nbt::Compression::kZlib);
+  // exact, too small, too large and unknown sizes must all give the same data
+  for (size_t hint : {raw.size(), size_t(16), raw.size() * 3, size_t(0)}) {
+    auto inflated = nbt::inflate(compressed, nbt::Compression::kZlib, hint);
+    ASSERT_TRUE(std::equal(inflated.begin(), inflated.end(), bytes.begin(),
+                           bytes.end()))
+        << hint;
+  }
+  auto truncated = std::span{compressed}.first(compressed.size() / 2);
+  ASSERT_THROW((void)nbt::inflate(truncated, nbt::Compression::kZlib),
+               std::runtime_error);
+
+  // a gzip trailer claiming almost 4 GiB doesn't allocate them
+  const std::string small = Encode(SampleDocument());
+  auto gzip = nbt::deflate(std::as_bytes(std::span{small}),
+                           nbt::Compression::kGzip);
+  std::fill(gzip.end() - 4, gzip.end(), std::byte{0xff});
+  ASSERT_THROW((void)nbt::inflate(gzip, nbt::Compression::kGzip),
+               std::runtime_error);
+  const auto hinted = nbt::inflate(
+      nbt::deflate(std::as_bytes(std::span{small}), nbt::Compression::kZlib),
+      nbt::Compression::kZlib, size_t(1) << 32);
+  ASSERT_EQ(hinted.size(), small.size());
+  ASSERT_LT(hinted.capacity(), size_t(1) << 24);
+}
+
+TEST(TestNBT, FileRoundTrip) {
+  const fs::path dir = fs::temp_directory_path() / "minecraft_test/test_nbt";
+  fs::create_directories(dir);
+  const nbt::NBT nbt = SampleDocument();
+  nbt::save_file(dir / "level.dat", nbt);
+  nbt::save_file(dir / "raw.nbt", nbt, nbt::Compression::kNone);
+  ASSERT_EQ(Encode(nbt::load_file(dir / "level.dat")), Encode(nbt));
+  ASSERT_EQ(Encode(nbt::load_file(dir / "raw.nbt")), Encode(nbt));
+  fs::remove_all(dir);
+}
+
+TEST(TestNBT, SnbtParsing) {
+  auto tag = nbt::parse_snbt(R"( {
+    name: "Steve \"the\" miner", 'quoted key': 'it\'s',
+    Health: 20.5f, Air: 300s, OnGround: true, Dim: -1b, Time: 123456789012L,
+    Pos: [1.5d, 64.0, -3.5D], Tags: [a, b.c, d_e], Empty: [],
+    Data: [I; 1, -2, 3], Bytes: [B; 1b, 2B], Longs: [L; 1L, -2l],
+    Nested: {Items: [{id: stone, Count: 64b}, {id: "dirt", Count: 1b}]},
+    Version: 1, Version2: 3e2, NotANumber: 1.2.3
+  } )");
+  ASSERT_EQ(tag.at<nbt::TagString>("name"), "Steve \"the\" miner");
+  ASSERT_EQ(tag.at<nbt::TagString>("quoted key"), "it's");
+  ASSERT_EQ(tag.at<nbt::TagFloat>("Health"), 20.5f);
+  ASSERT_EQ(tag.at<nbt::TagShort>("Air"), 300);
+  ASSERT_EQ(tag.at<nbt::TagByte>("OnGround"), 1);
+  ASSERT_EQ(tag.at<nbt::TagByte>("Dim"), -1);
+  ASSERT_EQ(tag.at<nbt::TagLong>("Time"), 123456789012);
+  ASSERT_EQ(nbt::get_list<nbt::TagDouble>(tag.at<nbt::TagList>("Pos")),
+            (std::vector<nbt::TagDouble>{1.5, 64.0, -3.5}));
+  ASSERT_EQ(nbt::get_list<nbt::TagString>(tag.at<nbt::TagList>("Tags")),
+            (std::vector<nbt::TagString>{"a", "b.c", "d_e"}));
+  ASSERT_EQ(tag.at<nbt::TagList>("Empty").index(), nbt::TAG_END);
+  ASSERT_EQ(tag.at<nbt::TagIntArray>("Data"), (nbt::TagIntArray{1, -2, 3}));
+  ASSERT_EQ(tag.at<nbt::TagByteArray>("Bytes"), (nbt::TagByteArray{1, 2}));
+  ASSERT_EQ(tag.at<nbt::TagLongArray>("Longs"), (nbt::TagLongArray{1, -2}));
+  auto &items = nbt::get_list<nbt::TagCompound>(
+      tag.at<nbt::TagCompound>("Nested").at<nbt::TagList>("Items"));
+  ASSERT_EQ(items.size(), 2u);
+  ASSERT_EQ(items[0].at<nbt::TagString>("id"), "stone");
+  ASSERT_EQ(items[1].at<nbt::TagByte>("Count"), 1);
+  ASSERT_EQ(tag.at<nbt::TagInt>("Version"), 1);
+  ASSERT_EQ(tag.at<nbt::TagDouble>("Version2"), 300.0);
+  ASSERT_EQ(tag.at<nbt::TagString>("NotANumber"), "1.2.3");
+}
+
+TEST(TestNBT, SnbtErrors) {
+  for (auto const *text :
+       {"", "{", "{a:}", "{a:1,}", "{a 1}", "{a:[1,2b]}", "{a:[X;1]}",
+        "{a:[B;300]}", "{a:\"unterminated}", "{a:1} trailing", "{a:'\\x'}"}) {
+    ASSERT_THROW((void)nbt::parse_snbt(text), nbt::SnbtException) << text;
+  }
+}
+
+TEST(TestNBT, SnbtRoundTrip) {
+  const nbt::NBT nbt = SampleDocument();
+  std::string snbt;
+  nbt::write_snbt(snbt, nbt);
+  ASSERT_EQ(snbt.find(' '), snbt.find("Hello, world!") + 6);
+  nbt::NBT parsed{nbt::parse_snbt(snbt)};
+  parsed.name = nbt.name;
+  ASSERT_EQ(Encode(parsed), Encode(nbt));
+  // the buffer is reused as is
+  snbt.clear();
+  nbt::write_snbt(snbt, parsed);
+  ASSERT_EQ(snbt, nbt::to_snbt(nbt));
+}
+
+TEST(TestNBT, SnbtBenchmark) {
+  using clock = std::chrono::high_resolution_clock;
+  constexpr int kIterations = 20;
+  nbt::NBT nbt{"Level"};
+  std::vector<nbt::TagCompound> entity_list;
+  for (int i = 0; i < 512; i++) {
+    nbt::NBT entity = SampleDocument();
+    entity["id"] = nbt::TagString{"minecraft:zombie_" + std::to_string(i)};
+    entity_list.push_back(entity);
+  }
+  nbt["Entities"] = nbt::TagList(entity_list);
+
+  const std::string binary = Encode(nbt);
+  std::string snbt;
+  nbt::write_snbt(snbt, nbt);
+
+  double binary_encode = 0, binary_decode = 0, snbt_write = 0, snbt_parse = 0;
+  for (int i = 0; i < kIterations; i++) {
+    auto begin = clock::now();
+    ASSERT_EQ(Encode(nbt).size(), binary.size());
+    auto end = clock::now();
+    binary_encode += time_diff(begin, end);
+
+    begin = clock::now();
+    nbt::NBT decoded{std::as_bytes(std::span{binary})};
+    end = clock::now();
+    binary_decode += time_diff(begin, end);
+    ASSERT_EQ(decoded.base.size(), nbt.base.size());
+
+    begin = clock::now();
+    snbt.clear();
+    nbt::write_snbt(snbt, nbt);
+    end = clock::now();
+    snbt_write += time_diff(begin, end);
+
+    begin = clock::now();
+    auto parsed = nbt::parse_snbt(snbt);
+    end = clock::now();
+    snbt_parse += time_diff(begin, end);
+    ASSERT_EQ(parsed.base.size(), nbt.base.size());
+  }
+  std::cout << "binary: " << binary.size() << " bytes, encode "
+            << binary_encode / kIterations << " ms, decode "
+            << binary_decode / kIterations << " ms\n"
+            << "snbt:   " << snbt.size() << " bytes, write "
+            << snbt_write / kIterations << " ms, parse "
+            << snbt_parse / kIterations << " ms\n";
+}
+
+TEST(TestNBT, BindEncodesPlainNbt) {
+  const std::string raw = EncodeStruct(SampleFurnace());
+  // the generic decoder must see the same document the binding wrote
+  nbt::NBT nbt{std::as_bytes(std::span{raw})};
+  ASSERT_EQ(nbt.name, "Furnace");
+  ASSERT_EQ(nbt.at<nbt::TagInt>("z"), 1 << 20);
+  ASSERT_EQ(nbt.at<nbt::TagByte>("facing"), 3);
+  ASSERT_EQ(nbt.at<nbt::TagByte>("lit"), 1);
+  ASSERT_EQ(nbt.at<nbt::TagShort>("BurnTime"), 1600);
+  ASSERT_EQ(nbt.at<nbt::TagFloat>("Experience"), 0.7f);
+  ASSERT_EQ(nbt.at<nbt::TagIntArray>("RecipesUsed"),
+            (nbt::TagIntArray{1, -2, 3}));
+  ASSERT_EQ(nbt.at<nbt::TagLongArray>("History").size(), 2u);
+  ASSERT_EQ(nbt::get_list<nbt::TagString>(nbt.at<nbt::TagList>("Tags")),
+            (std::vector<nbt::TagString>{"hot", "busy"}));
+  auto &items = nbt::get_list<nbt::TagCompound>(nbt.at<nbt::TagList>("Items"));
+  ASSERT_EQ(items.size(), 2u);
+  ASSERT_FALSE(items[0].base.contains("CustomName"));
+  ASSERT_EQ(items[1].at<nbt::TagString>("CustomName"), "Fuel");
+  ASSERT_FALSE(nbt.base.contains("Output"));
+}
+
+TEST(TestNBT, BindRoundTrip) {
+  Furnace furnace = SampleFurnace();
+  furnace.output = Item{"minecraft:iron_ingot", 7, std::nullopt};
+  const std::string raw = EncodeStruct(furnace);
+  for (int i = 0; i < 2; i++) {
+    const Furnace decoded =
+        i == 0 ? nbt::decode_struct<Furnace>(std::as_bytes(std::span{raw}))
+               : nbt::decode_struct<Furnace>(std::istringstream{raw});
+    ASSERT_EQ(EncodeStruct(decoded), raw);
+    ASSERT_EQ(decoded.facing, Facing::kWest);
+    ASSERT_EQ(decoded.items[1].custom_name, "Fuel");
+    ASSERT_FALSE(decoded.items[0].custom_name.has_value());
+    ASSERT_EQ(decoded.output->count, 7);
+  }
+}
+
+TEST(TestNBT, BindEncodesIntoVector) {
+  const Furnace furnace = SampleFurnace();
+  std::vector<std::byte> buffer;
+  nbt::encode_struct(buffer, furnace, "Furnace");
+  const std::string raw = EncodeStruct(furnace);
+  ASSERT_TRUE(std::ranges::equal(buffer, std::as_bytes(std::span{raw})));
+}
+
+TEST(TestNBT, BindSkipsUnknownTags) {
+  // a document written by a newer version with extra and missing fields
+  nbt::NBT nbt = SampleDocument();
+  nbt["BurnTime"] = nbt::TagShort{200};
+  nbt["Items"] = nbt::TagList{nbt::TagCompound{
+      {"id", nbt::TagString{"minecraft:sand"}},
+      {"Count", nbt::TagByte{5}},
+      {"tag", nbt::TagCompound{{"Damage", nbt::TagInt{3}}}}}};
+  const std::string raw = Encode(nbt);
+  const Furnace furnace =
+      nbt::decode_struct<Furnace>(std::as_bytes(std::span{raw}));
+  ASSERT_EQ(furnace.burn_time, 200);
+  ASSERT_EQ(furnace.items.size(), 1u);
+  ASSERT_EQ(furnace.items[0].id, "minecraft:sand");
+  ASSERT_EQ(furnace.items[0].count, 5);
+  ASSERT_EQ(furnace.x, 0);
+  ASSERT_TRUE(furnace.tags.empty());
+
+  nbt["x"] = nbt::TagString{"not an int"};
+  const std::string invalid = Encode(nbt);
+  ASSERT_THROW(
+      (void)nbt::decode_struct<Furnace>(std::as_bytes(std::span{invalid})),
+      std::runtime_error);
+  const std::string truncated = raw.substr(0, raw.size() / 2);
+  ASSERT_THROW(
+      (void)nbt::decode_struct<Furnace>(std::as_bytes(std::span{truncated})),
+      std::runtime_error);
+}
+
+TEST(TestNBT, BindBenchmark) {
+  using clock = std::chrono::high_resolution_clock;
+  constexpr int kIterations = 20000;
+  const Furnace furnace = SampleFurnace();
+  std::ostringstream stream;
+  double bound_encode = 0, bound_decode = 0, generic_encode = 0,
+         generic_decode = 0;
+  for (int i = 0; i < kIterations; i++) {
+    stream.str({});
+    auto begin = clock::now();
+    nbt::encode_struct(stream, furnace);
+    auto end = clock::now();
+    bound_encode += time_diff(begin, end);
+    const std::string raw = stream.str();
+
+    begin = clock::now();
+    const Furnace decoded =
+        nbt::decode_struct<Furnace>(std::as_bytes(std::span{raw}));
+    end = clock::now();
+    bound_decode += time_diff(begin, end);
+    ASSERT_EQ(decoded.items.size(), furnace.items.size());
+
+    // the same document built and read by hand through TagCompound
+    stream.str({});
+    begin = clock::now();
+    nbt::NBT nbt{""};
+    nbt["x"] = nbt::TagInt{furnace.x};
+    nbt["y"] = nbt::TagInt{furnace.y};
+    nbt["z"] = nbt::TagInt{furnace.z};
+    nbt["facing"] = static_cast<nbt::TagByte>(furnace.facing);
+    nbt["lit"] = nbt::TagByte{furnace.lit};
+    nbt["BurnTime"] = nbt::TagShort{furnace.burn_time};
+    nbt["Experience"] = nbt::TagFloat{furnace.experience};
+    std::vector<nbt::TagCompound> items;
+    for (auto const &item : furnace.items) {
+      nbt::TagCompound compound{{"id", item.id}, {"Count", item.count}};
+      if (item.custom_name) compound["CustomName"] = *item.custom_name;
+      items.push_back(std::move(compound));
+    }
+    nbt["Items"] = nbt::TagList(items);
+    nbt["RecipesUsed"] = furnace.recipes;
+    nbt["History"] = furnace.history;
+    nbt["Tags"] = nbt::TagList(furnace.tags);
+    nbt.encode(stream);
+    end = clock::now();
+    generic_encode += time_diff(begin, end);
+
+    begin = clock::now();
+    nbt::NBT generic{std::as_bytes(std::span{raw})};
+    Furnace manual;
+    manual.x = generic.at<nbt::TagInt>("x");
+    manual.burn_time = generic.at<nbt::TagShort>("BurnTime");
+    for (auto &item : nbt::get_list<nbt::TagCompound>(
+             generic.at<nbt::TagList>("Items"))) {
+      manual.items.push_back({item.at<nbt::TagString>("id"),
+                              item.at<nbt::TagByte>("Count"), std::nullopt});
+    }
+    manual.recipes = generic.at<nbt::TagIntArray>("RecipesUsed");
+    end = clock::now();
+    generic_decode += time_diff(begin, end);
+  }
+  std::cout << "bound:       encode " << bound_encode * 1000 / kIterations
+            << " us, decode " << bound_decode * 1000 / kIterations << " us\n"
+            << "TagCompound: encode " << generic_encode * 1000 / kIterations
+            << " us, decode " << generic_decode * 1000 / kIterations
+            << " us\n";
+}
+
+TEST(TestNBT, EncodeBenchmark) {
+  using clock = std::chrono::high_resolution_clock;
+  constexpr int kIterations = 20;
+  nbt::NBT nbt{"Level"};
+  std::vector<nbt::TagCompound> sections;
+  for (int i = 0; i < 64; i++) {
+    sections.push_back(SampleDocument());
+  }
+  nbt["Sections"] = nbt::TagList(sections);
+
+  double stream_encode = 0, buffer_encode = 0;
+  size_t size = 0;
+  for (int i = 0; i < kIterations; i++) {
+    auto begin = clock::now();
+    std::ostringstream stream;
+    nbt.encode(stream);
+    const std::string raw = stream.str();
+    auto end = clock::now();
+    stream_encode += time_diff(begin, end);
+
+    begin = clock::now();
+    const std::vector<std::byte> encoded = nbt.encode();
+    end = clock::now();
+    buffer_encode += time_diff(begin, end);
+    ASSERT_EQ(encoded.size(), raw.size());
+    size = raw.size();
+  }
+  std::cout << size << " bytes, ostream encode "
+            << stream_encode / kIterations << " ms, buffer encode "
+            << buffer_encode / kIterations << " ms\n";
+}
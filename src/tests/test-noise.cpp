@@ -0,0 +1,234 @@
+#include <cstring>
+#include <worldgen/noise.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace worldgen;
+
+namespace {
+std::vector<SimdLevel> SupportedLevels() {
+  std::vector<SimdLevel> levels;
+  for (SimdLevel level :
+       {SimdLevel::kScalar, SimdLevel::kSse2, SimdLevel::kAvx2}) {
+    if (Supported(level)) {
+      levels.push_back(level);
+    }
+  }
+  return levels;
+}
+
+NoiseSettings RandomSettings() {
+  NoiseSettings settings;
+  settings.seed = RandomInt32(INT32_MIN, INT32_MAX);
+  settings.frequency = 1.0f / static_cast<float>(RandomUint32(1, 256));
+  settings.octaves = RandomUint32(1, 8);
+  return settings;
+}
+}  // namespace
+
+TEST(TestNoise, IdenticalAcrossLevels) {
+  for (int i = 0; i < 20; i++) {
+    const NoiseSettings settings = RandomSettings();
+    // odd sizes leave partial vectors
+    const std::array<uint32_t, 3> size = {RandomUint32(1, 19),
+                                          RandomUint32(1, 19),
+                                          RandomUint32(1, 19)};
+    const std::array<float, 3> origin = {
+        static_cast<float>(RandomInt32(-100000, 100000)),
+        static_cast<float>(RandomInt32(-256, 256)),
+        static_cast<float>(RandomInt32(-100000, 100000))};
+    const size_t count = static_cast<size_t>(size[0]) * size[1] * size[2];
+
+    std::vector<float> grid(count), plane(size[0] * size[2]);
+    FractalNoise(settings, SimdLevel::kScalar)
+        .FillGrid(origin, size, 0.75f, grid);
+    FractalNoise(settings, SimdLevel::kScalar)
+        .FillPlane({origin[0], origin[2]}, {size[0], size[2]}, 0.75f, plane);
+    for (SimdLevel level : SupportedLevels()) {
+      FractalNoise noise(settings, level);
+      std::vector<float> other(count), other_plane(plane.size());
+      noise.FillGrid(origin, size, 0.75f, other);
+      noise.FillPlane({origin[0], origin[2]}, {size[0], size[2]}, 0.75f,
+                      other_plane);
+      ASSERT_EQ(std::memcmp(grid.data(), other.data(), count * sizeof(float)),
+                0)
+          << ToString(level);
+      ASSERT_EQ(std::memcmp(plane.data(), other_plane.data(),
+                            plane.size() * sizeof(float)),
+                0)
+          << ToString(level);
+    }
+  }
+}
+
+TEST(TestNoise, HugeCoordinates) {
+  // beyond 2^31 the lattice coordinates saturate, the same on every level
+  NoiseSettings settings;
+  settings.octaves = 3;
+  const std::vector<float> x = {3e9f,  -3e9f, 1e12f, -1e20f, 2147483520.0f,
+                                -2147483648.0f, 5e9f, 0.5f, -7e10f};
+  std::vector<float> y(x.rbegin(), x.rend()), z(x.size(), 1e10f);
+  std::vector<float> expected(x.size());
+  FractalNoise(settings, SimdLevel::kScalar).Sample(x, y, z, expected);
+  for (SimdLevel level : SupportedLevels()) {
+    std::vector<float> values(x.size());
+    FractalNoise(settings, level).Sample(x, y, z, values);
+    ASSERT_EQ(std::memcmp(values.data(), expected.data(),
+                          values.size() * sizeof(float)),
+              0)
+        << ToString(level);
+  }
+}
+
+TEST(TestNoise, Range) {
+  for (SimdLevel level : SupportedLevels()) {
+    for (uint32_t octaves : {1u, 4u}) {
+      NoiseSettings settings;
+      settings.frequency = 0.37f;
+      settings.octaves = octaves;
+      FractalNoise noise(settings, level);
+      std::vector<float> grid(64 * 64 * 64), plane(256 * 256);
+      noise.FillGrid({-100, -100, -100}, {64, 64, 64}, 1, grid);
+      noise.FillPlane({-100, -100}, {256, 256}, 1, plane);
+      for (float value : grid) {
+        ASSERT_TRUE(value >= -1 && value <= 1) << value;
+      }
+      for (float value : plane) {
+        ASSERT_TRUE(value >= -1 && value <= 1) << value;
+      }
+      // not flat either
+      auto [min, max] = std::minmax_element(grid.begin(), grid.end());
+      ASSERT_LT(*min, -0.3f);
+      ASSERT_GT(*max, 0.3f);
+      auto [plane_min, plane_max] =
+          std::minmax_element(plane.begin(), plane.end());
+      ASSERT_LT(*plane_min, -0.3f);
+      ASSERT_GT(*plane_max, 0.3f);
+    }
+  }
+}
+
+TEST(TestNoise, Seeds) {
+  NoiseSettings settings;
+  FractalNoise noise(settings);
+  FractalNoise same(settings);
+  settings.seed = 1;
+  FractalNoise other(settings);
+  int differences = 0;
+  for (int i = 0; i < 1000; i++) {
+    const float x = static_cast<float>(RandomInt32(-100000, 100000)) + 0.5f;
+    const float y = static_cast<float>(RandomInt32(-256, 256)) + 0.5f;
+    const float z = static_cast<float>(RandomInt32(-100000, 100000)) + 0.5f;
+    ASSERT_EQ(noise.Sample(x, y, z), same.Sample(x, y, z));
+    ASSERT_EQ(noise.Sample(x, z), same.Sample(x, z));
+    differences += noise.Sample(x, y, z) != other.Sample(x, y, z);
+  }
+  ASSERT_GT(differences, 900);
+}
+
+TEST(TestNoise, SampleMatchesFill) {
+  const NoiseSettings settings = RandomSettings();
+  for (SimdLevel level : SupportedLevels()) {
+    FractalNoise noise(settings, level);
+    const std::array<float, 3> origin = {-37.5f, 12, 1000.25f};
+    std::vector<float> grid(5 * 6 * 7), column(9), plane(5 * 7);
+    noise.FillGrid(origin, {5, 6, 7}, 0.5f, grid);
+    noise.FillColumn(origin, 9, 0.5f, column);
+    noise.FillPlane({origin[0], origin[2]}, {5, 7}, 0.5f, plane);
+    for (uint32_t y = 0; y < 6; y++) {
+      for (uint32_t z = 0; z < 7; z++) {
+        for (uint32_t x = 0; x < 5; x++) {
+          ASSERT_EQ(grid[(y * 7 + z) * 5 + x],
+                    noise.Sample(origin[0] + static_cast<float>(x) * 0.5f,
+                                 origin[1] + static_cast<float>(y) * 0.5f,
+                                 origin[2] + static_cast<float>(z) * 0.5f));
+        }
+      }
+    }
+    for (uint32_t y = 0; y < 9; y++) {
+      const float height = origin[1] + static_cast<float>(y) * 0.5f;
+      ASSERT_EQ(column[y], noise.Sample(origin[0], height, origin[2]));
+    }
+    for (uint32_t z = 0; z < 7; z++) {
+      for (uint32_t x = 0; x < 5; x++) {
+        ASSERT_EQ(plane[z * 5 + x],
+                  noise.Sample(origin[0] + static_cast<float>(x) * 0.5f,
+                               origin[2] + static_cast<float>(z) * 0.5f));
+      }
+    }
+
+    std::vector<float> xs(grid.size()), ys(grid.size()), zs(grid.size());
+    std::vector<float> batch(grid.size());
+    for (size_t i = 0; i < grid.size(); i++) {
+      xs[i] = static_cast<float>(RandomInt32(-1000, 1000)) * 0.1f;
+      ys[i] = static_cast<float>(RandomInt32(-1000, 1000)) * 0.1f;
+      zs[i] = static_cast<float>(RandomInt32(-1000, 1000)) * 0.1f;
+    }
+    noise.Sample(xs, ys, zs, batch);
+    for (size_t i = 0; i < grid.size(); i++) {
+      ASSERT_EQ(batch[i], noise.Sample(xs[i], ys[i], zs[i]));
+    }
+    noise.Sample(xs, zs, batch);
+    for (size_t i = 0; i < grid.size(); i++) {
+      ASSERT_EQ(batch[i], noise.Sample(xs[i], zs[i]));
+    }
+  }
+}
+
+TEST(TestNoise, InvalidSettings) {
+  NoiseSettings settings;
+  settings.octaves = 0;
+  ASSERT_THROW(FractalNoise{settings}, NoiseException);
+  settings.octaves = FractalNoise::kMaxOctaves + 1;
+  ASSERT_THROW(FractalNoise{settings}, NoiseException);
+  settings.octaves = FractalNoise::kMaxOctaves;
+  settings.frequency = 0;
+  ASSERT_THROW(FractalNoise{settings}, NoiseException);
+  settings.frequency = std::numeric_limits<float>::infinity();
+  ASSERT_THROW(FractalNoise{settings}, NoiseException);
+  settings.frequency = 1;
+  settings.gain = -0.5f;
+  ASSERT_THROW(FractalNoise{settings}, NoiseException);
+  settings.gain = 0.5f;
+  FractalNoise noise(settings);
+
+  std::vector<float> out(10), small(9);
+  ASSERT_THROW(noise.FillGrid({}, {2, 5, 1}, 1, small), NoiseException);
+  ASSERT_THROW(noise.Sample(out, small, out), NoiseException);
+  noise.FillGrid({}, {2, 5, 1}, 1, out);
+}
+
+TEST(TestNoise, Benchmark) {
+  NoiseSettings settings;
+  settings.octaves = 4;
+  constexpr uint32_t kSections = 64;
+  std::vector<float> grid(16 * 16 * 16), plane(16 * 16);
+  auto nanoseconds = [](auto begin, auto end, size_t samples) {
+    return static_cast<double>(
+               std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+                   .count()) /
+           static_cast<double>(samples);
+  };
+  for (SimdLevel level : SupportedLevels()) {
+    FractalNoise noise(settings, level);
+    auto begin = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < kSections; i++) {
+      noise.FillGrid({static_cast<float>(i * 16), 0, 0}, {16, 16, 16}, 1, grid);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    const double grid_ns = nanoseconds(begin, end, kSections * grid.size());
+
+    // as many samples as the grids, in height maps
+    begin = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < kSections * 16; i++) {
+      noise.FillPlane({static_cast<float>(i * 16), 0}, {16, 16}, 1, plane);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    const double plane_ns =
+        nanoseconds(begin, end, kSections * 16 * plane.size());
+    std::cout << ToString(level) << ", " << settings.octaves
+              << " octaves: " << grid_ns << " ns per 3D sample, " << plane_ns
+              << " ns per 2D sample" << std::endl;
+  }
+}
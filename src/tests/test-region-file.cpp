@@ -0,0 +1,187 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <world/region-file.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+namespace fs = std::filesystem;
+using namespace world;
+
+namespace {
+nbt::NBT MakeChunk(ChunkPos pos, size_t payload_size) {
+  nbt::NBT nbt{""};
+  nbt["xPos"] = nbt::TagInt{pos.x};
+  nbt["zPos"] = nbt::TagInt{pos.z};
+  // random data barely compresses, so the payload size controls the sectors
+  nbt::TagByteArray data(payload_size);
+  for (auto &value : data) {
+    value = static_cast<nbt::TagByte>(RandomInt16(-128, 127));
+  }
+  nbt["data"] = data;
+  return nbt;
+}
+
+std::string Encode(nbt::NBT const &nbt) {
+  std::ostringstream stream;
+  nbt.encode(stream);
+  return stream.str();
+}
+}  // namespace
+
+class TestRegionFile : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = fs::temp_directory_path() / "minecraft_test/TestRegionFile";
+    fs::remove_all(dir_);
+    fs::create_directories(dir_);
+  }
+  void TearDown() override { fs::remove_all(dir_); }
+  fs::path dir_;
+};
+
+TEST_F(TestRegionFile, WriteAndRead) {
+  RegionFile region{dir_ / "r.0.0.mca"};
+  ASSERT_FALSE(region.HasChunk({3, 4}));
+  ASSERT_FALSE(region.ReadChunk({3, 4}).has_value());
+
+  std::map<std::pair<int, int>, std::string> expected;
+  for (int x = 0; x < 32; x += 5) {
+    for (int z = 0; z < 32; z += 7) {
+      auto nbt = MakeChunk({x, z}, RandomSizeT(0, 20000));
+      region.WriteChunk({x, z}, nbt);
+      expected[{x, z}] = Encode(nbt);
+    }
+  }
+  for (auto const &[pos, data] : expected) {
+    ChunkPos const chunk{pos.first, pos.second};
+    ASSERT_TRUE(region.HasChunk(chunk));
+    ASSERT_NE(region.timestamp(chunk), 0u);
+    auto nbt = region.ReadChunk(chunk);
+    ASSERT_TRUE(nbt.has_value());
+    ASSERT_EQ(Encode(*nbt), data);
+  }
+}
+
+TEST_F(TestRegionFile, PersistsAcrossReopen) {
+  auto nbt = MakeChunk({-1, -32}, 5000);
+  {
+    RegionStorage storage{dir_};
+    storage.WriteChunk({-1, -32}, nbt);
+    storage.Flush();
+  }
+  RegionStorage storage{dir_};
+  ASSERT_TRUE(fs::exists(storage.RegionPath({-1, -1})));
+  ASSERT_TRUE(storage.HasChunk({-1, -32}));
+  ASSERT_FALSE(storage.HasChunk({-2, -32}));
+  ASSERT_FALSE(storage.HasChunk({100, 100}));
+  ASSERT_EQ(Encode(*storage.ReadChunk({-1, -32})), Encode(nbt));
+}
+
+TEST_F(TestRegionFile, RewritesReuseFreeSectors) {
+  RegionFile region{dir_ / "r.0.0.mca"};
+  for (int i = 0; i < 8; i++) {
+    region.WriteChunk({i, 0}, MakeChunk({i, 0}, 3 * 4096));
+  }
+  const uint32_t used = region.used_sectors();
+  const auto size = fs::file_size(dir_ / "r.0.0.mca");
+  // shrinking, growing and removing chunks must not grow the file while
+  // there are enough free sectors
+  region.WriteChunk({1, 0}, MakeChunk({1, 0}, 100));
+  region.RemoveChunk({2, 0});
+  ASSERT_FALSE(region.HasChunk({2, 0}));
+  ASSERT_LT(region.used_sectors(), used);
+  region.WriteChunk({3, 0}, MakeChunk({3, 0}, 5 * 4096));
+  ASSERT_EQ(fs::file_size(dir_ / "r.0.0.mca"), size);
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(region.HasChunk({i, 0}), i != 2);
+    if (i != 2) {
+      ASSERT_EQ(region.ReadChunk({i, 0}).value().at<nbt::TagInt>("xPos"), i);
+    }
+  }
+}
+
+TEST_F(TestRegionFile, TooLargeChunkThrows) {
+  RegionFile region{dir_ / "r.0.0.mca"};
+  ASSERT_THROW(region.WriteChunk({0, 0}, MakeChunk({0, 0}, 1100 * 1024)),
+               RegionException);
+  ASSERT_FALSE(region.HasChunk({0, 0}));
+}
+
+TEST_F(TestRegionFile, ConcurrentRegions) {
+  RegionStorage storage{dir_};
+  constexpr int kThreads = 4;
+  constexpr int kChunks = 64;
+  std::vector<std::jthread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&storage, t] {
+      // every thread works with its own region
+      for (int i = 0; i < kChunks; i++) {
+        ChunkPos const pos{t * kRegionSize + i % kRegionSize, i / kRegionSize};
+        storage.WriteChunk(pos, MakeChunk(pos, 1000));
+        ASSERT_EQ(storage.ReadChunk(pos).value().at<nbt::TagInt>("xPos"),
+                  pos.x);
+      }
+    });
+  }
+  threads.clear();
+  for (int t = 0; t < kThreads; t++) {
+    for (int i = 0; i < kChunks; i++) {
+      ASSERT_TRUE(
+          storage.HasChunk({t * kRegionSize + i % kRegionSize, i / kRegionSize}));
+    }
+  }
+}
+
+TEST_F(TestRegionFile, CorruptedLengthThrows) {
+  {
+    RegionFile region{dir_ / "r.0.0.mca"};
+    region.WriteChunk({0, 0}, MakeChunk({0, 0}, 100));
+  }
+  {
+    // the length of the first chunk, right after the header
+    std::fstream file{dir_ / "r.0.0.mca",
+                      std::ios::binary | std::ios::in | std::ios::out};
+    file.seekp(2 * RegionFile::kSectorSize);
+    file.write("\xff\xff\xff\xfe", 4);
+  }
+  RegionFile region{dir_ / "r.0.0.mca"};
+  ASSERT_THROW((void)region.ReadChunk({0, 0}), RegionException);
+}
+
+TEST_F(TestRegionFile, OpenRegionsAreLimited) {
+  RegionStorage storage{dir_, 2};
+  for (int i = 0; i < 6; i++) {
+    storage.WriteChunk({i * kRegionSize, 0}, MakeChunk({i, 0}, 100));
+    ASSERT_LE(storage.open_regions(), 2u);
+  }
+  // a region still in use is never closed
+  auto held = storage.GetRegion({0, 0});
+  for (int i = 1; i < 6; i++) {
+    ASSERT_EQ(storage.ReadChunk({i * kRegionSize, 0})
+                  .value()
+                  .at<nbt::TagInt>("xPos"),
+              i);
+  }
+  ASSERT_EQ(storage.GetRegion({0, 0}), held);
+  ASSERT_TRUE(storage.HasChunk({0, 0}));
+  ASSERT_FALSE(storage.HasChunk({100 * kRegionSize, 0}));
+  ASSERT_FALSE(fs::exists(storage.RegionPath({100, 0})));
+}
+
+TEST_F(TestRegionFile, MissingRegionsAreLimited) {
+  RegionStorage storage{dir_};
+  storage.WriteChunk({0, 0}, MakeChunk({0, 0}, 100));
+  // a player flying in a straight line over ungenerated land
+  const int count = static_cast<int>(RegionStorage::kMaxMissingRegions) + 100;
+  for (int i = 1; i <= count; i++) {
+    ASSERT_FALSE(storage.HasChunk({i * kRegionSize, 0}));
+    ASSERT_LE(storage.missing_regions(), RegionStorage::kMaxMissingRegions);
+  }
+  ASSERT_TRUE(storage.HasChunk({0, 0}));
+  ASSERT_FALSE(storage.HasChunk({kRegionSize, 0}));
+  storage.WriteChunk({kRegionSize, 0}, MakeChunk({32, 0}, 100));
+  ASSERT_TRUE(storage.HasChunk({kRegionSize, 0}));
+}
@@ -0,0 +1,275 @@
+#include <parsers/yaml/yaml.hpp>
+#include <thread>
+#include <world/remesher.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace world;
+
+namespace {
+class TestRemesher : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    stone_ = registry_.Register("minecraft:stone",
+                                yaml::Parse("sides:\n  default: stone.png"));
+    glass_ = registry_.Register(
+        "minecraft:glass",
+        yaml::Parse("transparent: true\nsides:\n  default: glass.png"));
+    remesher_ = std::make_unique<Remesher>(
+        registry_, jobs_,
+        [this](SectionPos pos) -> ChunkSection const * {
+          auto it = world_.find(pos);
+          return it == world_.end() ? nullptr : &it->second;
+        },
+        [this](SectionPos pos, SectionMesh const &mesh) {
+          meshes_[pos] = mesh;
+          uploads_++;
+        },
+        [this](SectionPos pos) { return Light(pos); });
+  }
+
+  // full daylight for the sections without an entry
+  SectionLight Light(SectionPos pos) const {
+    auto it = light_.find(pos);
+    return it == light_.end()
+               ? SectionLight{}
+               : SectionLight{&it->second.first, &it->second.second};
+  }
+
+  void Edit(SectionPos pos, uint32_t x, uint32_t y, uint32_t z,
+            BlockId block) {
+    world_.at(pos).Set(x, y, z, block);
+    remesher_->OnBlockChanged(pos, x, y, z);
+  }
+
+  // what the render loop does every frame
+  void Drain() {
+    while (remesher_->in_flight_count() > 0) {
+      if (jobs_.RunMainThreadJobs() == 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // the mesh a full remesh of the section would produce
+  SectionMesh FullMesh(SectionPos pos) {
+    std::array<ChunkSection const *, kDirectionCount> neighbors;
+    for (size_t face = 0; face < kDirectionCount; face++) {
+      auto it = world_.find(Neighbor(pos, static_cast<Direction>(face)));
+      neighbors[face] = it == world_.end() ? nullptr : &it->second;
+    }
+    std::array<SectionLight, kDirectionCount> neighbor_light;
+    for (size_t face = 0; face < kDirectionCount; face++) {
+      neighbor_light[face] = Light(Neighbor(pos, static_cast<Direction>(face)));
+    }
+    SectionMesh mesh;
+    mesher_.Mesh(world_.at(pos), neighbors, Light(pos), neighbor_light, mesh);
+    return mesh;
+  }
+
+  void ExpectUpToDate() {
+    for (auto const &[pos, section] : world_) {
+      const SectionMesh expected = FullMesh(pos);
+      SectionMesh const &actual = meshes_[pos];
+      ASSERT_EQ(actual.vertices, expected.vertices);
+      ASSERT_EQ(actual.indices, expected.indices);
+    }
+  }
+
+  // a 3x2x3 block of sections, stone at the bottom, glass and air above
+  void Generate() {
+    for (int32_t x = -1; x <= 1; x++) {
+      for (int32_t z = -1; z <= 1; z++) {
+        world_.emplace(SectionPos{x, 0, z}, ChunkSection(stone_));
+        ChunkSection &top = world_[SectionPos{x, 1, z}];
+        for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+          if (RandomSizeT(0, 5) == 0) {
+            top.Set(i, RandomSizeT(0, 1) ? stone_ : glass_);
+          }
+        }
+      }
+    }
+    for (auto const &[pos, section] : world_) {
+      remesher_->Invalidate(pos);
+    }
+    remesher_->Flush();
+    Drain();
+  }
+
+  BlockRegistry registry_;
+  BlockId stone_ = 0, glass_ = 0;
+  jobs::JobSystem jobs_{2};
+  std::map<SectionPos, ChunkSection> world_;
+  std::map<SectionPos, SectionMesh> meshes_;
+  // sky and block light
+  std::map<SectionPos, std::pair<NibbleArray, NibbleArray>> light_;
+  size_t uploads_ = 0;
+  SectionMesher mesher_{registry_};
+  std::unique_ptr<Remesher> remesher_;
+};
+}  // namespace
+
+TEST_F(TestRemesher, MatchesFullRemesh) {
+  Generate();
+  ASSERT_EQ(uploads_, world_.size());
+  ExpectUpToDate();
+
+  for (int round = 0; round < 20; round++) {
+    for (int i = 0; i < 10; i++) {
+      const SectionPos pos{RandomInt32(-1, 1), RandomInt32(0, 1),
+                           RandomInt32(-1, 1)};
+      // borders are hit a lot more often than random placement would
+      auto coordinate = [] {
+        return RandomSizeT(0, 2) == 0 ? 15 * RandomUint32(0, 1)
+                                      : RandomUint32(0, 15);
+      };
+      const std::array<BlockId, 3> blocks{kAir, stone_, glass_};
+      Edit(pos, coordinate(), coordinate(), coordinate(),
+           blocks[RandomSizeT(0, 2)]);
+    }
+    remesher_->Flush();
+    Drain();
+    ExpectUpToDate();
+  }
+}
+
+TEST_F(TestRemesher, Light) {
+  Generate();
+  // the light of a section changes everywhere, its neighbours' borders too
+  auto relight = [&](SectionPos pos) {
+    auto &[sky, block] = light_[pos];
+    for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+      sky.Set(i, static_cast<uint8_t>(RandomUint32(0, 15)));
+      block.Set(i, static_cast<uint8_t>(RandomUint32(0, 15)));
+    }
+    remesher_->OnLightChanged(pos);
+  };
+  relight({0, 1, 0});
+  relight({1, 0, 0});
+  remesher_->Flush();
+  Drain();
+  ExpectUpToDate();
+
+  // block edits keep the light
+  for (int i = 0; i < 20; i++) {
+    Edit({0, 1, 0}, RandomUint32(0, 15), RandomUint32(0, 15),
+         RandomUint32(0, 15), RandomSizeT(0, 1) ? stone_ : kAir);
+  }
+  remesher_->Flush();
+  Drain();
+  ExpectUpToDate();
+}
+
+TEST_F(TestRemesher, Coalescing) {
+  Generate();
+  const uint64_t dispatched = remesher_->dispatched();
+
+  // inner edits don't touch the neighbours
+  for (uint32_t x = 2; x < 14; x++) {
+    Edit({0, 0, 0}, x, 8, 8, kAir);
+  }
+  ASSERT_EQ(remesher_->dirty_count(), 1u);
+  ASSERT_EQ(remesher_->coalesced(), 11u);
+  // a border edit dirties exactly the neighbour across that border
+  Edit({0, 0, 0}, 0, 8, 8, kAir);
+  ASSERT_EQ(remesher_->dirty_count(), 2u);
+  // a corner touches three
+  Edit({0, 0, 0}, 15, 15, 15, kAir);
+  ASSERT_EQ(remesher_->dirty_count(), 5u);
+
+  ASSERT_EQ(remesher_->Flush(), 5u);
+  ASSERT_EQ(remesher_->dispatched(), dispatched + 5);
+  Drain();
+  ExpectUpToDate();
+}
+
+TEST_F(TestRemesher, StaleJobsAreDiscarded) {
+  Generate();
+  const size_t uploads = uploads_;
+  Edit({0, 1, 0}, 4, 4, 4, stone_);
+  ASSERT_EQ(remesher_->Flush(), 1u);
+  // edited again while the job runs
+  Edit({0, 1, 0}, 9, 9, 9, glass_);
+  ASSERT_EQ(remesher_->Flush(), 0u);
+  Drain();
+  ASSERT_EQ(remesher_->discarded(), 1u);
+  ASSERT_EQ(uploads_, uploads);
+
+  // both edits come back in the next mesh
+  ASSERT_EQ(remesher_->Flush(), 1u);
+  Drain();
+  ASSERT_EQ(uploads_, uploads + 1);
+  ExpectUpToDate();
+
+  // a forgotten section drops its result, the one loaded in its place
+  // gets a fresh mesh
+  Edit({1, 1, 1}, 1, 1, 1, stone_);
+  ASSERT_EQ(remesher_->Flush(), 1u);
+  remesher_->Forget({1, 1, 1});
+  remesher_->Invalidate({1, 1, 1});
+  Drain();
+  ASSERT_EQ(remesher_->Flush(), 1u);
+  Drain();
+  ExpectUpToDate();
+}
+
+TEST_F(TestRemesher, HelpingThreads) {
+  Generate();
+  for (int round = 0; round < 10; round++) {
+    for (auto const &[pos, section] : world_) {
+      remesher_->Invalidate(pos);
+    }
+    remesher_->Flush();
+    // threads outside the pool run the meshing jobs while they wait
+    const jobs::JobHandle last =
+        jobs_.Schedule([] {}, jobs::Priority::kLow);
+    std::vector<std::jthread> helpers;
+    for (int i = 0; i < 4; i++) {
+      helpers.emplace_back([&] { jobs_.Wait(last); });
+    }
+    helpers.clear();
+    Drain();
+    ExpectUpToDate();
+  }
+}
+
+TEST_F(TestRemesher, Benchmark) {
+  Generate();
+  // an explosion of radius 5 in the middle of the stone
+  const std::array<int32_t, 3> center{4, 12, 4};
+  auto explode = [&] {
+    for (int32_t dy = -5; dy <= 5; dy++) {
+      for (int32_t dz = -5; dz <= 5; dz++) {
+        for (int32_t dx = -5; dx <= 5; dx++) {
+          if (dx * dx + dy * dy + dz * dz > 25) {
+            continue;
+          }
+          const int32_t x = center[0] + dx, y = center[1] + dy,
+                        z = center[2] + dz;
+          const SectionPos pos{x >> 4, y >> 4, z >> 4};
+          Edit(pos, static_cast<uint32_t>(x & 15),
+               static_cast<uint32_t>(y & 15), static_cast<uint32_t>(z & 15),
+               kAir);
+        }
+      }
+    }
+  };
+
+  auto begin = std::chrono::high_resolution_clock::now();
+  explode();
+  const size_t sections = remesher_->Flush();
+  Drain();
+  auto end = std::chrono::high_resolution_clock::now();
+  ExpectUpToDate();
+
+  auto full_begin = std::chrono::high_resolution_clock::now();
+  for (auto const &[pos, section] : world_) {
+    (void)FullMesh(pos);
+  }
+  auto full_end = std::chrono::high_resolution_clock::now();
+  std::cout << "explosion: " << remesher_->coalesced() << " coalesced edits, "
+            << sections << " remesh jobs in " << time_diff(begin, end)
+            << " ms (full remesh of " << world_.size() << " sections: "
+            << time_diff(full_begin, full_end) << " ms)" << std::endl;
+}
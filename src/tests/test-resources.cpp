@@ -1,5 +1,6 @@
 
 #define minecraft_RESOURCE_PACKING
+#include <resources/definitions.hpp>
 #include <resources/pack.hpp>
 #include <resources/resources.hpp>
 #include <thread>
@@ -140,4 +141,81 @@ TEST_F(TestResources, TestMultithreadedRandomFileLoading) {
     thread.join();
   }
   ASSERT_NO_THROW(resource::UnloadResources(dir_ / "test.pack"));
-}
\ No newline at end of file
+}
+class TestDefinitions : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dir_ = fs::temp_directory_path() / "minecraft_test/TestDefinitions";
+    fs::remove_all(dir_);
+  }
+  void TearDown() override { fs::remove_all(dir_); }
+
+  void Write(std::string const &path, std::string_view content) {
+    CreateFile(dir_ / "data" / path, content.data(), content.size());
+  }
+  Entry const &Pack() {
+    std::vector<fs::path> folders{dir_ / "data"};
+    resource::packer::Pack(folders, dir_ / "data.pack");
+    return resource::LoadResources(dir_ / "data.pack") / "data";
+  }
+  fs::path dir_;
+};
+
+TEST_F(TestDefinitions, NamesAndErrors) {
+  ASSERT_EQ(resource::DefinitionName("minecraft/dirt"), "minecraft:dirt");
+  ASSERT_EQ(resource::DefinitionName("mod/ores/copper.yml"),
+            "mod:ores/copper");
+  ASSERT_EQ(resource::DefinitionName("mod/.hidden"), "mod:.hidden");
+
+  Write("minecraft/dirt", "type: block\nhardness: 1");
+  Write("minecraft/stone.yml", "type: block\nhardness: 4");
+  Write("minecraft/stick.yml", "type: item");
+  Write("mod/ores/copper.yml", "type: block\nhardness: 3");
+  Write("mod/broken.yml", "type: {block");
+  Write("mod/ores/copper", "type: item");
+  auto const set = resource::LoadDefinitions(Pack(), 4);
+  std::vector<std::string> names;
+  for (auto const &definition : set.definitions) {
+    names.push_back(definition.name);
+  }
+  ASSERT_EQ(names, (std::vector<std::string>{"minecraft:dirt", "minecraft:stick",
+                                             "minecraft:stone",
+                                             "mod:ores/copper"}));
+  ASSERT_EQ(set.definitions[2].yaml.contains("hardness"), true);
+  ASSERT_EQ(set.errors.size(), 2u);
+  ASSERT_EQ(set.errors[0].rfind("mod:broken: ", 0), 0u);
+  ASSERT_EQ(set.errors[1], "mod:ores/copper: duplicate definition");
+  resource::UnloadResources(dir_ / "data.pack");
+}
+
+TEST_F(TestDefinitions, ParallelLoading) {
+  constexpr int kDefinitions = 2000;
+  for (int i = 0; i < kDefinitions; i++) {
+    Write("mod/block_" + std::to_string(i) + ".yml",
+          "type: block\nsides:\n  default: block_" + std::to_string(i) +
+              ".png\n  top: top.png\nhardness: " + std::to_string(i % 50) +
+              "\nsolid: true\ntransparent: false\ntile: false");
+  }
+  Entry const &data = Pack();
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::string> reference;
+  for (unsigned threads : {1u, cores}) {
+    const auto begin = std::chrono::high_resolution_clock::now();
+    auto const set = resource::LoadDefinitions(data, threads);
+    const auto end = std::chrono::high_resolution_clock::now();
+    std::cout << kDefinitions << " definitions on " << threads
+              << " threads: " << time_diff(begin, end) << " ms\n";
+    ASSERT_TRUE(set.errors.empty());
+    std::vector<std::string> names;
+    for (auto const &definition : set.definitions) {
+      names.push_back(definition.name);
+    }
+    ASSERT_TRUE(std::is_sorted(names.begin(), names.end()));
+    if (reference.empty()) {
+      reference = names;
+    }
+    ASSERT_EQ(names, reference);
+  }
+  ASSERT_EQ(reference.size(), size_t(kDefinitions));
+  resource::UnloadResources(dir_ / "data.pack");
+}
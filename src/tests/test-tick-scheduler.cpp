@@ -0,0 +1,160 @@
+#include <tick/tick-scheduler.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace tick;
+using namespace std::chrono_literals;
+
+namespace {
+struct Counter {
+  int *ticks;
+  void Update() { (*ticks)++; }
+};
+
+struct Spawner {
+  TickScheduler *scheduler;
+  int *ticks;
+  int spawned = 0;
+  void Update() {
+    if (spawned++ == 0) {
+      scheduler->Add<Counter>(ticks);
+      scheduler->Add<Spawner>(scheduler, ticks);
+    }
+  }
+};
+
+struct VirtualUpdatable {
+  virtual ~VirtualUpdatable() = default;
+  virtual void Update() = 0;
+};
+
+struct VirtualAccumulator final : VirtualUpdatable {
+  uint64_t value = 0;
+  void Update() override { value += 3; }
+};
+
+struct Accumulator {
+  uint64_t value = 0;
+  void Update() { value += 3; }
+};
+}  // namespace
+
+TEST(TestTickScheduler, FixedTimestep) {
+  static_assert(kTickDuration == 50ms);
+  TickScheduler scheduler(kTickDuration, 4);
+  int ticks = 0;
+  scheduler.Add<Counter>(&ticks);
+
+  ASSERT_EQ(scheduler.Advance(30ms), 0u);
+  ASSERT_EQ(scheduler.Advance(90ms), 2u);
+  ASSERT_EQ(ticks, 2);
+  ASSERT_NEAR(scheduler.alpha(), 0.4f, 1e-5f);
+
+  // a long stall only catches up to the limit
+  ASSERT_EQ(scheduler.Advance(1s), 4u);
+  ASSERT_EQ(ticks, 6);
+  ASSERT_EQ(scheduler.stats().ticks, 6u);
+  ASSERT_EQ(scheduler.stats().skipped, 16u);
+  ASSERT_NEAR(scheduler.alpha(), 0.4f, 1e-5f);
+  ASSERT_LE(scheduler.stats().max, 50ms);
+  ASSERT_EQ(scheduler.stats().overruns, 0u);
+}
+
+TEST(TestTickScheduler, Buckets) {
+  TickScheduler scheduler;
+  int a = 0, b = 0;
+  std::vector<TickHandle> handles;
+  for (int i = 0; i < 10; i++) {
+    handles.push_back(scheduler.Add<Counter>(i % 2 ? &a : &b));
+  }
+  TickHandle spawner = scheduler.Add<Spawner>(&scheduler, &a);
+  ASSERT_EQ(scheduler.size(), 11u);
+  ASSERT_NE(spawner.bucket, handles.front().bucket);
+
+  // removal swaps with the last value, the handles keep working
+  scheduler.Remove(handles[0]);
+  scheduler.Remove(handles[3]);
+  ASSERT_EQ(scheduler.values<Counter>().size(), 8u);
+  ASSERT_EQ(scheduler.Get<Counter>(handles[9]).ticks, &a);
+  ASSERT_EQ(scheduler.Get<Counter>(handles[8]).ticks, &b);
+
+  // values added during a tick start ticking with the next one
+  scheduler.Tick();
+  ASSERT_EQ(a, 4);
+  ASSERT_EQ(b, 4);
+  ASSERT_EQ(scheduler.size(), 11u);
+  ASSERT_EQ(scheduler.Get<Spawner>(spawner).spawned, 1);
+  scheduler.Tick();
+  ASSERT_EQ(a, 9);
+  ASSERT_EQ(scheduler.size(), 13u);
+}
+
+TEST(TestTickScheduler, Benchmark) {
+  constexpr size_t kCount = 1'000'000;
+  constexpr int kTicks = 20;
+  TickScheduler scheduler;
+  std::vector<std::unique_ptr<VirtualUpdatable>> virtuals;
+  for (size_t i = 0; i < kCount; i++) {
+    scheduler.Add<Accumulator>();
+    virtuals.push_back(std::make_unique<VirtualAccumulator>());
+  }
+  // interleaved allocations, like objects created over time
+  std::shuffle(virtuals.begin(), virtuals.end(),
+               std::mt19937_64(RandomUint64()));
+
+  auto begin = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < kTicks; i++) {
+    for (auto &updatable : virtuals) {
+      updatable->Update();
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << kCount << " virtual updates x" << kTicks << ": "
+            << time_diff(begin, end) << " ms" << std::endl;
+
+  begin = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < kTicks; i++) {
+    scheduler.Tick();
+  }
+  end = std::chrono::high_resolution_clock::now();
+  std::cout << kCount << " bucket updates x" << kTicks << ": "
+            << time_diff(begin, end) << " ms, average tick "
+            << std::chrono::duration<double, std::milli>(
+                   scheduler.stats().average())
+                   .count()
+            << " ms" << std::endl;
+  ASSERT_EQ(scheduler.values<Accumulator>().front().value, 3u * kTicks);
+}
+
+TEST(TestTickScheduler, StaleHandles) {
+  TickScheduler scheduler;
+  int a = 0, b = 0;
+  const TickHandle first = scheduler.Add<Counter>(&a);
+  ASSERT_TRUE(scheduler.Remove(first));
+  ASSERT_FALSE(scheduler.Remove(first));
+  // the id is reused, the old handle doesn't reach the new value
+  const TickHandle second = scheduler.Add<Counter>(&b);
+  ASSERT_EQ(second.id, first.id);
+  ASSERT_NE(second, first);
+  ASSERT_FALSE(scheduler.Remove(first));
+  ASSERT_THROW((void)scheduler.Get<Counter>(first), std::out_of_range);
+  ASSERT_EQ(scheduler.Get<Counter>(second).ticks, &b);
+  ASSERT_FALSE(scheduler.Remove({7, 0, 0}));
+
+  // removing twice during a tick removes once
+  struct Remover {
+    TickScheduler *scheduler;
+    TickHandle target;
+    void Update() {
+      scheduler->Remove(target);
+      scheduler->Remove(target);
+    }
+  };
+  const TickHandle third = scheduler.Add<Counter>(&a);
+  const TickHandle remover = scheduler.Add<Remover>(&scheduler, second);
+  scheduler.Tick();
+  ASSERT_EQ(scheduler.values<Counter>().size(), 1u);
+  ASSERT_EQ(scheduler.Get<Counter>(third).ticks, &a);
+  ASSERT_TRUE(scheduler.Remove(remover));
+}
@@ -0,0 +1,242 @@
+#include <world/chunk.hpp>
+#include <world/tile-entities.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace world;
+
+namespace {
+struct Chest {
+  std::vector<int32_t> items;
+  int32_t ticks = 0;
+  void Tick(TileContext &context) {
+    ticks++;
+    context.Sleep();
+  }
+};
+
+struct Furnace {
+  int32_t burn_time = 0;
+  int32_t ticks = 0;
+  std::optional<std::string> name;
+  void Tick(TileContext &context) {
+    ticks++;
+    if (burn_time == 0) {
+      return context.Sleep();
+    }
+    if (--burn_time % 10 == 0) {
+      // wakes the chest above
+      context.tile_entities().Wake(context.x(), context.y() + 1, context.z());
+    }
+  }
+};
+
+struct Hopper {
+  int32_t cooldown = 8;
+  int32_t ticks = 0;
+  void Tick(TileContext &context) {
+    ticks++;
+    context.SleepFor(static_cast<uint32_t>(cooldown));
+  }
+};
+}  // namespace
+
+template <>
+struct nbt::Schema<Chest> {
+  static constexpr auto fields = std::make_tuple(
+      nbt::field("Items", &Chest::items), nbt::field("Ticks", &Chest::ticks));
+};
+
+template <>
+struct nbt::Schema<Furnace> {
+  static constexpr auto fields =
+      std::make_tuple(nbt::field("BurnTime", &Furnace::burn_time),
+                      nbt::field("CustomName", &Furnace::name));
+};
+
+template <>
+struct nbt::Schema<Hopper> {
+  static constexpr auto fields =
+      std::make_tuple(nbt::field("TransferCooldown", &Hopper::cooldown));
+};
+
+namespace {
+// needs the Chest schema to be complete
+struct Spawner {
+  void Tick(TileContext &context) {
+    context.tile_entities().Emplace<Chest>(context.x() + 1, context.y(),
+                                           context.z());
+  }
+};
+}  // namespace
+
+template <>
+struct nbt::Schema<Spawner> {
+  static constexpr auto fields = std::make_tuple();
+};
+
+TEST(TestTileEntities, SleepAndWake) {
+  TileEntities tiles;
+  tiles.Emplace<Furnace>(1, 64, 1).burn_time = 25;
+  tiles.Emplace<Chest>(1, 65, 1);
+  tiles.Emplace<Chest>(2, 65, 1);
+  ASSERT_EQ(tiles.size(), 3u);
+  ASSERT_EQ(tiles.active_count(), 3u);
+
+  // the chests go to sleep right away, the furnace burns for 25 ticks
+  uint64_t tick = 0;
+  tiles.Tick(++tick);
+  ASSERT_EQ(tiles.active_count(), 1u);
+  for (int i = 0; i < 30; i++) {
+    tiles.Tick(++tick);
+  }
+  ASSERT_EQ(tiles.active_count(), 0u);
+  ASSERT_EQ(tiles.Get<Furnace>(1, 64, 1)->ticks, 26);
+  // woken at 20, 10 and 0 burn time left
+  ASSERT_EQ(tiles.Get<Chest>(1, 65, 1)->ticks, 4);
+  ASSERT_EQ(tiles.Get<Chest>(2, 65, 1)->ticks, 1);
+  ASSERT_EQ(tiles.Get<Furnace>(2, 65, 1), nullptr);
+
+  tiles.Wake(2, 65, 1);
+  tiles.Wake(5, 5, 5);
+  tiles.Tick(++tick);
+  ASSERT_EQ(tiles.Get<Chest>(2, 65, 1)->ticks, 2);
+
+  // swap removal keeps the other handles right
+  ASSERT_TRUE(tiles.Remove(1, 65, 1));
+  ASSERT_FALSE(tiles.Remove(1, 65, 1));
+  ASSERT_EQ(tiles.Get<Chest>(2, 65, 1)->ticks, 2);
+  ASSERT_EQ(tiles.size(), 2u);
+}
+
+TEST(TestTileEntities, ScheduledTicks) {
+  TileEntities tiles;
+  tiles.Emplace<Hopper>(0, 0, 0);
+  tiles.Emplace<Hopper>(15, 255, 15).cooldown = 3;
+  for (uint64_t tick = 1; tick <= 24; tick++) {
+    tiles.Tick(tick);
+  }
+  // ticks at 1, 9, 17 and 1, 4, 7, ... 22
+  ASSERT_EQ(tiles.Get<Hopper>(0, 0, 0)->ticks, 3);
+  ASSERT_EQ(tiles.Get<Hopper>(15, 255, 15)->ticks, 8);
+  ASSERT_EQ(tiles.active_count(), 0u);
+  ASSERT_EQ(tiles.scheduled_count(), 2u);
+
+  // a replaced tile entity doesn't keep the schedule going
+  tiles.Emplace<Chest>(0, 0, 0);
+  for (uint64_t tick = 25; tick <= 40; tick++) {
+    tiles.Tick(tick);
+  }
+  ASSERT_EQ(tiles.Get<Chest>(0, 0, 0)->ticks, 1);
+
+  // pools can't grow under a ticking tile entity
+  tiles.Emplace<Spawner>(3, 3, 3);
+  ASSERT_THROW(tiles.Tick(41), TileEntityException);
+  ASSERT_FALSE(tiles.contains(4, 3, 3));
+}
+
+TEST(TestTileEntities, RemovedScheduledTicks) {
+  TileEntities tiles;
+  tiles.Emplace<Hopper>(0, 0, 0);
+  // ticks at 1, the wake up at 9 belongs to the removed hopper
+  tiles.Tick(1);
+  ASSERT_EQ(tiles.scheduled_count(), 1u);
+  ASSERT_TRUE(tiles.Remove(0, 0, 0));
+  tiles.Emplace<Chest>(0, 0, 0);
+  for (uint64_t tick = 2; tick <= 12; tick++) {
+    tiles.Tick(tick);
+  }
+  ASSERT_EQ(tiles.Get<Chest>(0, 0, 0)->ticks, 1);
+  ASSERT_EQ(tiles.scheduled_count(), 0u);
+
+  // churn doesn't grow the heap
+  for (uint64_t tick = 13; tick < 1013; tick++) {
+    tiles.Emplace<Hopper>(1, 0, 0);
+    tiles.Tick(tick);
+    ASSERT_LE(tiles.scheduled_count(), 2u);
+  }
+  ASSERT_EQ(tiles.Get<Chest>(0, 0, 0)->ticks, 1);
+}
+
+TEST(TestTileEntities, SaveAndLoad) {
+  TileEntityRegistry registry;
+  registry.Register<Chest>("minecraft:chest");
+  registry.Register<Furnace>("minecraft:furnace");
+  ASSERT_THROW(registry.Register<Hopper>("minecraft:chest"),
+               TileEntityException);
+  ASSERT_THROW(registry.Register<Chest>("minecraft:box"), TileEntityException);
+  // a world saved with a hopper, loaded without it
+  TileEntityRegistry without_hoppers = registry;
+  registry.Register<Hopper>("minecraft:hopper");
+
+  Chunk chunk({3, -2});
+  TileEntities &tiles = chunk.tile_entities();
+  tiles.Emplace<Chest>(4, 70, 9).items = {1, 2, 3};
+  Furnace &furnace = tiles.Emplace<Furnace>(15, 0, 3);
+  furnace.burn_time = 200;
+  furnace.name = "Smelter";
+  tiles.Emplace<Hopper>(0, 0, 0);
+
+  const std::vector<std::byte> data = tiles.Save(registry);
+  // plain NBT, readable by the generic parser
+  nbt::NBT nbt(data);
+  auto &list = nbt.at<nbt::TagList>("block_entities");
+  ASSERT_EQ(nbt::get_list<nbt::TagCompound>(list).size(), 3u);
+
+  TileEntities loaded;
+  ASSERT_EQ(loaded.Load(registry, data), 0u);
+  ASSERT_EQ(loaded.size(), 3u);
+  ASSERT_EQ(loaded.Save(registry).size(), data.size());
+
+  ASSERT_EQ(loaded.Load(without_hoppers, data), 1u);
+  ASSERT_EQ(loaded.size(), 2u);
+  ASSERT_EQ(loaded.Get<Chest>(4, 70, 9)->items, (std::vector<int32_t>{1, 2, 3}));
+  ASSERT_EQ(loaded.Get<Furnace>(15, 0, 3)->burn_time, 200);
+  ASSERT_EQ(loaded.Get<Furnace>(15, 0, 3)->name, "Smelter");
+  ASSERT_EQ(loaded.Get<Hopper>(0, 0, 0), nullptr);
+  // loaded tile entities tick once to decide whether they are needed
+  ASSERT_EQ(loaded.active_count(), 2u);
+}
+
+TEST(TestTileEntities, LoadSkipsOtherTags) {
+  TileEntityRegistry registry;
+  registry.Register<Chest>("minecraft:chest");
+  TileEntities tiles;
+  tiles.Emplace<Chest>(1, 2, 3).items = {7};
+  nbt::NBT nbt(tiles.Save(registry));
+  // the keys are written in order, two before the list and one after it
+  nbt["DataVersion"] = nbt::TagInt{3465};
+  nbt["Status"] = nbt::TagString{"minecraft:full"};
+  nbt["xPos"] = nbt::TagInt{-4};
+
+  TileEntities loaded;
+  ASSERT_EQ(loaded.Load(registry, nbt.encode()), 0u);
+  ASSERT_EQ(loaded.size(), 1u);
+  ASSERT_EQ(loaded.Get<Chest>(1, 2, 3)->items, std::vector<int32_t>{7});
+}
+
+TEST(TestTileEntities, Benchmark) {
+  // a storage room: lots of chests, a few running furnaces
+  constexpr int kChests = 4096;
+  constexpr int kFurnaces = 16;
+  constexpr int kTicks = 1000;
+  TileEntities tiles;
+  for (int i = 0; i < kChests; i++) {
+    tiles.Emplace<Chest>(i & 15, 1 + (i >> 8), (i >> 4) & 15);
+  }
+  for (int i = 0; i < kFurnaces; i++) {
+    tiles.Emplace<Furnace>(i, 0, 0).burn_time = kTicks * 2;
+  }
+  tiles.Tick(0);
+
+  auto begin = std::chrono::high_resolution_clock::now();
+  for (uint64_t tick = 1; tick <= kTicks; tick++) {
+    tiles.Tick(tick);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  ASSERT_EQ(tiles.active_count(), static_cast<size_t>(kFurnaces));
+  std::cout << kTicks << " ticks of " << tiles.size() << " tile entities ("
+            << tiles.active_count() << " awake): " << time_diff(begin, end)
+            << " ms" << std::endl;
+}
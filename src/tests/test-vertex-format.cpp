@@ -0,0 +1,56 @@
+#include <world/vertex-format.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace world;
+
+TEST(TestVertexFormat, RoundTrip) {
+  for (int i = 0; i < 100000; i++) {
+    VertexAttributes attributes;
+    for (auto &coordinate : attributes.position) {
+      coordinate =
+          static_cast<uint8_t>(RandomUint32(0, vertex::kMaxCoordinate));
+    }
+    for (auto &coordinate : attributes.uv) {
+      coordinate =
+          static_cast<uint8_t>(RandomUint32(0, vertex::kMaxCoordinate));
+    }
+    attributes.face =
+        static_cast<Direction>(RandomSizeT(0, kDirectionCount - 1));
+    attributes.ao = static_cast<uint8_t>(RandomUint32(0, vertex::kMaxAo));
+    attributes.texture = static_cast<uint16_t>(RandomUint32(0, UINT16_MAX));
+    attributes.sky_light =
+        static_cast<uint8_t>(RandomUint32(0, vertex::kMaxLight));
+    attributes.block_light =
+        static_cast<uint8_t>(RandomUint32(0, vertex::kMaxLight));
+    ASSERT_EQ(Decode(Encode(attributes)), attributes);
+  }
+}
+
+TEST(TestVertexFormat, Layout) {
+  // the layout chunkShader.vert unpacks
+  VertexAttributes attributes;
+  attributes.position = {16, 1, 2};
+  attributes.uv = {3, 16};
+  attributes.face = Direction::kSouth;
+  attributes.ao = 2;
+  attributes.texture = 0xABCD;
+  attributes.sky_light = 7;
+  attributes.block_light = 15;
+  const MeshVertex packed = Encode(attributes);
+  ASSERT_EQ(packed.position, 16u | 1u << 5 | 2u << 10 | 3u << 15 | 16u << 20 |
+                                 5u << 25 | 2u << 28);
+  ASSERT_EQ(packed.material, 0xABCDu | 7u << 16 | 15u << 20);
+
+  // the free bits stay clear
+  attributes.position = {31, 31, 31};
+  attributes.uv = {31, 31};
+  attributes.face = static_cast<Direction>(7);
+  attributes.ao = 3;
+  attributes.texture = UINT16_MAX;
+  attributes.sky_light = attributes.block_light = 15;
+  ASSERT_EQ(Encode(attributes).position, 0x3FFFFFFFu);
+  ASSERT_EQ(Encode(attributes).material, 0x00FFFFFFu);
+  static_assert(Decode(Encode(VertexAttributes{})) == VertexAttributes{});
+}
@@ -0,0 +1,245 @@
+#include <parsers/yaml/yaml.hpp>
+#include <unordered_map>
+#include <world/mesher.hpp>
+#include <world/visibility-graph.hpp>
+
+#include "pch.h"
+#include "utils.hpp"
+
+using namespace world;
+
+namespace {
+constexpr int32_t kWorldSize = 8;
+
+class TestVisibilityGraph : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    stone_ = registry_.Register("minecraft:stone",
+                                yaml::Parse("sides:\n  default: stone.png"));
+    glass_ = registry_.Register(
+        "minecraft:glass",
+        yaml::Parse("transparent: true\nsides:\n  default: glass.png"));
+  }
+
+  // A section of stone with the given blocks set to air.
+  template <typename Open>
+  FaceConnectivity Connectivity(Open &&open) {
+    PaddedSection blocks;
+    for (int32_t y = 0; y < 16; y++) {
+      for (int32_t z = 0; z < 16; z++) {
+        for (int32_t x = 0; x < 16; x++) {
+          blocks.Set(x, y, z, open(x, y, z) ? kAir : stone_);
+        }
+      }
+    }
+    return SectionMesher(registry_).Connectivity(blocks);
+  }
+
+  // 8x8 chunks: stone below a flat surface at y 120, a tunnel along x
+  // through the sections at y 2 and z 3, and a mountain ridge over the
+  // chunks x 5 and 6 up to y 192.
+  void BuildWorld() {
+    for (int32_t x = 0; x < kWorldSize; x++) {
+      for (int32_t z = 0; z < kWorldSize; z++) {
+        const bool ridge = x == 5 || x == 6;
+        for (int32_t y = 0; y < 16; y++) {
+          ChunkSection &section = world_[{x, y, z}];
+          if (y < 7 || (ridge && y < 12)) {
+            section.Fill(stone_);
+          } else if (y == 7) {
+            for (uint32_t i = 0; i < ChunkSection::kVolume / 2; i++) {
+              section.Set(i, stone_);
+            }
+          }
+          if (y == 2 && z == 3) {
+            for (uint32_t i = 0; i < ChunkSection::kVolume; i++) {
+              const uint32_t ly = i >> 8, lz = i >> 4 & 15;
+              if (ly >= 6 && ly < 10 && lz >= 6 && lz < 10) {
+                section.Set(i, kAir);
+              }
+            }
+          }
+        }
+      }
+    }
+    SectionMesher mesher(registry_);
+    SectionMesh mesh;
+    for (auto const &[pos, section] : world_) {
+      std::array<ChunkSection const *, kDirectionCount> neighbors;
+      for (size_t face = 0; face < kDirectionCount; face++) {
+        auto it = world_.find(Neighbor(pos, static_cast<Direction>(face)));
+        neighbors[face] = it == world_.end() ? nullptr : &it->second;
+      }
+      mesher.Mesh(section, neighbors, mesh);
+      graph_.Set(pos, mesh.connectivity);
+      if (!mesh.empty()) {
+        drawn_.push_back(pos);
+      }
+    }
+  }
+
+  [[nodiscard]] size_t Draws(std::span<const SectionPos> visible) const {
+    return static_cast<size_t>(
+        std::ranges::count_if(visible, [&](SectionPos pos) {
+          return std::ranges::find(drawn_, pos) != drawn_.end();
+        }));
+  }
+
+  BlockRegistry registry_;
+  BlockId stone_ = kAir;
+  BlockId glass_ = kAir;
+  std::unordered_map<SectionPos, ChunkSection> world_;
+  VisibilityGraph graph_;
+  // sections with a mesh
+  std::vector<SectionPos> drawn_;
+};
+}  // namespace
+
+TEST_F(TestVisibilityGraph, Connectivity) {
+  using enum Direction;
+  ASSERT_EQ(Connectivity([](int, int, int) { return true; }),
+            FaceConnectivity::All());
+  ASSERT_EQ(Connectivity([](int, int, int) { return false; }),
+            FaceConnectivity{});
+  // a sealed cave
+  ASSERT_EQ(Connectivity([](int x, int y, int z) {
+              return x > 2 && x < 12 && y > 2 && y < 12 && z > 2 && z < 12;
+            }),
+            FaceConnectivity{});
+  // fewer than 256 blocks of stone can't wall anything off
+  ASSERT_EQ(Connectivity([](int x, int y, int z) {
+              return y != 8 || (x == 0 && z == 0);
+            }),
+            FaceConnectivity::All());
+
+  // a floor: the sides see each other above and below it, but not across
+  const FaceConnectivity floor =
+      Connectivity([](int, int y, int) { return y != 8; });
+  ASSERT_FALSE(floor.connected(kTop, kBottom));
+  ASSERT_TRUE(floor.connected(kTop, kWest));
+  ASSERT_TRUE(floor.connected(kBottom, kSouth));
+  ASSERT_TRUE(floor.connected(kWest, kEast));
+
+  // a tunnel from the west face bending up to the top face
+  const FaceConnectivity bend = Connectivity([](int x, int y, int z) {
+    return z == 5 && ((y == 4 && x <= 9) || (x == 9 && y >= 4));
+  });
+  for (size_t a = 0; a < kDirectionCount; a++) {
+    for (size_t b = 0; b < kDirectionCount; b++) {
+      const auto first = static_cast<Direction>(a);
+      const auto second = static_cast<Direction>(b);
+      ASSERT_EQ(bend.connected(first, second),
+                (first == kWest || first == kTop) &&
+                    (second == kWest || second == kTop))
+          << a << " " << b;
+    }
+  }
+
+  // transparent blocks don't block
+  PaddedSection glass;
+  for (int32_t y = 0; y < 16; y++) {
+    for (int32_t z = 0; z < 16; z++) {
+      for (int32_t x = 0; x < 16; x++) {
+        glass.Set(x, y, z, y == 8 ? glass_ : stone_);
+      }
+    }
+  }
+  const FaceConnectivity layer = SectionMesher(registry_).Connectivity(glass);
+  ASSERT_TRUE(layer.connected(kWest, kNorth));
+  ASSERT_FALSE(layer.connected(kTop, kBottom));
+
+  // meshing fills it in
+  SectionMesher mesher(registry_);
+  SectionMesh mesh;
+  ASSERT_EQ(mesh.connectivity, FaceConnectivity::All());
+  mesher.Mesh(glass, mesh);
+  ASSERT_EQ(mesh.connectivity, layer);
+  const ChunkSection stone(stone_);
+  const std::array<ChunkSection const *, kDirectionCount> buried{
+      &stone, &stone, &stone, &stone, &stone, &stone};
+  mesher.Mesh(stone, buried, mesh);
+  ASSERT_TRUE(mesh.empty());
+  ASSERT_EQ(mesh.connectivity, FaceConnectivity{});
+  mesher.Mesh(ChunkSection(), buried, mesh);
+  ASSERT_EQ(mesh.connectivity, FaceConnectivity::All());
+}
+
+TEST_F(TestVisibilityGraph, Traverse) {
+  using enum Direction;
+  // a row of open sections with a wall in the middle
+  FaceConnectivity wall;
+  wall.Connect(kNorth, kSouth);
+  for (int32_t x = 0; x < 5; x++) {
+    graph_.Set({x, 0, 0}, x == 2 ? wall : FaceConnectivity::All());
+  }
+  auto visible = graph_.Traverse({0, 0, 0});
+  // the wall itself is seen, not what is behind it
+  ASSERT_EQ(std::vector<SectionPos>(visible.begin(), visible.end()),
+            (std::vector<SectionPos>{{0, 0, 0}, {1, 0, 0}, {2, 0, 0}}));
+
+  // the walk doesn't turn back towards the camera: the detour around the
+  // wall along z 1 would need a step back to the north
+  for (int32_t x = 0; x < 5; x++) {
+    graph_.Set({x, 0, 1}, FaceConnectivity::All());
+  }
+  visible = graph_.Traverse({1, 0, 0});
+  std::vector<SectionPos> seen(visible.begin(), visible.end());
+  ASSERT_EQ(seen.front(), (SectionPos{1, 0, 0}));
+  ASSERT_NE(std::ranges::find(seen, SectionPos{4, 0, 1}), seen.end());
+  ASSERT_EQ(std::ranges::find(seen, SectionPos{3, 0, 0}), seen.end());
+  ASSERT_EQ(seen.size(), 8u);
+
+  // a camera outside the nodes culls nothing
+  ASSERT_EQ(graph_.Traverse({0, 20, 0}).size(), 10u);
+  ASSERT_TRUE(graph_.Remove({4, 0, 1}));
+  ASSERT_FALSE(graph_.Remove({4, 0, 1}));
+  ASSERT_EQ(graph_.Traverse({1, 0, 0}).size(), 7u);
+}
+
+TEST_F(TestVisibilityGraph, World) {
+  BuildWorld();
+  ASSERT_EQ(graph_.size(), size_t{kWorldSize * kWorldSize * 16});
+
+  // in the tunnel only the tunnel is seen, and the stone around the camera
+  auto visible = graph_.Traverse({0, 2, 3});
+  std::vector<SectionPos> tunnel(visible.begin(), visible.end());
+  for (int32_t x = 0; x < kWorldSize; x++) {
+    ASSERT_NE(std::ranges::find(tunnel, SectionPos{x, 2, 3}), tunnel.end());
+  }
+  ASSERT_EQ(tunnel.size(), size_t{kWorldSize + 4});
+  const size_t tunnel_draws = Draws(tunnel);
+
+  // on the surface the ground is seen up to the ridge, and the side of the
+  // ridge, not what is under the ground, on the ridge or behind it
+  visible = graph_.Traverse({1, 8, 4});
+  std::vector<SectionPos> surface(visible.begin(), visible.end());
+  for (SectionPos pos : surface) {
+    ASSERT_GE(pos.y, 7) << pos.x << " " << pos.y << " " << pos.z;
+    ASSERT_TRUE(pos.x < 7 || pos.y >= 12)
+        << pos.x << " " << pos.y << " " << pos.z;
+  }
+  ASSERT_NE(std::ranges::find(surface, SectionPos{4, 7, 0}), surface.end());
+  ASSERT_NE(std::ranges::find(surface, SectionPos{5, 11, 7}), surface.end());
+  ASSERT_EQ(std::ranges::find(surface, SectionPos{6, 11, 7}), surface.end());
+  const size_t surface_draws = Draws(surface);
+
+  // the same walk every time
+  visible = graph_.Traverse({1, 8, 4});
+  ASSERT_TRUE(std::ranges::equal(visible, surface));
+
+  ASSERT_LT(tunnel_draws * 10, drawn_.size());
+  ASSERT_LT(surface_draws * 2, drawn_.size());
+  std::cout << "Sections with a mesh: " << drawn_.size()
+            << ", drawn from the tunnel: " << tunnel_draws
+            << ", from the surface: " << surface_draws << std::endl;
+
+  const auto begin = std::chrono::high_resolution_clock::now();
+  size_t total = 0;
+  for (int i = 0; i < 100; i++) {
+    total += graph_.Traverse({1, 8, 4}).size();
+  }
+  const auto end = std::chrono::high_resolution_clock::now();
+  std::cout << "Traversing " << total / 100 << " of " << graph_.size()
+            << " sections: " << time_diff(begin, end) / 100 << " ms"
+            << std::endl;
+}
@@ -146,6 +146,21 @@ Sammy Sosa: {
   ASSERT_TRUE((entry["Sammy Sosa"]["avg"].to_double() - 0.288) <
               std::numeric_limits<long double>::epsilon());
 }
+TEST(TestYamlParser, TestCollections_IndentedMappingOfMappings) {
+  Entry entry = Parse(R"(type: block
+sides:
+  default: grass_side.png
+  top: grass_top.png
+  bottom:
+hardness: 2)");
+  ASSERT_EQ(entry.size(), 3);
+  ASSERT_TRUE(entry["sides"].is_map());
+  ASSERT_EQ(entry["sides"].size(), 3);
+  ASSERT_EQ(entry["sides"]["default"], "grass_side.png");
+  ASSERT_EQ(entry["sides"]["top"], "grass_top.png");
+  ASSERT_TRUE(entry["sides"]["bottom"].is_null());
+  ASSERT_EQ(entry["hardness"].to_int(), 2);
+}
 #ifndef SKIP_FAILING_TESTS
 TEST(TestYamlParser, TestStructures_TwoDocuments) {
   Entry entry = Parse(R"(
@@ -1,4 +1,7 @@
 #include "utils.hpp"
+
+#include <parsers/yaml/yaml.hpp>
+
 namespace fs = std::filesystem;
 
 static std::random_device rd;
@@ -170,3 +173,14 @@ void CreateFile(fs::path const &path, char const *data, const size_t size) {
   ofs.write(data, size);
   ofs.close();
 }
+
+void RegisterTerrainBlocks(world::BlockRegistry &registry) {
+  for (std::string name :
+       {"stone", "dirt", "grass", "sand", "bedrock", "oak_log"}) {
+    registry.Register("minecraft:" + name,
+                      yaml::Parse("sides:\n  default: " + name + ".png"));
+  }
+  registry.Register(
+      "minecraft:oak_leaves",
+      yaml::Parse("transparent: true\nsides:\n  default: leaves.png"));
+}
@@ -6,6 +6,7 @@
 #include <limits>
 #include <random>
 #include <utils/utils.hpp>
+#include <world/block-registry.hpp>
 
 namespace fs = std::filesystem;
 
@@ -94,6 +95,9 @@ const std::string kAllBinaryCharacters = AllBinaryCharacters();
 [[nodiscard]] std::string RandomFilename(size_t const &size = 32);
 void CreateFile(fs::path const &path, char const *data, const size_t size);
 
+// Registers the blocks the chunk generator places.
+void RegisterTerrainBlocks(world::BlockRegistry &registry);
+
 [[nodiscard]] constexpr double time_diff(
     std::chrono::high_resolution_clock::time_point begin,
     std::chrono::high_resolution_clock::time_point end) {